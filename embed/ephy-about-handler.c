@@ -31,8 +31,11 @@
 #include "ephy-settings.h"
 #include "ephy-smaps.h"
 #include "ephy-snapshot-service.h"
+#include "ephy-trace.h"
 #include "ephy-vcs-version.h"
 #include "ephy-web-app-utils.h"
+#include "ephy-web-extension-proxy.h"
+#include "ephy-web-view.h"
 
 #include <gio/gio.h>
 #include <gtk/gtk.h>
@@ -155,6 +158,150 @@ ephy_about_handler_handle_memory (EphyAboutHandler       *handler,
   return TRUE;
 }
 
+typedef struct {
+  WebKitURISchemeRequest *request;
+  GPtrArray *web_process_summaries;
+  guint pending;
+} PerformanceRequest;
+
+static void
+append_trace_summary (GString    *html,
+                      const char *caption,
+                      GVariant   *summary)
+{
+  GVariantIter iter;
+  const char *category;
+  const char *name;
+  guint32 count;
+  gint64 total;
+  gint64 max;
+  GVariant *histogram;
+
+  g_string_append_printf (html,
+                          "<table class=\"performance-table\"><caption>%s</caption>"
+                          "<thead><tr><th>%s</th><th>%s</th><th>%s</th><th>%s</th><th>%s</th>"
+                          "<th>&lt; 0.1 ms</th><th>&lt; 1 ms</th><th>&lt; 10 ms</th>"
+                          "<th>&lt; 100 ms</th><th>&lt; 1 s</th><th>≥ 1 s</th></tr></thead><tbody>",
+                          caption, _("Subsystem"), _("Event"), _("Count"), _("Mean"), _("Maximum"));
+
+  if (g_variant_n_children (summary) == 0)
+    g_string_append_printf (html, "<tr><td colspan=\"11\">%s</td></tr>", _("No events recorded yet"));
+
+  g_variant_iter_init (&iter, summary);
+  while (g_variant_iter_next (&iter, "(&s&suxx@au)", &category, &name, &count, &total, &max, &histogram)) {
+    const guint32 *buckets;
+    gsize n_buckets;
+    char *row;
+
+    /* Summaries of web processes come over D-Bus, don't trust them. */
+    row = g_markup_printf_escaped ("<tr><td>%s</td><td>%s</td><td>%u</td><td>%.2f ms</td><td>%.2f ms</td>",
+                                   category, name, count,
+                                   total / 1000.0 / MAX (count, 1), max / 1000.0);
+    g_string_append (html, row);
+    g_free (row);
+
+    buckets = g_variant_get_fixed_array (histogram, &n_buckets, sizeof (guint32));
+    for (gsize i = 0; i < EPHY_TRACE_HISTOGRAM_BUCKETS; i++)
+      g_string_append_printf (html, "<td>%u</td>", i < n_buckets ? buckets[i] : 0);
+    g_string_append (html, "</tr>");
+
+    g_variant_unref (histogram);
+  }
+
+  g_string_append (html, "</tbody></table>");
+}
+
+static void
+performance_request_finish (PerformanceRequest *data)
+{
+  EphyHistoryService *history_service;
+  GVariant *summary;
+  GString *html;
+  gsize html_length;
+
+  history_service = ephy_embed_shell_get_global_history_service (ephy_embed_shell_get_default ());
+
+  html = g_string_new ("<html>");
+  g_string_append_printf (html, "<head><title>%s</title>"
+                          "<meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\" />"
+                          "<link href=\""EPHY_PAGE_TEMPLATE_ABOUT_CSS "\" rel=\"stylesheet\" type=\"text/css\">"
+                          "</head><body>",
+                          _("Performance"));
+  g_string_append_printf (html, "<h1>%s</h1>", _("Performance"));
+  g_string_append_printf (html, "<p>%s</p>",
+                          _("Each process counts events from the first time this page asks it for them, or from its start when EPHY_TRACE_DIR is set. Reload the page to update the numbers."));
+  g_string_append_printf (html, "<p>%s %u</p>",
+                          _("Pending history jobs:"),
+                          ephy_history_service_get_queue_length (history_service));
+
+  summary = g_variant_ref_sink (ephy_trace_get_summary ());
+  append_trace_summary (html, _("UI process"), summary);
+  g_variant_unref (summary);
+
+  for (guint i = 0; i < data->web_process_summaries->len; i++) {
+    char *caption = g_strdup_printf (_("Web process %u"), i + 1);
+
+    append_trace_summary (html, caption, g_ptr_array_index (data->web_process_summaries, i));
+    g_free (caption);
+  }
+
+  g_string_append (html, "</body></html>");
+
+  html_length = html->len;
+  ephy_about_handler_finish_request (data->request, g_string_free (html, FALSE), html_length);
+
+  g_object_unref (data->request);
+  g_ptr_array_unref (data->web_process_summaries);
+  g_free (data);
+}
+
+static void
+get_trace_summary_cb (EphyWebExtensionProxy *web_extension,
+                      GAsyncResult          *result,
+                      PerformanceRequest    *data)
+{
+  GVariant *summary;
+
+  /* A web process that did not answer in time is left out. */
+  summary = ephy_web_extension_proxy_get_trace_summary_finish (web_extension, result, NULL);
+  if (summary)
+    g_ptr_array_add (data->web_process_summaries, summary);
+
+  if (--data->pending == 0)
+    performance_request_finish (data);
+}
+
+static gboolean
+ephy_about_handler_handle_performance (EphyAboutHandler       *handler,
+                                       WebKitURISchemeRequest *request)
+{
+  PerformanceRequest *data;
+  GList *web_extensions;
+
+  /* Tracing is cheap but not free, so it only starts once asked for. */
+  ephy_trace_set_enabled (TRUE);
+
+  data = g_new0 (PerformanceRequest, 1);
+  data->request = g_object_ref (request);
+  data->web_process_summaries = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+
+  web_extensions = ephy_embed_shell_get_web_extensions (ephy_embed_shell_get_default ());
+  data->pending = g_list_length (web_extensions) + 1;
+
+  for (GList *l = web_extensions; l; l = l->next) {
+    ephy_web_extension_proxy_get_trace_summary (l->data, NULL,
+                                                (GAsyncReadyCallback)get_trace_summary_cb,
+                                                data);
+  }
+
+  /* The extra count held while the calls are made is dropped here, which also
+   * serves the page right away when there is no web process. */
+  if (--data->pending == 0)
+    performance_request_finish (data);
+
+  return TRUE;
+}
+
 static gboolean
 ephy_about_handler_handle_about (EphyAboutHandler       *handler,
                                  WebKitURISchemeRequest *request)
@@ -313,6 +460,7 @@ history_service_query_urls_cb (EphyHistoryService     *history,
 {
   EphySnapshotService *snapshot_service;
   EphyEmbedShell *shell;
+  WebKitWebView *web_view;
   GString *data_str;
   gsize data_length;
   char *lang;
@@ -321,6 +469,17 @@ history_service_query_urls_cb (EphyHistoryService     *history,
   snapshot_service = ephy_snapshot_service_get_default ();
   shell = ephy_embed_shell_get_default ();
 
+  /* The overview model of this web process may be out of date, as only
+   * processes already showing the overview get updates.
+   */
+  web_view = webkit_uri_scheme_request_get_web_view (request);
+  if (success && EPHY_IS_WEB_VIEW (web_view)) {
+    EphyWebExtensionProxy *web_extension = ephy_web_view_get_web_extension_proxy (EPHY_WEB_VIEW (web_view));
+
+    if (web_extension)
+      ephy_web_extension_proxy_history_update_urls (web_extension, urls);
+  }
+
   data_str = g_string_new (NULL);
 
   lang = g_strdup (pango_language_to_string (gtk_get_default_language ()));
@@ -499,6 +658,8 @@ ephy_about_handler_handle_request (EphyAboutHandler       *handler,
 
   if (!g_strcmp0 (path, "memory"))
     handled = ephy_about_handler_handle_memory (handler, request);
+  else if (!g_strcmp0 (path, "performance"))
+    handled = ephy_about_handler_handle_performance (handler, request);
   else if (!g_strcmp0 (path, "epiphany"))
     handled = ephy_about_handler_handle_epiphany (handler, request);
   else if (!g_strcmp0 (path, "applications") && !ephy_is_running_inside_flatpak ())
@@ -40,7 +40,6 @@
 #include "ephy-profile-utils.h"
 #include "ephy-settings.h"
 #include "ephy-snapshot-service.h"
-#include "ephy-tabs-catalog.h"
 #include "ephy-uri-helpers.h"
 #include "ephy-uri-tester-shared.h"
 #include "ephy-view-source-handler.h"
@@ -53,6 +52,7 @@
 
 #define PAGE_SETUP_FILENAME "page-setup-gtk.ini"
 #define PRINT_SETTINGS_FILENAME "print-settings.ini"
+#define FAVICON_CACHE_SIZE 256
 
 typedef struct {
   WebKitWebContext *web_context;
@@ -73,6 +73,7 @@ typedef struct {
   GList *web_extensions;
   EphyFiltersManager *filters_manager;
   EphySearchEngineManager *search_engine_manager;
+  EphyFaviconCache *favicon_cache;
   GCancellable *cancellable;
 } EphyEmbedShellPrivate;
 
@@ -100,12 +101,8 @@ static GParamSpec *object_properties[N_PROPERTIES] = { NULL, };
 
 static EphyEmbedShell *embed_shell = NULL;
 
-static void ephy_embed_shell_tabs_catalog_iface_init (EphyTabsCatalogInterface *iface);
-
 G_DEFINE_TYPE_WITH_CODE (EphyEmbedShell, ephy_embed_shell, DZL_TYPE_APPLICATION,
-                         G_ADD_PRIVATE (EphyEmbedShell)
-                         G_IMPLEMENT_INTERFACE (EPHY_TYPE_TABS_CATALOG,
-                                                ephy_embed_shell_tabs_catalog_iface_init))
+                         G_ADD_PRIVATE (EphyEmbedShell))
 
 static EphyWebView *
 ephy_embed_shell_get_view_for_page_id (EphyEmbedShell *self,
@@ -147,51 +144,6 @@ ephy_embed_shell_get_extension_proxy_for_page_id (EphyEmbedShell *self,
   return view ? ephy_web_view_get_web_extension_proxy (view) : NULL;
 }
 
-static GList *
-tabs_catalog_get_tabs_info (EphyTabsCatalog *catalog)
-{
-  EphyEmbedShell *embed_shell = EPHY_EMBED_SHELL (catalog);
-  WebKitFaviconDatabase *database;
-  GList *windows;
-  GList *tabs;
-  GList *tabs_info = NULL;
-  const char *title;
-  const char *url;
-  char *favicon;
-
-  windows = gtk_application_get_windows (GTK_APPLICATION (embed_shell));
-  database = webkit_web_context_get_favicon_database (ephy_embed_shell_get_web_context (embed_shell));
-
-  for (GList *l = windows; l && l->data; l = l->next) {
-    tabs = ephy_embed_container_get_children (l->data);
-
-    for (GList *t = tabs; t && t->data; t = t->next) {
-      title = ephy_embed_get_title (t->data);
-
-      if (!g_strcmp0 (title, _(BLANK_PAGE_TITLE)) || !g_strcmp0 (title, _(OVERVIEW_PAGE_TITLE)))
-        continue;
-
-      url = ephy_web_view_get_display_address (ephy_embed_get_web_view (t->data));
-      favicon = webkit_favicon_database_get_favicon_uri (database, url);
-
-      tabs_info = g_list_prepend (tabs_info,
-                                  ephy_tab_info_new (title, url, favicon));
-
-      g_free (favicon);
-    }
-
-    g_list_free (tabs);
-  }
-
-  return tabs_info;
-}
-
-static void
-ephy_embed_shell_tabs_catalog_iface_init (EphyTabsCatalogInterface *iface)
-{
-  iface->get_tabs_info = tabs_catalog_get_tabs_info;
-}
-
 static void
 ephy_embed_shell_dispose (GObject *object)
 {
@@ -218,6 +170,7 @@ ephy_embed_shell_dispose (GObject *object)
   g_clear_object (&priv->dbus_server);
   g_clear_object (&priv->filters_manager);
   g_clear_object (&priv->search_engine_manager);
+  g_clear_object (&priv->favicon_cache);
 
   G_OBJECT_CLASS (ephy_embed_shell_parent_class)->dispose (object);
 }
@@ -248,16 +201,26 @@ history_service_query_urls_cb (EphyHistoryService *service,
                                GList              *urls,
                                EphyEmbedShell     *shell)
 {
-  EphyEmbedShellPrivate *priv = ephy_embed_shell_get_instance_private (shell);
+  GList *windows;
   GList *l;
 
   if (!success)
     return;
 
-  for (l = priv->web_extensions; l; l = g_list_next (l)) {
-    EphyWebExtensionProxy *web_extension = (EphyWebExtensionProxy *)l->data;
+  /* Other web processes are brought up to date when they load the
+   * overview, see ephy-about-handler.c.
+   */
+  windows = gtk_application_get_windows (GTK_APPLICATION (shell));
+  for (l = windows; l && l->data; l = l->next) {
+    g_autoptr(GList) tabs = ephy_embed_container_get_children (l->data);
 
-    ephy_web_extension_proxy_history_set_urls (web_extension, urls);
+    for (GList *t = tabs; t && t->data; t = t->next) {
+      EphyWebView *view = ephy_embed_get_web_view (t->data);
+      EphyWebExtensionProxy *web_extension = ephy_web_view_get_web_extension_proxy (view);
+
+      if (web_extension && ephy_web_view_is_overview (view))
+        ephy_web_extension_proxy_history_update_urls (web_extension, urls);
+    }
   }
 
   for (l = urls; l; l = g_list_next (l))
@@ -1785,6 +1748,17 @@ ephy_embed_shell_get_search_engine_manager (EphyEmbedShell *shell)
   return priv->search_engine_manager;
 }
 
+EphyFaviconCache *
+ephy_embed_shell_get_favicon_cache (EphyEmbedShell *shell)
+{
+  EphyEmbedShellPrivate *priv = ephy_embed_shell_get_instance_private (shell);
+
+  if (!priv->favicon_cache)
+    priv->favicon_cache = ephy_favicon_cache_new (webkit_web_context_get_favicon_database (priv->web_context),
+                                                  FAVICON_CACHE_SIZE);
+  return priv->favicon_cache;
+}
+
 EphyPasswordManager *
 ephy_embed_shell_get_password_manager (EphyEmbedShell *shell)
 {
@@ -1792,3 +1766,18 @@ ephy_embed_shell_get_password_manager (EphyEmbedShell *shell)
 
   return priv->password_manager;
 }
+
+/**
+ * ephy_embed_shell_get_web_extensions:
+ * @shell: the #EphyEmbedShell
+ *
+ * Returns: (transfer none) (element-type EphyWebExtensionProxy): the proxies
+ * of the connected web processes
+ **/
+GList *
+ephy_embed_shell_get_web_extensions (EphyEmbedShell *shell)
+{
+  EphyEmbedShellPrivate *priv = ephy_embed_shell_get_instance_private (shell);
+
+  return priv->web_extensions;
+}
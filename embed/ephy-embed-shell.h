@@ -26,6 +26,7 @@
 
 #include "ephy-downloads-manager.h"
 #include "ephy-encodings.h"
+#include "ephy-favicon-cache.h"
 #include "ephy-gsb-service.h"
 #include "ephy-history-service.h"
 #include "ephy-password-manager.h"
@@ -82,6 +83,8 @@ WebKitUserContentManager *ephy_embed_shell_get_user_content_manager (EphyEmbedSh
 EphyDownloadsManager     *ephy_embed_shell_get_downloads_manager    (EphyEmbedShell *shell);
 EphyPermissionsManager   *ephy_embed_shell_get_permissions_manager  (EphyEmbedShell *shell);
 EphySearchEngineManager  *ephy_embed_shell_get_search_engine_manager (EphyEmbedShell *shell);
+EphyFaviconCache         *ephy_embed_shell_get_favicon_cache         (EphyEmbedShell *shell);
 EphyPasswordManager      *ephy_embed_shell_get_password_manager      (EphyEmbedShell *shell);
+GList                    *ephy_embed_shell_get_web_extensions        (EphyEmbedShell *shell);
 
 G_END_DECLS
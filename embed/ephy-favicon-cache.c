@@ -0,0 +1,352 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ephy-favicon-cache.h"
+
+#include "ephy-string.h"
+
+#define FAVICON_SIZE 16
+
+struct _EphyFaviconCache {
+  GObject parent_instance;
+
+  WebKitFaviconDatabase *database;
+  GCancellable *cancellable;
+  guint max_entries;
+
+  /* Most recently used first. */
+  GQueue entries;
+  GHashTable *links;
+
+  /* Tasks waiting for a favicon, by host. */
+  GHashTable *pending;
+};
+
+typedef struct {
+  char *host;
+  cairo_surface_t *favicon;
+} CacheEntry;
+
+typedef struct {
+  EphyFaviconCache *cache;
+  char *host;
+} LoadData;
+
+G_DEFINE_TYPE (EphyFaviconCache, ephy_favicon_cache, G_TYPE_OBJECT)
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+  g_free (entry->host);
+  g_clear_pointer (&entry->favicon, cairo_surface_destroy);
+  g_free (entry);
+}
+
+/* Pages without a scheme-based host, like file: URIs, are cached by URL. */
+static char *
+get_cache_key (const char *url)
+{
+  char *host = ephy_string_get_host_name (url);
+
+  return host ? host : g_strdup (url);
+}
+
+static void
+remove_entry (EphyFaviconCache *self,
+              GList            *link)
+{
+  CacheEntry *entry = link->data;
+
+  g_hash_table_remove (self->links, entry->host);
+  g_queue_delete_link (&self->entries, link);
+  cache_entry_free (entry);
+}
+
+static void
+insert_entry (EphyFaviconCache *self,
+              const char       *host,
+              cairo_surface_t  *favicon)
+{
+  CacheEntry *entry;
+  GList *link;
+
+  link = g_hash_table_lookup (self->links, host);
+  if (link)
+    remove_entry (self, link);
+
+  entry = g_new0 (CacheEntry, 1);
+  entry->host = g_strdup (host);
+  entry->favicon = favicon ? cairo_surface_reference (favicon) : NULL;
+
+  g_queue_push_head (&self->entries, entry);
+  g_hash_table_insert (self->links, entry->host, self->entries.head);
+
+  while (self->entries.length > self->max_entries)
+    remove_entry (self, self->entries.tail);
+}
+
+static void
+favicon_changed_cb (WebKitFaviconDatabase *database,
+                    const char            *page_uri,
+                    const char            *favicon_uri,
+                    EphyFaviconCache      *self)
+{
+  g_autofree char *host = get_cache_key (page_uri);
+  GList *link;
+
+  link = g_hash_table_lookup (self->links, host);
+  if (link)
+    remove_entry (self, link);
+}
+
+static void
+ephy_favicon_cache_dispose (GObject *object)
+{
+  EphyFaviconCache *self = EPHY_FAVICON_CACHE (object);
+
+  if (self->cancellable) {
+    g_cancellable_cancel (self->cancellable);
+    g_clear_object (&self->cancellable);
+  }
+
+  g_clear_object (&self->database);
+
+  G_OBJECT_CLASS (ephy_favicon_cache_parent_class)->dispose (object);
+}
+
+static void
+ephy_favicon_cache_finalize (GObject *object)
+{
+  EphyFaviconCache *self = EPHY_FAVICON_CACHE (object);
+
+  g_queue_foreach (&self->entries, (GFunc)cache_entry_free, NULL);
+  g_queue_clear (&self->entries);
+  g_hash_table_unref (self->links);
+  g_hash_table_unref (self->pending);
+
+  G_OBJECT_CLASS (ephy_favicon_cache_parent_class)->finalize (object);
+}
+
+static void
+ephy_favicon_cache_class_init (EphyFaviconCacheClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = ephy_favicon_cache_dispose;
+  object_class->finalize = ephy_favicon_cache_finalize;
+}
+
+static void
+ephy_favicon_cache_init (EphyFaviconCache *self)
+{
+  self->cancellable = g_cancellable_new ();
+  g_queue_init (&self->entries);
+  self->links = g_hash_table_new (g_str_hash, g_str_equal);
+  self->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+}
+
+/**
+ * ephy_favicon_cache_new:
+ * @database: the favicon database to load from
+ * @max_entries: how many hosts to keep favicons for
+ *
+ * Creates a cache of decoded favicons, keyed by the host of the page they
+ * belong to, that keeps the @max_entries most recently used ones.
+ *
+ * Returns: (transfer full): a new #EphyFaviconCache
+ **/
+EphyFaviconCache *
+ephy_favicon_cache_new (WebKitFaviconDatabase *database,
+                        guint                  max_entries)
+{
+  EphyFaviconCache *self;
+
+  g_assert (WEBKIT_IS_FAVICON_DATABASE (database));
+  g_assert (max_entries > 0);
+
+  self = g_object_new (EPHY_TYPE_FAVICON_CACHE, NULL);
+  self->database = g_object_ref (database);
+  self->max_entries = max_entries;
+
+  g_signal_connect_object (database, "favicon-changed",
+                           G_CALLBACK (favicon_changed_cb), self, 0);
+
+  return self;
+}
+
+/**
+ * ephy_favicon_cache_lookup:
+ * @self: an #EphyFaviconCache
+ * @url: the page to look up
+ * @favicon: (out) (transfer none) (nullable): the favicon of the host of
+ *   @url, or %NULL if it is known not to have one
+ *
+ * Returns: %TRUE if the favicon of the host of @url is cached, in which
+ * case it becomes the most recently used
+ **/
+gboolean
+ephy_favicon_cache_lookup (EphyFaviconCache  *self,
+                           const char        *url,
+                           cairo_surface_t  **favicon)
+{
+  g_autofree char *host = NULL;
+  GList *link;
+
+  g_assert (EPHY_IS_FAVICON_CACHE (self));
+  g_assert (url != NULL);
+
+  host = get_cache_key (url);
+  link = g_hash_table_lookup (self->links, host);
+  if (!link)
+    return FALSE;
+
+  g_queue_unlink (&self->entries, link);
+  g_queue_push_head_link (&self->entries, link);
+
+  *favicon = ((CacheEntry *)link->data)->favicon;
+  return TRUE;
+}
+
+static void
+icon_loaded_cb (GObject      *source,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  LoadData *data = user_data;
+  EphyFaviconCache *self = data->cache;
+  GPtrArray *tasks;
+  cairo_surface_t *favicon;
+  GError *error = NULL;
+
+  favicon = webkit_favicon_database_get_favicon_finish (WEBKIT_FAVICON_DATABASE (source), result, &error);
+  if (favicon) {
+    /* Suggestions draw favicons at 16 pixels. */
+    cairo_surface_set_device_scale (favicon,
+                                    (double)cairo_image_surface_get_width (favicon) / FAVICON_SIZE,
+                                    (double)cairo_image_surface_get_height (favicon) / FAVICON_SIZE);
+    insert_entry (self, data->host, favicon);
+  } else if (g_error_matches (error, WEBKIT_FAVICON_DATABASE_ERROR, WEBKIT_FAVICON_DATABASE_ERROR_FAVICON_NOT_FOUND) ||
+             g_error_matches (error, WEBKIT_FAVICON_DATABASE_ERROR, WEBKIT_FAVICON_DATABASE_ERROR_FAVICON_UNKNOWN)) {
+    /* Don't ask again for every keystroke; favicon-changed drops this. */
+    insert_entry (self, data->host, NULL);
+    g_clear_error (&error);
+  }
+
+  tasks = g_ptr_array_ref (g_hash_table_lookup (self->pending, data->host));
+  g_hash_table_remove (self->pending, data->host);
+
+  for (guint i = 0; i < tasks->len; i++) {
+    GTask *task = tasks->pdata[i];
+
+    if (error)
+      g_task_return_error (task, g_error_copy (error));
+    else
+      g_task_return_pointer (task,
+                             favicon ? cairo_surface_reference (favicon) : NULL,
+                             (GDestroyNotify)cairo_surface_destroy);
+  }
+
+  g_ptr_array_unref (tasks);
+  g_clear_pointer (&favicon, cairo_surface_destroy);
+  g_clear_error (&error);
+
+  g_object_unref (data->cache);
+  g_free (data->host);
+  g_free (data);
+}
+
+/**
+ * ephy_favicon_cache_load_async:
+ * @self: an #EphyFaviconCache
+ * @url: the page whose favicon to load
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: called when the favicon is loaded
+ * @user_data: data for @callback
+ *
+ * Loads the favicon of the host of @url from the favicon database and
+ * caches it. Requests for a host that is already being loaded share the
+ * same database request.
+ **/
+void
+ephy_favicon_cache_load_async (EphyFaviconCache    *self,
+                               const char          *url,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  g_autofree char *host = NULL;
+  cairo_surface_t *favicon;
+  GPtrArray *tasks;
+  GTask *task;
+  LoadData *data;
+
+  g_assert (EPHY_IS_FAVICON_CACHE (self));
+  g_assert (url != NULL);
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ephy_favicon_cache_load_async);
+
+  if (ephy_favicon_cache_lookup (self, url, &favicon)) {
+    g_task_return_pointer (task,
+                           favicon ? cairo_surface_reference (favicon) : NULL,
+                           (GDestroyNotify)cairo_surface_destroy);
+    g_object_unref (task);
+    return;
+  }
+
+  host = get_cache_key (url);
+  tasks = g_hash_table_lookup (self->pending, host);
+  if (tasks) {
+    g_ptr_array_add (tasks, task);
+    return;
+  }
+
+  tasks = g_ptr_array_new_with_free_func (g_object_unref);
+  g_ptr_array_add (tasks, task);
+  g_hash_table_insert (self->pending, g_strdup (host), tasks);
+
+  data = g_new (LoadData, 1);
+  data->cache = g_object_ref (self);
+  data->host = g_steal_pointer (&host);
+
+  webkit_favicon_database_get_favicon (self->database, url, self->cancellable,
+                                       icon_loaded_cb, data);
+}
+
+/**
+ * ephy_favicon_cache_load_finish:
+ * @self: an #EphyFaviconCache
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError
+ *
+ * Returns: (transfer full) (nullable): the favicon, or %NULL if the page
+ * has none or on error
+ **/
+cairo_surface_t *
+ephy_favicon_cache_load_finish (EphyFaviconCache  *self,
+                                GAsyncResult      *result,
+                                GError           **error)
+{
+  g_assert (EPHY_IS_FAVICON_CACHE (self));
+  g_assert (g_task_is_valid (result, self));
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
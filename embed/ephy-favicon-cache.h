@@ -0,0 +1,46 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cairo.h>
+#include <webkit2/webkit2.h>
+
+G_BEGIN_DECLS
+
+#define EPHY_TYPE_FAVICON_CACHE (ephy_favicon_cache_get_type ())
+
+G_DECLARE_FINAL_TYPE (EphyFaviconCache, ephy_favicon_cache, EPHY, FAVICON_CACHE, GObject)
+
+EphyFaviconCache *ephy_favicon_cache_new         (WebKitFaviconDatabase  *database,
+                                                  guint                   max_entries);
+gboolean          ephy_favicon_cache_lookup      (EphyFaviconCache       *self,
+                                                  const char             *url,
+                                                  cairo_surface_t       **favicon);
+void              ephy_favicon_cache_load_async  (EphyFaviconCache       *self,
+                                                  const char             *url,
+                                                  GCancellable           *cancellable,
+                                                  GAsyncReadyCallback     callback,
+                                                  gpointer                user_data);
+cairo_surface_t  *ephy_favicon_cache_load_finish (EphyFaviconCache       *self,
+                                                  GAsyncResult           *result,
+                                                  GError                **error);
+
+G_END_DECLS
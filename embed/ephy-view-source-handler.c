@@ -23,12 +23,17 @@
 
 #include "ephy-embed-container.h"
 #include "ephy-embed-shell.h"
+#include "ephy-view-source-stream.h"
 #include "ephy-web-view.h"
 
 #include <gio/gio.h>
 #include <glib/gi18n.h>
 #include <string.h>
 
+/* Highlighting costs far more than escaping, so huge documents (typically
+ * minified scripts) are shown as plain text. */
+#define HIGHLIGHT_MAX_SIZE (2 * 1024 * 1024)
+
 struct _EphyViewSourceHandler {
   GObject parent_instance;
 
@@ -79,22 +84,15 @@ ephy_view_source_request_free (EphyViewSourceRequest *request)
 
 static void
 finish_uri_scheme_request (EphyViewSourceRequest *request,
-                           gchar                 *data,
+                           GInputStream          *stream,
                            GError                *error)
 {
-  GInputStream *stream;
-  gssize data_length;
-
-  g_assert ((data && !error) || (!data && error));
+  g_assert ((stream && !error) || (!stream && error));
 
-  if (error) {
+  if (error)
     webkit_uri_scheme_request_finish_error (request->scheme_request, error);
-  } else {
-    data_length = MIN (strlen (data), G_MAXSSIZE);
-    stream = g_memory_input_stream_new_from_data (data, data_length, g_free);
-    webkit_uri_scheme_request_finish (request->scheme_request, stream, data_length, "text/html");
-    g_object_unref (stream);
-  }
+  else
+    webkit_uri_scheme_request_finish (request->scheme_request, stream, -1, "text/html");
 
   request->source_handler->outstanding_requests =
       g_list_remove (request->source_handler->outstanding_requests,
@@ -109,10 +107,9 @@ web_resource_data_cb (WebKitWebResource     *resource,
                       EphyViewSourceRequest *request)
 {
   guchar *data;
-  char *data_str;
-  char *escaped_str;
-  char *html;
   gsize length;
+  GBytes *source;
+  GInputStream *stream;
   GError *error = NULL;
 
   data = webkit_web_resource_get_data_finish (resource, result, &length, &error);
@@ -122,23 +119,13 @@ web_resource_data_cb (WebKitWebResource     *resource,
     return;
   }
 
-  data_str = g_malloc (length + 1);
-  strncpy (data_str, (const char *)data, length);
-  data_str[length] = '\0';
-  g_free (data);
-
-  escaped_str = g_markup_escape_text (data_str, -1);
-  g_free (data_str);
-
-  html = g_strdup_printf ("<body>"
-                            "<pre>"
-                              "<code class=\"language-html\">%s</code>"
-                            "</pre>"
-                          "</body>",
-                          escaped_str);
-  g_free (escaped_str);
+  /* The page is escaped as WebKit reads it, without copying the source. */
+  source = g_bytes_new_take (data, length);
+  stream = ephy_view_source_stream_new (source, length <= HIGHLIGHT_MAX_SIZE);
+  g_bytes_unref (source);
 
-  finish_uri_scheme_request (request, html, NULL);
+  finish_uri_scheme_request (request, stream, NULL);
+  g_object_unref (stream);
 }
 
 static void
@@ -0,0 +1,353 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ephy-view-source-stream.h"
+
+#include <string.h>
+
+/* Amount of source escaped at a time. Each source byte expands to at most a
+ * few dozen bytes of markup, which bounds the memory used while reading. */
+#define SOURCE_CHUNK_SIZE (16 * 1024)
+
+typedef enum {
+  STAGE_HEADER,
+  STAGE_BODY,
+  STAGE_DONE
+} Stage;
+
+/* A deliberately small HTML lexer: it only tells tags, attribute values and
+ * comments apart, which is enough for highlighting and can resume at any
+ * byte, so chunk boundaries don't matter. */
+typedef enum {
+  LEXER_TEXT,
+  LEXER_TAG,
+  LEXER_VALUE,
+  LEXER_COMMENT
+} LexerState;
+
+struct _EphyViewSourceStream {
+  GInputStream parent_instance;
+
+  GBytes *source;
+  gsize source_offset;
+  gboolean highlight;
+
+  Stage stage;
+  GString *pending;
+  gsize pending_offset;
+
+  LexerState lexer_state;
+  char quote;
+  guint tag_length;
+  guint comment_prefix;
+  guint dash_count;
+};
+
+G_DEFINE_TYPE (EphyViewSourceStream, ephy_view_source_stream, G_TYPE_INPUT_STREAM)
+
+static const char header[] =
+  "<body>"
+  "<pre>"
+  "<code class=\"language-html\">";
+
+static const char highlight_header[] =
+  "<head>"
+  "<style>"
+  ".tag { color: #204a87; }"
+  ".value { color: #4e9a06; }"
+  ".comment { color: #888a85; }"
+  "</style>"
+  "</head>";
+
+static const char footer[] =
+  "</code>"
+  "</pre>"
+  "</body>";
+
+static inline gboolean
+needs_escaping (char c)
+{
+  return c == '&' || c == '<' || c == '>' || c == '"' || c == '\'' || c == '\0';
+}
+
+static inline void
+append_escaped (GString *out,
+                char     c)
+{
+  switch (c) {
+    case '&':
+      g_string_append (out, "&amp;");
+      break;
+    case '<':
+      g_string_append (out, "&lt;");
+      break;
+    case '>':
+      g_string_append (out, "&gt;");
+      break;
+    case '"':
+      g_string_append (out, "&quot;");
+      break;
+    case '\'':
+      g_string_append (out, "&#39;");
+      break;
+    case '\0':
+      /* Not allowed in HTML text. */
+      break;
+    default:
+      g_string_append_c (out, c);
+      break;
+  }
+}
+
+static void
+escape_chunk (EphyViewSourceStream *self,
+              const char           *data,
+              gsize                 length)
+{
+  gsize i = 0;
+
+  while (i < length) {
+    gsize run_start = i;
+
+    while (i < length && !needs_escaping (data[i]))
+      i++;
+    g_string_append_len (self->pending, data + run_start, i - run_start);
+
+    if (i < length)
+      append_escaped (self->pending, data[i++]);
+  }
+}
+
+static void
+highlight_char (EphyViewSourceStream *self,
+                char                  c)
+{
+  GString *out = self->pending;
+
+  switch (self->lexer_state) {
+    case LEXER_TEXT:
+      if (c == '<') {
+        g_string_append (out, "<span class=\"tag\">&lt;");
+        self->lexer_state = LEXER_TAG;
+        self->tag_length = 0;
+        self->comment_prefix = 0;
+        return;
+      }
+      break;
+    case LEXER_TAG:
+      self->tag_length++;
+      if (c == '>') {
+        g_string_append (out, "&gt;</span>");
+        self->lexer_state = LEXER_TEXT;
+        return;
+      }
+      if (c == '"' || c == '\'') {
+        g_string_append (out, "<span class=\"value\">");
+        append_escaped (out, c);
+        self->lexer_state = LEXER_VALUE;
+        self->quote = c;
+        return;
+      }
+      /* Counts the characters of "<!--" seen so far. */
+      if (self->comment_prefix == self->tag_length - 1 && self->tag_length <= 3 &&
+          c == "!--"[self->tag_length - 1]) {
+        self->comment_prefix++;
+        if (self->comment_prefix == 3) {
+          g_string_append (out, "-</span><span class=\"comment\">");
+          self->lexer_state = LEXER_COMMENT;
+          self->dash_count = 0;
+          return;
+        }
+      }
+      break;
+    case LEXER_VALUE:
+      if (c == self->quote) {
+        append_escaped (out, c);
+        g_string_append (out, "</span>");
+        self->lexer_state = LEXER_TAG;
+        return;
+      }
+      break;
+    case LEXER_COMMENT:
+      if (c == '>' && self->dash_count >= 2) {
+        g_string_append (out, "&gt;</span>");
+        self->lexer_state = LEXER_TEXT;
+        return;
+      }
+      self->dash_count = c == '-' ? self->dash_count + 1 : 0;
+      break;
+    default:
+      g_assert_not_reached ();
+  }
+
+  append_escaped (out, c);
+}
+
+static void
+highlight_chunk (EphyViewSourceStream *self,
+                 const char           *data,
+                 gsize                 length)
+{
+  for (gsize i = 0; i < length; i++)
+    highlight_char (self, data[i]);
+}
+
+static void
+close_open_spans (EphyViewSourceStream *self)
+{
+  switch (self->lexer_state) {
+    case LEXER_VALUE:
+      g_string_append (self->pending, "</span></span>");
+      break;
+    case LEXER_TAG:
+    case LEXER_COMMENT:
+      g_string_append (self->pending, "</span>");
+      break;
+    case LEXER_TEXT:
+    default:
+      break;
+  }
+}
+
+/* Replaces the pending markup with the next piece of output. Returns FALSE
+ * once everything has been produced. */
+static gboolean
+fill_pending (EphyViewSourceStream *self)
+{
+  const char *data;
+  gsize size;
+  gsize length;
+
+  g_string_truncate (self->pending, 0);
+  self->pending_offset = 0;
+
+  switch (self->stage) {
+    case STAGE_HEADER:
+      if (self->highlight)
+        g_string_append (self->pending, highlight_header);
+      g_string_append (self->pending, header);
+      self->stage = STAGE_BODY;
+      break;
+    case STAGE_BODY:
+      data = g_bytes_get_data (self->source, &size);
+      if (self->source_offset < size) {
+        length = MIN (size - self->source_offset, SOURCE_CHUNK_SIZE);
+        if (self->highlight)
+          highlight_chunk (self, data + self->source_offset, length);
+        else
+          escape_chunk (self, data + self->source_offset, length);
+        self->source_offset += length;
+      } else {
+        if (self->highlight)
+          close_open_spans (self);
+        g_string_append (self->pending, footer);
+        self->stage = STAGE_DONE;
+      }
+      break;
+    case STAGE_DONE:
+      return FALSE;
+    default:
+      g_assert_not_reached ();
+  }
+
+  return TRUE;
+}
+
+static gssize
+ephy_view_source_stream_read (GInputStream  *stream,
+                              void          *buffer,
+                              gsize          count,
+                              GCancellable  *cancellable,
+                              GError       **error)
+{
+  EphyViewSourceStream *self = EPHY_VIEW_SOURCE_STREAM (stream);
+  gsize written = 0;
+
+  while (written < count) {
+    gsize available = self->pending->len - self->pending_offset;
+    gsize n;
+
+    if (available == 0) {
+      if (!fill_pending (self))
+        break;
+      continue;
+    }
+
+    n = MIN (available, count - written);
+    memcpy ((char *)buffer + written, self->pending->str + self->pending_offset, n);
+    self->pending_offset += n;
+    written += n;
+  }
+
+  return written;
+}
+
+static void
+ephy_view_source_stream_finalize (GObject *object)
+{
+  EphyViewSourceStream *self = EPHY_VIEW_SOURCE_STREAM (object);
+
+  g_bytes_unref (self->source);
+  g_string_free (self->pending, TRUE);
+
+  G_OBJECT_CLASS (ephy_view_source_stream_parent_class)->finalize (object);
+}
+
+static void
+ephy_view_source_stream_class_init (EphyViewSourceStreamClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GInputStreamClass *input_stream_class = G_INPUT_STREAM_CLASS (klass);
+
+  object_class->finalize = ephy_view_source_stream_finalize;
+
+  input_stream_class->read_fn = ephy_view_source_stream_read;
+}
+
+static void
+ephy_view_source_stream_init (EphyViewSourceStream *self)
+{
+  self->pending = g_string_sized_new (SOURCE_CHUNK_SIZE * 2);
+}
+
+/**
+ * ephy_view_source_stream_new:
+ * @source: the document source
+ * @highlight: whether to mark up tags, attribute values and comments
+ *
+ * Creates a stream producing an HTML page that shows @source. The source
+ * is escaped piece by piece as the stream is read, so the page is never
+ * held in memory in full.
+ *
+ * Returns: (transfer full): a new #GInputStream
+ **/
+GInputStream *
+ephy_view_source_stream_new (GBytes   *source,
+                             gboolean  highlight)
+{
+  EphyViewSourceStream *self;
+
+  self = g_object_new (EPHY_TYPE_VIEW_SOURCE_STREAM, NULL);
+  self->source = g_bytes_ref (source);
+  self->highlight = highlight;
+
+  return G_INPUT_STREAM (self);
+}
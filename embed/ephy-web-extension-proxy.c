@@ -25,6 +25,8 @@
 #include "ephy-dbus-names.h"
 #include "ephy-history-service.h"
 
+#include <libsoup/soup.h>
+
 struct _EphyWebExtensionProxy {
   GObject parent_instance;
 
@@ -34,6 +36,9 @@ struct _EphyWebExtensionProxy {
 
   guint page_created_signal_id;
   guint autofill_signal_id;
+
+  /* Overview URLs as last sent to the web process. */
+  GPtrArray *overview_urls;
 };
 
 enum {
@@ -71,6 +76,7 @@ ephy_web_extension_proxy_dispose (GObject *object)
 
   g_clear_object (&web_extension->proxy);
   g_clear_object (&web_extension->connection);
+  g_clear_pointer (&web_extension->overview_urls, g_ptr_array_unref);
 
   G_OBJECT_CLASS (ephy_web_extension_proxy_parent_class)->dispose (object);
 }
@@ -78,6 +84,7 @@ ephy_web_extension_proxy_dispose (GObject *object)
 static void
 ephy_web_extension_proxy_init (EphyWebExtensionProxy *web_extension)
 {
+  web_extension->overview_urls = g_ptr_array_new_with_free_func ((GDestroyNotify)ephy_history_url_free);
 }
 
 static void
@@ -287,32 +294,110 @@ ephy_web_extension_proxy_autofill (EphyWebExtensionProxy *web_extension,
                      NULL, NULL);
 }
 
-void
-ephy_web_extension_proxy_history_set_urls (EphyWebExtensionProxy *web_extension,
-                                           GList                 *urls)
+static int
+find_overview_url (GPtrArray  *urls,
+                   const char *url,
+                   guint       from)
 {
-  GList *l;
-  GVariantBuilder builder;
+  for (guint i = from; i < urls->len; i++) {
+    EphyHistoryURL *sent = g_ptr_array_index (urls, i);
 
-  if (!web_extension->proxy)
-    return;
+    if (!g_strcmp0 (sent->url, url))
+      return i;
+  }
 
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ss)"));
-  for (l = urls; l; l = g_list_next (l)) {
-    EphyHistoryURL *url = (EphyHistoryURL *)l->data;
+  return -1;
+}
 
-    g_variant_builder_add (&builder, "(ss)", url->url, url->title);
-  }
+static void
+history_insert_url (EphyWebExtensionProxy *web_extension,
+                    guint                  index,
+                    EphyHistoryURL        *url)
+{
+  g_dbus_proxy_call (web_extension->proxy,
+                     "HistoryInsertURL",
+                     g_variant_new ("(uss)", index, url->url, url->title),
+                     G_DBUS_CALL_FLAGS_NONE,
+                     -1,
+                     web_extension->cancellable,
+                     NULL, NULL);
+}
 
+static void
+history_move_url (EphyWebExtensionProxy *web_extension,
+                  const char            *url,
+                  guint                  index)
+{
   g_dbus_proxy_call (web_extension->proxy,
-                     "HistorySetURLs",
-                     g_variant_new ("(@a(ss))", g_variant_builder_end (&builder)),
+                     "HistoryMoveURL",
+                     g_variant_new ("(su)", url, index),
                      G_DBUS_CALL_FLAGS_NONE,
                      -1,
                      web_extension->cancellable,
                      NULL, NULL);
 }
 
+/**
+ * ephy_web_extension_proxy_history_update_urls:
+ * @web_extension: an #EphyWebExtensionProxy
+ * @urls: (element-type EphyHistoryURL): the overview URLs, in order
+ *
+ * Brings the overview model of the web process up to date with @urls,
+ * sending only the items that were removed, inserted, moved or renamed
+ * since the last update.
+ */
+void
+ephy_web_extension_proxy_history_update_urls (EphyWebExtensionProxy *web_extension,
+                                              GList                 *urls)
+{
+  GPtrArray *sent = web_extension->overview_urls;
+  g_autoptr(GHashTable) wanted = NULL;
+  guint i = 0;
+
+  if (!web_extension->proxy)
+    return;
+
+  wanted = g_hash_table_new (g_str_hash, g_str_equal);
+  for (GList *l = urls; l; l = g_list_next (l))
+    g_hash_table_add (wanted, ((EphyHistoryURL *)l->data)->url);
+
+  for (guint j = sent->len; j > 0; j--) {
+    EphyHistoryURL *url = g_ptr_array_index (sent, j - 1);
+
+    if (!g_hash_table_contains (wanted, url->url))
+      ephy_web_extension_proxy_history_delete_url (web_extension, url->url);
+  }
+
+  /* Items before i are in place, so each URL is either found at or
+   * after i, or is new.
+   */
+  for (GList *l = urls; l; l = g_list_next (l), i++) {
+    EphyHistoryURL *url = (EphyHistoryURL *)l->data;
+    EphyHistoryURL *item;
+    int index;
+
+    index = find_overview_url (sent, url->url, i);
+    if (index == -1) {
+      history_insert_url (web_extension, i, url);
+      g_ptr_array_insert (sent, i, ephy_history_url_copy (url));
+      continue;
+    }
+
+    if ((guint)index != i) {
+      history_move_url (web_extension, url->url, i);
+      g_ptr_array_insert (sent, i, ephy_history_url_copy (g_ptr_array_index (sent, index)));
+      g_ptr_array_remove_index (sent, index + 1);
+    }
+
+    item = g_ptr_array_index (sent, i);
+    if (g_strcmp0 (item->title, url->title)) {
+      ephy_web_extension_proxy_history_set_url_title (web_extension, url->url, url->title);
+      g_free (item->title);
+      item->title = g_strdup (url->title);
+    }
+  }
+}
+
 void
 ephy_web_extension_proxy_history_set_url_thumbnail (EphyWebExtensionProxy *web_extension,
                                                     const char            *url,
@@ -351,6 +436,8 @@ void
 ephy_web_extension_proxy_history_delete_url (EphyWebExtensionProxy *web_extension,
                                              const char            *url)
 {
+  int index;
+
   if (!web_extension->proxy)
     return;
 
@@ -361,6 +448,11 @@ ephy_web_extension_proxy_history_delete_url (EphyWebExtensionProxy *web_extensio
                      -1,
                      web_extension->cancellable,
                      NULL, NULL);
+
+  /* Last, as url may belong to the removed item. */
+  index = find_overview_url (web_extension->overview_urls, url, 0);
+  if (index != -1)
+    g_ptr_array_remove_index (web_extension->overview_urls, index);
 }
 
 void
@@ -370,6 +462,16 @@ ephy_web_extension_proxy_history_delete_host (EphyWebExtensionProxy *web_extensi
   if (!web_extension->proxy)
     return;
 
+  for (guint i = web_extension->overview_urls->len; i > 0; i--) {
+    EphyHistoryURL *url = g_ptr_array_index (web_extension->overview_urls, i - 1);
+    SoupURI *uri = soup_uri_new (url->url);
+
+    if (!g_strcmp0 (uri ? soup_uri_get_host (uri) : NULL, host))
+      g_ptr_array_remove_index (web_extension->overview_urls, i - 1);
+
+    g_clear_pointer (&uri, soup_uri_free);
+  }
+
   g_dbus_proxy_call (web_extension->proxy,
                      "HistoryDeleteHost",
                      g_variant_new ("(s)", host),
@@ -385,6 +487,8 @@ ephy_web_extension_proxy_history_clear (EphyWebExtensionProxy *web_extension)
   if (!web_extension->proxy)
     return;
 
+  g_ptr_array_set_size (web_extension->overview_urls, 0);
+
   g_dbus_proxy_call (web_extension->proxy,
                      "HistoryClear",
                      NULL,
@@ -434,4 +538,63 @@ ephy_web_extension_proxy_password_query_response (EphyWebExtensionProxy *web_ext
                      -1,
                      web_extension->cancellable,
                      NULL, NULL);
-}
\ No newline at end of file
+}
+
+static void
+get_trace_summary_cb (GDBusProxy   *proxy,
+                      GAsyncResult *result,
+                      GTask        *task)
+{
+  GVariant *ret;
+  GError *error = NULL;
+
+  ret = g_dbus_proxy_call_finish (proxy, result, &error);
+  if (ret) {
+    g_task_return_pointer (task, g_variant_get_child_value (ret, 0), (GDestroyNotify)g_variant_unref);
+    g_variant_unref (ret);
+  } else {
+    g_task_return_error (task, error);
+  }
+
+  g_object_unref (task);
+}
+
+void
+ephy_web_extension_proxy_get_trace_summary (EphyWebExtensionProxy *web_extension,
+                                            GCancellable          *cancellable,
+                                            GAsyncReadyCallback    callback,
+                                            gpointer               user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (EPHY_IS_WEB_EXTENSION_PROXY (web_extension));
+
+  task = g_task_new (web_extension, cancellable, callback, user_data);
+
+  if (!web_extension->proxy) {
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+                             "Web process is not connected yet");
+    g_object_unref (task);
+    return;
+  }
+
+  /* A busy web process should not hold up about:performance for long. */
+  g_dbus_proxy_call (web_extension->proxy,
+                     "GetTraceSummary",
+                     NULL,
+                     G_DBUS_CALL_FLAGS_NONE,
+                     1000,
+                     cancellable,
+                     (GAsyncReadyCallback)get_trace_summary_cb,
+                     task);
+}
+
+GVariant *
+ephy_web_extension_proxy_get_trace_summary_finish (EphyWebExtensionProxy  *web_extension,
+                                                   GAsyncResult           *result,
+                                                   GError                **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, web_extension), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
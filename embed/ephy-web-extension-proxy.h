@@ -30,7 +30,7 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (EphyWebExtensionProxy, ephy_web_extension_proxy, EPHY, WEB_EXTENSION_PROXY, GObject)
 
 EphyWebExtensionProxy *ephy_web_extension_proxy_new                                       (GDBusConnection       *connection);
-void                   ephy_web_extension_proxy_history_set_urls                          (EphyWebExtensionProxy *web_extension,
+void                   ephy_web_extension_proxy_history_update_urls                       (EphyWebExtensionProxy *web_extension,
                                                                                            GList                 *urls);
 void                   ephy_web_extension_proxy_history_set_url_thumbnail                 (EphyWebExtensionProxy *web_extension,
                                                                                            const char            *url,
@@ -56,5 +56,12 @@ void                   ephy_web_extension_proxy_autofill
                                                                                            guint64                page_id,
                                                                                            const char            *selector,
                                                                                            int                    fill_choice);
+void                   ephy_web_extension_proxy_get_trace_summary                         (EphyWebExtensionProxy *web_extension,
+                                                                                           GCancellable          *cancellable,
+                                                                                           GAsyncReadyCallback    callback,
+                                                                                           gpointer               user_data);
+GVariant              *ephy_web_extension_proxy_get_trace_summary_finish                  (EphyWebExtensionProxy *web_extension,
+                                                                                           GAsyncResult          *result,
+                                                                                           GError               **error);
 
 G_END_DECLS
@@ -30,6 +30,7 @@
 #include "ephy-debug.h"
 #include "ephy-prefs.h"
 #include "ephy-settings.h"
+#include "ephy-trace.h"
 #include "ephy-uri-tester-shared.h"
 
 #include <gio/gio.h>
@@ -182,8 +183,12 @@ ephy_uri_tester_is_matched (EphyUriTester *tester,
     urlcache = tester->whitelisted_urlcache;
 
   /* Check cached URLs first. */
-  if (g_hash_table_lookup_extended (urlcache, req_uri, NULL, &is_matched))
+  if (g_hash_table_lookup_extended (urlcache, req_uri, NULL, &is_matched)) {
+    EPHY_TRACE_MARK (EPHY_TRACE_ADBLOCK, "cache-hit");
     return GPOINTER_TO_INT (is_matched);
+  }
+
+  EPHY_TRACE_MARK (EPHY_TRACE_ADBLOCK, "cache-miss");
 
   /* Look for a match either by key or by pattern. */
   if (ephy_uri_tester_is_matched_by_key (tester, opts, req_uri, page_uri, whitelist)) {
@@ -582,8 +587,14 @@ ephy_uri_tester_rewrite_uri (EphyUriTester    *tester,
                              const char       *request_uri,
                              const char       *page_uri)
 {
+  gboolean block;
+  EPHY_TRACE_BEGIN (begin);
+
   /* Should we block the URL outright? */
-  if (ephy_uri_tester_block_uri (tester, request_uri, page_uri)) {
+  block = ephy_uri_tester_block_uri (tester, request_uri, page_uri);
+  EPHY_TRACE_END (begin, EPHY_TRACE_ADBLOCK, block ? "block" : "allow");
+
+  if (block) {
     g_debug ("Request '%s' blocked (page: '%s')", request_uri, page_uri);
 
     return NULL;
@@ -829,12 +840,15 @@ ephy_uri_tester_load (EphyUriTester *tester)
 
   g_assert (EPHY_IS_URI_TESTER (tester));
 
-  if (!g_settings_get_boolean (EPHY_SETTINGS_WEB_EXTENSION_WEB, EPHY_PREFS_WEB_ENABLE_ADBLOCK))
-    tester->adblock_loaded = TRUE;
-
+  /* This runs for every filtered request, so check the cheap flag first. */
   if (tester->adblock_loaded)
     return;
 
+  if (!g_settings_get_boolean (EPHY_SETTINGS_WEB_EXTENSION_WEB, EPHY_PREFS_WEB_ENABLE_ADBLOCK)) {
+    tester->adblock_loaded = TRUE;
+    return;
+  }
+
   g_signal_handlers_disconnect_by_func (EPHY_SETTINGS_WEB, ephy_uri_tester_adblock_filters_changed_cb, tester);
   g_signal_handlers_disconnect_by_func (EPHY_SETTINGS_WEB, ephy_uri_tester_enable_adblock_changed_cb, tester);
 
@@ -30,6 +30,7 @@
 #include "ephy-permissions-manager.h"
 #include "ephy-prefs.h"
 #include "ephy-settings.h"
+#include "ephy-trace.h"
 #include "ephy-uri-helpers.h"
 #include "ephy-uri-tester.h"
 #include "ephy-web-overview-model.h"
@@ -43,6 +44,24 @@
 #include <webkit2/webkit-web-extension.h>
 #include <JavaScriptCore/JavaScript.h>
 
+/* Preferences consulted while loading pages. A snapshot is never modified;
+ * when one of the keys changes a new snapshot replaces it, so the request
+ * path does not have to query GSettings. */
+typedef struct {
+  gboolean do_not_track;
+  gboolean enable_adblock;
+  gboolean remember_passwords;
+} EphyRequestSettings;
+
+/* What the request filters need to know about a request, worked out once. */
+typedef struct {
+  const char *request_uri;
+  const char *page_uri;
+  gboolean is_main_resource;
+  gboolean is_exempt_scheme;
+  gboolean has_query;
+} EphyRequestInfo;
+
 struct _EphyWebExtension {
   GObject parent_instance;
 
@@ -58,6 +77,8 @@ struct _EphyWebExtension {
 
   WebKitScriptWorld *script_world;
 
+  EphyRequestSettings *request_settings;
+
   gboolean is_private_profile;
 };
 
@@ -83,8 +104,14 @@ static const char introspection_xml[] =
   "   <arg type='s' name='css_selector' direction='in'/>"
   "   <arg type='i' name='fill_choice' direction='in'/>"
   "  </method>"
-  "  <method name='HistorySetURLs'>"
-  "   <arg type='a(ss)' name='urls' direction='in'/>"
+  "  <method name='HistoryInsertURL'>"
+  "   <arg type='u' name='index' direction='in'/>"
+  "   <arg type='s' name='url' direction='in'/>"
+  "   <arg type='s' name='title' direction='in'/>"
+  "  </method>"
+  "  <method name='HistoryMoveURL'>"
+  "   <arg type='s' name='url' direction='in'/>"
+  "   <arg type='u' name='index' direction='in'/>"
   "  </method>"
   "  <method name='HistorySetURLThumbnail'>"
   "   <arg type='s' name='url' direction='in'/>"
@@ -112,46 +139,90 @@ static const char introspection_xml[] =
   "    <arg type='i' name='promise_id' direction='in'/>"
   "    <arg type='t' name='page_id' direction='in'/>"
   "  </method>"
+  "  <method name='GetTraceSummary'>"
+  "   <arg type='" EPHY_TRACE_SUMMARY_TYPE "' name='summary' direction='out'/>"
+  "  </method>"
   " </interface>"
   "</node>";
 
 G_DEFINE_TYPE (EphyWebExtension, ephy_web_extension, G_TYPE_OBJECT)
 
-static gboolean
-should_use_adblocker (const char *request_uri,
-                      const char *page_uri,
-                      const char *redirected_request_uri)
+static EphyRequestSettings *
+ephy_request_settings_new (void)
 {
-  if (!g_settings_get_boolean (EPHY_SETTINGS_WEB_EXTENSION_WEB, EPHY_PREFS_WEB_ENABLE_ADBLOCK))
-    return FALSE;
+  GSettings *settings = EPHY_SETTINGS_WEB_EXTENSION_WEB;
+  EphyRequestSettings *request_settings = g_new (EphyRequestSettings, 1);
 
-  /* Always load the main resource... */
-  if (g_strcmp0 (request_uri, page_uri) == 0)
-    return FALSE;
+  request_settings->do_not_track = g_settings_get_boolean (settings, EPHY_PREFS_WEB_DO_NOT_TRACK);
+  request_settings->enable_adblock = g_settings_get_boolean (settings, EPHY_PREFS_WEB_ENABLE_ADBLOCK);
+  request_settings->remember_passwords = g_settings_get_boolean (settings, EPHY_PREFS_WEB_REMEMBER_PASSWORDS);
 
-  /* ...even during a redirect, when page_uri is stale. */
-  if (g_strcmp0 (page_uri, redirected_request_uri) == 0)
-    return FALSE;
+  return request_settings;
+}
 
-  /* Always load data requests, as uri_tester won't do any good here. */
-  if (g_str_has_prefix (request_uri, SOUP_URI_SCHEME_DATA))
-    return FALSE;
+static void
+request_settings_changed_cb (GSettings        *settings,
+                             const char       *key,
+                             EphyWebExtension *extension)
+{
+  g_free (extension->request_settings);
+  extension->request_settings = ephy_request_settings_new ();
+}
 
-  /* Always load about pages */
-  if (g_str_has_prefix (request_uri, "about") ||
-      g_str_has_prefix (request_uri, "ephy-about"))
+/* Schemes whose resources are always loaded: the adblocker can't do any good
+ * for data requests, and about pages, resources and local files are ours or
+ * the user's. */
+static gboolean
+scheme_is_exempt_from_adblock (const char *uri)
+{
+  static const char * const schemes[] = {
+    SOUP_URI_SCHEME_DATA,
+    "about",
+    "ephy-about",
+    "resource",
+    "ephy-resource",
+    "file"
+  };
+  const char *colon;
+  gsize len;
+
+  colon = strchr (uri, ':');
+  if (!colon)
     return FALSE;
 
-  /* Always load resources */
-  if (g_str_has_prefix (request_uri, "resource://") ||
-      g_str_has_prefix (request_uri, "ephy-resource://"))
-    return FALSE;
+  len = colon - uri;
+  for (guint i = 0; i < G_N_ELEMENTS (schemes); i++) {
+    if (strlen (schemes[i]) == len && g_ascii_strncasecmp (uri, schemes[i], len) == 0)
+      return TRUE;
+  }
 
-  /* Always load local files */
-  if (g_str_has_prefix (request_uri, "file://"))
-    return FALSE;
+  return FALSE;
+}
 
-  return TRUE;
+static void
+ephy_request_info_init (EphyRequestInfo *info,
+                        const char      *request_uri,
+                        const char      *page_uri,
+                        const char      *redirected_request_uri)
+{
+  info->request_uri = request_uri;
+  info->page_uri = page_uri;
+
+  /* Always load the main resource, even during a redirect, when page_uri
+   * is stale. */
+  info->is_main_resource = g_strcmp0 (request_uri, page_uri) == 0 ||
+                           g_strcmp0 (page_uri, redirected_request_uri) == 0;
+  info->is_exempt_scheme = scheme_is_exempt_from_adblock (request_uri);
+  info->has_query = strchr (request_uri, '?') != NULL;
+}
+
+static gboolean
+should_use_adblocker (const EphyRequestSettings *settings,
+                      const EphyRequestInfo     *info)
+{
+  return settings->enable_adblock &&
+         !info->is_main_resource &&
+         !info->is_exempt_scheme;
 }
 
 static gboolean
@@ -160,19 +231,21 @@ web_page_send_request (WebKitWebPage     *web_page,
                        WebKitURIResponse *redirected_response,
                        EphyWebExtension  *extension)
 {
+  const EphyRequestSettings *settings = extension->request_settings;
+  EphyRequestInfo info;
   const char *request_uri;
-  const char *redirected_response_uri;
   const char *page_uri;
   g_autofree char *modified_uri = NULL;
 
   request_uri = webkit_uri_request_get_uri (request);
   page_uri = webkit_web_page_get_uri (web_page);
-  redirected_response_uri = redirected_response ? webkit_uri_response_get_uri (redirected_response) : NULL;
+  ephy_request_info_init (&info, request_uri, page_uri,
+                          redirected_response ? webkit_uri_response_get_uri (redirected_response) : NULL);
 
-  if (g_settings_get_boolean (EPHY_SETTINGS_WEB_EXTENSION_WEB, EPHY_PREFS_WEB_DO_NOT_TRACK))
+  if (settings->do_not_track && info.has_query)
     modified_uri = ephy_remove_tracking_from_uri (request_uri);
 
-  if (should_use_adblocker (request_uri, page_uri, redirected_response_uri)) {
+  if (should_use_adblocker (settings, &info)) {
     char *result;
 
     ephy_uri_tester_load (extension->uri_tester);
@@ -280,7 +353,7 @@ web_page_form_controls_associated (WebKitWebPage    *web_page,
                                           G_TYPE_STRING, 2,
                                           G_TYPE_UINT64, G_TYPE_BOOLEAN);
   remember_passwords = !extension->is_private_profile &&
-                       g_settings_get_boolean (EPHY_SETTINGS_WEB_EXTENSION_WEB, EPHY_PREFS_WEB_REMEMBER_PASSWORDS);
+                       extension->request_settings->remember_passwords;
   js_result = jsc_value_object_invoke_method (js_ephy,
                                               "formControlsAssociated",
                                               G_TYPE_UINT64, webkit_web_page_get_id (web_page),
@@ -443,21 +516,23 @@ handle_method_call (GDBusConnection       *connection,
   if (g_strcmp0 (interface_name, EPHY_WEB_EXTENSION_INTERFACE) != 0)
     return;
 
-  if (g_strcmp0 (method_name, "HistorySetURLs") == 0) {
+  if (g_strcmp0 (method_name, "HistoryInsertURL") == 0) {
     if (extension->overview_model) {
-      GVariantIter iter;
-      g_autoptr(GVariant) array = NULL;
       const char *url;
       const char *title;
-      GList *items = NULL;
-
-      g_variant_get (parameters, "(@a(ss))", &array);
-      g_variant_iter_init (&iter, array);
+      guint index;
 
-      while (g_variant_iter_loop (&iter, "(&s&s)", &url, &title))
-        items = g_list_prepend (items, ephy_web_overview_model_item_new (url, title));
+      g_variant_get (parameters, "(u&s&s)", &index, &url, &title);
+      ephy_web_overview_model_insert_url (extension->overview_model, index, url, title);
+    }
+    g_dbus_method_invocation_return_value (invocation, NULL);
+  } else if (g_strcmp0 (method_name, "HistoryMoveURL") == 0) {
+    if (extension->overview_model) {
+      const char *url;
+      guint index;
 
-      ephy_web_overview_model_set_urls (extension->overview_model, g_list_reverse (items));
+      g_variant_get (parameters, "(&su)", &url, &index);
+      ephy_web_overview_model_move_url (extension->overview_model, url, index);
     }
     g_dbus_method_invocation_return_value (invocation, NULL);
   } else if (g_strcmp0 (method_name, "Autofill") == 0) {
@@ -511,6 +586,12 @@ handle_method_call (GDBusConnection       *connection,
     if (extension->overview_model)
       ephy_web_overview_model_clear (extension->overview_model);
     g_dbus_method_invocation_return_value (invocation, NULL);
+  } else if (g_strcmp0 (method_name, "GetTraceSummary") == 0) {
+    /* Asked for by about:performance, which wants numbers from now on. */
+    ephy_trace_set_enabled (TRUE);
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("(@" EPHY_TRACE_SUMMARY_TYPE ")",
+                                                          ephy_trace_get_summary ()));
   } else if (g_strcmp0 (method_name, "PasswordQueryUsernamesResponse") == 0) {
     g_autofree const char **users;
     g_autoptr(JSCValue) ret = NULL;
@@ -555,6 +636,11 @@ ephy_web_extension_dispose (GObject *object)
 {
   EphyWebExtension *extension = EPHY_WEB_EXTENSION (object);
 
+  if (extension->request_settings) {
+    g_signal_handlers_disconnect_by_func (EPHY_SETTINGS_WEB_EXTENSION_WEB, request_settings_changed_cb, extension);
+    g_clear_pointer (&extension->request_settings, g_free);
+  }
+
   g_clear_object (&extension->uri_tester);
   g_clear_object (&extension->overview_model);
   g_clear_object (&extension->permissions_manager);
@@ -826,6 +912,16 @@ ephy_web_extension_initialize (EphyWebExtension   *extension,
 
   extension->permissions_manager = ephy_permissions_manager_new ();
 
+  /* Connect before taking the snapshot: GSettings only notifies about keys
+   * that have been read since the handler was connected. */
+  g_signal_connect (EPHY_SETTINGS_WEB_EXTENSION_WEB, "changed::" EPHY_PREFS_WEB_DO_NOT_TRACK,
+                    G_CALLBACK (request_settings_changed_cb), extension);
+  g_signal_connect (EPHY_SETTINGS_WEB_EXTENSION_WEB, "changed::" EPHY_PREFS_WEB_ENABLE_ADBLOCK,
+                    G_CALLBACK (request_settings_changed_cb), extension);
+  g_signal_connect (EPHY_SETTINGS_WEB_EXTENSION_WEB, "changed::" EPHY_PREFS_WEB_REMEMBER_PASSWORDS,
+                    G_CALLBACK (request_settings_changed_cb), extension);
+  extension->request_settings = ephy_request_settings_new ();
+
   g_signal_connect_swapped (extension->extension, "page-created",
                             G_CALLBACK (ephy_web_extension_page_created_cb),
                             extension);
@@ -30,6 +30,9 @@ struct _EphyWebOverviewModel {
   GHashTable *thumbnails;
 
   GHashTable *urls_listeners;
+  GHashTable *url_inserted_listeners;
+  GHashTable *url_moved_listeners;
+  GHashTable *url_removed_listeners;
   GHashTable *thumbnail_listeners;
   GHashTable *title_listeners;
 };
@@ -52,6 +55,9 @@ ephy_web_overview_model_dispose (GObject *object)
   }
 
   g_clear_pointer (&model->urls_listeners, g_hash_table_destroy);
+  g_clear_pointer (&model->url_inserted_listeners, g_hash_table_destroy);
+  g_clear_pointer (&model->url_moved_listeners, g_hash_table_destroy);
+  g_clear_pointer (&model->url_removed_listeners, g_hash_table_destroy);
   g_clear_pointer (&model->thumbnail_listeners, g_hash_table_destroy);
   g_clear_pointer (&model->title_listeners, g_hash_table_destroy);
 
@@ -77,6 +83,18 @@ ephy_web_overview_model_init (EphyWebOverviewModel *model)
                                                  g_direct_equal,
                                                  g_object_unref,
                                                  NULL);
+  model->url_inserted_listeners = g_hash_table_new_full (g_direct_hash,
+                                                         g_direct_equal,
+                                                         g_object_unref,
+                                                         NULL);
+  model->url_moved_listeners = g_hash_table_new_full (g_direct_hash,
+                                                      g_direct_equal,
+                                                      g_object_unref,
+                                                      NULL);
+  model->url_removed_listeners = g_hash_table_new_full (g_direct_hash,
+                                                        g_direct_equal,
+                                                        g_object_unref,
+                                                        NULL);
   model->thumbnail_listeners = g_hash_table_new_full (g_direct_hash,
                                                       g_direct_equal,
                                                       g_object_unref,
@@ -135,6 +153,74 @@ ephy_web_overview_model_notify_urls_changed (EphyWebOverviewModel *model)
   }
 }
 
+/* Items are placed by the URL of the item that follows them, which still
+ * works if the page already dropped some of the items.
+ */
+static const char *
+ephy_web_overview_model_get_next_url (GList *link)
+{
+  return link->next ? ((EphyWebOverviewModelItem *)link->next->data)->url : NULL;
+}
+
+static void
+ephy_web_overview_model_notify_url_inserted (EphyWebOverviewModel *model,
+                                             GList                *link)
+{
+  EphyWebOverviewModelItem *item = (EphyWebOverviewModelItem *)link->data;
+  const char *next_url = ephy_web_overview_model_get_next_url (link);
+  GHashTableIter iter;
+  gpointer key;
+
+  g_hash_table_iter_init (&iter, model->url_inserted_listeners);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    g_autoptr(JSCValue) value = NULL;
+    g_autoptr(JSCValue) ret = NULL;
+
+    value = jsc_weak_value_get_value (JSC_WEAK_VALUE (key));
+    if (value && jsc_value_is_function (value))
+      ret = jsc_value_function_call (value, G_TYPE_STRING, item->url, G_TYPE_STRING, item->title,
+                                     G_TYPE_STRING, next_url, G_TYPE_NONE);
+  }
+}
+
+static void
+ephy_web_overview_model_notify_url_moved (EphyWebOverviewModel *model,
+                                          GList                *link)
+{
+  EphyWebOverviewModelItem *item = (EphyWebOverviewModelItem *)link->data;
+  const char *next_url = ephy_web_overview_model_get_next_url (link);
+  GHashTableIter iter;
+  gpointer key;
+
+  g_hash_table_iter_init (&iter, model->url_moved_listeners);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    g_autoptr(JSCValue) value = NULL;
+    g_autoptr(JSCValue) ret = NULL;
+
+    value = jsc_weak_value_get_value (JSC_WEAK_VALUE (key));
+    if (value && jsc_value_is_function (value))
+      ret = jsc_value_function_call (value, G_TYPE_STRING, item->url, G_TYPE_STRING, next_url, G_TYPE_NONE);
+  }
+}
+
+static void
+ephy_web_overview_model_notify_url_removed (EphyWebOverviewModel *model,
+                                            const char           *url)
+{
+  GHashTableIter iter;
+  gpointer key;
+
+  g_hash_table_iter_init (&iter, model->url_removed_listeners);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    g_autoptr(JSCValue) value = NULL;
+    g_autoptr(JSCValue) ret = NULL;
+
+    value = jsc_weak_value_get_value (JSC_WEAK_VALUE (key));
+    if (value && jsc_value_is_function (value))
+      ret = jsc_value_function_call (value, G_TYPE_STRING, url, G_TYPE_NONE);
+  }
+}
+
 static void
 ephy_web_overview_model_notify_thumbnail_changed (EphyWebOverviewModel *model,
                                                   const char           *url,
@@ -183,15 +269,59 @@ ephy_web_overview_model_new (void)
   return g_object_new (EPHY_TYPE_WEB_OVERVIEW_MODEL, NULL);
 }
 
+static GList *
+ephy_web_overview_model_find_url (EphyWebOverviewModel *model,
+                                  const char           *url)
+{
+  for (GList *l = model->items; l; l = g_list_next (l)) {
+    EphyWebOverviewModelItem *item = (EphyWebOverviewModelItem *)l->data;
+
+    if (g_strcmp0 (item->url, url) == 0)
+      return l;
+  }
+
+  return NULL;
+}
+
 void
-ephy_web_overview_model_set_urls (EphyWebOverviewModel *model,
-                                  GList                *urls)
+ephy_web_overview_model_insert_url (EphyWebOverviewModel *model,
+                                    guint                 index,
+                                    const char           *url,
+                                    const char           *title)
 {
+  EphyWebOverviewModelItem *item;
+
   g_assert (EPHY_IS_WEB_OVERVIEW_MODEL (model));
 
-  g_list_free_full (model->items, (GDestroyNotify)ephy_web_overview_model_item_free);
-  model->items = urls;
-  ephy_web_overview_model_notify_urls_changed (model);
+  if (ephy_web_overview_model_find_url (model, url)) {
+    ephy_web_overview_model_set_url_title (model, url, title);
+    ephy_web_overview_model_move_url (model, url, index);
+    return;
+  }
+
+  item = ephy_web_overview_model_item_new (url, title);
+  model->items = g_list_insert (model->items, item, index);
+  ephy_web_overview_model_notify_url_inserted (model, g_list_find (model->items, item));
+}
+
+void
+ephy_web_overview_model_move_url (EphyWebOverviewModel *model,
+                                  const char           *url,
+                                  guint                 index)
+{
+  EphyWebOverviewModelItem *item;
+  GList *l;
+
+  g_assert (EPHY_IS_WEB_OVERVIEW_MODEL (model));
+
+  l = ephy_web_overview_model_find_url (model, url);
+  if (!l || g_list_position (model->items, l) == (int)index)
+    return;
+
+  item = (EphyWebOverviewModelItem *)l->data;
+  model->items = g_list_delete_link (model->items, l);
+  model->items = g_list_insert (model->items, item, index);
+  ephy_web_overview_model_notify_url_moved (model, g_list_find (model->items, item));
 }
 
 void
@@ -266,7 +396,7 @@ ephy_web_overview_model_delete_url (EphyWebOverviewModel *model,
   }
 
   if (changed)
-    ephy_web_overview_model_notify_urls_changed (model);
+    ephy_web_overview_model_notify_url_removed (model, url);
 }
 
 void
@@ -274,7 +404,6 @@ ephy_web_overview_model_delete_host (EphyWebOverviewModel *model,
                                      const char           *host)
 {
   GList *l;
-  gboolean changed = FALSE;
 
   g_assert (EPHY_IS_WEB_OVERVIEW_MODEL (model));
 
@@ -285,18 +414,14 @@ ephy_web_overview_model_delete_host (EphyWebOverviewModel *model,
     GList *next = l->next;
 
     if (g_strcmp0 (soup_uri_get_host (uri), host) == 0) {
-      changed = TRUE;
-
-      ephy_web_overview_model_item_free (item);
       model->items = g_list_delete_link (model->items, l);
+      ephy_web_overview_model_notify_url_removed (model, item->url);
+      ephy_web_overview_model_item_free (item);
     }
 
     soup_uri_free (uri);
     l = next;
   }
-
-  if (changed)
-    ephy_web_overview_model_notify_urls_changed (model);
 }
 
 void
@@ -366,57 +491,66 @@ js_event_listener_destroyed (JSCWeakValue *weak_value,
 }
 
 static void
-js_web_overview_model_add_urls_changed_event_listener (EphyWebOverviewModel *model,
-                                                       JSCValue             *js_function)
+js_web_overview_model_add_event_listener (GHashTable *listeners,
+                                          JSCValue   *js_function,
+                                          const char *name)
 {
   JSCWeakValue *weak_value;
 
   if (!jsc_value_is_function (js_function)) {
-    jsc_context_throw (jsc_context_get_current (), "Invalid type passed to onurlschanged");
+    g_autofree char *message = g_strdup_printf ("Invalid type passed to %s", name);
+
+    jsc_context_throw (jsc_context_get_current (), message);
     return;
   }
 
   weak_value = jsc_weak_value_new (js_function);
   g_signal_connect (weak_value, "cleared",
                     G_CALLBACK (js_event_listener_destroyed),
-                    model->urls_listeners);
-  g_hash_table_add (model->urls_listeners, weak_value);
+                    listeners);
+  g_hash_table_add (listeners, weak_value);
 }
 
 static void
-js_web_overview_model_add_thumbnail_changed_event_listener (EphyWebOverviewModel *model,
-                                                            JSCValue             *js_function)
+js_web_overview_model_add_urls_changed_event_listener (EphyWebOverviewModel *model,
+                                                       JSCValue             *js_function)
 {
-  JSCWeakValue *weak_value;
+  js_web_overview_model_add_event_listener (model->urls_listeners, js_function, "onurlschanged");
+}
 
-  if (!jsc_value_is_function (js_function)) {
-    jsc_context_throw (jsc_context_get_current (), "Invalid type passed to onthumbnailchanged");
-    return;
-  }
+static void
+js_web_overview_model_add_url_inserted_event_listener (EphyWebOverviewModel *model,
+                                                       JSCValue             *js_function)
+{
+  js_web_overview_model_add_event_listener (model->url_inserted_listeners, js_function, "onurlinserted");
+}
 
-  weak_value = jsc_weak_value_new (js_function);
-  g_signal_connect (weak_value, "cleared",
-                    G_CALLBACK (js_event_listener_destroyed),
-                    model->thumbnail_listeners);
-  g_hash_table_add (model->thumbnail_listeners, weak_value);
+static void
+js_web_overview_model_add_url_moved_event_listener (EphyWebOverviewModel *model,
+                                                    JSCValue             *js_function)
+{
+  js_web_overview_model_add_event_listener (model->url_moved_listeners, js_function, "onurlmoved");
 }
 
 static void
-js_web_overview_model_add_title_changed_event_listener (EphyWebOverviewModel *model,
-                                                        JSCValue             *js_function)
+js_web_overview_model_add_url_removed_event_listener (EphyWebOverviewModel *model,
+                                                      JSCValue             *js_function)
 {
-  JSCWeakValue *weak_value;
+  js_web_overview_model_add_event_listener (model->url_removed_listeners, js_function, "onurlremoved");
+}
 
-  if (!jsc_value_is_function (js_function)) {
-    jsc_context_throw (jsc_context_get_current (), "Invalid type passed to ontitlechanged");
-    return;
-  }
+static void
+js_web_overview_model_add_thumbnail_changed_event_listener (EphyWebOverviewModel *model,
+                                                            JSCValue             *js_function)
+{
+  js_web_overview_model_add_event_listener (model->thumbnail_listeners, js_function, "onthumbnailchanged");
+}
 
-  weak_value = jsc_weak_value_new (js_function);
-  g_signal_connect (weak_value, "cleared",
-                    G_CALLBACK (js_event_listener_destroyed),
-                    model->title_listeners);
-  g_hash_table_add (model->title_listeners, weak_value);
+static void
+js_web_overview_model_add_title_changed_event_listener (EphyWebOverviewModel *model,
+                                                        JSCValue             *js_function)
+{
+  js_web_overview_model_add_event_listener (model->title_listeners, js_function, "ontitlechanged");
 }
 
 JSCValue *
@@ -448,6 +582,24 @@ ephy_web_overview_model_export_to_js_context (EphyWebOverviewModel *model,
                           NULL,
                           G_CALLBACK (js_web_overview_model_add_urls_changed_event_listener),
                           NULL, NULL);
+  jsc_class_add_property (js_class,
+                          "onurlinserted",
+                          JSC_TYPE_VALUE,
+                          NULL,
+                          G_CALLBACK (js_web_overview_model_add_url_inserted_event_listener),
+                          NULL, NULL);
+  jsc_class_add_property (js_class,
+                          "onurlmoved",
+                          JSC_TYPE_VALUE,
+                          NULL,
+                          G_CALLBACK (js_web_overview_model_add_url_moved_event_listener),
+                          NULL, NULL);
+  jsc_class_add_property (js_class,
+                          "onurlremoved",
+                          JSC_TYPE_VALUE,
+                          NULL,
+                          G_CALLBACK (js_web_overview_model_add_url_removed_event_listener),
+                          NULL, NULL);
   jsc_class_add_property (js_class,
                           "onthumbnailchanged",
                           JSC_TYPE_VALUE,
@@ -30,8 +30,13 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (EphyWebOverviewModel, ephy_web_overview_model, EPHY, WEB_OVERVIEW_MODEL, GObject)
 
 EphyWebOverviewModel *ephy_web_overview_model_new               (void);
-void                  ephy_web_overview_model_set_urls          (EphyWebOverviewModel *model,
-                                                                 GList                *urls);
+void                  ephy_web_overview_model_insert_url        (EphyWebOverviewModel *model,
+                                                                 guint                 index,
+                                                                 const char           *url,
+                                                                 const char           *title);
+void                  ephy_web_overview_model_move_url          (EphyWebOverviewModel *model,
+                                                                 const char           *url,
+                                                                 guint                 index);
 void                  ephy_web_overview_model_set_url_thumbnail (EphyWebOverviewModel *model,
                                                                  const char           *url,
                                                                  const char           *path,
@@ -4,11 +4,18 @@ Ephy.Overview = class Overview
     {
         this._model = model;
         this._items = [];
+        this._initialized = false;
 
         // Event handlers are weak references in EphyWebOverviewModel, we need to keep
         // a strong reference to them while Ephy.Overview is alive.
         this._onURLsChangedFunction = this._onURLsChanged.bind(this);
         this._model.onurlschanged = this._onURLsChangedFunction;
+        this._onURLInsertedFunction = this._onURLInserted.bind(this);
+        this._model.onurlinserted = this._onURLInsertedFunction;
+        this._onURLMovedFunction = this._onURLMoved.bind(this);
+        this._model.onurlmoved = this._onURLMovedFunction;
+        this._onURLRemovedFunction = this._onURLRemoved.bind(this);
+        this._model.onurlremoved = this._onURLRemovedFunction;
         this._onThumbnailChangedFunction = this._onThumbnailChanged.bind(this);
         this._model.onthumbnailchanged = this._onThumbnailChangedFunction;
         this._onTitleChangedFunction = this._onTitleChanged.bind(this);
@@ -45,11 +52,81 @@ Ephy.Overview = class Overview
 
             this._items.push(item);
         }
+        this._initialized = true;
+
+        // The model is empty until the UI process sends the URLs, which then
+        // arrive as insertions of the items already in the page.
         let items = this._model.urls;
-        if (items.length > this._items.length)
+        if (items.length && !this._matchesURLs(items))
             this._onURLsChanged(items);
     }
 
+    _matchesURLs(urls)
+    {
+        if (urls.length != this._items.length)
+            return false;
+
+        for (let i = 0; i < urls.length; i++) {
+            if (this._items[i].url() != urls[i].url)
+                return false;
+        }
+        return true;
+    }
+
+    _findItem(url)
+    {
+        for (let i = 0; i < this._items.length; i++) {
+            if (this._items[i].url() == url)
+                return i;
+        }
+        return -1;
+    }
+
+    _removeEmptyMessage()
+    {
+        let overview = document.getElementById('overview');
+        if (overview.classList.contains('overview-empty')) {
+            while (overview.lastChild)
+                overview.removeChild(overview.lastChild);
+            overview.classList.remove('overview-empty');
+        }
+    }
+
+    _createItem()
+    {
+        let anchor = document.createElement('a');
+        anchor.classList.add('overview-item');
+        let closeButton = document.createElement('div');
+        closeButton.title = Ephy._("Remove from overview");
+        closeButton.onclick = (event) => {
+            this._removeItem(anchor);
+            event.preventDefault();
+        };
+        closeButton.innerHTML = '&#10006;';
+        closeButton.classList.add('overview-close-button');
+        anchor.appendChild(closeButton);
+        let thumbnailSpan = document.createElement('span');
+        thumbnailSpan.classList.add('overview-thumbnail');
+        anchor.appendChild(thumbnailSpan);
+        let titleSpan = document.createElement('span');
+        titleSpan.classList.add('overview-title');
+        anchor.appendChild(titleSpan);
+        return new Ephy.Overview.Item(anchor);
+    }
+
+    // Places item before the one showing nextURL, or last if there's none.
+    _placeItem(item, nextURL)
+    {
+        let index = nextURL ? this._findItem(nextURL) : -1;
+        if (index == -1) {
+            item.attachToParent(document.getElementById('overview'), null);
+            this._items.push(item);
+        } else {
+            item.attachToParent(document.getElementById('overview'), this._items[index]);
+            this._items.splice(index, 0, item);
+        }
+    }
+
     _onKeyPress(event)
     {
         if (event.which != 127)
@@ -80,12 +157,10 @@ Ephy.Overview = class Overview
 
     _onURLsChanged(urls)
     {
-        let overview = document.getElementById('overview');
-        if (overview.classList.contains('overview-empty')) {
-            while (overview.lastChild)
-                overview.removeChild(overview.lastChild);
-            overview.classList.remove('overview-empty');
-        }
+        if (!this._initialized)
+            return;
+
+        this._removeEmptyMessage();
 
         for (let i = 0; i < urls.length; i++) {
             let url = urls[i];
@@ -95,25 +170,8 @@ Ephy.Overview = class Overview
                 item = this._items[i];
             } else {
                 Ephy.log('create an item for the url ' + url.url);
-                let anchor = document.createElement('a');
-                anchor.classList.add('overview-item');
-                let closeButton = document.createElement('div');
-                closeButton.title = Ephy._("Remove from overview");
-                closeButton.onclick = (event) => {
-                    this._removeItem(anchor);
-                    event.preventDefault();
-                };
-                closeButton.innerHTML = '&#10006;';
-                closeButton.classList.add('overview-close-button');
-                anchor.appendChild(closeButton);
-                let thumbnailSpan = document.createElement('span');
-                thumbnailSpan.classList.add('overview-thumbnail');
-                anchor.appendChild(thumbnailSpan);
-                let titleSpan = document.createElement('span');
-                titleSpan.classList.add('overview-title');
-                anchor.appendChild(titleSpan);
-                document.getElementById('overview').appendChild(anchor);
-                item = new Ephy.Overview.Item(anchor);
+                item = this._createItem();
+                item.attachToParent(document.getElementById('overview'), null);
                 this._items.push(item);
             }
 
@@ -128,6 +186,53 @@ Ephy.Overview = class Overview
         }
     }
 
+    _onURLInserted(url, title, nextURL)
+    {
+        if (!this._initialized)
+            return;
+
+        this._removeEmptyMessage();
+
+        // The page may already show it, if it was loaded before the model was updated.
+        let item;
+        let index = this._findItem(url);
+        if (index != -1) {
+            item = this._items.splice(index, 1)[0];
+        } else {
+            item = this._createItem();
+            item.setURL(url);
+            item.setThumbnailPath(this._model.getThumbnail(url));
+        }
+        item.setTitle(title);
+        this._placeItem(item, nextURL);
+    }
+
+    _onURLMoved(url, nextURL)
+    {
+        if (!this._initialized)
+            return;
+
+        let index = this._findItem(url);
+        if (index == -1)
+            return;
+
+        let item = this._items.splice(index, 1)[0];
+        this._placeItem(item, nextURL);
+    }
+
+    _onURLRemoved(url)
+    {
+        if (!this._initialized)
+            return;
+
+        let index = this._findItem(url);
+        if (index == -1)
+            return;
+
+        let item = this._items.splice(index, 1)[0];
+        item.detachFromParent();
+    }
+
     _onThumbnailChanged(url, path)
     {
         for (let i = 0; i < this._items.length; i++) {
@@ -218,6 +323,11 @@ Ephy.Overview.Item = class OverviewItem
             this._thumbnail.style.background = null;
     }
 
+    attachToParent(parent, nextItem)
+    {
+        parent.insertBefore(this._item, nextItem ? nextItem._item : null);
+    }
+
     detachFromParent()
     {
         this._item.parentNode.removeChild(this._item);
@@ -24,6 +24,7 @@
 
 #include "ephy-autofill-input-element.h"
 #include "ephy-autofill-select-element.h"
+#include "ephy-autofill-storage.h"
 
 #include <glib-object.h>
 
@@ -35,6 +36,49 @@ is_valid_form (WebKitDOMHTMLFormElement *form)
   return form != NULL && webkit_dom_html_form_element_get_length (form) < MAX_FORM_LENGTH;
 }
 
+typedef struct
+{
+  WebKitDOMHTMLFormElement *form;
+  bool fill_personal_info;
+  bool fill_card_info;
+} FillFormData;
+
+static void
+fill_form_cb (GObject *source_object,
+              GAsyncResult *res,
+              gpointer user_data)
+{
+  FillFormData *data = user_data;
+  GHashTable *values = ephy_autofill_storage_get_all_finish (res);
+  WebKitDOMHTMLCollection *elements;
+  long length;
+  long i;
+
+  if (values == NULL || !is_valid_form (data->form))
+    goto out;
+
+  elements = webkit_dom_html_form_element_get_elements (data->form);
+  length = webkit_dom_html_collection_get_length (elements);
+
+  for (i = 0; i < length; i++) {
+    WebKitDOMNode *element = webkit_dom_html_collection_item (elements, i);
+
+    if (WEBKIT_DOM_IS_HTML_SELECT_ELEMENT (element))
+      ephy_autofill_select_element_fill_from_values (WEBKIT_DOM_HTML_SELECT_ELEMENT (element), values,
+                                                     data->fill_personal_info, data->fill_card_info);
+    else if (WEBKIT_DOM_IS_HTML_INPUT_ELEMENT (element))
+      ephy_autofill_input_element_fill_from_values (WEBKIT_DOM_HTML_INPUT_ELEMENT (element), values,
+                                                    data->fill_personal_info, data->fill_card_info);
+  }
+
+  g_object_unref (elements);
+
+out:
+  g_clear_pointer (&values, g_hash_table_unref);
+  g_object_unref (data->form);
+  g_slice_free (FillFormData, data);
+}
+
 /*
  * ephy_autofill_form_element_fill:
  * @form: (allow-none): a #WebKitDOMHTMLFormElement
@@ -44,36 +88,28 @@ is_valid_form (WebKitDOMHTMLFormElement *form)
  *  For example it is now used to indicate that the user accepted to
  *  fill credit card info from the Autofill popup.
  *
- * Goes through all input and select elements in @form and fills them
+ * Fetches all stored values at once with ephy_autofill_storage_get_all(),
+ * then goes through all input and select elements in @form and fills them
  * using the appropriate function:
- * - Select element: ephy_autofill_select_element_fill()
- * - Input element: ephy_autofill_input_element_fill()
+ * - Select element: ephy_autofill_select_element_fill_from_values()
+ * - Input element: ephy_autofill_input_element_fill_from_values()
  */
 void
 ephy_autofill_form_element_fill (WebKitDOMHTMLFormElement *form,
                                  bool fill_personal_info,
                                  bool fill_card_info)
 {
-  WebKitDOMHTMLCollection *elements;
-  long length;
-  long i;
+  FillFormData *data;
 
   if (!is_valid_form (form))
     return;
 
-  elements = webkit_dom_html_form_element_get_elements (form);
-  length = webkit_dom_html_collection_get_length (elements);
-
-  for (i = 0; i < length; i++) {
-    WebKitDOMNode *element = webkit_dom_html_collection_item (elements, i);
-
-    if (WEBKIT_DOM_IS_HTML_SELECT_ELEMENT (element))
-      ephy_autofill_select_element_fill (WEBKIT_DOM_HTML_SELECT_ELEMENT (element), fill_personal_info, fill_card_info);
-    else if (WEBKIT_DOM_IS_HTML_INPUT_ELEMENT (element))
-      ephy_autofill_input_element_fill (WEBKIT_DOM_HTML_INPUT_ELEMENT (element), fill_personal_info, fill_card_info);
-  }
+  data = g_slice_new (FillFormData);
+  data->form = g_object_ref (form);
+  data->fill_personal_info = fill_personal_info;
+  data->fill_card_info = fill_card_info;
 
-  g_object_unref (elements);
+  ephy_autofill_storage_get_all (fill_form_cb, data);
 }
 
 /**
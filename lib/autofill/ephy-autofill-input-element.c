@@ -41,61 +41,60 @@ is_valid_input_type (const char *type)
 }
 
 static EphyAutofillField
-get_personal_field (const char *element_key)
+get_personal_field (EphyAutofillMatch matches)
 {
-  if (ephy_autofill_matchers_is_fullname (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_FULLNAME)
     return EPHY_AUTOFILL_FIELD_FULLNAME;
-  if (ephy_autofill_matchers_is_firstname (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_FIRSTNAME)
     return EPHY_AUTOFILL_FIELD_FIRSTNAME;
-  if (ephy_autofill_matchers_is_lastname (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_LASTNAME)
     return EPHY_AUTOFILL_FIELD_LASTNAME;
-  if (ephy_autofill_matchers_is_username (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_USERNAME)
     return EPHY_AUTOFILL_FIELD_USERNAME;
-  if (ephy_autofill_matchers_is_email (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_EMAIL)
     return EPHY_AUTOFILL_FIELD_EMAIL;
-  if (ephy_autofill_matchers_is_phone (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_PHONE)
     return EPHY_AUTOFILL_FIELD_PHONE;
-  if (ephy_autofill_matchers_is_organization (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_ORGANIZATION)
     return EPHY_AUTOFILL_FIELD_ORGANIZATION;
-  if (ephy_autofill_matchers_is_postal_code (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_POSTAL_CODE)
     return EPHY_AUTOFILL_FIELD_POSTAL_CODE;
-  if (ephy_autofill_matchers_is_country (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_COUNTRY)
     return EPHY_AUTOFILL_FIELD_COUNTRY_NAME;
-  if (ephy_autofill_matchers_is_state (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_STATE)
     return EPHY_AUTOFILL_FIELD_STATE;
-  if (ephy_autofill_matchers_is_city (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_CITY)
     return EPHY_AUTOFILL_FIELD_CITY;
-  if (ephy_autofill_matchers_is_street_address (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_STREET_ADDRESS)
     return EPHY_AUTOFILL_FIELD_STREET_ADDRESS;
 
   return EPHY_AUTOFILL_FIELD_UNKNOWN;
 }
 
 static EphyAutofillField
-get_credit_card_field (WebKitDOMHTMLInputElement *input_element,
-                       const char *element_key)
+get_credit_card_field (EphyAutofillMatch matches)
 {
-  if (ephy_autofill_matchers_is_card_expdate_month (element_key) &&
-      ephy_autofill_matchers_is_card_expdate_year (element_key)) {
+  if ((matches & EPHY_AUTOFILL_MATCH_CARD_EXPDATE_MONTH) &&
+      (matches & EPHY_AUTOFILL_MATCH_CARD_EXPDATE_YEAR)) {
 
-    if (ephy_autofill_matchers_is_month (element_key))
+    if (matches & EPHY_AUTOFILL_MATCH_MONTH)
       return EPHY_AUTOFILL_FIELD_CARD_EXPDATE_MONTH;
-    if (ephy_autofill_matchers_is_year (element_key))
+    if (matches & EPHY_AUTOFILL_MATCH_YEAR)
       return EPHY_AUTOFILL_FIELD_CARD_EXPDATE_YEAR;
 
     return EPHY_AUTOFILL_FIELD_CARD_EXPDATE;
   }
-  if (ephy_autofill_matchers_is_card_expdate_month (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_CARD_EXPDATE_MONTH)
     return EPHY_AUTOFILL_FIELD_CARD_EXPDATE_MONTH;
-  if (ephy_autofill_matchers_is_card_expdate_year (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_CARD_EXPDATE_YEAR)
     return EPHY_AUTOFILL_FIELD_CARD_EXPDATE_YEAR;
-  if (ephy_autofill_matchers_is_card_expdate (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_CARD_EXPDATE)
     return EPHY_AUTOFILL_FIELD_CARD_EXPDATE;
-  if (ephy_autofill_matchers_is_name_on_card (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_NAME_ON_CARD)
     return EPHY_AUTOFILL_FIELD_NAME_ON_CARD;
-  if (ephy_autofill_matchers_is_card_number (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_CARD_NUMBER)
     return EPHY_AUTOFILL_FIELD_CARD_NUMBER;
-  if (ephy_autofill_matchers_is_card_type (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_CARD_TYPE)
     return EPHY_AUTOFILL_FIELD_CARD_TYPE;
 
   return EPHY_AUTOFILL_FIELD_UNKNOWN;
@@ -111,12 +110,15 @@ get_field_helper (WebKitDOMHTMLInputElement *input_element,
 
   if (!ephy_autofill_utils_is_valid_element_key (element_key))
     field = EPHY_AUTOFILL_FIELD_UNKNOWN;
-  else {
+  else if (fill_personal_info || fill_credit_card_info) {
+    WebKitDOMHTMLFormElement *form = webkit_dom_html_input_element_get_form (input_element);
+    EphyAutofillMatch matches = ephy_autofill_utils_classify_element_key (form, element_key);
+
     if (fill_personal_info)
-      field = get_personal_field (element_key);
+      field = get_personal_field (matches);
 
     if (fill_credit_card_info && field == EPHY_AUTOFILL_FIELD_UNKNOWN)
-      field = get_credit_card_field (input_element, element_key);
+      field = get_credit_card_field (matches);
   }
 
   return field;
@@ -179,13 +181,9 @@ ephy_autofill_input_element_get_field (WebKitDOMHTMLInputElement *input_element,
 }
 
 static void
-fill_input_element_cb (GObject *source_object,
-                       GAsyncResult *res,
-                       gpointer user_data)
+set_input_element_value (WebKitDOMHTMLInputElement *input_element,
+                         const char *autofill_value)
 {
-  WebKitDOMHTMLInputElement *input_element = user_data;
-  char *autofill_value = ephy_autofill_storage_get_finish (res);
-
   if (!ephy_autofill_utils_is_empty_value(autofill_value)) {
     webkit_dom_html_input_element_set_value (input_element, autofill_value);
     ephy_autofill_utils_dispatch_event (WEBKIT_DOM_NODE (input_element),
@@ -194,6 +192,17 @@ fill_input_element_cb (GObject *source_object,
 
     webkit_dom_html_input_element_set_auto_filled (input_element, TRUE);
   }
+}
+
+static void
+fill_input_element_cb (GObject *source_object,
+                       GAsyncResult *res,
+                       gpointer user_data)
+{
+  WebKitDOMHTMLInputElement *input_element = user_data;
+  char *autofill_value = ephy_autofill_storage_get_finish (res);
+
+  set_input_element_value (input_element, autofill_value);
 
   g_free (autofill_value);
 }
@@ -226,3 +235,31 @@ ephy_autofill_input_element_fill (WebKitDOMHTMLInputElement *input_element,
 
   g_free (value);
 }
+
+/**
+ * ephy_autofill_input_element_fill_from_values:
+ * @input_element: a #WebKitDOMHTMLInputElement
+ * @values: values returned by ephy_autofill_storage_get_all_finish()
+ * @fill_personal_info: whether personal info should be filled
+ * @fill_credit_card_info: whether credit card info should be filled
+ *
+ * Same as ephy_autofill_input_element_fill(), but synchronously
+ * takes the value from @values instead of looking it up.
+ **/
+void
+ephy_autofill_input_element_fill_from_values (WebKitDOMHTMLInputElement *input_element,
+                                              GHashTable *values,
+                                              bool fill_personal_info,
+                                              bool fill_credit_card_info)
+{
+  char *value = webkit_dom_html_input_element_get_value (WEBKIT_DOM_HTML_INPUT_ELEMENT (input_element));
+
+  if (ephy_autofill_utils_is_empty_value (value)) {
+    EphyAutofillField field = ephy_autofill_input_element_get_field (input_element, fill_personal_info, fill_credit_card_info);
+
+    if (field != EPHY_AUTOFILL_FIELD_UNKNOWN)
+      set_input_element_value (input_element, ephy_autofill_storage_lookup (values, field));
+  }
+
+  g_free (value);
+}
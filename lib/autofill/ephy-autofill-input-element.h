@@ -39,6 +39,12 @@ ephy_autofill_input_element_fill (WebKitDOMHTMLInputElement *input_element,
                                   bool fill_personal_info,
                                   bool fill_credit_card_info);
 
+void
+ephy_autofill_input_element_fill_from_values (WebKitDOMHTMLInputElement *input_element,
+                                              GHashTable *values,
+                                              bool fill_personal_info,
+                                              bool fill_credit_card_info);
+
 G_END_DECLS
 
 #endif
@@ -24,28 +24,6 @@
 
 #include <glib-object.h>
 
-#define FIRSTNAME_REGEX get_regex (FIRSTNAME_PATTERN)
-#define LASTNAME_REGEX  get_regex (LASTNAME_PATTERN)
-#define FULLNAME_REGEX  get_regex (FULLNAME_PATTERN)
-#define USERNAME_REGEX  get_regex (USERNAME_PATTERN)
-#define EMAIL_REGEX     get_regex (EMAIL_PATTERN)
-#define PHONE_REGEX     get_regex (PHONE_PATTERN)
-
-#define STREET_ADDRESS_REGEX get_regex (STREET_ADDRESS_PATTERN)
-#define ORGANIZATION_REGEX   get_regex (ORGANIZATION_PATTERN)
-#define POSTAL_CODE_REGEX    get_regex (POSTAL_CODE_PATTERN)
-#define COUNTRY_REGEX        get_regex (COUNTRY_PATTERN)
-#define STATE_REGEX          get_regex (STATE_PATTERN)
-#define CITY_REGEX           get_regex (CITY_PATTERN)
-
-#define CARD_EXPDATE_MONTH_REGEX get_regex (CARD_EXPDATE_MONTH_PATTERN)
-#define CARD_EXPDATE_YEAR_REGEX  get_regex (CARD_EXPDATE_YEAR_PATTERN)
-#define CARD_EXPDATE_REGEX       get_regex (CARD_EXPDATE_PATTERN)
-#define NAME_ON_CARD_REGEX       get_regex (NAME_ON_CARD_PATTERN)
-#define CARD_NUMBER_REGEX        get_regex (CARD_NUMBER_PATTERN)
-#define CARD_TYPE_REGEX          get_regex (CARD_TYPE_PATTERN)
-
-
 /* Regexes below are inspired by Chromium Autofill implementation.
  * You can find them here:
  * https://chromium.googlesource.com/chromium/src.git/+/master/components/autofill/core/browser/autofill_regex_constants.cc
@@ -78,150 +56,138 @@ static const char NAME_ON_CARD_PATTERN[] =
   "|(card|cc).?name|cc.?full.?name";
 static const char CARD_NUMBER_PATTERN[] = "(card|cc|acct).?(number|#|no|num)";
 static const char CARD_TYPE_PATTERN[] = "debit.*card|(card|cc).?type";
-
-static GHashTable *regexes = NULL;
-
-static const GRegex *
-get_regex (const char *pattern)
+static const char MONTH_PATTERN[] = "month";
+static const char YEAR_PATTERN[] = "year";
+
+static const struct {
+  EphyAutofillMatch match;
+  const char *pattern;
+} matchers[] = {
+  { EPHY_AUTOFILL_MATCH_FIRSTNAME, FIRSTNAME_PATTERN },
+  { EPHY_AUTOFILL_MATCH_LASTNAME, LASTNAME_PATTERN },
+  { EPHY_AUTOFILL_MATCH_FULLNAME, FULLNAME_PATTERN },
+  { EPHY_AUTOFILL_MATCH_USERNAME, USERNAME_PATTERN },
+  { EPHY_AUTOFILL_MATCH_EMAIL, EMAIL_PATTERN },
+  { EPHY_AUTOFILL_MATCH_PHONE, PHONE_PATTERN },
+  { EPHY_AUTOFILL_MATCH_STREET_ADDRESS, STREET_ADDRESS_PATTERN },
+  { EPHY_AUTOFILL_MATCH_ORGANIZATION, ORGANIZATION_PATTERN },
+  { EPHY_AUTOFILL_MATCH_POSTAL_CODE, POSTAL_CODE_PATTERN },
+  { EPHY_AUTOFILL_MATCH_COUNTRY, COUNTRY_PATTERN },
+  { EPHY_AUTOFILL_MATCH_STATE, STATE_PATTERN },
+  { EPHY_AUTOFILL_MATCH_CITY, CITY_PATTERN },
+  { EPHY_AUTOFILL_MATCH_CARD_EXPDATE_MONTH, CARD_EXPDATE_MONTH_PATTERN },
+  { EPHY_AUTOFILL_MATCH_CARD_EXPDATE_YEAR, CARD_EXPDATE_YEAR_PATTERN },
+  { EPHY_AUTOFILL_MATCH_CARD_EXPDATE, CARD_EXPDATE_PATTERN },
+  { EPHY_AUTOFILL_MATCH_MONTH, MONTH_PATTERN },
+  { EPHY_AUTOFILL_MATCH_YEAR, YEAR_PATTERN },
+  { EPHY_AUTOFILL_MATCH_NAME_ON_CARD, NAME_ON_CARD_PATTERN },
+  { EPHY_AUTOFILL_MATCH_CARD_NUMBER, CARD_NUMBER_PATTERN },
+  { EPHY_AUTOFILL_MATCH_CARD_TYPE, CARD_TYPE_PATTERN }
+};
+
+/* All the patterns above are compiled into a single regex. Each pattern is
+ * wrapped in an optional lookahead anchored at the start of the key, which
+ * records in a named group whether (and where) it matches. A single call to
+ * g_regex_match() therefore classifies the key against every pattern.
+ */
+static GRegex *
+get_classifier (void)
 {
-  GRegex *regex;
+  static GRegex *classifier = NULL;
+  GString *pattern;
+  GError *error = NULL;
 
-  if (regexes == NULL)
-    regexes = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
+  if (classifier != NULL)
+    return classifier;
 
-  regex = g_hash_table_lookup (regexes, pattern);
+  pattern = g_string_new ("^");
+  for (guint i = 0; i < G_N_ELEMENTS (matchers); i++)
+    g_string_append_printf (pattern, "(?=(?:(?s:.*?)(?<m%u>%s))?)", i, matchers[i].pattern);
 
-  if (regex == NULL) {
-    regex = g_regex_new (pattern, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, NULL);
-    g_hash_table_insert (regexes, (char*)pattern, regex);
+  classifier = g_regex_new (pattern->str, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, &error);
+  if (error != NULL) {
+    g_critical ("Failed to compile autofill classifier: %s", error->message);
+    g_error_free (error);
   }
 
-  return (const GRegex*)regex;
-}
-
-static bool
-matches (const GRegex *regex,
-         const char *string)
-{
-  return g_regex_match (regex, (const char*)string, 0, NULL);
-}
-
-bool
-ephy_autofill_matchers_is_firstname (const char *element_key)
-{
-  return matches (FIRSTNAME_REGEX, element_key);
-}
-
-bool
-ephy_autofill_matchers_is_lastname (const char *element_key)
-{
-  return matches (LASTNAME_REGEX, element_key);
-}
-
-bool
-ephy_autofill_matchers_is_fullname (const char *element_key)
-{
-  return matches (FULLNAME_REGEX, element_key);
-}
-
-bool
-ephy_autofill_matchers_is_username (const char *element_key)
-{
-  return matches (USERNAME_REGEX, element_key);
-}
-
-bool
-ephy_autofill_matchers_is_email (const char *element_key)
-{
-  return matches (EMAIL_REGEX, element_key);
-}
-
-bool
-ephy_autofill_matchers_is_phone (const char *element_key)
-{
-  return matches (PHONE_REGEX, element_key);
-}
-
-bool
-ephy_autofill_matchers_is_street_address (const char *element_key)
-{
-  return matches (STREET_ADDRESS_REGEX, element_key);
-}
-
-bool
-ephy_autofill_matchers_is_organization (const char *element_key)
-{
-  return matches (ORGANIZATION_REGEX, element_key);
-}
-
-bool
-ephy_autofill_matchers_is_postal_code (const char *element_key)
-{
-  return matches (POSTAL_CODE_REGEX, element_key);
-}
+  g_string_free (pattern, TRUE);
 
-bool
-ephy_autofill_matchers_is_country (const char *element_key)
-{
-  return matches (COUNTRY_REGEX, element_key);
+  return classifier;
 }
 
-bool
-ephy_autofill_matchers_is_state (const char *element_key)
-{
-  return matches (STATE_REGEX, element_key);
-}
-
-bool
-ephy_autofill_matchers_is_city (const char *element_key)
-{
-  return matches (CITY_REGEX, element_key);
-}
+/**
+ * ephy_autofill_matchers_classify:
+ * @element_key: an element key (e.g: name, id or label)
+ *
+ * Scans @element_key once and reports every pattern that matches it.
+ *
+ * Returns: a mask of #EphyAutofillMatch flags
+ **/
+EphyAutofillMatch
+ephy_autofill_matchers_classify (const char *element_key)
+{
+  GRegex *classifier = get_classifier ();
+  GMatchInfo *match_info;
+  EphyAutofillMatch result = EPHY_AUTOFILL_MATCH_NONE;
+
+  if (classifier == NULL || element_key == NULL)
+    return EPHY_AUTOFILL_MATCH_NONE;
+
+  if (g_regex_match (classifier, element_key, 0, &match_info)) {
+    for (guint i = 0; i < G_N_ELEMENTS (matchers); i++) {
+      char name[8];
+      int start = -1;
+
+      g_snprintf (name, sizeof (name), "m%u", i);
+      if (g_match_info_fetch_named_pos (match_info, name, &start, NULL) && start >= 0)
+        result |= matchers[i].match;
+    }
+  }
 
-bool
-ephy_autofill_matchers_is_card_expdate_month (const char *element_key)
-{
-  return matches (CARD_EXPDATE_MONTH_REGEX, element_key);
-}
+  g_match_info_free (match_info);
 
-bool
-ephy_autofill_matchers_is_card_expdate_year (const char *element_key)
-{
-  return matches (CARD_EXPDATE_YEAR_REGEX, element_key);
+  return result;
 }
 
-bool
-ephy_autofill_matchers_is_month (const char *element_key)
+/**
+ * ephy_autofill_matchers_cache_new:
+ *
+ * Creates a table to memoize classifications in, see
+ * ephy_autofill_matchers_classify_cached().
+ *
+ * Returns: (transfer full): a new #GHashTable
+ **/
+GHashTable *
+ephy_autofill_matchers_cache_new (void)
 {
-  return matches (get_regex ("month"), element_key);
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 }
 
-bool
-ephy_autofill_matchers_is_year (const char *element_key)
+/**
+ * ephy_autofill_matchers_classify_cached:
+ * @cache: a table created by ephy_autofill_matchers_cache_new()
+ * @element_key: an element key (e.g: name, id or label)
+ *
+ * Like ephy_autofill_matchers_classify(), but only scans @element_key the
+ * first time it is seen, and remembers the result in @cache.
+ *
+ * Returns: a mask of #EphyAutofillMatch flags
+ **/
+EphyAutofillMatch
+ephy_autofill_matchers_classify_cached (GHashTable *cache,
+                                        const char *element_key)
 {
-  return matches (get_regex ("year"), element_key);
-}
+  gpointer value;
+  EphyAutofillMatch match;
 
-bool
-ephy_autofill_matchers_is_card_expdate (const char *element_key)
-{
-  return matches (CARD_EXPDATE_REGEX, element_key);
-}
+  if (element_key == NULL)
+    return EPHY_AUTOFILL_MATCH_NONE;
 
-bool
-ephy_autofill_matchers_is_name_on_card (const char *element_key)
-{
-  return matches (NAME_ON_CARD_REGEX, element_key);
-}
+  if (g_hash_table_lookup_extended (cache, element_key, NULL, &value))
+    return GPOINTER_TO_UINT (value);
 
-bool
-ephy_autofill_matchers_is_card_number (const char *element_key)
-{
-  return matches (CARD_NUMBER_REGEX, element_key);
-}
+  match = ephy_autofill_matchers_classify (element_key);
+  g_hash_table_insert (cache, g_strdup (element_key), GUINT_TO_POINTER (match));
 
-bool
-ephy_autofill_matchers_is_card_type (const char *element_key)
-{
-  return matches (CARD_TYPE_REGEX, element_key);
+  return match;
 }
@@ -28,29 +28,40 @@
 
 G_BEGIN_DECLS
 
-bool ephy_autofill_matchers_is_firstname (const char *element_key);
-bool ephy_autofill_matchers_is_lastname  (const char *element_key);
-bool ephy_autofill_matchers_is_fullname  (const char *element_key);
-bool ephy_autofill_matchers_is_username  (const char *element_key);
-bool ephy_autofill_matchers_is_email     (const char *element_key);
-bool ephy_autofill_matchers_is_phone     (const char *element_key);
-
-bool ephy_autofill_matchers_is_street_address (const char *element_key);
-bool ephy_autofill_matchers_is_organization   (const char *element_key);
-bool ephy_autofill_matchers_is_postal_code    (const char *element_key);
-bool ephy_autofill_matchers_is_country        (const char *element_key);
-bool ephy_autofill_matchers_is_state          (const char *element_key);
-bool ephy_autofill_matchers_is_city           (const char *element_key);
-
-bool ephy_autofill_matchers_is_card_expdate_month (const char *element_key);
-bool ephy_autofill_matchers_is_card_expdate_year  (const char *element_key);
-bool ephy_autofill_matchers_is_card_expdate       (const char *element_key);
-bool ephy_autofill_matchers_is_month              (const char *element_key);
-bool ephy_autofill_matchers_is_year               (const char *element_key);
-
-bool ephy_autofill_matchers_is_name_on_card (const char *element_key);
-bool ephy_autofill_matchers_is_card_number  (const char *element_key);
-bool ephy_autofill_matchers_is_card_type    (const char *element_key);
+typedef enum
+{
+  EPHY_AUTOFILL_MATCH_NONE = 0,
+
+  EPHY_AUTOFILL_MATCH_FIRSTNAME = (1 << 0),
+  EPHY_AUTOFILL_MATCH_LASTNAME = (1 << 1),
+  EPHY_AUTOFILL_MATCH_FULLNAME = (1 << 2),
+  EPHY_AUTOFILL_MATCH_USERNAME = (1 << 3),
+  EPHY_AUTOFILL_MATCH_EMAIL = (1 << 4),
+  EPHY_AUTOFILL_MATCH_PHONE = (1 << 5),
+
+  EPHY_AUTOFILL_MATCH_STREET_ADDRESS = (1 << 6),
+  EPHY_AUTOFILL_MATCH_ORGANIZATION = (1 << 7),
+  EPHY_AUTOFILL_MATCH_POSTAL_CODE = (1 << 8),
+  EPHY_AUTOFILL_MATCH_COUNTRY = (1 << 9),
+  EPHY_AUTOFILL_MATCH_STATE = (1 << 10),
+  EPHY_AUTOFILL_MATCH_CITY = (1 << 11),
+
+  EPHY_AUTOFILL_MATCH_CARD_EXPDATE_MONTH = (1 << 12),
+  EPHY_AUTOFILL_MATCH_CARD_EXPDATE_YEAR = (1 << 13),
+  EPHY_AUTOFILL_MATCH_CARD_EXPDATE = (1 << 14),
+  EPHY_AUTOFILL_MATCH_MONTH = (1 << 15),
+  EPHY_AUTOFILL_MATCH_YEAR = (1 << 16),
+
+  EPHY_AUTOFILL_MATCH_NAME_ON_CARD = (1 << 17),
+  EPHY_AUTOFILL_MATCH_CARD_NUMBER = (1 << 18),
+  EPHY_AUTOFILL_MATCH_CARD_TYPE = (1 << 19)
+} EphyAutofillMatch;
+
+EphyAutofillMatch ephy_autofill_matchers_classify (const char *element_key);
+
+GHashTable *ephy_autofill_matchers_cache_new (void);
+EphyAutofillMatch ephy_autofill_matchers_classify_cached (GHashTable *cache,
+                                                          const char *element_key);
 
 G_END_DECLS
 
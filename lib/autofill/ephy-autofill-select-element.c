@@ -33,38 +33,36 @@
 #define MAX_SELECT_ELEMENT_LENGTH 256
 
 static EphyAutofillField
-get_credit_card_field (WebKitDOMHTMLSelectElement *select_element,
-                       const char *element_key)
+get_credit_card_field (EphyAutofillMatch matches)
 {
-  if (ephy_autofill_matchers_is_card_expdate_month (element_key) &&
-      ephy_autofill_matchers_is_card_expdate_year (element_key)) {
+  if ((matches & EPHY_AUTOFILL_MATCH_CARD_EXPDATE_MONTH) &&
+      (matches & EPHY_AUTOFILL_MATCH_CARD_EXPDATE_YEAR)) {
 
-    if (ephy_autofill_matchers_is_month (element_key))
+    if (matches & EPHY_AUTOFILL_MATCH_MONTH)
       return EPHY_AUTOFILL_FIELD_CARD_EXPDATE_MONTH;
-    if (ephy_autofill_matchers_is_year (element_key))
+    if (matches & EPHY_AUTOFILL_MATCH_YEAR)
       return EPHY_AUTOFILL_FIELD_CARD_EXPDATE_YEAR;
 
     return EPHY_AUTOFILL_FIELD_UNKNOWN;
   }
-  if (ephy_autofill_matchers_is_card_expdate_month (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_CARD_EXPDATE_MONTH)
     return EPHY_AUTOFILL_FIELD_CARD_EXPDATE_MONTH;
-  if (ephy_autofill_matchers_is_card_expdate_year (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_CARD_EXPDATE_YEAR)
     return EPHY_AUTOFILL_FIELD_CARD_EXPDATE_YEAR;
-  if (ephy_autofill_matchers_is_card_type (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_CARD_TYPE)
     return EPHY_AUTOFILL_FIELD_CARD_TYPE;
 
   return EPHY_AUTOFILL_FIELD_UNKNOWN;
 }
 
 static EphyAutofillField
-get_personal_field (WebKitDOMHTMLSelectElement *select_element,
-                    const char *element_key)
+get_personal_field (EphyAutofillMatch matches)
 {
-  if (ephy_autofill_matchers_is_country (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_COUNTRY)
     return EPHY_AUTOFILL_FIELD_COUNTRY_NAME;
-  if (ephy_autofill_matchers_is_state (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_STATE)
     return EPHY_AUTOFILL_FIELD_STATE;
-  if (ephy_autofill_matchers_is_city (element_key))
+  if (matches & EPHY_AUTOFILL_MATCH_CITY)
     return EPHY_AUTOFILL_FIELD_CITY;
 
   return EPHY_AUTOFILL_FIELD_UNKNOWN;
@@ -77,13 +75,21 @@ get_field_helper (WebKitDOMHTMLSelectElement *select_element,
                   bool fill_credit_card_info)
 {
   EphyAutofillField field = EPHY_AUTOFILL_FIELD_UNKNOWN;
+  WebKitDOMHTMLFormElement *form;
+  EphyAutofillMatch matches;
 
   if (!ephy_autofill_utils_is_valid_element_key (element_key))
     return field;
+  if (!fill_personal_info && !fill_credit_card_info)
+    return field;
+
+  form = webkit_dom_html_select_element_get_form (select_element);
+  matches = ephy_autofill_utils_classify_element_key (form, element_key);
+
   if (fill_personal_info)
-    field = get_personal_field (select_element, element_key);
+    field = get_personal_field (matches);
   if (fill_credit_card_info && field == EPHY_AUTOFILL_FIELD_UNKNOWN)
-    field = get_credit_card_field (select_element, element_key);
+    field = get_credit_card_field (matches);
 
   return field;
 }
@@ -166,12 +172,9 @@ get_named_index (WebKitDOMHTMLSelectElement *select_element,
 }
 
 static void
-fill_cb (GObject *source_object,
-         GAsyncResult *res,
-         gpointer user_data)
+select_named_item (WebKitDOMHTMLSelectElement *select_element,
+                   const char *autofill_value)
 {
-  WebKitDOMHTMLSelectElement *select_element = user_data;
-  char *autofill_value = ephy_autofill_storage_get_finish (res);
   long index = get_named_index (select_element, autofill_value);
 
   if (index >= 0) {
@@ -180,6 +183,17 @@ fill_cb (GObject *source_object,
                                         "HTMLEvents", "change",
                                         FALSE, TRUE);
   }
+}
+
+static void
+fill_cb (GObject *source_object,
+         GAsyncResult *res,
+         gpointer user_data)
+{
+  WebKitDOMHTMLSelectElement *select_element = user_data;
+  char *autofill_value = ephy_autofill_storage_get_finish (res);
+
+  select_named_item (select_element, autofill_value);
 
   g_free (autofill_value);
 }
@@ -204,3 +218,25 @@ ephy_autofill_select_element_fill (WebKitDOMHTMLSelectElement *select_element,
   if (field != EPHY_AUTOFILL_FIELD_UNKNOWN)
     ephy_autofill_storage_get (field, fill_cb, select_element);
 }
+
+/**
+ * ephy_autofill_select_element_fill_from_values:
+ * @select_element: a #WebKitDOMHTMLSelectElement
+ * @values: values returned by ephy_autofill_storage_get_all_finish()
+ * @fill_personal_info: whether personal info should be filled
+ * @fill_credit_card_info: whether credit card info should be filled
+ *
+ * Same as ephy_autofill_select_element_fill(), but synchronously
+ * takes the value from @values instead of looking it up.
+ **/
+void
+ephy_autofill_select_element_fill_from_values (WebKitDOMHTMLSelectElement *select_element,
+                                               GHashTable *values,
+                                               bool fill_personal_info,
+                                               bool fill_credit_card_info)
+{
+  EphyAutofillField field = ephy_autofill_select_element_get_field (select_element, fill_personal_info, fill_credit_card_info);
+
+  if (field != EPHY_AUTOFILL_FIELD_UNKNOWN)
+    select_named_item (select_element, ephy_autofill_storage_lookup (values, field));
+}
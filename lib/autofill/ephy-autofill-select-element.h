@@ -39,6 +39,12 @@ ephy_autofill_select_element_fill (WebKitDOMHTMLSelectElement *select_element,
                                    bool fill_personal_info,
                                    bool fill_credit_card_info);
 
+void
+ephy_autofill_select_element_fill_from_values (WebKitDOMHTMLSelectElement *select_element,
+                                               GHashTable *values,
+                                               bool fill_personal_info,
+                                               bool fill_credit_card_info);
+
 G_END_DECLS
 
 #endif
@@ -81,6 +81,11 @@
 
 #define SCHEMA get_schema ()
 
+/* Snapshot of every stored key → value, filled by ephy_autofill_storage_get_all()
+ * and dropped whenever a value is changed through this process. */
+static GHashTable *cached_values = NULL;
+static guint cache_generation = 0;
+
 static const SecretSchema *
 get_schema (void)
 {
@@ -209,6 +214,19 @@ get_key_and_label_for_field (EphyAutofillField field, const char **key, const ch
   }
 }
 
+/**
+ * ephy_autofill_storage_invalidate_cache:
+ *
+ * Drops the values cached by ephy_autofill_storage_get_all(), so that
+ * the next call fetches them again from the secret service.
+ **/
+void
+ephy_autofill_storage_invalidate_cache (void)
+{
+  g_clear_pointer (&cached_values, g_hash_table_unref);
+  cache_generation++;
+}
+
 /**
  * ephy_autofill_storage_delete:
  * @field: an #EphyAutofillField
@@ -231,6 +249,7 @@ ephy_autofill_storage_delete (EphyAutofillField field,
   get_key_and_label_for_field (field, &key, &label);
 
   if (key != NULL) {
+    ephy_autofill_storage_invalidate_cache ();
     secret_password_clear (SCHEMA, NULL,
                            callback, user_data,
                            FIELD_KEY, key,
@@ -289,6 +308,7 @@ ephy_autofill_storage_set (EphyAutofillField field,
   get_key_and_label_for_field (field, &key, &label);
 
   if (label != NULL && key != NULL) {
+    ephy_autofill_storage_invalidate_cache ();
     secret_password_store (SCHEMA, SECRET_COLLECTION_DEFAULT,
                            label, storable_value,
                            NULL, callback, user_data,
@@ -334,3 +354,115 @@ ephy_autofill_storage_set_finish (GAsyncResult *res)
 {
   return secret_password_store_finish (res, NULL);
 }
+
+static void
+get_all_search_cb (GObject *source_object,
+                   GAsyncResult *res,
+                   gpointer user_data)
+{
+  GTask *task = user_data;
+  guint generation = GPOINTER_TO_UINT (g_task_get_task_data (task));
+  GHashTable *values;
+  GError *error = NULL;
+  GList *items;
+
+  items = secret_service_search_finish (NULL, res, &error);
+  if (error != NULL) {
+    g_task_return_error (task, error);
+    g_object_unref (task);
+    return;
+  }
+
+  values = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  for (GList *l = items; l != NULL; l = l->next) {
+    SecretItem *item = l->data;
+    GHashTable *attributes = secret_item_get_attributes (item);
+    SecretValue *value = secret_item_get_secret (item);
+    const char *key = g_hash_table_lookup (attributes, FIELD_KEY);
+
+    if (key != NULL && value != NULL && secret_value_get_text (value) != NULL)
+      g_hash_table_replace (values, g_strdup (key), g_strdup (secret_value_get_text (value)));
+
+    if (value != NULL)
+      secret_value_unref (value);
+    g_hash_table_unref (attributes);
+  }
+
+  g_list_free_full (items, g_object_unref);
+
+  /* Only cache the result if no value was changed while searching. */
+  if (generation == cache_generation) {
+    g_clear_pointer (&cached_values, g_hash_table_unref);
+    cached_values = g_hash_table_ref (values);
+  }
+
+  g_task_return_pointer (task, values, (GDestroyNotify)g_hash_table_unref);
+  g_object_unref (task);
+}
+
+/**
+ * ephy_autofill_storage_get_all:
+ * @callback: a #GAsyncReadyCallback
+ * @user_data: a value passed to @callback
+ *
+ * Gets all stored values using a single secret service search,
+ * instead of one lookup per field as ephy_autofill_storage_get() does.
+ * The result is cached until a value is set or deleted.
+ **/
+void
+ephy_autofill_storage_get_all (GAsyncReadyCallback callback,
+                               gpointer user_data)
+{
+  GTask *task = g_task_new (NULL, NULL, callback, user_data);
+  GHashTable *attributes;
+
+  if (cached_values != NULL) {
+    g_task_return_pointer (task, g_hash_table_ref (cached_values), (GDestroyNotify)g_hash_table_unref);
+    g_object_unref (task);
+    return;
+  }
+
+  g_task_set_task_data (task, GUINT_TO_POINTER (cache_generation), NULL);
+
+  attributes = secret_attributes_build (SCHEMA, NULL);
+  secret_service_search (NULL, SCHEMA, attributes,
+                         SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK | SECRET_SEARCH_LOAD_SECRETS,
+                         NULL, get_all_search_cb, task);
+  g_hash_table_unref (attributes);
+}
+
+/**
+ * ephy_autofill_storage_get_all_finish:
+ * @res: a #GAsyncResult
+ *
+ * Returns: (transfer full): a read-only table of all stored values associated
+ *          with @res, to be queried with ephy_autofill_storage_lookup(), or %NULL
+ **/
+GHashTable *
+ephy_autofill_storage_get_all_finish (GAsyncResult *res)
+{
+  return g_task_propagate_pointer (G_TASK (res), NULL);
+}
+
+/**
+ * ephy_autofill_storage_lookup:
+ * @values: (allow-none): a table returned by ephy_autofill_storage_get_all_finish()
+ * @field: an #EphyAutofillField
+ *
+ * Returns: (transfer none): the value stored for @field in @values or %NULL
+ **/
+const char *
+ephy_autofill_storage_lookup (GHashTable *values,
+                              EphyAutofillField field)
+{
+  const char *label;
+  const char *key;
+
+  if (values == NULL)
+    return NULL;
+
+  get_key_and_label_for_field (field, &key, &label);
+
+  return key != NULL ? g_hash_table_lookup (values, key) : NULL;
+}
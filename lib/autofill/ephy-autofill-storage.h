@@ -44,10 +44,19 @@ void ephy_autofill_storage_set (EphyAutofillField field,
                                 GAsyncReadyCallback callback,
                                 gpointer user_data);
 
+void ephy_autofill_storage_get_all (GAsyncReadyCallback callback,
+                                    gpointer user_data);
+
+void ephy_autofill_storage_invalidate_cache (void);
+
 bool  ephy_autofill_storage_delete_finish (GAsyncResult *res);
 char *ephy_autofill_storage_get_finish (GAsyncResult *res);
 bool  ephy_autofill_storage_set_finish (GAsyncResult *res);
 
+GHashTable *ephy_autofill_storage_get_all_finish (GAsyncResult *res);
+const char *ephy_autofill_storage_lookup (GHashTable *values,
+                                          EphyAutofillField field);
+
 G_END_DECLS
 
 #endif
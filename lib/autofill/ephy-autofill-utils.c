@@ -27,6 +27,7 @@
 #include <string.h>
 
 #define MAX_ELEMENT_KEY_LENGTH 64
+#define FORM_MATCHES_KEY "ephy-autofill-form-matches"
 
 /**
  * ephy_autofill_utils_is_element_visible:
@@ -161,3 +162,33 @@ ephy_autofill_utils_dispatch_event (WebKitDOMNode *node,
 
   g_object_unref (event);
 }
+
+/**
+ * ephy_autofill_utils_classify_element_key:
+ * @form: (allow-none): the #WebKitDOMHTMLFormElement owning the element
+ * @key: a valid element key, see ephy_autofill_utils_is_valid_element_key()
+ *
+ * Classifies @key using ephy_autofill_matchers_classify().
+ * Results are memoized on @form, so that the keys of a form are only
+ * scanned once for as long as the form is alive in the document.
+ *
+ * Returns: a mask of #EphyAutofillMatch flags
+ **/
+EphyAutofillMatch
+ephy_autofill_utils_classify_element_key (WebKitDOMHTMLFormElement *form,
+                                          const char *key)
+{
+  GHashTable *matches;
+
+  if (form == NULL)
+    return ephy_autofill_matchers_classify (key);
+
+  matches = g_object_get_data (G_OBJECT (form), FORM_MATCHES_KEY);
+  if (matches == NULL) {
+    matches = ephy_autofill_matchers_cache_new ();
+    g_object_set_data_full (G_OBJECT (form), FORM_MATCHES_KEY,
+                            matches, (GDestroyNotify)g_hash_table_destroy);
+  }
+
+  return ephy_autofill_matchers_classify_cached (matches, key);
+}
@@ -22,6 +22,8 @@
 #ifndef EPHY_AUTOFILL_UTILS_H
 #define EPHY_AUTOFILL_UTILS_H
 
+#include "ephy-autofill-matchers.h"
+
 #include <glib.h>
 #include <webkit2/webkit-web-extension.h>
 
@@ -43,6 +45,9 @@ bool ephy_autofill_utils_is_https (WebKitDOMNode *node);
 
 bool ephy_autofill_utils_is_element_visible (WebKitDOMElement *element);
 
+EphyAutofillMatch ephy_autofill_utils_classify_element_key (WebKitDOMHTMLFormElement *form,
+                                                            const char *key);
+
 G_END_DECLS
 
 #endif
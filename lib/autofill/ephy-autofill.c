@@ -315,6 +315,10 @@ ephy_autofill_fill (WebKitWebPage *web_page,
   input_element = WEBKIT_DOM_HTML_INPUT_ELEMENT (element);
   form = webkit_dom_html_input_element_get_form (input_element);
 
+  /* Values are edited from the UI process, so whatever this web process
+   * fetched for a previous fill may be stale by now. */
+  ephy_autofill_storage_invalidate_cache ();
+
   switch (fill_choice)
   {
     case EPHY_AUTOFILL_FILL_CHOICE_FORM_PERSONAL:
@@ -361,6 +365,20 @@ ephy_autofill_get (EphyAutofillField field,
   ephy_autofill_storage_get (field, callback, user_data);
 }
 
+/**
+ * ephy_autofill_get_all:
+ * @callback: a #GAsyncReadyCallback
+ * @user_data: a #gpointer
+ *
+ * A simple function that calls ephy_autofill_storage_get_all()
+ **/
+void
+ephy_autofill_get_all (GAsyncReadyCallback callback,
+                       gpointer user_data)
+{
+  ephy_autofill_storage_get_all (callback, user_data);
+}
+
 /**
  * ephy_autofill_set:
  * @field: an #EphyAutofillField
@@ -403,6 +421,32 @@ ephy_autofill_get_finish (GAsyncResult *res)
   return ephy_autofill_storage_get_finish (res);
 }
 
+/**
+ * ephy_autofill_get_all_finish:
+ * @res: a #GAsyncResult
+ *
+ * Returns: (transfer full): ephy_autofill_storage_get_all_finish()
+ **/
+GHashTable *
+ephy_autofill_get_all_finish (GAsyncResult *res)
+{
+  return ephy_autofill_storage_get_all_finish (res);
+}
+
+/**
+ * ephy_autofill_lookup:
+ * @values: (allow-none): a table returned by ephy_autofill_get_all_finish()
+ * @field: an #EphyAutofillField
+ *
+ * Returns: (transfer none): ephy_autofill_storage_lookup()
+ **/
+const char *
+ephy_autofill_lookup (GHashTable *values,
+                      EphyAutofillField field)
+{
+  return ephy_autofill_storage_lookup (values, field);
+}
+
 /**
  * ephy_autofill_set_finish:
  * @res: a #GAsyncResult
@@ -50,6 +50,9 @@ void ephy_autofill_get (EphyAutofillField field,
                         GAsyncReadyCallback callback,
                         gpointer user_data);
 
+void ephy_autofill_get_all (GAsyncReadyCallback callback,
+                            gpointer user_data);
+
 void ephy_autofill_set (EphyAutofillField field,
                         const char *value,
                         GAsyncReadyCallback callback,
@@ -59,6 +62,10 @@ bool  ephy_autofill_delete_finish (GAsyncResult *res);
 char *ephy_autofill_get_finish (GAsyncResult *res);
 bool  ephy_autofill_set_finish (GAsyncResult *res);
 
+GHashTable *ephy_autofill_get_all_finish (GAsyncResult *res);
+const char *ephy_autofill_lookup (GHashTable *values,
+                                  EphyAutofillField field);
+
 G_END_DECLS
 
 #endif
@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include "ephy-debug.h"
+#include "ephy-trace.h"
 
 #include <string.h>
 #ifdef HAVE_EXECINFO_H
@@ -33,17 +34,14 @@
 
 /**
  * SECTION:ephy-debug
- * @short_description: Epiphany debugging and profiling facilities
+ * @short_description: Epiphany debugging facilities
  *
- * Epiphany includes powerful profiling and debugging facilities to log and
+ * Epiphany includes powerful debugging and tracing facilities to log and
  * analyze modules. Refer to doc/debugging.txt for more information.
  */
 
 #if DEVELOPER_MODE
 static const char *ephy_debug_break = NULL;
-static GHashTable *ephy_profilers_hash = NULL;
-static char **ephy_profile_modules;
-static gboolean ephy_profile_all_modules;
 
 static char **
 build_modules (const char *name,
@@ -141,123 +139,12 @@ trap_handler (const char    *log_domain,
   }
 }
 
-static EphyProfiler *
-ephy_profiler_new (const char *name, const char *module)
-{
-  EphyProfiler *profiler;
-
-  profiler = g_new0 (EphyProfiler, 1);
-  profiler->timer = g_timer_new ();
-  profiler->name = g_strdup (name);
-  profiler->module = g_strdup (module);
-
-  g_timer_start (profiler->timer);
-
-  return profiler;
-}
-
-static gboolean
-ephy_should_profile (const char *module)
-{
-  char *slash;
-  gboolean result = FALSE;
-  guint i;
-
-  slash = strrchr (module, '/');
-
-  /* Happens on builddir != srcdir builds */
-  if (slash != NULL)
-    module = slash + 1;
-
-  for (i = 0; ephy_profile_modules[i] != NULL; i++) {
-    if (strcmp (ephy_profile_modules[i], module) == 0) {
-      result = TRUE;
-      break;
-    }
-  }
-
-  return result;
-}
-
-static void
-ephy_profiler_dump (EphyProfiler *profiler)
-{
-  double seconds;
-
-  g_assert (profiler != NULL);
-
-  seconds = g_timer_elapsed (profiler->timer, NULL);
-
-  g_print ("[ %s ] %s %f s elapsed\n",
-           profiler->module, profiler->name,
-           seconds);
-}
-
-static void
-ephy_profiler_free (EphyProfiler *profiler)
-{
-  g_assert (profiler != NULL);
-
-  g_timer_destroy (profiler->timer);
-  g_free (profiler->name);
-  g_free (profiler->module);
-  g_free (profiler);
-}
-
-/**
- * ephy_profiler_start:
- * @name: name of this new profiler
- * @module: Epiphany module to profile
- *
- * Starts a new profiler on @module naming it @name.
- **/
-void
-ephy_profiler_start (const char *name, const char *module)
-{
-  EphyProfiler *profiler;
-
-  if (ephy_profilers_hash == NULL) {
-    ephy_profilers_hash =
-      g_hash_table_new_full (g_str_hash, g_str_equal,
-                             g_free, NULL);
-  }
-
-  if (!ephy_profile_all_modules &&
-      (ephy_profile_modules == NULL || !ephy_should_profile (module)))
-    return;
-
-  profiler = ephy_profiler_new (name, module);
-
-  g_hash_table_insert (ephy_profilers_hash, g_strdup (name), profiler);
-}
-
-/**
- * ephy_profiler_stop:
- * @name: name of the profiler to stop
- *
- * Stops the profiler named @name.
- **/
-void
-ephy_profiler_stop (const char *name)
-{
-  EphyProfiler *profiler;
-
-  profiler = g_hash_table_lookup (ephy_profilers_hash, name);
-  if (profiler == NULL)
-    return;
-
-  g_hash_table_remove (ephy_profilers_hash, name);
-
-  ephy_profiler_dump (profiler);
-  ephy_profiler_free (profiler);
-}
-
 /**
  * ephy_debug_init:
  *
  * Starts the debugging facility. See Epiphany's HACKING file for
- * more information. It also starts module logging and profiling if the
- * appropiate variables are set: EPHY_LOG_MODULES and EPHY_PROFILE_MODULES.
+ * more information. It also starts module logging and tracing if the
+ * appropiate variables are set: EPHY_LOG_MODULES and EPHY_TRACE_DIR.
  **/
 void
 ephy_debug_init (void)
@@ -265,10 +152,10 @@ ephy_debug_init (void)
   ephy_log_modules = build_modules ("EPHY_LOG_MODULES", &ephy_log_all_modules);
   g_log_set_handler (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, log_module, NULL);
 
-  ephy_profile_modules = build_modules ("EPHY_PROFILE_MODULES", &ephy_profile_all_modules);
-
   ephy_debug_break = g_getenv ("EPHY_DEBUG_BREAK");
   g_log_set_default_handler (trap_handler, NULL);
+
+  ephy_trace_init ();
 }
 
 #else
@@ -276,6 +163,7 @@ ephy_debug_init (void)
 void
 ephy_debug_init (void)
 {
+  ephy_trace_init ();
 }
 
 #endif
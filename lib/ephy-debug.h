@@ -33,30 +33,6 @@ G_BEGIN_DECLS
 #define LOG(...) G_STMT_START { } G_STMT_END
 #endif
 
-#if DEVELOPER_MODE
-#define START_PROFILER(name)	ephy_profiler_start (name, __FILE__);
-#define STOP_PROFILER(name)   ephy_profiler_stop (name);
-#else
-#define START_PROFILER(name)
-#define STOP_PROFILER(name)
-#endif
-
-typedef struct
-{
-	GTimer *timer;
-	char *name;
-	char *module;
-} EphyProfiler;
-
 void		ephy_debug_init		(void);
 
-#if DEVELOPER_MODE
-
-void		ephy_profiler_start	(const char *name,
-					 const char *module);
-
-void		ephy_profiler_stop	(const char *name);
-
-#endif
-
 G_END_DECLS
@@ -25,8 +25,6 @@
 #include "ephy-file-helpers.h"
 #include "ephy-string.h"
 
-#define G_SETTINGS_ENABLE_BACKEND 1
-#include <gio/gsettingsbackend.h>
 #include <stdlib.h>
 #include <string.h>
 #include <webkit2/webkit2.h>
@@ -35,8 +33,19 @@ struct _EphyPermissionsManager
 {
   GObject parent_instance;
 
-  GHashTable *origins_mapping;
-  GHashTable *settings_mapping;
+  /* All permissions live in a single keyfile that is parsed once. It keeps the
+   * on-disk format previously written by GKeyfileSettingsBackend, one group per
+   * origin, so existing profiles keep working. */
+  char *filename;
+  GKeyFile *keyfile;
+  char *keyfile_digest;
+  GFileMonitor *monitor;
+  guint save_source_id;
+
+  /* Origin URI → keyfile group name. */
+  GHashTable *groups_mapping;
+  /* Keyfile group name → permission bitmap, see permission_bitmap_get (). */
+  GHashTable *permissions;
 
   GHashTable *permission_type_permitted_origins;
   GHashTable *permission_type_denied_origins;
@@ -45,17 +54,87 @@ struct _EphyPermissionsManager
 G_DEFINE_TYPE (EphyPermissionsManager, ephy_permissions_manager, G_TYPE_OBJECT)
 
 #define PERMISSIONS_FILENAME "permissions.ini"
+#define PERMISSIONS_GROUP_PREFIX "org/gnome/epiphany/permissions/"
+#define PERMISSIONS_SAVE_DELAY 100 /* ms */
 
-static void
-ephy_permissions_manager_init (EphyPermissionsManager *manager)
+/* Each EphyPermissionType occupies two bits of the bitmap, holding the
+ * EphyPermission value offset by one, so that 0 means undecided and an origin
+ * without any decision does not need an entry at all. */
+#define PERMISSION_BITS 2
+#define PERMISSION_MASK 0x3
+
+static EphyPermission
+permission_bitmap_get (guint              bitmap,
+                       EphyPermissionType type)
 {
-  manager->origins_mapping = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
-  manager->settings_mapping = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+  return (EphyPermission)((bitmap >> (type * PERMISSION_BITS)) & PERMISSION_MASK) - 1;
+}
 
-  /* We cannot use a key_destroy_func here because we need to be able to update
-   * the GList keys without destroying the contents of the lists. */
-  manager->permission_type_permitted_origins = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, NULL);
-  manager->permission_type_denied_origins = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, NULL);
+static guint
+permission_bitmap_set (guint              bitmap,
+                       EphyPermissionType type,
+                       EphyPermission     permission)
+{
+  bitmap &= ~(PERMISSION_MASK << (type * PERMISSION_BITS));
+  return bitmap | ((guint)(permission + 1) << (type * PERMISSION_BITS));
+}
+
+static const char *
+permission_type_to_string (EphyPermissionType type)
+{
+  switch (type) {
+  case EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS:
+    return "notifications-permission";
+  case EPHY_PERMISSION_TYPE_SAVE_PASSWORD:
+    return "save-password-permission";
+  case EPHY_PERMISSION_TYPE_ACCESS_LOCATION:
+    return "geolocation-permission";
+  case EPHY_PERMISSION_TYPE_ACCESS_MICROPHONE:
+    return "audio-device-permission";
+  case EPHY_PERMISSION_TYPE_ACCESS_WEBCAM:
+    return "video-device-permission";
+  default:
+    g_assert_not_reached ();
+  }
+}
+
+static gboolean
+permission_type_from_string (const char         *string,
+                             EphyPermissionType *type)
+{
+  for (EphyPermissionType i = EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS; i <= EPHY_PERMISSION_TYPE_ACCESS_WEBCAM; i++) {
+    if (strcmp (permission_type_to_string (i), string) == 0) {
+      *type = i;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/* Values are stored as serialized GVariants of the org.gnome.Epiphany.Permission
+ * enum nicks, as GSettings used to write them. */
+static const char *
+permission_to_keyfile_value (EphyPermission permission)
+{
+  switch (permission) {
+  case EPHY_PERMISSION_DENY:
+    return "'deny'";
+  case EPHY_PERMISSION_PERMIT:
+    return "'allow'";
+  default:
+    g_assert_not_reached ();
+  }
+}
+
+static EphyPermission
+permission_from_keyfile_value (const char *value)
+{
+  if (strcmp (value, "'allow'") == 0)
+    return EPHY_PERMISSION_PERMIT;
+  if (strcmp (value, "'deny'") == 0)
+    return EPHY_PERMISSION_DENY;
+  return EPHY_PERMISSION_UNDECIDED;
 }
 
 static void
@@ -66,13 +145,203 @@ free_cached_origin_list (gpointer key,
   g_list_free_full ((GList *)value, (GDestroyNotify)webkit_security_origin_unref);
 }
 
+static void
+clear_cached_origin_lists (EphyPermissionsManager *manager)
+{
+  g_hash_table_foreach (manager->permission_type_permitted_origins, free_cached_origin_list, NULL);
+  g_hash_table_remove_all (manager->permission_type_permitted_origins);
+
+  g_hash_table_foreach (manager->permission_type_denied_origins, free_cached_origin_list, NULL);
+  g_hash_table_remove_all (manager->permission_type_denied_origins);
+}
+
+static void
+index_keyfile_group (EphyPermissionsManager *manager,
+                     const char             *group)
+{
+  char **keys;
+  guint bitmap = 0;
+  EphyPermissionType type;
+
+  if (!g_str_has_prefix (group, PERMISSIONS_GROUP_PREFIX))
+    return;
+
+  keys = g_key_file_get_keys (manager->keyfile, group, NULL, NULL);
+  if (!keys)
+    return;
+
+  for (guint i = 0; keys[i]; i++) {
+    g_autofree char *value = NULL;
+    EphyPermission permission;
+
+    if (!permission_type_from_string (keys[i], &type))
+      continue;
+
+    value = g_key_file_get_value (manager->keyfile, group, keys[i], NULL);
+    if (!value)
+      continue;
+
+    permission = permission_from_keyfile_value (value);
+    if (permission != EPHY_PERMISSION_UNDECIDED)
+      bitmap = permission_bitmap_set (bitmap, type, permission);
+  }
+
+  g_strfreev (keys);
+
+  if (bitmap != 0)
+    g_hash_table_insert (manager->permissions, g_strdup (group), GUINT_TO_POINTER (bitmap));
+}
+
+static void
+ephy_permissions_manager_load (EphyPermissionsManager *manager)
+{
+  g_autofree char *contents = NULL;
+  gsize length = 0;
+  char **groups;
+  GError *error = NULL;
+
+  g_clear_pointer (&manager->keyfile, g_key_file_unref);
+  g_clear_pointer (&manager->keyfile_digest, g_free);
+  g_hash_table_remove_all (manager->permissions);
+  clear_cached_origin_lists (manager);
+
+  manager->keyfile = g_key_file_new ();
+
+  if (!g_file_get_contents (manager->filename, &contents, &length, &error)) {
+    if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      g_warning ("Error reading %s: %s", manager->filename, error->message);
+    g_error_free (error);
+    return;
+  }
+
+  manager->keyfile_digest = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *)contents, length);
+
+  if (!g_key_file_load_from_data (manager->keyfile, contents, length, G_KEY_FILE_NONE, &error)) {
+    g_warning ("Error processing %s: %s", manager->filename, error->message);
+    g_error_free (error);
+    return;
+  }
+
+  groups = g_key_file_get_groups (manager->keyfile, NULL);
+  for (guint i = 0; groups[i]; i++)
+    index_keyfile_group (manager, groups[i]);
+  g_strfreev (groups);
+}
+
+static gboolean
+ephy_permissions_manager_save (EphyPermissionsManager *manager)
+{
+  g_autofree char *data = NULL;
+  gsize length;
+  GError *error = NULL;
+
+  manager->save_source_id = 0;
+
+  data = g_key_file_to_data (manager->keyfile, &length, NULL);
+
+  /* Remember what we wrote, so that our own file monitor does not trigger a
+   * pointless reload. */
+  g_free (manager->keyfile_digest);
+  manager->keyfile_digest = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *)data, length);
+
+  if (!g_file_set_contents (manager->filename, data, length, &error)) {
+    g_warning ("Failed to save %s: %s", manager->filename, error->message);
+    g_error_free (error);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+ephy_permissions_manager_schedule_save (EphyPermissionsManager *manager)
+{
+  if (manager->save_source_id != 0)
+    return;
+
+  manager->save_source_id = g_timeout_add (PERMISSIONS_SAVE_DELAY,
+                                           (GSourceFunc)ephy_permissions_manager_save,
+                                           manager);
+  g_source_set_name_by_id (manager->save_source_id, "[epiphany] permissions_manager_save");
+}
+
+static void
+permissions_file_changed_cb (GFileMonitor           *monitor,
+                             GFile                  *file,
+                             GFile                  *other_file,
+                             GFileMonitorEvent       event_type,
+                             EphyPermissionsManager *manager)
+{
+  g_autofree char *contents = NULL;
+  g_autofree char *digest = NULL;
+  gsize length = 0;
+
+  if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED ||
+      event_type == G_FILE_MONITOR_EVENT_PRE_UNMOUNT ||
+      event_type == G_FILE_MONITOR_EVENT_UNMOUNTED)
+    return;
+
+  /* Pending local changes win over whatever another process wrote. */
+  if (manager->save_source_id != 0)
+    return;
+
+  if (g_file_get_contents (manager->filename, &contents, &length, NULL))
+    digest = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *)contents, length);
+
+  if (g_strcmp0 (digest, manager->keyfile_digest) != 0)
+    ephy_permissions_manager_load (manager);
+}
+
+static void
+ephy_permissions_manager_init (EphyPermissionsManager *manager)
+{
+  GFile *file;
+  GError *error = NULL;
+
+  manager->filename = g_build_filename (ephy_profile_dir (), PERMISSIONS_FILENAME, NULL);
+
+  manager->groups_mapping = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  manager->permissions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /* We cannot use a key_destroy_func here because we need to be able to update
+   * the GList keys without destroying the contents of the lists. */
+  manager->permission_type_permitted_origins = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, NULL);
+  manager->permission_type_denied_origins = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, NULL);
+
+  ephy_permissions_manager_load (manager);
+
+  /* The UI process writes the file and web processes read it, so pick up
+   * changes made by other processes. */
+  file = g_file_new_for_path (manager->filename);
+  manager->monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, &error);
+  if (manager->monitor) {
+    g_signal_connect (manager->monitor, "changed",
+                      G_CALLBACK (permissions_file_changed_cb),
+                      manager);
+  } else {
+    g_warning ("Failed to monitor %s: %s", manager->filename, error->message);
+    g_error_free (error);
+  }
+  g_object_unref (file);
+}
+
 static void
 ephy_permissions_manager_dispose (GObject *object)
 {
   EphyPermissionsManager *manager = EPHY_PERMISSIONS_MANAGER (object);
 
-  g_clear_pointer (&manager->origins_mapping, g_hash_table_destroy);
-  g_clear_pointer (&manager->settings_mapping, g_hash_table_destroy);
+  if (manager->save_source_id != 0) {
+    g_source_remove (manager->save_source_id);
+    ephy_permissions_manager_save (manager);
+  }
+
+  if (manager->monitor) {
+    g_signal_handlers_disconnect_by_func (manager->monitor, permissions_file_changed_cb, manager);
+    g_file_monitor_cancel (manager->monitor);
+    g_clear_object (&manager->monitor);
+  }
+
+  g_clear_pointer (&manager->groups_mapping, g_hash_table_destroy);
+  g_clear_pointer (&manager->permissions, g_hash_table_destroy);
 
   if (manager->permission_type_permitted_origins != NULL) {
     g_hash_table_foreach (manager->permission_type_permitted_origins, free_cached_origin_list, NULL);
@@ -89,59 +358,63 @@ ephy_permissions_manager_dispose (GObject *object)
   G_OBJECT_CLASS (ephy_permissions_manager_parent_class)->dispose (object);
 }
 
+static void
+ephy_permissions_manager_finalize (GObject *object)
+{
+  EphyPermissionsManager *manager = EPHY_PERMISSIONS_MANAGER (object);
+
+  g_free (manager->filename);
+  g_free (manager->keyfile_digest);
+  g_clear_pointer (&manager->keyfile, g_key_file_unref);
+
+  G_OBJECT_CLASS (ephy_permissions_manager_parent_class)->finalize (object);
+}
+
 static void
 ephy_permissions_manager_class_init (EphyPermissionsManagerClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->dispose = ephy_permissions_manager_dispose;
+  object_class->finalize = ephy_permissions_manager_finalize;
 }
 
-static GSettings *
-ephy_permissions_manager_get_settings_for_origin (EphyPermissionsManager *manager,
-                                                  const char             *origin)
+static const char *
+ephy_permissions_manager_get_group_for_origin (EphyPermissionsManager *manager,
+                                               const char             *origin)
 {
-  char *origin_path;
+  char *group;
   char *trimmed_protocol;
-  char *filename;
-  GSettingsBackend* backend;
-  GSettings *settings;
   WebKitSecurityOrigin *security_origin;
   char *pos;
 
   g_assert (origin != NULL);
 
-  settings = g_hash_table_lookup (manager->origins_mapping, origin);
-  if (settings)
-    return settings;
+  group = g_hash_table_lookup (manager->groups_mapping, origin);
+  if (group)
+    return group;
 
-  filename = g_build_filename (ephy_profile_dir (), PERMISSIONS_FILENAME, NULL);
-  backend = g_keyfile_settings_backend_new (filename, "/", NULL);
-  g_free (filename);
+  security_origin = webkit_security_origin_new_for_uri (origin);
+  if (!security_origin)
+    return NULL;
 
   /* Cannot contain consecutive slashes in GSettings path... */
-  security_origin = webkit_security_origin_new_for_uri (origin);
   trimmed_protocol = g_strdup (webkit_security_origin_get_protocol (security_origin));
   pos = strchr (trimmed_protocol, '/');
   if (pos != NULL)
     *pos = '\0';
 
-  origin_path = g_strdup_printf ("/org/gnome/epiphany/permissions/%s/%s/%u/",
-                                 trimmed_protocol,
-                                 webkit_security_origin_get_host (security_origin),
-                                 webkit_security_origin_get_port (security_origin));
+  group = g_strdup_printf (PERMISSIONS_GROUP_PREFIX "%s/%s/%u",
+                           trimmed_protocol,
+                           webkit_security_origin_get_host (security_origin),
+                           webkit_security_origin_get_port (security_origin));
 
-  settings = g_settings_new_with_backend_and_path ("org.gnome.Epiphany.permissions", backend, origin_path);
   g_free (trimmed_protocol);
-  g_free (origin_path);
-  g_object_unref (backend);
   webkit_security_origin_unref (security_origin);
 
-  /* Note that settings is owned only by the first hash table! */
-  g_hash_table_insert (manager->origins_mapping, g_strdup (origin), settings);
-  g_hash_table_insert (manager->settings_mapping, settings, g_strdup (origin));
+  g_hash_table_insert (manager->groups_mapping, g_strdup (origin), group);
 
-  return settings;
+  return group;
 }
 
 EphyPermissionsManager *
@@ -150,32 +423,18 @@ ephy_permissions_manager_new (void)
   return EPHY_PERMISSIONS_MANAGER (g_object_new (EPHY_TYPE_PERMISSIONS_MANAGER, NULL));
 }
 
-static const char *
-permission_type_to_string (EphyPermissionType type)
-{
-  switch (type) {
-  case EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS:
-    return "notifications-permission";
-  case EPHY_PERMISSION_TYPE_SAVE_PASSWORD:
-    return "save-password-permission";
-  case EPHY_PERMISSION_TYPE_ACCESS_LOCATION:
-    return "geolocation-permission";
-  case EPHY_PERMISSION_TYPE_ACCESS_MICROPHONE:
-    return "audio-device-permission";
-  case EPHY_PERMISSION_TYPE_ACCESS_WEBCAM:
-    return "video-device-permission";
-  default:
-    g_assert_not_reached ();
-  }
-}
-
 EphyPermission
 ephy_permissions_manager_get_permission (EphyPermissionsManager *manager,
                                          EphyPermissionType      type,
                                          const char             *origin)
 {
-  GSettings *settings = ephy_permissions_manager_get_settings_for_origin (manager, origin);
-  return g_settings_get_enum (settings, permission_type_to_string (type));
+  const char *group;
+
+  group = ephy_permissions_manager_get_group_for_origin (manager, origin);
+  if (!group)
+    return EPHY_PERMISSION_UNDECIDED;
+
+  return permission_bitmap_get (GPOINTER_TO_UINT (g_hash_table_lookup (manager->permissions, group)), type);
 }
 
 static gint
@@ -227,7 +486,7 @@ maybe_remove_origin_from_permission_type_cache (GHashTable           *permission
     l = g_list_find_custom (origins, origin, (GCompareFunc)webkit_security_origin_compare);
     if (l != NULL) {
       webkit_security_origin_unref (l->data);
-      origins = g_list_remove_link (origins, l);
+      origins = g_list_delete_link (origins, l);
       g_hash_table_replace (permissions, GINT_TO_POINTER (type), origins);
     }
   }
@@ -240,14 +499,33 @@ ephy_permissions_manager_set_permission (EphyPermissionsManager *manager,
                                          EphyPermission          permission)
 {
   WebKitSecurityOrigin *webkit_origin;
-  GSettings *settings;
+  const char *group;
+  guint bitmap;
 
   webkit_origin = webkit_security_origin_new_for_uri (origin);
   if (webkit_origin == NULL)
     return;
 
-  settings = ephy_permissions_manager_get_settings_for_origin (manager, origin);
-  g_settings_set_enum (settings, permission_type_to_string (type), permission);
+  group = ephy_permissions_manager_get_group_for_origin (manager, origin);
+  g_assert (group);
+
+  bitmap = GPOINTER_TO_UINT (g_hash_table_lookup (manager->permissions, group));
+  bitmap = permission_bitmap_set (bitmap, type, permission);
+  if (bitmap != 0)
+    g_hash_table_replace (manager->permissions, g_strdup (group), GUINT_TO_POINTER (bitmap));
+  else
+    g_hash_table_remove (manager->permissions, group);
+
+  if (permission == EPHY_PERMISSION_UNDECIDED) {
+    g_key_file_remove_key (manager->keyfile, group, permission_type_to_string (type), NULL);
+    if (bitmap == 0)
+      g_key_file_remove_group (manager->keyfile, group, NULL);
+  } else {
+    g_key_file_set_value (manager->keyfile, group, permission_type_to_string (type),
+                          permission_to_keyfile_value (permission));
+  }
+
+  ephy_permissions_manager_schedule_save (manager);
 
   switch (permission) {
     case EPHY_PERMISSION_UNDECIDED:
@@ -285,79 +563,15 @@ group_name_to_security_origin (const char *group)
   return origin;
 }
 
-static WebKitSecurityOrigin *
-origin_for_keyfile_key (GKeyFile           *file,
-                        const char         *filename,
-                        const char         *group,
-                        const char         *key,
-                        EphyPermissionType  type,
-                        gboolean            permit)
-{
-  WebKitSecurityOrigin *origin = NULL;
-  char *value;
-  GError *error = NULL;
-
-  if (strcmp (permission_type_to_string (type), key) == 0) {
-    value = g_key_file_get_string (file, group, key, &error);
-    if (error != NULL) {
-      g_warning ("Error processing %s group %s key %s: %s",
-                 filename, group, key, error->message);
-      g_error_free (error);
-      return NULL;
-    }
-
-    if ((permit && strcmp (value, "'allow'") == 0) ||
-        (!permit && strcmp (value, "'deny'") == 0))
-      origin = group_name_to_security_origin (group);
-
-    g_free (value);
-  }
-
-  return origin;
-}
-
-static GList *
-origins_for_keyfile_group (GKeyFile           *file,
-                           const char         *filename,
-                           const char         *group,
-                           EphyPermissionType  type,
-                           gboolean            permit)
-{
-  char **keys;
-  gsize keys_length;
-  GList *origins = NULL;
-  WebKitSecurityOrigin *origin;
-  GError *error = NULL;
-
-  keys = g_key_file_get_keys (file, group, &keys_length, &error);
-  if (error != NULL) {
-    g_warning ("Error processing %s group %s: %s", filename, group, error->message);
-    g_error_free (error);
-    return NULL;
-  }
-
-  for (guint i = 0; i < keys_length; i++) {
-    origin = origin_for_keyfile_key (file, filename, group, keys[i], type, permit);
-    if (origin)
-      origins = g_list_prepend (origins, origin);
-  }
-
-  g_strfreev (keys);
-
-  return origins;
-}
-
 static GList *
 ephy_permissions_manager_get_matching_origins (EphyPermissionsManager *manager,
                                                EphyPermissionType      type,
                                                gboolean                permit)
 {
-  GKeyFile *file;
-  char *filename;
-  char **groups = NULL;
-  gsize groups_length;
+  GHashTableIter iter;
+  gpointer key, value;
   GList *origins = NULL;
-  GError *error = NULL;
+  EphyPermission wanted = permit ? EPHY_PERMISSION_PERMIT : EPHY_PERMISSION_DENY;
 
   /* Return results from cache, if they exist. */
   if (permit) {
@@ -370,23 +584,18 @@ ephy_permissions_manager_get_matching_origins (EphyPermissionsManager *manager,
       return origins;
   }
 
-  /* Not cached. Load results from GSettings keyfile. Do it manually because the
-   * GSettings API is not designed to be used for enumerating settings. */
-  file = g_key_file_new ();
-  filename = g_build_filename (ephy_profile_dir (), PERMISSIONS_FILENAME, NULL);
+  /* Not cached. Build the list from the in-memory index. */
+  g_hash_table_iter_init (&iter, manager->permissions);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    WebKitSecurityOrigin *origin;
 
-  g_key_file_load_from_file (file, filename, G_KEY_FILE_NONE, &error);
-  if (error != NULL) {
-    if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
-      g_warning ("Error processing %s: %s", filename, error->message);
-    g_error_free (error);
-    goto out;
-  }
+    if (permission_bitmap_get (GPOINTER_TO_UINT (value), type) != wanted)
+      continue;
 
-  groups = g_key_file_get_groups (file, &groups_length);
-  for (guint i = 0; i < groups_length; i++)
-    origins = g_list_concat (origins,
-                             origins_for_keyfile_group (file, filename, groups[i], type, permit));
+    origin = group_name_to_security_origin (key);
+    if (origin)
+      origins = g_list_prepend (origins, origin);
+  }
 
   /* Cache the results. */
   if (origins != NULL) {
@@ -396,11 +605,6 @@ ephy_permissions_manager_get_matching_origins (EphyPermissionsManager *manager,
                          origins);
   }
 
-out:
-  g_key_file_unref (file);
-  g_strfreev (groups);
-  g_free (filename);
-
   return origins;
 }
 
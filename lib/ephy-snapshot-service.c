@@ -23,6 +23,7 @@
 
 #include "ephy-favicon-helpers.h"
 #include "ephy-file-helpers.h"
+#include "ephy-trace.h"
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <stdio.h>
@@ -280,6 +281,7 @@ typedef struct {
   GdkPixbuf *snapshot;
   WebKitWebView *web_view;
   char *url;
+  gint64 capture_begin;
 } SnapshotAsyncData;
 
 static SnapshotAsyncData *
@@ -365,11 +367,14 @@ save_snapshot_thread (GTask               *task,
                       GCancellable        *cancellable)
 {
   char *path;
+  EPHY_TRACE_BEGIN (begin);
 
   save_thumbnail (data->snapshot, data->url);
   path = thumbnail_path (data->url);
   cache_snapshot_data_in_idle (service, data->url, path, SNAPSHOT_FRESH);
 
+  EPHY_TRACE_END (begin, EPHY_TRACE_SNAPSHOT, "save");
+
   g_task_return_pointer (task, path, g_free);
 }
 
@@ -424,9 +429,11 @@ save_snapshot (cairo_surface_t *surface,
                GTask           *task)
 {
   SnapshotAsyncData *data = g_task_get_task_data (task);
+  EPHY_TRACE_BEGIN (begin);
 
   data->snapshot = ephy_snapshot_service_prepare_snapshot (surface,
                                                            webkit_web_view_get_favicon (data->web_view));
+  EPHY_TRACE_END (begin, EPHY_TRACE_SNAPSHOT, "prepare");
 
   ephy_snapshot_service_save_snapshot_async (g_task_get_source_object (task),
                                              data->snapshot,
@@ -441,10 +448,12 @@ on_snapshot_ready (WebKitWebView *web_view,
                    GAsyncResult  *result,
                    GTask         *task)
 {
+  SnapshotAsyncData *data = g_task_get_task_data (task);
   cairo_surface_t *surface;
   GError *error = NULL;
 
   surface = webkit_web_view_get_snapshot_finish (web_view, result, &error);
+  EPHY_TRACE_END (data->capture_begin, EPHY_TRACE_SNAPSHOT, "capture");
   if (error) {
     g_task_return_error (task, error);
     g_object_unref (task);
@@ -470,6 +479,7 @@ retrieve_snapshot_from_web_view (GTask *task)
     return FALSE;
   }
 
+  data->capture_begin = ephy_trace_now ();
   webkit_web_view_get_snapshot (data->web_view,
                                 WEBKIT_SNAPSHOT_REGION_VISIBLE,
                                 WEBKIT_SNAPSHOT_OPTIONS_NONE,
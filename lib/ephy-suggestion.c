@@ -98,6 +98,16 @@ ephy_suggestion_get_icon_surface (DzlSuggestion *self,
   return suggestion->favicon;
 }
 
+static void
+ephy_suggestion_finalize (GObject *object)
+{
+  EphySuggestion *self = EPHY_SUGGESTION (object);
+
+  g_free (self->unescaped_title);
+  g_clear_pointer (&self->favicon, cairo_surface_destroy);
+
+  G_OBJECT_CLASS (ephy_suggestion_parent_class)->finalize (object);
+}
 
 static void
 ephy_suggestion_class_init (EphySuggestionClass *klass)
@@ -105,6 +115,7 @@ ephy_suggestion_class_init (EphySuggestionClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   DzlSuggestionClass *dzl_suggestion_class = DZL_SUGGESTION_CLASS (klass);
 
+  object_class->finalize = ephy_suggestion_finalize;
   object_class->get_property = ephy_suggestion_get_property;
   object_class->set_property = ephy_suggestion_set_property;
 
@@ -172,6 +183,18 @@ ephy_suggestion_get_unescaped_title (EphySuggestion *self)
   return self->unescaped_title;
 }
 
+void
+ephy_suggestion_set_title (EphySuggestion *self,
+                           const char     *title)
+{
+  g_assert (EPHY_IS_SUGGESTION (self));
+
+  g_free (self->unescaped_title);
+  self->unescaped_title = g_strdup (title);
+  dzl_suggestion_set_title (DZL_SUGGESTION (self), title);
+  g_object_notify_by_pspec (G_OBJECT (self), obj_properties[PROP_UNESCAPED_TITLE]);
+}
+
 const char *
 ephy_suggestion_get_uri (EphySuggestion *self)
 {
@@ -184,6 +207,9 @@ void
 ephy_suggestion_set_favicon (EphySuggestion  *self,
                              cairo_surface_t *favicon)
 {
-  self->favicon = favicon;
+  g_assert (EPHY_IS_SUGGESTION (self));
+
+  g_clear_pointer (&self->favicon, cairo_surface_destroy);
+  self->favicon = favicon ? cairo_surface_reference (favicon) : NULL;
   g_object_notify (G_OBJECT (self), "icon");
 }
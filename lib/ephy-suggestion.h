@@ -32,6 +32,8 @@ EphySuggestion *ephy_suggestion_new                  (const char *title,
 EphySuggestion *ephy_suggestion_new_without_subtitle (const char *title,
                                                       const char *uri);
 const char     *ephy_suggestion_get_unescaped_title  (EphySuggestion *self);
+void            ephy_suggestion_set_title            (EphySuggestion *self,
+                                                      const char     *title);
 const char     *ephy_suggestion_get_uri              (EphySuggestion *self);
 
 void            ephy_suggestion_set_favicon          (EphySuggestion  *self,
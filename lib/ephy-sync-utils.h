@@ -40,6 +40,8 @@ const SecretSchema *ephy_sync_utils_get_secret_schema (void) G_GNUC_CONST;
 #define EPHY_SYNC_BATCH_SIZE    80
 #define EPHY_SYNC_MAX_BATCHES   80
 
+#define EPHY_SYNC_DOWNLOAD_PAGE_SIZE  1000
+
 char     *ephy_sync_utils_encode_hex                    (const guint8 *data,
                                                          gsize         data_len);
 guint8   *ephy_sync_utils_decode_hex                    (const char   *hex);
@@ -0,0 +1,398 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ephy-trace.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * SECTION:ephy-trace
+ * @short_description: Low overhead tracing
+ *
+ * Trace points record spans into a ring buffer owned by the calling thread,
+ * so recording never takes a lock. The most recent events of every thread
+ * can be exported in the Chrome trace event format, which chrome://tracing
+ * and Perfetto can open. See HACKING.md for how to enable it.
+ *
+ * Every event is also added to counters kept per category and name, which
+ * ephy_trace_get_summary() reports. Unlike the rings, they cover everything
+ * recorded since tracing was enabled.
+ */
+
+/* Must be a power of two. */
+#define RING_SIZE 4096
+
+/* Must be a power of two, and well above the number of distinct events. */
+#define STATS_SIZE 256
+
+typedef struct {
+  const char *name;
+  gint64 begin;
+  gint64 duration;
+  EphyTraceCategory category;
+  guint tid;
+} TraceEvent;
+
+typedef struct {
+  TraceEvent events[RING_SIZE];
+  /* Only advanced by the owning thread; readers load it atomically. */
+  guint head;
+  guint tid;
+  gboolean in_use;
+} TraceRing;
+
+gint ephy_trace_enabled;
+
+static GMutex rings_lock;
+static GSList *rings;
+static guint last_tid;
+static char *trace_dir;
+
+static const char * const category_names[] = {
+  "history",
+  "safe-browsing",
+  "adblock",
+  "session",
+  "snapshot",
+  "sync"
+};
+
+/* Counters of one (category, name) pair. @name is published last, once
+ * @category is set, and the counters are only updated atomically. */
+typedef struct {
+  const char *name;
+  EphyTraceCategory category;
+  guint count;
+  gint64 total;
+  gint64 max;
+  guint histogram[EPHY_TRACE_HISTOGRAM_BUCKETS];
+} TraceStats;
+
+static GMutex stats_lock;
+static TraceStats stats[STATS_SIZE];
+
+static void
+trace_ring_release (TraceRing *ring)
+{
+  g_mutex_lock (&rings_lock);
+  ring->in_use = FALSE;
+  g_mutex_unlock (&rings_lock);
+}
+
+static GPrivate current_ring = G_PRIVATE_INIT ((GDestroyNotify)trace_ring_release);
+
+/* Rings outlive their threads so that their events can still be exported,
+ * and are handed to new threads instead of growing without bound. */
+static TraceRing *
+trace_ring_acquire (void)
+{
+  TraceRing *ring = NULL;
+
+  g_mutex_lock (&rings_lock);
+
+  for (GSList *l = rings; l; l = l->next) {
+    TraceRing *candidate = l->data;
+
+    if (!candidate->in_use) {
+      ring = candidate;
+      break;
+    }
+  }
+
+  if (!ring) {
+    ring = g_new0 (TraceRing, 1);
+    rings = g_slist_prepend (rings, ring);
+  }
+
+  ring->in_use = TRUE;
+  ring->tid = ++last_tid;
+
+  g_mutex_unlock (&rings_lock);
+
+  return ring;
+}
+
+static guint
+histogram_bucket (gint64 duration)
+{
+  guint bucket = 0;
+
+  for (gint64 limit = 100; duration >= limit && bucket < EPHY_TRACE_HISTOGRAM_BUCKETS - 1; limit *= 10)
+    bucket++;
+
+  return bucket;
+}
+
+static TraceStats *
+trace_stats_find (EphyTraceCategory  category,
+                  const char        *name,
+                  guint             *slot)
+{
+  for (guint i = 0; i < STATS_SIZE; i++) {
+    TraceStats *entry = &stats[*slot];
+    const char *entry_name = g_atomic_pointer_get (&entry->name);
+
+    if (!entry_name)
+      return NULL;
+    if (entry_name == name && entry->category == category)
+      return entry;
+
+    *slot = (*slot + 1) & (STATS_SIZE - 1);
+  }
+
+  return NULL;
+}
+
+/* Lookups never lock. Adding an event that was not seen before takes
+ * stats_lock, which happens a few dozen times per process. */
+static TraceStats *
+trace_stats_lookup (EphyTraceCategory  category,
+                    const char        *name)
+{
+  guint slot = (GPOINTER_TO_UINT (name) * 31 + category) & (STATS_SIZE - 1);
+  TraceStats *entry;
+
+  entry = trace_stats_find (category, name, &slot);
+  if (G_LIKELY (entry))
+    return entry;
+
+  g_mutex_lock (&stats_lock);
+
+  entry = trace_stats_find (category, name, &slot);
+  if (!entry && !g_atomic_pointer_get (&stats[slot].name)) {
+    entry = &stats[slot];
+    entry->category = category;
+    g_atomic_pointer_set (&entry->name, name);
+  }
+
+  g_mutex_unlock (&stats_lock);
+
+  /* NULL if the table is full, then the event only goes to the ring. */
+  return entry;
+}
+
+static void
+trace_stats_add (TraceStats *entry,
+                 gint64      duration)
+{
+  gint64 max;
+
+  g_atomic_int_inc (&entry->count);
+  g_atomic_int_inc (&entry->histogram[histogram_bucket (duration)]);
+
+  /* GLib has no 64-bit atomics, these builtins are what it uses itself. */
+  __atomic_fetch_add (&entry->total, duration, __ATOMIC_RELAXED);
+  max = __atomic_load_n (&entry->max, __ATOMIC_RELAXED);
+  while (duration > max &&
+         !__atomic_compare_exchange_n (&entry->max, &max, duration, TRUE,
+                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/**
+ * ephy_trace_add_event:
+ * @category: the subsystem the event belongs to
+ * @name: (transfer none): static name of the event
+ * @begin: monotonic start time in microseconds
+ * @duration: duration in microseconds
+ *
+ * Records a complete span. Usually called through EPHY_TRACE_END().
+ **/
+void
+ephy_trace_add_event (EphyTraceCategory  category,
+                      const char        *name,
+                      gint64             begin,
+                      gint64             duration)
+{
+  TraceRing *ring = g_private_get (&current_ring);
+  TraceStats *entry;
+  TraceEvent *event;
+  guint head;
+
+  entry = trace_stats_lookup (category, name);
+  if (G_LIKELY (entry))
+    trace_stats_add (entry, duration);
+
+  if (G_UNLIKELY (!ring)) {
+    ring = trace_ring_acquire ();
+    g_private_set (&current_ring, ring);
+  }
+
+  head = ring->head;
+  event = &ring->events[head & (RING_SIZE - 1)];
+  event->name = name;
+  event->begin = begin;
+  event->duration = duration;
+  event->category = category;
+  event->tid = ring->tid;
+
+  g_atomic_int_set (&ring->head, head + 1);
+}
+
+/**
+ * ephy_trace_to_json:
+ *
+ * Serializes the most recent events of every thread in the Chrome trace
+ * event format. Events that are overwritten while this runs are left out.
+ *
+ * Returns: (transfer full): a JSON document
+ **/
+char *
+ephy_trace_to_json (void)
+{
+  GString *json = g_string_new ("{\"traceEvents\":[");
+  int pid = getpid ();
+  gboolean first = TRUE;
+
+  g_mutex_lock (&rings_lock);
+
+  for (GSList *l = rings; l; l = l->next) {
+    TraceRing *ring = l->data;
+    guint head = g_atomic_int_get (&ring->head);
+    guint start = head > RING_SIZE ? head - RING_SIZE : 0;
+
+    for (guint i = start; i != head; i++) {
+      TraceEvent event = ring->events[i & (RING_SIZE - 1)];
+
+      /* The owning thread may have lapped the ring while the event was
+       * copied, in which case the copy cannot be trusted. */
+      if (g_atomic_int_get (&ring->head) - i >= RING_SIZE)
+        continue;
+
+      g_string_append_printf (json,
+                              "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                              "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ","
+                              "\"pid\":%d,\"tid\":%u}",
+                              first ? "" : ",",
+                              event.name, category_names[event.category],
+                              event.begin, event.duration,
+                              pid, event.tid);
+      first = FALSE;
+    }
+  }
+
+  g_mutex_unlock (&rings_lock);
+
+  g_string_append (json, "]}");
+
+  return g_string_free (json, FALSE);
+}
+
+/**
+ * ephy_trace_get_summary:
+ *
+ * Reports the counters of every event recorded since tracing was enabled,
+ * by category and name, so that they can be shown by about:performance or
+ * sent over D-Bus. Events recorded while this runs may be counted in some
+ * of the columns only.
+ *
+ * Returns: (transfer floating): a #GVariant of type %EPHY_TRACE_SUMMARY_TYPE
+ **/
+GVariant *
+ephy_trace_get_summary (void)
+{
+  GVariantBuilder builder;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (EPHY_TRACE_SUMMARY_TYPE));
+  for (guint i = 0; i < STATS_SIZE; i++) {
+    TraceStats *entry = &stats[i];
+    const char *name = g_atomic_pointer_get (&entry->name);
+    guint histogram[EPHY_TRACE_HISTOGRAM_BUCKETS];
+
+    if (!name)
+      continue;
+
+    for (guint j = 0; j < EPHY_TRACE_HISTOGRAM_BUCKETS; j++)
+      histogram[j] = g_atomic_int_get (&entry->histogram[j]);
+
+    g_variant_builder_add (&builder, "(ssuxx@au)",
+                           category_names[entry->category], name,
+                           g_atomic_int_get (&entry->count),
+                           __atomic_load_n (&entry->total, __ATOMIC_RELAXED),
+                           __atomic_load_n (&entry->max, __ATOMIC_RELAXED),
+                           g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                                      histogram,
+                                                      EPHY_TRACE_HISTOGRAM_BUCKETS,
+                                                      sizeof (guint)));
+  }
+
+  return g_variant_builder_end (&builder);
+}
+
+/**
+ * ephy_trace_write:
+ * @path: the file to write
+ * @error: return location for a #GError
+ *
+ * Writes the output of ephy_trace_to_json() to @path.
+ *
+ * Returns: %TRUE on success
+ **/
+gboolean
+ephy_trace_write (const char  *path,
+                  GError     **error)
+{
+  g_autofree char *json = ephy_trace_to_json ();
+
+  return g_file_set_contents (path, json, -1, error);
+}
+
+/**
+ * ephy_trace_set_enabled:
+ * @enabled: whether trace points should record events
+ *
+ * Starts or stops recording. Events recorded so far are kept.
+ **/
+void
+ephy_trace_set_enabled (gboolean enabled)
+{
+  g_atomic_int_set (&ephy_trace_enabled, !!enabled);
+}
+
+static void
+write_trace_at_exit (void)
+{
+  g_autofree char *filename = g_strdup_printf ("epiphany-%d.json", getpid ());
+  g_autofree char *path = g_build_filename (trace_dir, filename, NULL);
+  g_autoptr(GError) error = NULL;
+
+  if (!ephy_trace_write (path, &error))
+    g_printerr ("Failed to write trace to %s: %s\n", path, error->message);
+}
+
+/**
+ * ephy_trace_init:
+ *
+ * Enables tracing if EPHY_TRACE_DIR is set. Each process then writes its
+ * events to a file in that directory when it exits.
+ **/
+void
+ephy_trace_init (void)
+{
+  const char *dir = g_getenv ("EPHY_TRACE_DIR");
+
+  if (!dir || trace_dir)
+    return;
+
+  trace_dir = g_strdup (dir);
+  ephy_trace_set_enabled (TRUE);
+  atexit (write_trace_at_exit);
+}
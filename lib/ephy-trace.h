@@ -0,0 +1,87 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  EPHY_TRACE_HISTORY,
+  EPHY_TRACE_SAFE_BROWSING,
+  EPHY_TRACE_ADBLOCK,
+  EPHY_TRACE_SESSION,
+  EPHY_TRACE_SNAPSHOT,
+  EPHY_TRACE_SYNC
+} EphyTraceCategory;
+
+/* Latency buckets of ephy_trace_get_summary(): below 0.1 ms, 1 ms, 10 ms,
+ * 100 ms, 1 s, and the rest. */
+#define EPHY_TRACE_HISTOGRAM_BUCKETS 6
+
+/* Type of ephy_trace_get_summary(): category, name, count, total and
+ * maximum duration in microseconds, histogram. */
+#define EPHY_TRACE_SUMMARY_TYPE "a(ssuxxau)"
+
+/* Read through ephy_trace_now(), never written directly. */
+extern gint ephy_trace_enabled;
+
+/* Returns the current time when tracing, 0 otherwise. A trace point costs
+ * a single load and branch while tracing is off. */
+static inline gint64
+ephy_trace_now (void)
+{
+  return G_UNLIKELY (g_atomic_int_get (&ephy_trace_enabled)) ? g_get_monotonic_time () : 0;
+}
+
+#define EPHY_TRACE_BEGIN(begin) \
+  gint64 begin = ephy_trace_now ()
+
+/* @name must be a string literal, it is recorded by pointer. */
+#define EPHY_TRACE_END(begin, category, name) G_STMT_START { \
+    if (G_UNLIKELY (begin != 0)) \
+      ephy_trace_add_event (category, name, begin, g_get_monotonic_time () - begin); \
+  } G_STMT_END
+
+/* Records an instant, e.g. a cache hit. */
+#define EPHY_TRACE_MARK(category, name) G_STMT_START { \
+    gint64 ephy_trace_mark_time = ephy_trace_now (); \
+    if (G_UNLIKELY (ephy_trace_mark_time != 0)) \
+      ephy_trace_add_event (category, name, ephy_trace_mark_time, 0); \
+  } G_STMT_END
+
+void      ephy_trace_init        (void);
+
+void      ephy_trace_set_enabled (gboolean            enabled);
+
+void      ephy_trace_add_event   (EphyTraceCategory   category,
+                                  const char         *name,
+                                  gint64              begin,
+                                  gint64              duration);
+
+char     *ephy_trace_to_json     (void);
+
+GVariant *ephy_trace_get_summary (void);
+
+gboolean  ephy_trace_write       (const char         *path,
+                                  GError            **error);
+
+G_END_DECLS
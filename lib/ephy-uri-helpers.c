@@ -35,155 +35,232 @@
  * URI related functions, including functions to clean up URI.
  */
 
-/* QueryItem holds the decoded name for each parameter, as well as the untouched
- * name/value pair. The name is unescaped in query_decode() with form_decode(),
- * the pair is not altered. */
+#define XDIGIT(c) ((c) <= '9' ? (c) - '0' : ((c) & 0x4F) - 'A' + 10)
+#define HEXCHAR(s) ((XDIGIT (s[1]) << 4) + XDIGIT (s[2]))
+
+/* Query parameters that only serve to track users, along with the host
+ * suffix they are restricted to, if any. More can be listed in the
+ * tracking-parameters data file. */
+static const struct {
+  const char *field;
+  const char *host;
+} builtin_tracking_fields[] = {
+  /* analytics.google.com */
+  { "utm_source", NULL },
+  { "utm_medium", NULL },
+  { "utm_term", NULL },
+  { "utm_content", NULL },
+  { "utm_campaign", NULL },
+  { "utm_reader", NULL },
+  /* metrika.yandex.ru */
+  { "yclid", NULL },
+  /* youtube.com */
+  { "feature", "youtube.com" },
+  /* facebook.com */
+  { "fb_action_ids", NULL },
+  { "fb_action_types", NULL },
+  { "fb_ref", NULL },
+  { "fb_source", NULL },
+  { "action_object_map", NULL },
+  { "action_type_map", NULL },
+  { "action_ref_map", NULL },
+  { "ref", "facebook.com" },
+  { "fref", "facebook.com" },
+  { "hc_location", "facebook.com" },
+  /* imdb.com */
+  { "ref_", "imdb.com" },
+  /* addons.mozilla.org */
+  { "src", "addons.mozilla.org" }
+};
+
 typedef struct {
-  char *decoded_name;
-  char *pair;
-} QueryItem;
+  gboolean any_host;
+  GPtrArray *hosts; /* Lowercase host suffixes */
+} TrackingField;
+
+/* Built once per process and never freed. */
+typedef struct {
+  GHashTable *fields; /* name -> TrackingField */
+  gsize max_name_len;
+} TrackingFieldTable;
 
 static void
-query_item_free (QueryItem *item)
+tracking_field_table_add (TrackingFieldTable *table,
+                          const char         *name,
+                          const char         *host)
 {
-  g_free (item->decoded_name);
-  g_free (item->pair);
-  g_free (item);
+  TrackingField *field;
+
+  field = g_hash_table_lookup (table->fields, name);
+  if (!field) {
+    field = g_new0 (TrackingField, 1);
+    field->hosts = g_ptr_array_new_with_free_func (g_free);
+    g_hash_table_insert (table->fields, g_strdup (name), field);
+    table->max_name_len = MAX (table->max_name_len, strlen (name));
+  }
+
+  if (host)
+    g_ptr_array_add (field->hosts, g_ascii_strdown (host, -1));
+  else
+    field->any_host = TRUE;
 }
 
-#define XDIGIT(c) ((c) <= '9' ? (c) - '0' : ((c) & 0x4F) - 'A' + 10)
-#define HEXCHAR(s) ((XDIGIT (s[1]) << 4) + XDIGIT (s[2]))
+/* Each line holds a parameter name, optionally followed by the host suffix
+ * it is restricted to. Empty lines and lines starting with # are ignored. */
+static void
+tracking_field_table_load_file (TrackingFieldTable *table,
+                                const char         *path)
+{
+  g_autofree char *contents = NULL;
+  g_auto(GStrv) lines = NULL;
 
-/* From libsoup, in libsoup/soup-form.c */
-static gboolean
-form_decode (char *part)
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    return;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (guint i = 0; lines[i]; i++) {
+    char *line = g_strstrip (lines[i]);
+    char *host;
+
+    if (*line == '\0' || *line == '#')
+      continue;
+
+    host = strpbrk (line, " \t");
+    if (host) {
+      *host++ = '\0';
+      host = g_strchug (host);
+      if (*host == '\0')
+        host = NULL;
+    }
+
+    tracking_field_table_add (table, line, host);
+  }
+}
+
+static gpointer
+tracking_field_table_create (gpointer data)
 {
-  unsigned char *s, *d;
+  TrackingFieldTable *table;
+  g_autofree char *path = NULL;
 
-  s = d = (unsigned char *)part;
-  do {
-    if (*s == '%') {
-      if (!g_ascii_isxdigit (s[1]) ||
-          !g_ascii_isxdigit (s[2]))
-        return FALSE;
-      *d++ = HEXCHAR (s);
-      s += 2;
-    } else if (*s == '+')
-      *d++ = ' ';
-    else
-      *d++ = *s;
-  } while (*s++);
+  table = g_new0 (TrackingFieldTable, 1);
+  table->fields = g_hash_table_new (g_str_hash, g_str_equal);
 
-  return TRUE;
+  for (guint i = 0; i < G_N_ELEMENTS (builtin_tracking_fields); i++)
+    tracking_field_table_add (table, builtin_tracking_fields[i].field, builtin_tracking_fields[i].host);
+
+  path = g_build_filename (PKGDATADIR, "tracking-parameters", NULL);
+  tracking_field_table_load_file (table, path);
+
+  return table;
 }
 
-static GList *
-query_split (const char *query)
+static TrackingFieldTable *
+get_tracking_field_table (void)
 {
-  GList *items;
-  char **pairs;
-  int i;
-
-  items = NULL;
-  pairs = g_strsplit (query, "&", -1);
-  for (i = 0; pairs[i]; i++) {
-    QueryItem *item;
-    char *decoded_name = NULL;
-    char *pair, *eq;
-
-    pair = pairs[i];
-    eq = strchr (pair, '=');
-    if (eq)
-      decoded_name = g_strndup (pair, eq - pair);
-    else
-      decoded_name = g_strdup (pair);
+  static GOnce once = G_ONCE_INIT;
+
+  return g_once (&once, tracking_field_table_create, NULL);
+}
+
+/* Form-decodes (as libsoup's form_decode() does) the @len bytes at @name
+ * into @buffer, which holds @size bytes. Returns FALSE if the name is
+ * malformed or too long to be a tracking parameter. */
+static gboolean
+decode_query_name (const char *name,
+                   gsize       len,
+                   char       *buffer,
+                   gsize       size)
+{
+  gsize j = 0;
+
+  for (gsize i = 0; i < len; i++) {
+    char c = name[i];
 
-    if (!form_decode (decoded_name)) {
-      g_free (decoded_name);
-      decoded_name = NULL;
+    if (c == '%') {
+      if (i + 2 >= len ||
+          !g_ascii_isxdigit (name[i + 1]) ||
+          !g_ascii_isxdigit (name[i + 2]))
+        return FALSE;
+      c = HEXCHAR ((name + i));
+      i += 2;
+    } else if (c == '+') {
+      c = ' ';
     }
 
-    item = g_new0 (QueryItem, 1);
-    item->decoded_name = decoded_name;
-    item->pair = pair;
-    items = g_list_prepend (items, item);
+    if (j + 1 >= size)
+      return FALSE;
+    buffer[j++] = c;
   }
-  g_free (pairs);
 
-  return g_list_reverse (items);
+  buffer[j] = '\0';
+  return TRUE;
 }
 
-static char *
-query_concat (GList *items)
+/* Finds the host of a hierarchical URI, without the user info and port,
+ * looking no further than @end. */
+static gboolean
+find_uri_host (const char  *uri,
+               const char  *end,
+               const char **host,
+               gsize       *host_len)
 {
-  GList *l;
-  GPtrArray *array;
-  char *ret;
+  const char *start, *authority_end, *host_end, *p;
 
-  if (!items)
-    return NULL;
-
-  array = g_ptr_array_new ();
+  p = strstr (uri, "://");
+  if (!p || p >= end)
+    return FALSE;
 
-  for (l = items; l != NULL; l = l->next) {
-    QueryItem *item = l->data;
+  start = p + 3;
+  authority_end = start + strcspn (start, "/?#");
 
-    g_ptr_array_add (array, item->pair);
+  for (p = authority_end; p > start; p--) {
+    if (p[-1] == '@') {
+      start = p;
+      break;
+    }
   }
-  g_ptr_array_add (array, NULL);
 
-  ret = g_strjoinv ("&", (char **)array->pdata);
-  g_ptr_array_free (array, TRUE);
+  if (*start == '[') {
+    host_end = memchr (start, ']', authority_end - start);
+    host_end = host_end ? host_end + 1 : authority_end;
+  } else {
+    host_end = memchr (start, ':', authority_end - start);
+    if (!host_end)
+      host_end = authority_end;
+  }
 
-  return ret;
+  *host = start;
+  *host_len = host_end - start;
+  return TRUE;
 }
 
 static gboolean
-is_garbage (const char *name,
-            const char *host)
+is_tracking_field (TrackingFieldTable *table,
+                   const char         *raw_name,
+                   gsize               raw_name_len,
+                   const char         *host,
+                   gsize               host_len,
+                   char               *buffer)
 {
-  struct {
-    const char *field;
-    const char *host;
-  } const fields[] = {
-    /* analytics.google.com */
-    { "utm_source", NULL },
-    { "utm_medium", NULL },
-    { "utm_term", NULL },
-    { "utm_content", NULL },
-    { "utm_campaign", NULL },
-    { "utm_reader", NULL },
-    /* metrika.yandex.ru */
-    { "yclid", NULL },
-    /* youtube.com */
-    { "feature", "youtube.com" },
-    /* facebook.com */
-    { "fb_action_ids", NULL },
-    { "fb_action_types", NULL },
-    { "fb_ref", NULL },
-    { "fb_source", NULL },
-    { "action_object_map", NULL },
-    { "action_type_map", NULL },
-    { "action_ref_map", NULL },
-    { "ref", "facebook.com" },
-    { "fref", "facebook.com" },
-    { "hc_location", "facebook.com" },
-    /* imdb.com */
-    { "ref_", "imdb.com" },
-    /* addons.mozilla.org */
-    { "src", "addons.mozilla.org" }
-  };
-  guint i;
-
-  if (name == NULL)
+  TrackingField *field;
+
+  if (!decode_query_name (raw_name, raw_name_len, buffer, table->max_name_len + 1))
     return FALSE;
 
-  for (i = 0; i < G_N_ELEMENTS (fields); i++) {
-    if (host != NULL &&
-        fields[i].host != NULL &&
-        !g_str_has_suffix (host, fields[i].host))
-      continue;
-    if (!g_strcmp0 (fields[i].field, name))
+  field = g_hash_table_lookup (table->fields, buffer);
+  if (!field)
+    return FALSE;
+
+  if (field->any_host)
+    return TRUE;
+
+  for (guint i = 0; i < field->hosts->len; i++) {
+    const char *suffix = g_ptr_array_index (field->hosts, i);
+    gsize suffix_len = strlen (suffix);
+
+    if (host_len >= suffix_len &&
+        g_ascii_strncasecmp (host + host_len - suffix_len, suffix, suffix_len) == 0)
       return TRUE;
   }
 
@@ -198,59 +275,79 @@ is_garbage (const char *name,
  * information. Inspired by the Firefox PureURL add-on:
  * https://addons.mozilla.org/fr/firefox/addon/pure-url/
  *
+ * The query is scanned in place, so nothing is allocated unless a
+ * tracking parameter is actually removed.
+ *
  * Returns: the sanitized uri, or %NULL on error or when the URI did
  * not change.
  */
 char *
 ephy_remove_tracking_from_uri (const char *uri_string)
 {
-  SoupURI *uri;
-  GList *items, *new_items, *l;
-  const char *query, *host;
-  gboolean has_garbage = FALSE;
-  char *ret = NULL;
-
-  uri = soup_uri_new (uri_string);
-  if (!uri)
-    return ret;
-
-  host = soup_uri_get_host (uri);
-  query = soup_uri_get_query (uri);
+  TrackingFieldTable *table;
+  const char *query, *query_end, *fragment, *host, *p;
+  gsize host_len;
+  char *name_buffer;
+  GString *result = NULL;
+  gboolean has_kept_items = FALSE;
+
+  query = strchr (uri_string, '?');
   if (!query)
-    goto bail;
-
-  items = query_split (query);
-  if (!items)
-    goto bail;
+    return NULL;
 
-  new_items = NULL;
-  for (l = items; l != NULL; l = l->next) {
-    QueryItem *item = l->data;
+  fragment = strchr (uri_string, '#');
+  if (fragment && fragment < query)
+    return NULL;
+  query_end = fragment ? fragment : query + strlen (query);
 
-    if (!is_garbage (item->decoded_name, host))
-      new_items = g_list_prepend (new_items, item);
-    else
-      has_garbage = TRUE;
-  }
+  if (!find_uri_host (uri_string, query, &host, &host_len))
+    return NULL;
 
-  if (has_garbage) {
-    char *new_query;
+  table = get_tracking_field_table ();
+  name_buffer = g_alloca (table->max_name_len + 1);
+
+  for (p = query + 1;; ) {
+    const char *item_end, *eq;
+    gsize name_len;
+
+    item_end = memchr (p, '&', query_end - p);
+    if (!item_end)
+      item_end = query_end;
+
+    eq = memchr (p, '=', item_end - p);
+    name_len = (eq ? eq : item_end) - p;
+
+    if (is_tracking_field (table, p, name_len, host, host_len, name_buffer)) {
+      if (!result) {
+        /* Everything up to here is kept, minus the separator. */
+        result = g_string_sized_new (strlen (uri_string));
+        g_string_append_len (result, uri_string, p - uri_string);
+        has_kept_items = p > query + 1;
+        if (has_kept_items)
+          g_string_truncate (result, result->len - 1);
+      }
+    } else if (result) {
+      if (has_kept_items)
+        g_string_append_c (result, '&');
+      g_string_append_len (result, p, item_end - p);
+      has_kept_items = TRUE;
+    }
 
-    new_items = g_list_reverse (new_items);
-    new_query = query_concat (new_items);
+    if (item_end == query_end)
+      break;
+    p = item_end + 1;
+  }
 
-    soup_uri_set_query (uri, new_query);
-    g_free (new_query);
+  if (!result)
+    return NULL;
 
-    ret = soup_uri_to_string (uri, FALSE);
-  }
+  /* Drop the '?' along with an emptied query. */
+  if (!has_kept_items)
+    g_string_truncate (result, query - uri_string);
 
-  g_list_free_full (items, (GDestroyNotify)query_item_free);
-  g_list_free (new_items);
+  g_string_append (result, query_end);
 
- bail:
-  soup_uri_free (uri);
-  return ret;
+  return g_string_free (result, FALSE);
 }
 
 static inline void
@@ -428,6 +428,41 @@ ephy_history_service_get_host_row_from_url (EphyHistoryService *self,
   return host;
 }
 
+/* Like ephy_history_service_get_host_row_from_url(), but remembers the
+ * hosts in @hosts so that URLs sharing a host only look it up once. The
+ * returned host is owned by @hosts. */
+EphyHistoryHost *
+ephy_history_service_get_host_row_from_url_cached (EphyHistoryService *self,
+                                                   const gchar        *url,
+                                                   GHashTable         *hosts)
+{
+  GList *host_locations, *l;
+  GString *key;
+  char *hostname;
+  EphyHistoryHost *host;
+
+  /* The host row only depends on the candidate locations. */
+  host_locations = get_hostname_and_locations (url, &hostname);
+  key = g_string_new (NULL);
+  for (l = host_locations; l != NULL; l = l->next) {
+    g_string_append (key, l->data);
+    g_string_append_c (key, ' ');
+  }
+
+  host = g_hash_table_lookup (hosts, key->str);
+  if (host == NULL) {
+    host = ephy_history_service_get_host_row_from_url (self, url);
+    g_hash_table_insert (hosts, g_string_free (key, FALSE), host);
+  } else {
+    g_string_free (key, TRUE);
+  }
+
+  g_free (hostname);
+  g_list_free_full (host_locations, (GDestroyNotify)g_free);
+
+  return host;
+}
+
 void
 ephy_history_service_delete_host_row (EphyHistoryService *self,
                                       EphyHistoryHost    *host)
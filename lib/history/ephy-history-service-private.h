@@ -36,6 +36,7 @@ struct _EphyHistoryService {
   gboolean scheduled_to_quit;
   gboolean read_only;
   int queue_urls_visited_id;
+  GList *pending_url_changes; /* Only touched on the history thread */
 };
 
 gboolean                 ephy_history_service_initialize_urls_table   (EphyHistoryService *self);
@@ -56,6 +57,7 @@ EphyHistoryHost *        ephy_history_service_get_host_row            (EphyHisto
 GList *                  ephy_history_service_get_all_hosts           (EphyHistoryService *self);
 GList*                   ephy_history_service_find_host_rows          (EphyHistoryService *self, EphyHistoryQuery *query);
 EphyHistoryHost *        ephy_history_service_get_host_row_from_url   (EphyHistoryService *self, const gchar *url);
+EphyHistoryHost *        ephy_history_service_get_host_row_from_url_cached (EphyHistoryService *self, const gchar *url, GHashTable *hosts);
 void                     ephy_history_service_delete_host_row         (EphyHistoryService *self, EphyHistoryHost *host);
 void                     ephy_history_service_delete_orphan_hosts     (EphyHistoryService *self);
 
@@ -28,27 +28,36 @@ ephy_history_service_initialize_urls_table (EphyHistoryService *self)
 {
   GError *error = NULL;
 
-  if (ephy_sqlite_connection_table_exists (self->history_database, "visits")) {
-    return TRUE;
+  if (!ephy_sqlite_connection_table_exists (self->history_database, "visits")) {
+    ephy_sqlite_connection_execute (self->history_database,
+                                    "CREATE TABLE urls ("
+                                    "id INTEGER PRIMARY KEY,"
+                                    "host INTEGER NOT NULL REFERENCES hosts(id) ON DELETE CASCADE,"
+                                    "url LONGVARCAR,"
+                                    "title LONGVARCAR,"
+                                    "sync_id LONGVARCAR,"
+                                    "visit_count INTEGER DEFAULT 0 NOT NULL,"
+                                    "typed_count INTEGER DEFAULT 0 NOT NULL,"
+                                    "last_visit_time INTEGER,"
+                                    "thumbnail_update_time INTEGER DEFAULT 0," /* this column is legacy, unused */
+                                    "hidden_from_overview INTEGER DEFAULT 0)", &error);
+
+    if (error) {
+      g_warning ("Could not create urls table: %s", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
   }
-  ephy_sqlite_connection_execute (self->history_database,
-                                  "CREATE TABLE urls ("
-                                  "id INTEGER PRIMARY KEY,"
-                                  "host INTEGER NOT NULL REFERENCES hosts(id) ON DELETE CASCADE,"
-                                  "url LONGVARCAR,"
-                                  "title LONGVARCAR,"
-                                  "sync_id LONGVARCAR,"
-                                  "visit_count INTEGER DEFAULT 0 NOT NULL,"
-                                  "typed_count INTEGER DEFAULT 0 NOT NULL,"
-                                  "last_visit_time INTEGER,"
-                                  "thumbnail_update_time INTEGER DEFAULT 0," /* this column is legacy, unused */
-                                  "hidden_from_overview INTEGER DEFAULT 0)", &error);
 
+  /* Lets paginated queries seek straight to the cursor. */
+  ephy_sqlite_connection_execute (self->history_database,
+                                  "CREATE INDEX IF NOT EXISTS idx_urls_last_visit_time "
+                                  "ON urls (last_visit_time, id)", &error);
   if (error) {
-    g_warning ("Could not create urls table: %s", error->message);
+    g_warning ("Could not create urls index: %s", error->message);
     g_error_free (error);
-    return FALSE;
   }
+
   return TRUE;
 }
 
@@ -269,6 +278,15 @@ ephy_history_service_find_url_rows (EphyHistoryService *self, EphyHistoryQuery *
   if (query->host > 0)
     statement_str = g_string_append (statement_str, "urls.host = ? AND ");
 
+  if (query->after) {
+    if (query->sort_type == EPHY_HISTORY_SORT_MOST_RECENTLY_VISITED)
+      statement_str = g_string_append (statement_str, "(urls.last_visit_time < ? OR (urls.last_visit_time = ? AND urls.id < ?)) AND ");
+    else if (query->sort_type == EPHY_HISTORY_SORT_LEAST_RECENTLY_VISITED)
+      statement_str = g_string_append (statement_str, "(urls.last_visit_time > ? OR (urls.last_visit_time = ? AND urls.id > ?)) AND ");
+    else
+      g_warning ("Cursors are only supported when sorting by visit time.");
+  }
+
   for (substring = query->substring_list; substring != NULL; substring = substring->next)
     statement_str = g_string_append (statement_str, "(urls.url LIKE ? OR urls.title LIKE ?) AND ");
 
@@ -282,10 +300,10 @@ ephy_history_service_find_url_rows (EphyHistoryService *self, EphyHistoryQuery *
       statement_str = g_string_append (statement_str, "ORDER BY urls.visit_count ");
       break;
     case EPHY_HISTORY_SORT_MOST_RECENTLY_VISITED:
-      statement_str = g_string_append (statement_str, "ORDER BY urls.last_visit_time DESC ");
+      statement_str = g_string_append (statement_str, "ORDER BY urls.last_visit_time DESC, urls.id DESC ");
       break;
     case EPHY_HISTORY_SORT_LEAST_RECENTLY_VISITED:
-      statement_str = g_string_append (statement_str, "ORDER BY urls.last_visit_time ");
+      statement_str = g_string_append (statement_str, "ORDER BY urls.last_visit_time, urls.id ");
       break;
     case EPHY_HISTORY_SORT_TITLE_ASCENDING:
       statement_str = g_string_append (statement_str, "ORDER BY LOWER(urls.title) ");
@@ -342,6 +360,18 @@ ephy_history_service_find_url_rows (EphyHistoryService *self, EphyHistoryQuery *
       return NULL;
     }
   }
+  if (query->after &&
+      (query->sort_type == EPHY_HISTORY_SORT_MOST_RECENTLY_VISITED ||
+       query->sort_type == EPHY_HISTORY_SORT_LEAST_RECENTLY_VISITED)) {
+    if (ephy_sqlite_statement_bind_int64 (statement, i++, query->after->last_visit_time, &error) == FALSE ||
+        ephy_sqlite_statement_bind_int64 (statement, i++, query->after->last_visit_time, &error) == FALSE ||
+        ephy_sqlite_statement_bind_int (statement, i++, query->after->id, &error) == FALSE) {
+      g_warning ("Could not build urls table query statement: %s", error->message);
+      g_error_free (error);
+      g_object_unref (statement);
+      return NULL;
+    }
+  }
   for (substring = query->substring_list; substring != NULL; substring = substring->next) {
     char *string = ephy_sqlite_create_match_pattern (substring->data);
     if (ephy_sqlite_statement_bind_string (statement, i++, string, &error) == FALSE) {
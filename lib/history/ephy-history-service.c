@@ -26,6 +26,7 @@
 #include "ephy-lib-type-builtins.h"
 #include "ephy-sqlite-connection.h"
 #include "ephy-sync-utils.h"
+#include "ephy-trace.h"
 
 #include <errno.h>
 #include <glib.h>
@@ -40,6 +41,7 @@ typedef enum {
   SET_URL_HIDDEN,
   ADD_VISIT,
   ADD_VISITS,
+  MERGE_URLS,
   DELETE_URLS,
   DELETE_HOST,
   CLEAR,
@@ -57,6 +59,7 @@ typedef enum {
 enum {
   VISIT_URL,
   URLS_VISITED,
+  URLS_CHANGED,
   CLEARED,
   URL_TITLE_CHANGED,
   URL_DELETED,
@@ -76,6 +79,7 @@ typedef struct _EphyHistoryServiceMessage {
   GCancellable *cancellable;
   GDestroyNotify method_argument_cleanup;
   EphyHistoryJobCallback callback;
+  gint64 queued_time;
 } EphyHistoryServiceMessage;
 
 static gpointer run_history_service_thread (EphyHistoryService *self);
@@ -242,6 +246,27 @@ ephy_history_service_class_init (EphyHistoryServiceClass *klass)
                   G_TYPE_NONE,
                   0);
 
+/**
+ * EphyHistoryService::urls-changed:
+ * @service: the #EphyHistoryService that received the signal
+ * @changes: (element-type EphyHistoryURLChange): the changes, oldest first
+ *
+ * The ::urls-changed signal is emitted on the main thread once per
+ * history operation that inserted, updated or deleted URLs. Each
+ * change carries the URL with its sort keys (id and last visit time),
+ * so that views can update their rows in place instead of querying
+ * the database again. Clearing the history or deleting a host is only
+ * reported through ::cleared and ::host-deleted.
+ **/
+  signals[URLS_CHANGED] =
+    g_signal_new ("urls-changed",
+                  G_OBJECT_CLASS_TYPE (gobject_class),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL, NULL,
+                  G_TYPE_NONE,
+                  1,
+                  G_TYPE_POINTER | G_SIGNAL_TYPE_STATIC_SCOPE);
+
   signals[CLEARED] =
     g_signal_new ("cleared",
                   G_OBJECT_CLASS_TYPE (gobject_class),
@@ -353,6 +378,7 @@ ephy_history_service_message_free (EphyHistoryServiceMessage *message)
 static void
 ephy_history_service_send_message (EphyHistoryService *self, EphyHistoryServiceMessage *message)
 {
+  message->queued_time = ephy_trace_now ();
   g_async_queue_push_sorted (self->queue, message, (GCompareDataFunc)sort_messages, NULL);
 }
 
@@ -505,6 +531,8 @@ ephy_history_service_execute_job_callback (gpointer data)
 
   if (message->type == CLEAR)
     g_signal_emit (message->service, signals[CLEARED], 0);
+  else if (message->type == MERGE_URLS)
+    ephy_history_service_queue_urls_visited (message->service);
 
   ephy_history_service_message_free (message);
 
@@ -540,28 +568,82 @@ signal_emission_context_new (EphyHistoryService *service,
   return ctx;
 }
 
+static void
+ephy_history_service_queue_url_change (EphyHistoryService      *self,
+                                       EphyHistoryURLChangeType type,
+                                       EphyHistoryURL          *url)
+{
+  g_assert (self->history_thread == g_thread_self ());
+
+  self->pending_url_changes = g_list_prepend (self->pending_url_changes,
+                                              ephy_history_url_change_new (type, url));
+}
+
 static gboolean
-ephy_history_service_execute_add_visit_helper (EphyHistoryService *self, EphyHistoryPageVisit *visit)
-{
-  if (visit->url->host == NULL)
-    visit->url->host = ephy_history_service_get_host_row_from_url (self, visit->url->url);
-  else if (visit->url->host->id == -1) {
-    /* This will happen when we migrate the old history to the new
-     * format. We need to store a zoom level for a not-yet-created
-     * host, so we'll end up here. Ugly, but it works. */
-    double zoom_level = visit->url->host->zoom_level;
-    ephy_history_host_free (visit->url->host);
-    visit->url->host = ephy_history_service_get_host_row_from_url (self, visit->url->url);
-    visit->url->host->zoom_level = zoom_level;
-  }
+urls_changed_signal_emit (SignalEmissionContext *ctx)
+{
+  g_signal_emit (ctx->service, signals[URLS_CHANGED], 0, ctx->user_data);
 
-  visit->url->host->visit_count++;
-  ephy_history_service_update_host_row (self, visit->url->host);
+  return FALSE;
+}
+
+/* Hands the changes made by the current message over to the main thread.
+ * This runs before the job callback is queued, so listeners always see the
+ * changes before the callback of the operation that made them. */
+static void
+ephy_history_service_flush_url_changes (EphyHistoryService *self)
+{
+  SignalEmissionContext *ctx;
+
+  if (!self->pending_url_changes)
+    return;
+
+  ctx = signal_emission_context_new (self, g_list_reverse (self->pending_url_changes),
+                                     (GDestroyNotify)ephy_history_url_change_list_free);
+  self->pending_url_changes = NULL;
+
+  g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                   (GSourceFunc)urls_changed_signal_emit,
+                   ctx,
+                   (GDestroyNotify)signal_emission_context_free);
+}
+
+/* When @hosts is not NULL, host rows are shared between the visits of a
+ * batch and written back once by ephy_history_service_flush_hosts(). */
+static gboolean
+ephy_history_service_execute_add_visit_helper (EphyHistoryService   *self,
+                                               EphyHistoryPageVisit *visit,
+                                               GHashTable           *hosts)
+{
+  EphyHistoryURLChangeType change_type;
+
+  if (visit->url->host == NULL && hosts != NULL) {
+    EphyHistoryHost *host = ephy_history_service_get_host_row_from_url_cached (self, visit->url->url, hosts);
+
+    host->visit_count++;
+    visit->url->host = ephy_history_host_copy (host);
+  } else {
+    if (visit->url->host == NULL)
+      visit->url->host = ephy_history_service_get_host_row_from_url (self, visit->url->url);
+    else if (visit->url->host->id == -1) {
+      /* This will happen when we migrate the old history to the new
+       * format. We need to store a zoom level for a not-yet-created
+       * host, so we'll end up here. Ugly, but it works. */
+      double zoom_level = visit->url->host->zoom_level;
+      ephy_history_host_free (visit->url->host);
+      visit->url->host = ephy_history_service_get_host_row_from_url (self, visit->url->url);
+      visit->url->host->zoom_level = zoom_level;
+    }
+
+    visit->url->host->visit_count++;
+    ephy_history_service_update_host_row (self, visit->url->host);
+  }
 
   /* A NULL return here means that the URL does not yet exist in the database.
    * This overwrites visit->url so we have to test the sync id against NULL on
    * both branches. */
   if (ephy_history_service_get_url_row (self, visit->url->url, visit->url) == NULL) {
+    change_type = EPHY_HISTORY_URL_CHANGE_INSERTED;
     visit->url->last_visit_time = visit->visit_time;
     visit->url->visit_count = 1;
 
@@ -575,6 +657,7 @@ ephy_history_service_execute_add_visit_helper (EphyHistoryService *self, EphyHis
       return FALSE;
     }
   } else {
+    change_type = EPHY_HISTORY_URL_CHANGE_UPDATED;
     visit->url->visit_count++;
 
     if (visit->visit_time > visit->url->last_visit_time)
@@ -586,6 +669,8 @@ ephy_history_service_execute_add_visit_helper (EphyHistoryService *self, EphyHis
     ephy_history_service_update_url_row (self, visit->url);
   }
 
+  ephy_history_service_queue_url_change (self, change_type, visit->url);
+
   if (visit->url->notify_visit)
     g_signal_emit (self, signals[VISIT_URL], 0, visit->url);
 
@@ -602,24 +687,121 @@ ephy_history_service_execute_add_visit (EphyHistoryService *self, EphyHistoryPag
   if (self->read_only)
     return FALSE;
 
-  success = ephy_history_service_execute_add_visit_helper (self, visit);
+  success = ephy_history_service_execute_add_visit_helper (self, visit, NULL);
   return success;
 }
 
+static GHashTable *
+ephy_history_service_hosts_cache_new (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal,
+                                g_free, (GDestroyNotify)ephy_history_host_free);
+}
+
+static void
+ephy_history_service_flush_hosts (EphyHistoryService *self,
+                                  GHashTable         *hosts)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, hosts);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    ephy_history_service_update_host_row (self, (EphyHistoryHost *)value);
+}
+
 static gboolean
 ephy_history_service_execute_add_visits (EphyHistoryService *self, GList *visits, gpointer *result)
 {
+  GHashTable *hosts;
   gboolean success = TRUE;
   g_assert (self->history_thread == g_thread_self ());
 
   if (self->read_only)
     return FALSE;
 
+  hosts = ephy_history_service_hosts_cache_new ();
+
   while (visits) {
-    success = success && ephy_history_service_execute_add_visit_helper (self, (EphyHistoryPageVisit *)visits->data);
+    success = success && ephy_history_service_execute_add_visit_helper (self, (EphyHistoryPageVisit *)visits->data, hosts);
     visits = visits->next;
   }
 
+  ephy_history_service_flush_hosts (self, hosts);
+  g_hash_table_unref (hosts);
+
+  return success;
+}
+
+static gboolean
+ephy_history_service_execute_merge_urls (EphyHistoryService *self, GList *urls, gpointer *result)
+{
+  EphyHistoryQuery *query;
+  GHashTable *local_by_sync_id;
+  GHashTable *local_by_url;
+  GHashTable *hosts;
+  GList *local_urls;
+  gboolean success = TRUE;
+  g_assert (self->history_thread == g_thread_self ());
+
+  if (self->read_only)
+    return FALSE;
+
+  query = ephy_history_query_new ();
+  query->from = -1;
+  query->to = -1;
+  local_urls = ephy_history_service_find_url_rows (self, query);
+  ephy_history_query_free (query);
+
+  /* Both tables point into local_urls. URLs without a sync id are migrated
+   * history and take no part in the merge. */
+  local_by_sync_id = g_hash_table_new (g_str_hash, g_str_equal);
+  local_by_url = g_hash_table_new (g_str_hash, g_str_equal);
+  for (GList *l = local_urls, *next; l; l = next) {
+    EphyHistoryURL *url = (EphyHistoryURL *)l->data;
+
+    next = l->next;
+    if (!url->sync_id) {
+      ephy_history_url_free (url);
+      local_urls = g_list_delete_link (local_urls, l);
+      continue;
+    }
+
+    g_hash_table_insert (local_by_sync_id, url->sync_id, url);
+    g_hash_table_insert (local_by_url, url->url, url);
+  }
+
+  hosts = ephy_history_service_hosts_cache_new ();
+
+  for (GList *l = urls; l; l = l->next) {
+    EphyHistoryURL *remote = (EphyHistoryURL *)l->data;
+    EphyHistoryURL *local;
+    EphyHistoryPageVisit *visit;
+
+    local = remote->sync_id ? g_hash_table_lookup (local_by_sync_id, remote->sync_id) : NULL;
+    if (!local)
+      local = g_hash_table_lookup (local_by_url, remote->url);
+
+    /* Record the remote last visit when it is newer than the local one. A URL
+     * found by address keeps its local sync id. */
+    if (remote->last_visit_time <= (local ? local->last_visit_time : 0))
+      continue;
+
+    visit = ephy_history_page_visit_new (remote->url, remote->last_visit_time, EPHY_PAGE_VISIT_LINK);
+    visit->url->sync_id = g_strdup (local ? local->sync_id : remote->sync_id);
+    visit->url->notify_visit = FALSE;
+    success = ephy_history_service_execute_add_visit_helper (self, visit, hosts) && success;
+    ephy_history_page_visit_free (visit);
+  }
+
+  ephy_history_service_flush_hosts (self, hosts);
+  g_hash_table_unref (hosts);
+  g_hash_table_unref (local_by_sync_id);
+  g_hash_table_unref (local_by_url);
+
+  /* The caller computes what needs uploading from the state before the merge. */
+  *result = local_urls;
+
   return success;
 }
 
@@ -699,6 +881,39 @@ ephy_history_service_add_visits (EphyHistoryService *self, GList *visits, GCance
   ephy_history_service_send_message (self, message);
 }
 
+/**
+ * ephy_history_service_merge_urls:
+ * @self: an #EphyHistoryService
+ * @urls: (element-type EphyHistoryURL): remote URLs, each with its sync id
+ *   and last visit time
+ * @cancellable: a #GCancellable or %NULL
+ * @callback: callback called when the merge is done
+ * @user_data: data for @callback
+ *
+ * Merges a set of remote URLs into the history database in a single job.
+ * Local URLs are matched by sync id or, failing that, by address, and a
+ * visit is added for each remote URL that was visited more recently than its
+ * local counterpart. @callback receives the list of local URLs with a sync
+ * id as they were before the merge.
+ **/
+void
+ephy_history_service_merge_urls (EphyHistoryService    *self,
+                                 GList                 *urls,
+                                 GCancellable          *cancellable,
+                                 EphyHistoryJobCallback callback,
+                                 gpointer               user_data)
+{
+  EphyHistoryServiceMessage *message;
+
+  g_assert (EPHY_IS_HISTORY_SERVICE (self));
+
+  message = ephy_history_service_message_new (self, MERGE_URLS,
+                                              ephy_history_url_list_copy (urls),
+                                              (GDestroyNotify)ephy_history_url_list_free,
+                                              cancellable, callback, user_data);
+  ephy_history_service_send_message (self, message);
+}
+
 void
 ephy_history_service_find_visits_in_time (EphyHistoryService *self, gint64 from, gint64 to, GCancellable *cancellable, EphyHistoryJobCallback callback, gpointer user_data)
 {
@@ -815,6 +1030,7 @@ ephy_history_service_execute_set_url_title (EphyHistoryService *self,
     g_free (url->title);
     url->title = title;
     ephy_history_service_update_url_row (self, url);
+    ephy_history_service_queue_url_change (self, EPHY_HISTORY_URL_CHANGE_UPDATED, url);
 
     ctx = signal_emission_context_new (self,
                                        ephy_history_url_copy (url),
@@ -1031,6 +1247,7 @@ ephy_history_service_execute_delete_urls (EphyHistoryService *self,
   for (l = urls; l != NULL; l = l->next) {
     url = l->data;
     ephy_history_service_delete_url (self, url);
+    ephy_history_service_queue_url_change (self, EPHY_HISTORY_URL_CHANGE_DELETED, url);
 
     if (url->notify_delete) {
       ctx = signal_emission_context_new (self, ephy_history_url_copy (url),
@@ -1165,6 +1382,7 @@ static EphyHistoryServiceMethod methods[] = {
   (EphyHistoryServiceMethod)ephy_history_service_execute_set_url_hidden,
   (EphyHistoryServiceMethod)ephy_history_service_execute_add_visit,
   (EphyHistoryServiceMethod)ephy_history_service_execute_add_visits,
+  (EphyHistoryServiceMethod)ephy_history_service_execute_merge_urls,
   (EphyHistoryServiceMethod)ephy_history_service_execute_delete_urls,
   (EphyHistoryServiceMethod)ephy_history_service_execute_delete_host,
   (EphyHistoryServiceMethod)ephy_history_service_execute_clear,
@@ -1177,6 +1395,28 @@ static EphyHistoryServiceMethod methods[] = {
   (EphyHistoryServiceMethod)ephy_history_service_execute_query_hosts
 };
 
+/* Trace event names, in the same order as the methods. */
+static const char * const method_names[] = {
+  "set-url-title",
+  "set-url-zoom-level",
+  "set-url-hidden",
+  "add-visit",
+  "add-visits",
+  "merge-urls",
+  "delete-urls",
+  "delete-host",
+  "clear",
+  "quit",
+  "get-url",
+  "get-host-for-url",
+  "query-urls",
+  "query-visits",
+  "get-hosts",
+  "query-hosts"
+};
+
+G_STATIC_ASSERT (G_N_ELEMENTS (method_names) == G_N_ELEMENTS (methods));
+
 static gboolean
 ephy_history_service_message_is_write (EphyHistoryServiceMessage *message)
 {
@@ -1188,9 +1428,12 @@ ephy_history_service_process_message (EphyHistoryService        *self,
                                       EphyHistoryServiceMessage *message)
 {
   EphyHistoryServiceMethod method;
+  EPHY_TRACE_BEGIN (begin);
 
   g_assert (self->history_thread == g_thread_self ());
 
+  EPHY_TRACE_END (message->queued_time, EPHY_TRACE_HISTORY, "queue-wait");
+
   if (g_cancellable_is_cancelled (message->cancellable) &&
       !ephy_history_service_message_is_write (message)) {
     ephy_history_service_message_free (message);
@@ -1203,10 +1446,13 @@ ephy_history_service_process_message (EphyHistoryService        *self,
     ephy_history_service_open_transaction (self);
     message->success = method (message->service, message->method_argument, &message->result);
     ephy_history_service_commit_transaction (self);
+    ephy_history_service_flush_url_changes (self);
   } else {
     message->success = FALSE;
   }
 
+  EPHY_TRACE_END (begin, EPHY_TRACE_HISTORY, method_names[message->type]);
+
   if (message->callback || message->type == CLEAR)
     g_idle_add ((GSourceFunc)ephy_history_service_execute_job_callback, message);
   else
@@ -1247,6 +1493,37 @@ ephy_history_service_find_urls (EphyHistoryService *self,
   ephy_history_query_free (query);
 }
 
+/* Fetches one page of URLs, most recently visited first. Pass a cursor for the
+ * last URL of a page to get the next one; the cost of a page does not depend
+ * on how deep into the history it is. Takes ownership of @substring_list. */
+void
+ephy_history_service_find_urls_page (EphyHistoryService    *self,
+                                     GList                 *substring_list,
+                                     EphyHistoryCursor     *after,
+                                     guint                  limit,
+                                     GCancellable          *cancellable,
+                                     EphyHistoryJobCallback callback,
+                                     gpointer               user_data)
+{
+  EphyHistoryQuery *query;
+
+  g_assert (EPHY_IS_HISTORY_SERVICE (self));
+  g_assert (limit > 0);
+
+  query = ephy_history_query_new ();
+  query->from = -1;
+  query->to = -1;
+  query->limit = limit;
+  query->substring_list = substring_list;
+  query->sort_type = EPHY_HISTORY_SORT_MOST_RECENTLY_VISITED;
+  query->after = ephy_history_cursor_copy (after);
+
+  ephy_history_service_query_urls (self,
+                                   query, cancellable,
+                                   callback, user_data);
+  ephy_history_query_free (query);
+}
+
 void
 ephy_history_service_visit_url (EphyHistoryService       *self,
                                 const char               *url,
@@ -1290,3 +1567,11 @@ ephy_history_service_find_hosts (EphyHistoryService *self,
                                     cancellable, callback, user_data);
   ephy_history_query_free (query);
 }
+
+guint
+ephy_history_service_get_queue_length (EphyHistoryService *self)
+{
+  g_assert (EPHY_IS_HISTORY_SERVICE (self));
+
+  return MAX (g_async_queue_length (self->queue), 0);
+}
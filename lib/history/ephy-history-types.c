@@ -196,6 +196,61 @@ ephy_history_url_list_free (GList *list)
   g_list_free_full (list, (GDestroyNotify)ephy_history_url_free);
 }
 
+EphyHistoryCursor *
+ephy_history_cursor_new_for_url (EphyHistoryURL *url)
+{
+  EphyHistoryCursor *cursor = g_new0 (EphyHistoryCursor, 1);
+
+  cursor->last_visit_time = url->last_visit_time;
+  cursor->id = url->id;
+
+  return cursor;
+}
+
+EphyHistoryCursor *
+ephy_history_cursor_copy (EphyHistoryCursor *cursor)
+{
+  EphyHistoryCursor *copy;
+
+  if (cursor == NULL)
+    return NULL;
+
+  copy = g_new0 (EphyHistoryCursor, 1);
+  copy->last_visit_time = cursor->last_visit_time;
+  copy->id = cursor->id;
+
+  return copy;
+}
+
+void
+ephy_history_cursor_free (EphyHistoryCursor *cursor)
+{
+  g_free (cursor);
+}
+
+EphyHistoryURLChange *
+ephy_history_url_change_new (EphyHistoryURLChangeType type,
+                             EphyHistoryURL          *url)
+{
+  EphyHistoryURLChange *change = g_new0 (EphyHistoryURLChange, 1);
+  change->type = type;
+  change->url = ephy_history_url_copy (url);
+  return change;
+}
+
+void
+ephy_history_url_change_free (EphyHistoryURLChange *change)
+{
+  ephy_history_url_free (change->url);
+  g_free (change);
+}
+
+void
+ephy_history_url_change_list_free (GList *list)
+{
+  g_list_free_full (list, (GDestroyNotify)ephy_history_url_change_free);
+}
+
 EphyHistoryQuery *
 ephy_history_query_new (void)
 {
@@ -206,6 +261,7 @@ void
 ephy_history_query_free (EphyHistoryQuery *query)
 {
   g_list_free_full (query->substring_list, g_free);
+  ephy_history_cursor_free (query->after);
   g_free (query);
 }
 
@@ -221,6 +277,7 @@ ephy_history_query_copy (EphyHistoryQuery *query)
   copy->ignore_hidden = query->ignore_hidden;
   copy->ignore_local = query->ignore_local;
   copy->host = query->host;
+  copy->after = ephy_history_cursor_copy (query->after);
 
   for (iter = query->substring_list; iter != NULL; iter = iter->next) {
     copy->substring_list = g_list_prepend (copy->substring_list, g_strdup (iter->data));
@@ -38,6 +38,12 @@ typedef enum {
   EPHY_HISTORY_URL_TITLE,
 } EphyHistoryURLProperty;
 
+typedef enum {
+  EPHY_HISTORY_URL_CHANGE_INSERTED,
+  EPHY_HISTORY_URL_CHANGE_UPDATED,
+  EPHY_HISTORY_URL_CHANGE_DELETED
+} EphyHistoryURLChangeType;
+
 typedef enum {
   EPHY_HISTORY_SORT_NONE = 0,
   EPHY_HISTORY_SORT_MOST_RECENTLY_VISITED,
@@ -82,6 +88,21 @@ typedef struct _EphyHistoryPageVisit
   EphyHistoryPageVisitType visit_type;
 } EphyHistoryPageVisit;
 
+/* Position in a list of URLs sorted by recency, used for keyset pagination. */
+typedef struct _EphyHistoryCursor
+{
+  gint64 last_visit_time; /* Microseconds */
+  int id;
+} EphyHistoryCursor;
+
+/* A single row change in the urls table. The url carries its sort keys
+ * (id and last_visit_time) as they are after the change. */
+typedef struct _EphyHistoryURLChange
+{
+  EphyHistoryURLChangeType type;
+  EphyHistoryURL *url;
+} EphyHistoryURLChange;
+
 typedef struct _EphyHistoryQuery
 {
   gint64 from;  /* Microseconds */
@@ -92,6 +113,7 @@ typedef struct _EphyHistoryQuery
   gboolean ignore_local;
   gint host;
   EphyHistorySortType sort_type;
+  EphyHistoryCursor *after; /* Only rows sorting after this one, for the recency sorts */
 } EphyHistoryQuery;
 
 EphyHistoryPageVisit *          ephy_history_page_visit_new (const char *url, gint64 visit_time, EphyHistoryPageVisitType visit_type);
@@ -113,6 +135,14 @@ void                            ephy_history_url_free (EphyHistoryURL *url);
 GList *                         ephy_history_url_list_copy (GList *original);
 void                            ephy_history_url_list_free (GList *list);
 
+EphyHistoryCursor *             ephy_history_cursor_new_for_url (EphyHistoryURL *url);
+EphyHistoryCursor *             ephy_history_cursor_copy (EphyHistoryCursor *cursor);
+void                            ephy_history_cursor_free (EphyHistoryCursor *cursor);
+
+EphyHistoryURLChange *          ephy_history_url_change_new (EphyHistoryURLChangeType type, EphyHistoryURL *url);
+void                            ephy_history_url_change_free (EphyHistoryURLChange *change);
+void                            ephy_history_url_change_list_free (GList *list);
+
 EphyHistoryQuery *              ephy_history_query_new (void);
 void                            ephy_history_query_free (EphyHistoryQuery *query);
 EphyHistoryQuery *              ephy_history_query_copy (EphyHistoryQuery *query);
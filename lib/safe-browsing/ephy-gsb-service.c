@@ -23,6 +23,7 @@
 
 #include "ephy-debug.h"
 #include "ephy-gsb-storage.h"
+#include "ephy-trace.h"
 #include "ephy-user-agent.h"
 
 #include <libsoup/soup.h>
@@ -618,6 +619,7 @@ ephy_gsb_service_verify_url_thread (GTask          *task,
   gboolean has_matching_expired_hashes = FALSE;
   gboolean has_matching_expired_prefixes = FALSE;
   GList *threats = NULL;
+  EPHY_TRACE_BEGIN (begin);
 
   g_assert (EPHY_IS_GSB_SERVICE (self));
   g_assert (G_IS_TASK (task));
@@ -726,6 +728,8 @@ ephy_gsb_service_verify_url_thread (GTask          *task,
   }
 
 out:
+  EPHY_TRACE_END (begin, EPHY_TRACE_SAFE_BROWSING, threats ? "lookup-match" : "lookup");
+
   g_task_return_pointer (task, threats, NULL);
 
   g_list_free (matching_prefixes);
@@ -564,7 +564,7 @@ ephy_sync_debug_view_collection (const char *collection,
     g_free (record);
   }
 
-  ephy_sync_crypto_key_bundle_free (bundle);
+  ephy_sync_crypto_key_bundle_unref (bundle);
 free_node:
   json_node_unref (node);
 free_response:
@@ -630,7 +630,7 @@ ephy_sync_debug_view_record (const char *collection,
   LOG ("%s", record);
 
   g_free (record);
-  ephy_sync_crypto_key_bundle_free (bundle);
+  ephy_sync_crypto_key_bundle_unref (bundle);
 free_node:
   json_node_unref (node);
 free_response:
@@ -678,7 +678,7 @@ ephy_sync_debug_upload_record (const char *collection,
   g_free (endpoint);
   g_free (body);
   g_free (response);
-  ephy_sync_crypto_key_bundle_free (bundle);
+  ephy_sync_crypto_key_bundle_unref (bundle);
 }
 
 /**
@@ -733,7 +733,7 @@ ephy_sync_debug_delete_collection (const char *collection)
     g_free (resp);
   }
 
-  ephy_sync_crypto_key_bundle_free (bundle);
+  ephy_sync_crypto_key_bundle_unref (bundle);
 free_node:
   json_node_unref (node);
 free_response:
@@ -779,7 +779,7 @@ ephy_sync_debug_delete_record (const char *collection,
   g_free (endpoint);
   g_free (body);
   g_free (response);
-  ephy_sync_crypto_key_bundle_free (bundle);
+  ephy_sync_crypto_key_bundle_unref (bundle);
 }
 
 /**
@@ -996,7 +996,7 @@ ephy_sync_debug_view_crypto_keys_record (void)
 
   g_free (crypto_keys);
 free_bundle:
-  ephy_sync_crypto_key_bundle_free (bundle);
+  ephy_sync_crypto_key_bundle_unref (bundle);
   g_free (kb);
   json_node_unref (node);
 free_response:
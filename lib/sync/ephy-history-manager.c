@@ -291,25 +291,14 @@ ephy_history_manager_handle_different_id_same_url (EphyHistoryManager *self,
                                                    EphyHistoryRecord  *local,
                                                    EphyHistoryRecord  *remote)
 {
-  gint64 local_last_visit_time;
-  gint64 remote_last_visit_time;
-
   g_assert (EPHY_IS_HISTORY_MANAGER (self));
   g_assert (EPHY_HISTORY_RECORD (local));
   g_assert (EPHY_HISTORY_RECORD (remote));
 
-  local_last_visit_time = ephy_history_record_get_last_visit_time (local);
-  remote_last_visit_time = ephy_history_record_get_last_visit_time (remote);
-
-  if (remote_last_visit_time > local_last_visit_time)
-    ephy_history_service_visit_url (self->service,
-                                    ephy_history_record_get_uri (local),
-                                    ephy_history_record_get_id (local),
-                                    local_last_visit_time,
-                                    EPHY_PAGE_VISIT_LINK, FALSE);
-
+  /* The remote visit was already recorded under the local ID by
+   * ephy_history_service_merge_urls(). */
   ephy_history_record_set_id (remote, ephy_history_record_get_id (local));
-  ephy_history_record_add_visit_time (remote, local_last_visit_time);
+  ephy_history_record_add_visit_time (remote, ephy_history_record_get_last_visit_time (local));
 }
 
 static GPtrArray *
@@ -324,7 +313,6 @@ ephy_history_manager_handle_initial_merge (EphyHistoryManager *self,
   GPtrArray *to_upload;
   const char *remote_id;
   const char *remote_url;
-  gint64 remote_last_visit_time;
   gint64 local_last_visit_time;
 
   g_assert (EPHY_IS_HISTORY_MANAGER (self));
@@ -336,23 +324,19 @@ ephy_history_manager_handle_initial_merge (EphyHistoryManager *self,
    * by ID or by URL. We start from the assumption that same ID means same URL
    * but same URL does not necessarily mean same ID. This is what our merge
    * logic is based on.
+   *
+   * The local database has already been updated with the remote visits by
+   * ephy_history_service_merge_urls(), here we only work out what to upload.
    */
   for (GList *l = remote_records; l && l->data; l = l->next) {
     remote_id = ephy_history_record_get_id (l->data);
     remote_url = ephy_history_record_get_uri (l->data);
-    remote_last_visit_time = ephy_history_record_get_last_visit_time (l->data);
 
     /* Try find by ID. */
     record = g_hash_table_lookup (records_ht_id, remote_id);
     if (record) {
-      /* Same ID, same URL. Update last visit time for the local record and add
-       * the local last visit time to the remote one. */
+      /* Same ID, same URL. Add the local last visit time to the remote one. */
       local_last_visit_time = ephy_history_record_get_last_visit_time (record);
-      if (remote_last_visit_time > local_last_visit_time)
-        ephy_history_service_visit_url (self->service, remote_url,
-                                        remote_id, remote_last_visit_time,
-                                        EPHY_PAGE_VISIT_LINK, FALSE);
-
       if (ephy_history_record_add_visit_time (l->data, local_last_visit_time))
         g_ptr_array_add (to_upload, g_object_ref (l->data));
 
@@ -366,12 +350,6 @@ ephy_history_manager_handle_initial_merge (EphyHistoryManager *self,
         ephy_history_manager_handle_different_id_same_url (self, record, l->data);
         g_ptr_array_add (to_upload, g_object_ref (l->data));
         g_hash_table_remove (records_ht_id, ephy_history_record_get_id (record));
-      } else {
-        /* Different ID, different URL. This is a new record. */
-        if (remote_last_visit_time > 0)
-          ephy_history_service_visit_url (self->service, remote_url,
-                                          remote_id, remote_last_visit_time,
-                                          EPHY_PAGE_VISIT_LINK, FALSE);
       }
     }
   }
@@ -396,7 +374,6 @@ ephy_history_manager_handle_regular_merge (EphyHistoryManager  *self,
   const char *remote_id;
   const char *remote_url;
   gint64 remote_last_visit_time;
-  gint64 local_last_visit_time;
 
   g_assert (EPHY_IS_HISTORY_MANAGER (self));
 
@@ -424,10 +401,9 @@ ephy_history_manager_handle_regular_merge (EphyHistoryManager  *self,
     /* Try find by ID. */
     record = g_hash_table_lookup (records_ht_id, remote_id);
     if (record) {
-      /* Same ID, same URL. Update last visit time for the local record. */
-      local_last_visit_time = ephy_history_record_get_last_visit_time (record);
-
-      /* Firefox offers the option to "forget about this site" which means that
+      /* Same ID, same URL. The last visit time was already updated.
+       *
+       * Firefox offers the option to "forget about this site" which means that
        * the record is not deleted from server but only has its visit times
        * deleted. Having no visit times translates to a negative last visit time
        * in Epiphany. Since Epiphany does not support having a history record
@@ -436,10 +412,6 @@ ephy_history_manager_handle_regular_merge (EphyHistoryManager  *self,
       if (remote_last_visit_time <= 0)
         ephy_synchronizable_manager_remove (EPHY_SYNCHRONIZABLE_MANAGER (self),
                                             EPHY_SYNCHRONIZABLE (record));
-      else if (remote_last_visit_time > local_last_visit_time)
-        ephy_history_service_visit_url (self->service, remote_url,
-                                        remote_id, remote_last_visit_time,
-                                        EPHY_PAGE_VISIT_LINK, FALSE);
     } else {
       /* Try find by URL. */
       record = g_hash_table_lookup (records_ht_url, remote_url);
@@ -448,12 +420,6 @@ ephy_history_manager_handle_regular_merge (EphyHistoryManager  *self,
         g_signal_emit_by_name (self, "synchronizable-deleted", l->data);
         ephy_history_manager_handle_different_id_same_url (self, record, l->data);
         g_ptr_array_add (to_upload, g_object_ref (l->data));
-      } else {
-        /* Different ID, different URL. This is a new record. */
-        if (remote_last_visit_time > 0)
-          ephy_history_service_visit_url (self->service, remote_url,
-                                          remote_id, remote_last_visit_time,
-                                          EPHY_PAGE_VISIT_LINK, FALSE);
       }
     }
   }
@@ -524,16 +490,32 @@ synchronizable_manager_merge (EphySynchronizableManager              *manager,
                               gpointer                                user_data)
 {
   EphyHistoryManager *self = EPHY_HISTORY_MANAGER (manager);
+  GList *urls = NULL;
+
+  /* Record all remote visits in a single history job. It hands back the
+   * local URLs as they were before the merge. */
+  for (GList *l = remotes_updated; l && l->data; l = l->next) {
+    EphyHistoryRecord *record = EPHY_HISTORY_RECORD (l->data);
+    EphyHistoryURL *url;
+
+    url = ephy_history_url_new (ephy_history_record_get_uri (record),
+                                ephy_history_record_get_title (record),
+                                0, 0,
+                                ephy_history_record_get_last_visit_time (record));
+    url->sync_id = g_strdup (ephy_history_record_get_id (record));
+    urls = g_list_prepend (urls, url);
+  }
+
+  ephy_history_service_merge_urls (self->service, urls, NULL,
+                                   (EphyHistoryJobCallback)merge_history_cb,
+                                   merge_history_async_data_new (self,
+                                                                 is_initial,
+                                                                 remotes_deleted,
+                                                                 remotes_updated,
+                                                                 callback,
+                                                                 user_data));
 
-  ephy_history_service_find_urls (self->service, -1, -1, -1, 0, NULL,
-                                  EPHY_HISTORY_SORT_MOST_RECENTLY_VISITED, NULL,
-                                  (EphyHistoryJobCallback)merge_history_cb,
-                                  merge_history_async_data_new (self,
-                                                                is_initial,
-                                                                remotes_deleted,
-                                                                remotes_updated,
-                                                                callback,
-                                                                user_data));
+  ephy_history_url_list_free (urls);
 }
 
 static void
@@ -407,4 +407,5 @@ ephy_synchronizable_iface_init (EphySynchronizableInterface *iface)
   iface->get_server_time_modified = synchronizable_get_server_time_modified;
   iface->set_server_time_modified = synchronizable_set_server_time_modified;
   iface->to_bso = ephy_synchronizable_default_to_bso;
+  iface->to_cleartext = ephy_synchronizable_default_to_cleartext;
 }
@@ -30,6 +30,17 @@ struct _EphyOpenTabsManager {
 
   EphyTabsCatalog *catalog;
 
+  /* The local tabs as of catalog version local_version, by tab id. They
+   * are kept up to date with the changes of the catalog. */
+  GHashTable *local_tabs;
+  guint64 local_version;
+
+  /* The catalog version of the last successful upload, and of the one
+   * in progress. */
+  gboolean has_uploaded;
+  guint64 uploaded_version;
+  guint64 uploading_version;
+
   /* A list of EphyOpenTabsRecord objects describing the open tabs
    * of other sync clients. This is updated at every sync. */
   GList *remote_records;
@@ -91,6 +102,7 @@ ephy_open_tabs_manager_finalize (GObject *object)
   EphyOpenTabsManager *self = EPHY_OPEN_TABS_MANAGER (object);
 
   g_list_free_full (self->remote_records, g_object_unref);
+  g_hash_table_unref (self->local_tabs);
 
   G_OBJECT_CLASS (ephy_open_tabs_manager_parent_class)->finalize (object);
 }
@@ -128,6 +140,8 @@ ephy_open_tabs_manager_class_init (EphyOpenTabsManagerClass *klass)
 static void
 ephy_open_tabs_manager_init (EphyOpenTabsManager *self)
 {
+  self->local_tabs = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free,
+                                            (GDestroyNotify)ephy_tab_info_free);
 }
 
 EphyOpenTabsManager *
@@ -138,35 +152,80 @@ ephy_open_tabs_manager_new (EphyTabsCatalog *catalog)
                                                NULL));
 }
 
-EphyOpenTabsRecord *
-ephy_open_tabs_manager_get_local_tabs (EphyOpenTabsManager *self)
+static void
+ephy_open_tabs_manager_update_local_tabs (EphyOpenTabsManager *self)
+{
+  GList *changes;
+
+  if (!ephy_tabs_catalog_get_changes (self->catalog, self->local_version,
+                                      &changes, &self->local_version))
+    g_hash_table_remove_all (self->local_tabs);
+
+  for (GList *l = changes; l && l->data; l = l->next) {
+    EphyTabChange *change = l->data;
+    guint64 *id;
+
+    if (!change->info) {
+      g_hash_table_remove (self->local_tabs, &change->id);
+      continue;
+    }
+
+    id = g_new (guint64, 1);
+    *id = change->id;
+    g_hash_table_replace (self->local_tabs, id, g_steal_pointer (&change->info));
+  }
+
+  g_list_free_full (changes, (GDestroyNotify)ephy_tab_change_free);
+}
+
+static int
+compare_tab_ids (gconstpointer a,
+                 gconstpointer b)
+{
+  guint64 id_a = *(const guint64 *)a;
+  guint64 id_b = *(const guint64 *)b;
+
+  return id_a < id_b ? -1 : id_a > id_b;
+}
+
+static EphyOpenTabsRecord *
+ephy_open_tabs_manager_build_local_tabs (EphyOpenTabsManager *self)
 {
   EphyOpenTabsRecord *local_tabs;
   EphyTabInfo *info;
-  GList *tabs_info;
+  GList *ids;
   char *device_bso_id;
   char *device_name;
 
-  g_assert (EPHY_IS_OPEN_TABS_MANAGER (self));
-
   device_bso_id = ephy_sync_utils_get_device_bso_id ();
   device_name = ephy_sync_utils_get_device_name ();
 
   local_tabs = ephy_open_tabs_record_new (device_bso_id, device_name);
-  tabs_info = ephy_tabs_catalog_get_tabs_info (self->catalog);
 
-  for (GList *l = tabs_info; l && l->data; l = l->next) {
-    info = (EphyTabInfo *)l->data;
+  /* Tab ids grow as tabs are opened. */
+  ids = g_list_sort (g_hash_table_get_keys (self->local_tabs), compare_tab_ids);
+  for (GList *l = ids; l && l->data; l = l->next) {
+    info = g_hash_table_lookup (self->local_tabs, l->data);
     ephy_open_tabs_record_add_tab (local_tabs, info->title, info->url, info->favicon);
   }
 
   g_free (device_bso_id);
   g_free (device_name);
-  g_list_free_full (tabs_info, (GDestroyNotify)ephy_tab_info_free);
+  g_list_free (ids);
 
   return local_tabs;
 }
 
+EphyOpenTabsRecord *
+ephy_open_tabs_manager_get_local_tabs (EphyOpenTabsManager *self)
+{
+  g_assert (EPHY_IS_OPEN_TABS_MANAGER (self));
+
+  ephy_open_tabs_manager_update_local_tabs (self);
+
+  return ephy_open_tabs_manager_build_local_tabs (self);
+}
+
 GList *
 ephy_open_tabs_manager_get_remote_tabs (EphyOpenTabsManager *self)
 {
@@ -182,6 +241,9 @@ ephy_open_tabs_manager_clear_cache (EphyOpenTabsManager *self)
 
   g_list_free_full (self->remote_records, g_object_unref);
   self->remote_records = NULL;
+
+  /* The next sync may be with another account. */
+  self->has_uploaded = FALSE;
 }
 
 const char *
@@ -222,6 +284,12 @@ static void
 synchronizable_manager_set_sync_time (EphySynchronizableManager *manager,
                                       gint64                     sync_time)
 {
+  EphyOpenTabsManager *self = EPHY_OPEN_TABS_MANAGER (manager);
+
+  /* This is only called once the local tabs were uploaded. */
+  self->has_uploaded = TRUE;
+  self->uploaded_version = self->uploading_version;
+
   ephy_sync_utils_set_open_tabs_sync_time (sync_time);
 }
 
@@ -259,26 +327,38 @@ synchronizable_manager_merge (EphySynchronizableManager              *manager,
   EphyOpenTabsManager *self = EPHY_OPEN_TABS_MANAGER (manager);
   GPtrArray *to_upload;
   char *device_bso_id;
+  char *device_name;
+  gboolean server_is_current = FALSE;
 
   device_bso_id = ephy_sync_utils_get_device_bso_id ();
+  device_name = ephy_sync_utils_get_device_name ();
   g_list_free_full (self->remote_records, g_object_unref);
   self->remote_records = NULL;
 
   for (GList *l = remotes_updated; l && l->data; l = l->next) {
     /* Exclude the record which describes the local open tabs. */
-    if (!g_strcmp0 (device_bso_id, ephy_open_tabs_record_get_id (l->data)))
+    if (!g_strcmp0 (device_bso_id, ephy_open_tabs_record_get_id (l->data))) {
+      server_is_current = !g_strcmp0 (device_name, ephy_open_tabs_record_get_client_name (l->data));
       continue;
+    }
 
     self->remote_records = g_list_prepend (self->remote_records, g_object_ref (l->data));
   }
 
   /* Only upload the local open tabs, we don't want to alter open tabs of
    * other clients. Also, overwrite any previous value by doing a force upload.
+   * Skip the upload if nothing changed since the last one went through.
    */
   to_upload = g_ptr_array_new_with_free_func (g_object_unref);
-  g_ptr_array_add (to_upload, ephy_open_tabs_manager_get_local_tabs (self));
+  ephy_open_tabs_manager_update_local_tabs (self);
+  if (!server_is_current || !self->has_uploaded ||
+      self->uploaded_version != self->local_version) {
+    self->uploading_version = self->local_version;
+    g_ptr_array_add (to_upload, ephy_open_tabs_manager_build_local_tabs (self));
+  }
 
   g_free (device_bso_id);
+  g_free (device_name);
 
   callback (to_upload, user_data);
 }
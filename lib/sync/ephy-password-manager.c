@@ -22,6 +22,7 @@
 #include "ephy-password-manager.h"
 
 #include "ephy-debug.h"
+#include "ephy-password-record-index.h"
 #include "ephy-settings.h"
 #include "ephy-sync-utils.h"
 #include "ephy-synchronizable-manager.h"
@@ -53,6 +54,18 @@ struct _EphyPasswordManager {
   GObject parent_instance;
 
   GHashTable *cache;
+
+  /* All password records, loaded from the secret service and then kept in
+   * sync with every successful store and forget operation. Queries are
+   * answered from here; the ones issued while the records are (re)loading
+   * wait in pending_queries. Changes to the collection made behind our back
+   * invalidate it. */
+  EphyPasswordRecordIndex *records;
+  gboolean records_loaded;
+  gboolean records_loading;
+  gboolean records_stale;
+  GList *pending_queries;
+  SecretCollection *collection;
 };
 
 static void ephy_synchronizable_manager_iface_init (EphySynchronizableManagerInterface *iface);
@@ -62,6 +75,13 @@ G_DEFINE_TYPE_WITH_CODE (EphyPasswordManager, ephy_password_manager, G_TYPE_OBJE
                                                 ephy_synchronizable_manager_iface_init))
 
 typedef struct {
+  EphyPasswordManager *manager;
+  char *id;
+  char *origin;
+  char *target_origin;
+  char *username;
+  char *username_field;
+  char *password_field;
   EphyPasswordManagerQueryCallback callback;
   gpointer user_data;
 } QueryAsyncData;
@@ -76,6 +96,12 @@ typedef struct {
   EphyPasswordRecord  *record;
 } ManageRecordAsyncData;
 
+typedef struct {
+  EphyPasswordManager *manager;
+  char                *id;          /* NULL when clearing all records */
+  EphyPasswordRecord  *replacement;
+} ForgetRecordAsyncData;
+
 typedef struct {
   EphyPasswordManager                    *manager;
   gboolean                                is_initial;
@@ -86,12 +112,26 @@ typedef struct {
 } MergePasswordsAsyncData;
 
 static QueryAsyncData *
-query_async_data_new (EphyPasswordManagerQueryCallback callback,
-                      gpointer                         user_data)
+query_async_data_new (EphyPasswordManager              *manager,
+                      const char                       *id,
+                      const char                       *origin,
+                      const char                       *target_origin,
+                      const char                       *username,
+                      const char                       *username_field,
+                      const char                       *password_field,
+                      EphyPasswordManagerQueryCallback  callback,
+                      gpointer                          user_data)
 {
   QueryAsyncData *data;
 
   data = g_new (QueryAsyncData, 1);
+  data->manager = g_object_ref (manager);
+  data->id = g_strdup (id);
+  data->origin = g_strdup (origin);
+  data->target_origin = g_strdup (target_origin);
+  data->username = g_strdup (username);
+  data->username_field = g_strdup (username_field);
+  data->password_field = g_strdup (password_field);
   data->callback = callback;
   data->user_data = user_data;
 
@@ -103,6 +143,13 @@ query_async_data_free (QueryAsyncData *data)
 {
   g_assert (data);
 
+  g_object_unref (data->manager);
+  g_free (data->id);
+  g_free (data->origin);
+  g_free (data->target_origin);
+  g_free (data->username);
+  g_free (data->username_field);
+  g_free (data->password_field);
   g_free (data);
 }
 
@@ -182,6 +229,32 @@ manage_record_async_data_free (ManageRecordAsyncData *data)
   g_free (data);
 }
 
+static ForgetRecordAsyncData *
+forget_record_async_data_new (EphyPasswordManager *manager,
+                              const char          *id,
+                              EphyPasswordRecord  *replacement)
+{
+  ForgetRecordAsyncData *data;
+
+  data = g_new (ForgetRecordAsyncData, 1);
+  data->manager = g_object_ref (manager);
+  data->id = g_strdup (id);
+  data->replacement = replacement ? g_object_ref (replacement) : NULL;
+
+  return data;
+}
+
+static void
+forget_record_async_data_free (ForgetRecordAsyncData *data)
+{
+  g_assert (data);
+
+  g_object_unref (data->manager);
+  g_free (data->id);
+  g_clear_object (&data->replacement);
+  g_free (data);
+}
+
 static GHashTable *
 get_attributes_table (const char *id,
                       const char *origin,
@@ -287,21 +360,259 @@ ephy_password_manager_cache_add (EphyPasswordManager *self,
   g_hash_table_replace (self->cache, g_strdup (origin), usernames);
 }
 
+static GList *
+records_from_secret_items (GList *items)
+{
+  GList *records = NULL;
+
+  for (GList *l = items; l && l->data; l = l->next) {
+    SecretItem *item = (SecretItem *)l->data;
+    GHashTable *attributes = secret_item_get_attributes (item);
+    SecretValue *value = secret_item_get_secret (item);
+    const char *id = g_hash_table_lookup (attributes, ID_KEY);
+    const char *origin = g_hash_table_lookup (attributes, ORIGIN_KEY);
+    const char *target_origin = g_hash_table_lookup (attributes, TARGET_ORIGIN_KEY);
+    const char *username = g_hash_table_lookup (attributes, USERNAME_KEY);
+    const char *username_field = g_hash_table_lookup (attributes, USERNAME_FIELD_KEY);
+    const char *password_field = g_hash_table_lookup (attributes, PASSWORD_FIELD_KEY);
+    const char *timestamp = g_hash_table_lookup (attributes, SERVER_TIME_MODIFIED_KEY);
+    const char *password = secret_value_get (value, NULL);
+    gint64 server_time_modified;
+    EphyPasswordRecord *record;
+
+    LOG ("Found password record for (%s, %s, %s, %s, %s)",
+         origin, target_origin, username, username_field, password_field);
+
+    if (!id || !origin || !target_origin || !timestamp) {
+      LOG ("Password record is corrupted, skipping it...");
+      goto next;
+    }
+
+    record = ephy_password_record_new (id, origin, target_origin,
+                                       username, password,
+                                       username_field, password_field,
+                                       secret_item_get_created (item) * 1000,
+                                       secret_item_get_modified (item) * 1000);
+    server_time_modified = g_ascii_strtod (timestamp, NULL);
+    ephy_synchronizable_set_server_time_modified (EPHY_SYNCHRONIZABLE (record),
+                                                  server_time_modified);
+    records = g_list_prepend (records, record);
+
+next:
+    secret_value_unref (value);
+    g_hash_table_unref (attributes);
+  }
+
+  return records;
+}
+
 static void
-populate_cache_cb (GList    *records,
-                   gpointer  user_data)
+query_async_data_complete (QueryAsyncData *data)
 {
-  EphyPasswordManager *self = EPHY_PASSWORD_MANAGER (user_data);
+  GList *records;
 
+  records = ephy_password_record_index_query (data->manager->records,
+                                              data->id, data->origin, data->target_origin,
+                                              data->username, data->username_field,
+                                              data->password_field);
+  if (data->callback)
+    data->callback (records, data->user_data);
+  else
+    g_list_free_full (records, g_object_unref);
+
+  query_async_data_free (data);
+}
+
+static gboolean
+query_idle_cb (QueryAsyncData *data)
+{
+  query_async_data_complete (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+secret_service_search_cb (SecretService  *service,
+                          GAsyncResult   *result,
+                          QueryAsyncData *data)
+{
+  GList *matches;
+  GList *records = NULL;
+  GError *error = NULL;
+
+  matches = secret_service_search_finish (service, result, &error);
+  if (error) {
+    g_warning ("Failed to search secrets in password schema: %s", error->message);
+    g_error_free (error);
+  } else {
+    records = records_from_secret_items (matches);
+    g_list_free_full (matches, g_object_unref);
+  }
+
+  if (data->callback)
+    data->callback (records, data->user_data);
+  else
+    g_list_free_full (records, g_object_unref);
+
+  query_async_data_free (data);
+}
+
+static void
+query_secret_service (QueryAsyncData *data)
+{
+  GHashTable *attributes;
+
+  attributes = get_attributes_table (data->id, data->origin, data->target_origin,
+                                     data->username, data->username_field,
+                                     data->password_field, -1);
+  secret_service_search (NULL,
+                         EPHY_FORM_PASSWORD_SCHEMA,
+                         attributes,
+                         SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK | SECRET_SEARCH_LOAD_SECRETS,
+                         NULL,
+                         (GAsyncReadyCallback)secret_service_search_cb,
+                         data);
+  g_hash_table_unref (attributes);
+}
+
+static void ephy_password_manager_load_records (EphyPasswordManager *self);
+
+static void
+load_records_cb (SecretService       *service,
+                 GAsyncResult        *result,
+                 EphyPasswordManager *self)
+{
+  GList *matches;
+  GList *records;
+  GList *pending;
+  GError *error = NULL;
+
+  self->records_loading = FALSE;
+
+  matches = secret_service_search_finish (service, result, &error);
+  if (error) {
+    /* Most likely the keyring could not be unlocked. Send each waiting query
+     * to the secret service on its own, so that it gets the same answer it
+     * would have had without the index, and load again on the next query. */
+    g_warning ("Failed to load password records: %s", error->message);
+    g_error_free (error);
+
+    pending = g_list_reverse (self->pending_queries);
+    self->pending_queries = NULL;
+    for (GList *l = pending; l && l->data; l = l->next)
+      query_secret_service (l->data);
+    g_list_free (pending);
+
+    g_object_unref (self);
+    return;
+  }
+
+  if (self->records_stale) {
+    /* The collection changed while we were reading it. */
+    g_list_free_full (matches, g_object_unref);
+    self->records_stale = FALSE;
+    ephy_password_manager_load_records (self);
+    g_object_unref (self);
+    return;
+  }
+
+  ephy_password_record_index_clear (self->records);
+  ephy_password_manager_cache_clear (self);
+
+  records = records_from_secret_items (matches);
   for (GList *l = records; l && l->data; l = l->next) {
     EphyPasswordRecord *record = EPHY_PASSWORD_RECORD (l->data);
-    const char *origin = ephy_password_record_get_origin (record);
-    const char *username = ephy_password_record_get_username (record);
 
-    ephy_password_manager_cache_add (self, origin, username);
+    ephy_password_record_index_add (self->records, record);
+    ephy_password_manager_cache_add (self,
+                                     ephy_password_record_get_origin (record),
+                                     ephy_password_record_get_username (record));
   }
-
   g_list_free_full (records, g_object_unref);
+  g_list_free_full (matches, g_object_unref);
+
+  LOG ("Loaded %u password records", ephy_password_record_index_get_size (self->records));
+  self->records_loaded = TRUE;
+
+  pending = g_list_reverse (self->pending_queries);
+  self->pending_queries = NULL;
+  for (GList *l = pending; l && l->data; l = l->next)
+    query_async_data_complete (l->data);
+  g_list_free (pending);
+
+  g_object_unref (self);
+}
+
+static void
+ephy_password_manager_load_records (EphyPasswordManager *self)
+{
+  GHashTable *attributes;
+
+  if (self->records_loaded || self->records_loading)
+    return;
+
+  self->records_loading = TRUE;
+
+  attributes = secret_attributes_build (EPHY_FORM_PASSWORD_SCHEMA, NULL);
+  secret_service_search (NULL,
+                         EPHY_FORM_PASSWORD_SCHEMA,
+                         attributes,
+                         SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK | SECRET_SEARCH_LOAD_SECRETS,
+                         NULL,
+                         (GAsyncReadyCallback)load_records_cb,
+                         g_object_ref (self));
+  g_hash_table_unref (attributes);
+}
+
+static void
+collection_signal_cb (GDBusProxy          *proxy,
+                      const char          *sender_name,
+                      const char          *signal_name,
+                      GVariant            *parameters,
+                      EphyPasswordManager *self)
+{
+  if (g_strcmp0 (signal_name, "ItemCreated") &&
+      g_strcmp0 (signal_name, "ItemDeleted") &&
+      g_strcmp0 (signal_name, "ItemChanged"))
+    return;
+
+  /* The collection is shared with other applications, and any of them may
+   * have touched our items. Reload on the next query. */
+  LOG ("Secret collection changed (%s), invalidating password records", signal_name);
+  if (self->records_loading)
+    self->records_stale = TRUE;
+  self->records_loaded = FALSE;
+}
+
+static void
+collection_for_alias_cb (GObject             *source_object,
+                         GAsyncResult        *result,
+                         EphyPasswordManager *self)
+{
+  SecretCollection *collection;
+  GError *error = NULL;
+
+  collection = secret_collection_for_alias_finish (result, &error);
+  if (!collection) {
+    if (error) {
+      LOG ("Failed to get default secret collection: %s", error->message);
+      g_error_free (error);
+    }
+    g_object_unref (self);
+    return;
+  }
+
+  /* Do not watch the collection when the manager is already disposed. */
+  if (self->records) {
+    self->collection = collection;
+    g_signal_connect_object (collection, "g-signal",
+                             G_CALLBACK (collection_signal_cb),
+                             self, 0);
+  } else {
+    g_object_unref (collection);
+  }
+
+  g_object_unref (self);
 }
 
 static void
@@ -314,6 +625,11 @@ ephy_password_manager_dispose (GObject *object)
     g_clear_pointer (&self->cache, g_hash_table_unref);
   }
 
+  g_list_free_full (self->pending_queries, (GDestroyNotify)query_async_data_free);
+  self->pending_queries = NULL;
+  g_clear_pointer (&self->records, ephy_password_record_index_free);
+  g_clear_object (&self->collection);
+
   G_OBJECT_CLASS (ephy_password_manager_parent_class)->dispose (object);
 }
 
@@ -328,10 +644,16 @@ ephy_password_manager_class_init (EphyPasswordManagerClass *klass)
 static void
 ephy_password_manager_init (EphyPasswordManager *self)
 {
-  LOG ("Loading usernames into internal cache...");
+  LOG ("Loading password records into internal cache...");
   self->cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-  ephy_password_manager_query (self, NULL, NULL, NULL, NULL, NULL, NULL,
-                               populate_cache_cb, self);
+  self->records = ephy_password_record_index_new ();
+  ephy_password_manager_load_records (self);
+
+  /* Password items are stored in the default collection. */
+  secret_collection_for_alias (NULL, SECRET_COLLECTION_DEFAULT,
+                               SECRET_COLLECTION_NONE, NULL,
+                               (GAsyncReadyCallback)collection_for_alias_cb,
+                               g_object_ref (self));
 }
 
 EphyPasswordManager *
@@ -371,8 +693,10 @@ secret_service_store_cb (SecretService         *service,
                ephy_password_record_get_username_field (data->record),
                ephy_password_record_get_password_field (data->record),
                error->message);
+    /* The index still has the previous version of the record, if any. */
     g_error_free (error);
   } else {
+    ephy_password_record_index_add (data->manager->records, data->record);
     ephy_password_manager_cache_add (data->manager, origin, username);
   }
 
@@ -510,67 +834,6 @@ ephy_password_manager_save (EphyPasswordManager *self,
   g_object_unref (record);
 }
 
-static void
-secret_service_search_cb (SecretService  *service,
-                          GAsyncResult   *result,
-                          QueryAsyncData *data)
-{
-  GList *matches = NULL;
-  GList *records = NULL;
-  GError *error = NULL;
-
-  matches = secret_service_search_finish (service, result, &error);
-  if (error) {
-    g_warning ("Failed to search secrets in password schema: %s", error->message);
-    g_error_free (error);
-    goto out;
-  }
-
-  for (GList *l = matches; l && l->data; l = l->next) {
-    SecretItem *item = (SecretItem *)l->data;
-    GHashTable *attributes = secret_item_get_attributes (item);
-    SecretValue *value = secret_item_get_secret (item);
-    const char *id = g_hash_table_lookup (attributes, ID_KEY);
-    const char *origin = g_hash_table_lookup (attributes, ORIGIN_KEY);
-    const char *target_origin = g_hash_table_lookup (attributes, TARGET_ORIGIN_KEY);
-    const char *username = g_hash_table_lookup (attributes, USERNAME_KEY);
-    const char *username_field = g_hash_table_lookup (attributes, USERNAME_FIELD_KEY);
-    const char *password_field = g_hash_table_lookup (attributes, PASSWORD_FIELD_KEY);
-    const char *timestamp = g_hash_table_lookup (attributes, SERVER_TIME_MODIFIED_KEY);
-    const char *password = secret_value_get (value, NULL);
-    gint64 server_time_modified;
-    EphyPasswordRecord *record;
-
-    LOG ("Found password record for (%s, %s, %s, %s, %s)",
-         origin, target_origin, username, username_field, password_field);
-
-    if (!id || !origin || !target_origin || !timestamp) {
-      LOG ("Password record is corrupted, skipping it...");
-      goto next;
-    }
-
-    record = ephy_password_record_new (id, origin, target_origin,
-                                       username, password,
-                                       username_field, password_field,
-                                       secret_item_get_created (item) * 1000,
-                                       secret_item_get_modified (item) * 1000);
-    server_time_modified = g_ascii_strtod (timestamp, NULL);
-    ephy_synchronizable_set_server_time_modified (EPHY_SYNCHRONIZABLE (record),
-                                                  server_time_modified);
-    records = g_list_prepend (records, record);
-
-next:
-    secret_value_unref (value);
-    g_hash_table_unref (attributes);
-  }
-
-out:
-  if (data->callback)
-    data->callback (records, data->user_data);
-  query_async_data_free (data);
-  g_list_free_full (matches, g_object_unref);
-}
-
 void
 ephy_password_manager_query (EphyPasswordManager              *self,
                              const char                       *id,
@@ -583,47 +846,53 @@ ephy_password_manager_query (EphyPasswordManager              *self,
                              gpointer                          user_data)
 {
   QueryAsyncData *data;
-  GHashTable *attributes;
 
   g_assert (EPHY_IS_PASSWORD_MANAGER (self));
 
   LOG ("Querying password records for (%s, %s, %s, %s)",
        origin, username, username_field, password_field);
 
-  attributes = get_attributes_table (id, origin, target_origin, username,
-                                     username_field, password_field, -1);
-  data = query_async_data_new (callback, user_data);
+  data = query_async_data_new (self, id, origin, target_origin, username,
+                               username_field, password_field,
+                               callback, user_data);
 
-  secret_service_search (NULL,
-                         EPHY_FORM_PASSWORD_SCHEMA,
-                         attributes,
-                         SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK | SECRET_SEARCH_LOAD_SECRETS,
-                         NULL,
-                         (GAsyncReadyCallback)secret_service_search_cb,
-                         data);
+  /* Answer from the in-memory index, but keep the callback asynchronous as
+   * callers rely on that. */
+  if (self->records_loaded) {
+    g_idle_add ((GSourceFunc)query_idle_cb, data);
+    return;
+  }
 
-  g_hash_table_unref (attributes);
+  self->pending_queries = g_list_prepend (self->pending_queries, data);
+  ephy_password_manager_load_records (self);
 }
 
 static void
-secret_service_clear_cb (SecretService *service,
-                         GAsyncResult  *result,
-                         gpointer       user_data)
+secret_service_clear_cb (SecretService         *service,
+                         GAsyncResult          *result,
+                         ForgetRecordAsyncData *data)
 {
   GError *error = NULL;
 
   secret_service_clear_finish (service, result, &error);
   if (error) {
+    /* Keep the index in line with the secret service. */
     g_warning ("Failed to clear secrets from password schema: %s", error->message);
     g_error_free (error);
+    forget_record_async_data_free (data);
     return;
   }
 
-  if (user_data) {
-    ManageRecordAsyncData *data = (ManageRecordAsyncData *)user_data;
-    ephy_password_manager_store_record (data->manager, data->record);
-    manage_record_async_data_free (data);
-  }
+  if (data->id)
+    ephy_password_record_index_remove (data->manager->records, data->id);
+  else
+    ephy_password_record_index_clear (data->manager->records);
+
+  /* The replacement is indexed once it has been stored. */
+  if (data->replacement)
+    ephy_password_manager_store_record (data->manager, data->replacement);
+
+  forget_record_async_data_free (data);
 }
 
 static void
@@ -653,7 +922,9 @@ ephy_password_manager_forget_record (EphyPasswordManager *self,
 
   secret_service_clear (NULL, EPHY_FORM_PASSWORD_SCHEMA, attributes, NULL,
                         (GAsyncReadyCallback)secret_service_clear_cb,
-                        replacement ? manage_record_async_data_new (self, replacement) : NULL);
+                        forget_record_async_data_new (self,
+                                                      ephy_password_record_get_id (record),
+                                                      replacement));
 
   ephy_password_manager_cache_remove (self,
                                       ephy_password_record_get_origin (record),
@@ -704,7 +975,8 @@ forget_all_cb (GList    *records,
 
   attributes = secret_attributes_build (EPHY_FORM_PASSWORD_SCHEMA, NULL);
   secret_service_clear (NULL, EPHY_FORM_PASSWORD_SCHEMA, attributes, NULL,
-                        (GAsyncReadyCallback)secret_service_clear_cb, NULL);
+                        (GAsyncReadyCallback)secret_service_clear_cb,
+                        forget_record_async_data_new (self, NULL, NULL));
 
   for (GList *l = records; l && l->data; l = l->next)
     g_signal_emit_by_name (self, "synchronizable-deleted", l->data);
@@ -824,61 +1096,13 @@ synchronizable_manager_save (EphySynchronizableManager *manager,
   ephy_password_manager_replace_existing (self, record);
 }
 
-static EphyPasswordRecord *
-get_record_by_id (GList      *records,
-                  const char *id)
-{
-  g_assert (id);
-
-  for (GList *l = records; l && l->data; l = l->next) {
-    if (!g_strcmp0 (ephy_password_record_get_id (l->data), id))
-      return l->data;
-  }
-
-  return NULL;
-}
-
-static EphyPasswordRecord *
-get_record_by_parameters (GList      *records,
-                          const char *origin,
-                          const char *target_origin,
-                          const char *username,
-                          const char *username_field,
-                          const char *password_field)
-{
-  for (GList *l = records; l && l->data; l = l->next) {
-    if (!g_strcmp0 (ephy_password_record_get_username (l->data), username) &&
-        !g_strcmp0 (ephy_password_record_get_origin (l->data), origin) &&
-        !g_strcmp0 (ephy_password_record_get_target_origin (l->data), target_origin) &&
-        !g_strcmp0 (ephy_password_record_get_username_field (l->data), username_field) &&
-        !g_strcmp0 (ephy_password_record_get_password_field (l->data), password_field))
-      return l->data;
-  }
-
-  return NULL;
-}
-
-
-static GList *
-delete_record_by_id (GList      *records,
-                     const char *id)
-{
-  for (GList *l = records; l && l->data; l = l->next) {
-    if (!g_strcmp0 (ephy_password_record_get_id (l->data), id)) {
-      g_object_unref (l->data);
-      return g_list_delete_link (records, l);
-    }
-  }
-
-  return records;
-}
-
 static GPtrArray *
 ephy_password_manager_handle_initial_merge (EphyPasswordManager *self,
                                             GList               *local_records,
                                             GList               *remote_records)
 {
   EphyPasswordRecord *record;
+  EphyPasswordRecordIndex *local_index;
   GHashTable *dont_upload;
   GPtrArray *to_upload;
   const char *remote_id;
@@ -904,6 +1128,7 @@ ephy_password_manager_handle_initial_merge (EphyPasswordManager *self,
    */
   to_upload = g_ptr_array_new_with_free_func (g_object_unref);
   dont_upload = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  local_index = ephy_password_record_index_new_from_list (local_records);
 
   for (GList *l = remote_records; l && l->data; l = l->next) {
     remote_id = ephy_password_record_get_id (l->data);
@@ -916,7 +1141,7 @@ ephy_password_manager_handle_initial_merge (EphyPasswordManager *self,
     remote_timestamp = ephy_password_record_get_time_password_changed (l->data);
     remote_server_time_modified = ephy_synchronizable_get_server_time_modified (l->data);
 
-    record = get_record_by_id (local_records, remote_id);
+    record = ephy_password_record_index_lookup_id (local_index, remote_id);
     if (record) {
       if (!g_strcmp0 (ephy_password_record_get_password (record), remote_password)) {
         /* Same id, same password. Nothing to do. */
@@ -940,12 +1165,12 @@ ephy_password_manager_handle_initial_merge (EphyPasswordManager *self,
         }
       }
     } else {
-      record = get_record_by_parameters (local_records,
-                                         remote_origin,
-                                         remote_target_origin,
-                                         remote_username,
-                                         remote_username_field,
-                                         remote_password_field);
+      record = ephy_password_record_index_lookup_parameters (local_index,
+                                               remote_origin,
+                                               remote_target_origin,
+                                               remote_username,
+                                               remote_username_field,
+                                               remote_password_field);
       if (record) {
         /* Different id, same tuple. Keep the most recent modified. */
         local_timestamp = ephy_password_record_get_time_password_changed (record);
@@ -958,12 +1183,12 @@ ephy_password_manager_handle_initial_merge (EphyPasswordManager *self,
           g_hash_table_add (dont_upload, g_strdup (remote_id));
         }
       } else {
-        record = get_record_by_parameters (local_records,
-                                           remote_origin,
-                                           remote_origin,
-                                           remote_username,
-                                           remote_username_field,
-                                           remote_password_field);
+        record = ephy_password_record_index_lookup_parameters (local_index,
+                                                 remote_origin,
+                                                 remote_origin,
+                                                 remote_username,
+                                                 remote_username_field,
+                                                 remote_password_field);
         if (record) {
           /* A leftover from migration: the local record has incorrect target_origin
            * Replace it with remote record */
@@ -986,17 +1211,19 @@ ephy_password_manager_handle_initial_merge (EphyPasswordManager *self,
   }
 
   g_hash_table_unref (dont_upload);
+  ephy_password_record_index_free (local_index);
 
   return to_upload;
 }
 
 static GPtrArray *
-ephy_password_manager_handle_regular_merge (EphyPasswordManager  *self,
-                                            GList               **local_records,
-                                            GList                *deleted_records,
-                                            GList                *updated_records)
+ephy_password_manager_handle_regular_merge (EphyPasswordManager *self,
+                                            GList               *local_records,
+                                            GList               *deleted_records,
+                                            GList               *updated_records)
 {
   EphyPasswordRecord *record;
+  EphyPasswordRecordIndex *local_index;
   GPtrArray *to_upload;
   const char *remote_id;
   const char *remote_origin;
@@ -1010,13 +1237,14 @@ ephy_password_manager_handle_regular_merge (EphyPasswordManager  *self,
   g_assert (EPHY_IS_PASSWORD_MANAGER (self));
 
   to_upload = g_ptr_array_new_with_free_func (g_object_unref);
+  local_index = ephy_password_record_index_new_from_list (local_records);
 
   for (GList *l = deleted_records; l && l->data; l = l->next) {
     remote_id = ephy_password_record_get_id (l->data);
-    record = get_record_by_id (*local_records, remote_id);
+    record = ephy_password_record_index_lookup_id (local_index, remote_id);
     if (record) {
       ephy_password_manager_forget_record (self, record, NULL);
-      *local_records = delete_record_by_id (*local_records, remote_id);
+      ephy_password_record_index_remove (local_index, remote_id);
     }
   }
 
@@ -1030,17 +1258,17 @@ ephy_password_manager_handle_regular_merge (EphyPasswordManager  *self,
     remote_password_field = ephy_password_record_get_password_field (l->data);
     remote_timestamp = ephy_password_record_get_time_password_changed (l->data);
 
-    record = get_record_by_id (*local_records, remote_id);
+    record = ephy_password_record_index_lookup_id (local_index, remote_id);
     if (record) {
       /* Same id. Overwrite local record. */
       ephy_password_manager_forget_record (self, record, l->data);
     } else {
-      record = get_record_by_parameters (*local_records,
-                                         remote_origin,
-                                         remote_target_origin,
-                                         remote_username,
-                                         remote_username_field,
-                                         remote_password_field);
+      record = ephy_password_record_index_lookup_parameters (local_index,
+                                               remote_origin,
+                                               remote_target_origin,
+                                               remote_username,
+                                               remote_username_field,
+                                               remote_password_field);
       if (record) {
         /* Different id, same tuple. Keep the most recent modified. */
         local_timestamp = ephy_password_record_get_time_password_changed (record);
@@ -1059,6 +1287,8 @@ ephy_password_manager_handle_regular_merge (EphyPasswordManager  *self,
     }
   }
 
+  ephy_password_record_index_free (local_index);
+
   return to_upload;
 }
 
@@ -1073,7 +1303,7 @@ merge_cb (GList    *records,
     to_upload = ephy_password_manager_handle_initial_merge (data->manager, records,
                                                             data->remotes_updated);
   else
-    to_upload = ephy_password_manager_handle_regular_merge (data->manager, &records,
+    to_upload = ephy_password_manager_handle_regular_merge (data->manager, records,
                                                             data->remotes_deleted,
                                                             data->remotes_updated);
 
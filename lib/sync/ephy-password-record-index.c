@@ -0,0 +1,344 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ephy-password-record-index.h"
+
+#include "ephy-synchronizable.h"
+
+struct _EphyPasswordRecordIndex {
+  GHashTable *by_id;     /* id → EphyPasswordRecord */
+  GHashTable *by_tuple;  /* (origin, target origin, username) → GList of EphyPasswordRecord */
+  GHashTable *by_origin; /* origin → GList of EphyPasswordRecord */
+};
+
+static EphyPasswordRecord *
+record_copy (EphyPasswordRecord *record)
+{
+  EphyPasswordRecord *copy;
+  guint64 time_created;
+
+  g_object_get (record, "timeCreated", &time_created, NULL);
+  copy = ephy_password_record_new (ephy_password_record_get_id (record),
+                                   ephy_password_record_get_origin (record),
+                                   ephy_password_record_get_target_origin (record),
+                                   ephy_password_record_get_username (record),
+                                   ephy_password_record_get_password (record),
+                                   ephy_password_record_get_username_field (record),
+                                   ephy_password_record_get_password_field (record),
+                                   time_created,
+                                   ephy_password_record_get_time_password_changed (record));
+  ephy_synchronizable_set_server_time_modified (EPHY_SYNCHRONIZABLE (copy),
+                                                ephy_synchronizable_get_server_time_modified (EPHY_SYNCHRONIZABLE (record)));
+
+  return copy;
+}
+
+static char *
+record_tuple_key (const char *origin,
+                  const char *target_origin,
+                  const char *username)
+{
+  /* Unit separators cannot appear in origins, and NULL fields are encoded
+   * differently from empty ones. */
+  return g_strdup_printf ("%s\x1f%s\x1f%s",
+                          origin ? origin : "\x1e",
+                          target_origin ? target_origin : "\x1e",
+                          username ? username : "\x1e");
+}
+
+static void
+record_list_remove (GHashTable         *table,
+                    const char         *key,
+                    EphyPasswordRecord *record)
+{
+  gpointer orig_key;
+  gpointer list;
+
+  if (!g_hash_table_lookup_extended (table, key, &orig_key, &list))
+    return;
+
+  /* Steal the entry so that updating it does not free the list. */
+  g_hash_table_steal (table, key);
+  list = g_list_remove (list, record);
+  if (list)
+    g_hash_table_insert (table, orig_key, list);
+  else
+    g_free (orig_key);
+}
+
+static void
+record_list_add (GHashTable         *table,
+                 const char         *key,
+                 EphyPasswordRecord *record)
+{
+  gpointer orig_key;
+  gpointer list;
+
+  if (g_hash_table_lookup_extended (table, key, &orig_key, &list)) {
+    g_hash_table_steal (table, key);
+    g_hash_table_insert (table, orig_key, g_list_prepend (list, record));
+  } else {
+    g_hash_table_insert (table, g_strdup (key), g_list_prepend (NULL, record));
+  }
+}
+
+static gboolean
+record_matches (EphyPasswordRecord *record,
+                const char         *id,
+                const char         *origin,
+                const char         *target_origin,
+                const char         *username,
+                const char         *username_field,
+                const char         *password_field)
+{
+  /* Same semantics as a secret service attribute search: NULL matches all. */
+  return (!id || !g_strcmp0 (ephy_password_record_get_id (record), id)) &&
+         (!origin || !g_strcmp0 (ephy_password_record_get_origin (record), origin)) &&
+         (!target_origin || !g_strcmp0 (ephy_password_record_get_target_origin (record), target_origin)) &&
+         (!username || !g_strcmp0 (ephy_password_record_get_username (record), username)) &&
+         (!username_field || !g_strcmp0 (ephy_password_record_get_username_field (record), username_field)) &&
+         (!password_field || !g_strcmp0 (ephy_password_record_get_password_field (record), password_field));
+}
+
+EphyPasswordRecordIndex *
+ephy_password_record_index_new (void)
+{
+  EphyPasswordRecordIndex *index;
+
+  index = g_new (EphyPasswordRecordIndex, 1);
+  index->by_id = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  index->by_tuple = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_list_free);
+  index->by_origin = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_list_free);
+
+  return index;
+}
+
+EphyPasswordRecordIndex *
+ephy_password_record_index_new_from_list (GList *records)
+{
+  EphyPasswordRecordIndex *index = ephy_password_record_index_new ();
+
+  for (GList *l = records; l && l->data; l = l->next)
+    ephy_password_record_index_add (index, l->data);
+
+  return index;
+}
+
+void
+ephy_password_record_index_free (EphyPasswordRecordIndex *index)
+{
+  g_assert (index);
+
+  /* The list tables do not own references, so destroy them first. */
+  g_hash_table_unref (index->by_tuple);
+  g_hash_table_unref (index->by_origin);
+  g_hash_table_unref (index->by_id);
+  g_free (index);
+}
+
+void
+ephy_password_record_index_clear (EphyPasswordRecordIndex *index)
+{
+  g_assert (index);
+
+  g_hash_table_remove_all (index->by_tuple);
+  g_hash_table_remove_all (index->by_origin);
+  g_hash_table_remove_all (index->by_id);
+}
+
+guint
+ephy_password_record_index_get_size (EphyPasswordRecordIndex *index)
+{
+  g_assert (index);
+
+  return g_hash_table_size (index->by_id);
+}
+
+void
+ephy_password_record_index_remove (EphyPasswordRecordIndex *index,
+                                   const char              *id)
+{
+  EphyPasswordRecord *record;
+  const char *origin;
+  char *key;
+
+  g_assert (index);
+  g_assert (id);
+
+  record = g_hash_table_lookup (index->by_id, id);
+  if (!record)
+    return;
+
+  origin = ephy_password_record_get_origin (record);
+  key = record_tuple_key (origin,
+                          ephy_password_record_get_target_origin (record),
+                          ephy_password_record_get_username (record));
+  record_list_remove (index->by_tuple, key, record);
+  if (origin)
+    record_list_remove (index->by_origin, origin, record);
+  g_free (key);
+
+  /* Drops the reference held by the index. */
+  g_hash_table_remove (index->by_id, id);
+}
+
+/**
+ * ephy_password_record_index_add:
+ * @index: an #EphyPasswordRecordIndex
+ * @record: the record to index
+ *
+ * Indexes a copy of @record, replacing the record with the same id if there
+ * is one. Records without an id are ignored.
+ **/
+void
+ephy_password_record_index_add (EphyPasswordRecordIndex *index,
+                                EphyPasswordRecord      *record)
+{
+  EphyPasswordRecord *copy;
+  const char *id;
+  const char *origin;
+  char *key;
+
+  g_assert (index);
+  g_assert (EPHY_IS_PASSWORD_RECORD (record));
+
+  id = ephy_password_record_get_id (record);
+  if (!id)
+    return;
+
+  ephy_password_record_index_remove (index, id);
+
+  copy = record_copy (record);
+  origin = ephy_password_record_get_origin (copy);
+  key = record_tuple_key (origin,
+                          ephy_password_record_get_target_origin (copy),
+                          ephy_password_record_get_username (copy));
+  record_list_add (index->by_tuple, key, copy);
+  if (origin)
+    record_list_add (index->by_origin, origin, copy);
+  g_hash_table_insert (index->by_id, g_strdup (id), copy);
+  g_free (key);
+}
+
+/**
+ * ephy_password_record_index_query:
+ * @index: an #EphyPasswordRecordIndex
+ *
+ * Finds the records matching all the given fields, where %NULL matches
+ * anything.
+ *
+ * Returns: (transfer full): a list of copies of the matching records
+ **/
+GList *
+ephy_password_record_index_query (EphyPasswordRecordIndex *index,
+                                  const char              *id,
+                                  const char              *origin,
+                                  const char              *target_origin,
+                                  const char              *username,
+                                  const char              *username_field,
+                                  const char              *password_field)
+{
+  GList *candidates = NULL;
+  GList *records = NULL;
+  gboolean free_candidates = FALSE;
+  EphyPasswordRecord *record;
+
+  g_assert (index);
+
+  if (id) {
+    record = g_hash_table_lookup (index->by_id, id);
+    if (record)
+      candidates = g_list_prepend (NULL, record);
+    free_candidates = TRUE;
+  } else if (origin && target_origin && username) {
+    char *key = record_tuple_key (origin, target_origin, username);
+    candidates = g_hash_table_lookup (index->by_tuple, key);
+    g_free (key);
+  } else if (origin) {
+    candidates = g_hash_table_lookup (index->by_origin, origin);
+  } else {
+    candidates = g_hash_table_get_values (index->by_id);
+    free_candidates = TRUE;
+  }
+
+  for (GList *l = candidates; l && l->data; l = l->next) {
+    if (record_matches (l->data, id, origin, target_origin, username, username_field, password_field))
+      records = g_list_prepend (records, record_copy (l->data));
+  }
+
+  if (free_candidates)
+    g_list_free (candidates);
+
+  return records;
+}
+
+/**
+ * ephy_password_record_index_lookup_id:
+ * @index: an #EphyPasswordRecordIndex
+ * @id: a record id
+ *
+ * Returns: (transfer none) (nullable): the indexed record with @id
+ **/
+EphyPasswordRecord *
+ephy_password_record_index_lookup_id (EphyPasswordRecordIndex *index,
+                                      const char              *id)
+{
+  g_assert (index);
+  g_assert (id);
+
+  return g_hash_table_lookup (index->by_id, id);
+}
+
+/**
+ * ephy_password_record_index_lookup_parameters:
+ * @index: an #EphyPasswordRecordIndex
+ *
+ * Returns: (transfer none) (nullable): the first indexed record that has
+ * exactly the given fields
+ **/
+EphyPasswordRecord *
+ephy_password_record_index_lookup_parameters (EphyPasswordRecordIndex *index,
+                                              const char              *origin,
+                                              const char              *target_origin,
+                                              const char              *username,
+                                              const char              *username_field,
+                                              const char              *password_field)
+{
+  EphyPasswordRecord *record = NULL;
+  GList *candidates;
+  char *key;
+
+  g_assert (index);
+
+  key = record_tuple_key (origin, target_origin, username);
+  candidates = g_hash_table_lookup (index->by_tuple, key);
+  g_free (key);
+
+  for (GList *l = candidates; l && l->data; l = l->next) {
+    if (!g_strcmp0 (ephy_password_record_get_username_field (l->data), username_field) &&
+        !g_strcmp0 (ephy_password_record_get_password_field (l->data), password_field)) {
+      record = l->data;
+      break;
+    }
+  }
+
+  return record;
+}
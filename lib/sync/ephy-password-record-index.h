@@ -0,0 +1,59 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ephy-password-record.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Password records by id, by (origin, target origin, username) and by origin.
+ * The index keeps its own copies of the records, so that callers can never
+ * modify an indexed record behind its back. */
+typedef struct _EphyPasswordRecordIndex EphyPasswordRecordIndex;
+
+EphyPasswordRecordIndex *ephy_password_record_index_new                    (void);
+EphyPasswordRecordIndex *ephy_password_record_index_new_from_list          (GList                   *records);
+void                     ephy_password_record_index_free                   (EphyPasswordRecordIndex *index);
+void                     ephy_password_record_index_clear                  (EphyPasswordRecordIndex *index);
+guint                    ephy_password_record_index_get_size               (EphyPasswordRecordIndex *index);
+void                     ephy_password_record_index_add                    (EphyPasswordRecordIndex *index,
+                                                                            EphyPasswordRecord      *record);
+void                     ephy_password_record_index_remove                 (EphyPasswordRecordIndex *index,
+                                                                            const char              *id);
+GList                   *ephy_password_record_index_query                  (EphyPasswordRecordIndex *index,
+                                                                            const char              *id,
+                                                                            const char              *origin,
+                                                                            const char              *target_origin,
+                                                                            const char              *username,
+                                                                            const char              *username_field,
+                                                                            const char              *password_field);
+EphyPasswordRecord      *ephy_password_record_index_lookup_id              (EphyPasswordRecordIndex *index,
+                                                                            const char              *id);
+EphyPasswordRecord      *ephy_password_record_index_lookup_parameters      (EphyPasswordRecordIndex *index,
+                                                                            const char              *origin,
+                                                                            const char              *target_origin,
+                                                                            const char              *username,
+                                                                            const char              *username_field,
+                                                                            const char              *password_field);
+
+G_END_DECLS
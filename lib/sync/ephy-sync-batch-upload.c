@@ -0,0 +1,512 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ephy-sync-batch-upload.h"
+
+#include "ephy-debug.h"
+#include "ephy-sync-utils.h"
+
+#include <json-glib/json-glib.h>
+#include <math.h>
+
+/* Records are POSTed EPHY_SYNC_BATCH_SIZE at a time, and every
+ * EPHY_SYNC_MAX_BATCHES such chunks are committed as one server batch. A few
+ * chunks are encrypted ahead on worker threads while others are in flight. */
+#define MAX_REQUESTS_IN_FLIGHT 4
+#define MAX_CHUNKS_AHEAD (2 * MAX_REQUESTS_IN_FLIGHT)
+
+typedef struct {
+  GObject                    *source_object;
+  EphySyncStorageRequestFunc  request_func;
+  char                       *collection;
+  GPtrArray                  *records;
+  SyncCryptoKeyBundle        *bundle;
+  /* Timestamp of the collection, which each commit must still match. */
+  gint64                      unmodified_since;
+  gint64                      last_modified;
+
+  guint                       n_chunks;
+  char                      **bodies;
+  guint                       next_encode;
+  guint                       encoding;
+  guint                       ready;
+  guint                       next_post;
+  guint                       in_flight;
+
+  /* The server batch being uploaded: chunks up to batch_end go in it. */
+  char                       *batch_id;
+  guint                       batch_end;
+  gboolean                    starting;
+  gboolean                    committing;
+
+  GError                     *error;
+} BatchUpload;
+
+typedef struct {
+  GPtrArray           *records;
+  SyncCryptoKeyBundle *bundle;
+  guint                start;
+  guint                end;
+  guint                chunk;
+} EncodeData;
+
+static void batch_upload_pump (GTask *task);
+
+EphySyncBatchRecord *
+ephy_sync_batch_record_new (const char *id,
+                            const char *cleartext)
+{
+  EphySyncBatchRecord *record;
+
+  g_assert (id);
+  g_assert (cleartext);
+
+  record = g_new0 (EphySyncBatchRecord, 1);
+  record->id = g_strdup (id);
+  record->cleartext = g_strdup (cleartext);
+
+  return record;
+}
+
+/* For records that are already encrypted, e.g. by a custom to_bso (). */
+EphySyncBatchRecord *
+ephy_sync_batch_record_new_from_bso (JsonNode *bso)
+{
+  EphySyncBatchRecord *record;
+  JsonObject *object;
+
+  g_assert (bso);
+  g_assert (JSON_NODE_HOLDS_OBJECT (bso));
+
+  object = json_node_get_object (bso);
+  g_assert (json_object_has_member (object, "id"));
+
+  record = g_new0 (EphySyncBatchRecord, 1);
+  record->id = g_strdup (json_object_get_string_member (object, "id"));
+  record->bso = json_node_copy (bso);
+
+  return record;
+}
+
+void
+ephy_sync_batch_record_free (EphySyncBatchRecord *record)
+{
+  g_assert (record);
+
+  g_free (record->id);
+  g_free (record->cleartext);
+  if (record->bso)
+    json_node_unref (record->bso);
+  g_free (record);
+}
+
+static void
+batch_upload_free (BatchUpload *upload)
+{
+  g_object_unref (upload->source_object);
+  g_free (upload->collection);
+  g_ptr_array_unref (upload->records);
+  ephy_sync_crypto_key_bundle_unref (upload->bundle);
+  for (guint i = 0; i < upload->n_chunks; i++)
+    g_free (upload->bodies[i]);
+  g_free (upload->bodies);
+  g_free (upload->batch_id);
+  g_clear_error (&upload->error);
+  g_free (upload);
+}
+
+static void
+batch_upload_fail (BatchUpload *upload,
+                   const char  *format,
+                   ...) G_GNUC_PRINTF (2, 3);
+
+static void
+batch_upload_fail (BatchUpload *upload,
+                   const char  *format,
+                   ...)
+{
+  va_list args;
+
+  /* Only the first failure is reported. */
+  if (upload->error)
+    return;
+
+  va_start (args, format);
+  upload->error = g_error_new_valist (G_IO_ERROR, G_IO_ERROR_FAILED, format, args);
+  va_end (args);
+}
+
+static void
+encode_chunk_thread (GTask        *task,
+                     gpointer      source_object,
+                     gpointer      task_data,
+                     GCancellable *cancellable)
+{
+  EncodeData *data = task_data;
+  JsonNode *node;
+  JsonArray *array;
+  GPtrArray *cleartexts;
+  GPtrArray *payloads;
+  guint next_payload = 0;
+  char *body;
+
+  cleartexts = g_ptr_array_sized_new (data->end - data->start);
+  for (guint i = data->start; i < data->end; i++) {
+    EphySyncBatchRecord *record = g_ptr_array_index (data->records, i);
+
+    if (!record->bso)
+      g_ptr_array_add (cleartexts, record->cleartext);
+  }
+  payloads = ephy_sync_crypto_encrypt_records (cleartexts, data->bundle);
+
+  node = json_node_new (JSON_NODE_ARRAY);
+  array = json_array_new ();
+
+  for (guint i = data->start; i < data->end; i++) {
+    EphySyncBatchRecord *record = g_ptr_array_index (data->records, i);
+    JsonObject *object;
+
+    if (record->bso) {
+      json_array_add_element (array, json_node_copy (record->bso));
+      continue;
+    }
+
+    object = json_object_new ();
+    json_object_set_string_member (object, "id", record->id);
+    json_object_set_string_member (object, "payload",
+                                   g_ptr_array_index (payloads, next_payload++));
+    json_array_add_object_element (array, object);
+  }
+
+  json_node_take_array (node, array);
+  body = json_to_string (node, FALSE);
+  json_node_unref (node);
+  g_ptr_array_unref (payloads);
+  g_ptr_array_unref (cleartexts);
+
+  g_task_return_pointer (task, body, g_free);
+}
+
+static void
+encode_chunk_cb (GObject      *source_object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  GTask *task = user_data;
+  BatchUpload *upload = g_task_get_task_data (task);
+  EncodeData *data = g_task_get_task_data (G_TASK (result));
+
+  upload->bodies[data->chunk] = g_task_propagate_pointer (G_TASK (result), NULL);
+  upload->encoding--;
+  upload->ready++;
+
+  batch_upload_pump (task);
+  g_object_unref (task);
+}
+
+static void
+batch_upload_encode_chunk (GTask *task)
+{
+  BatchUpload *upload = g_task_get_task_data (task);
+  GTask *encode_task;
+  EncodeData *data;
+
+  data = g_new (EncodeData, 1);
+  data->records = upload->records;
+  data->bundle = upload->bundle;
+  data->chunk = upload->next_encode++;
+  data->start = data->chunk * EPHY_SYNC_BATCH_SIZE;
+  data->end = MIN (data->start + EPHY_SYNC_BATCH_SIZE, upload->records->len);
+
+  /* The records and the bundle stay alive with the upload, which the
+   * callback holds a reference to. */
+  encode_task = g_task_new (NULL, NULL, encode_chunk_cb, g_object_ref (task));
+  g_task_set_task_data (encode_task, data, g_free);
+  upload->encoding++;
+  g_task_run_in_thread (encode_task, encode_chunk_thread);
+  g_object_unref (encode_task);
+}
+
+/* Checks the response to a POST that adds records to a batch. */
+static gboolean
+check_post_response (BatchUpload  *upload,
+                     SoupMessage  *msg,
+                     char        **batch_id)
+{
+  JsonNode *node;
+  JsonObject *object;
+  JsonObject *failed;
+  GError *error = NULL;
+
+  /* Note: "202 Accepted" status code. */
+  if (msg->status_code != 202) {
+    batch_upload_fail (upload, "Failed to upload batch. Status code: %u, response: %s",
+                       msg->status_code, msg->response_body->data);
+    return FALSE;
+  }
+
+  node = json_from_string (msg->response_body->data, &error);
+  if (error) {
+    batch_upload_fail (upload, "Response is not a valid JSON: %s", error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+
+  object = json_node_get_object (node);
+  if (!object) {
+    batch_upload_fail (upload, "JSON node does not hold an object");
+    json_node_unref (node);
+    return FALSE;
+  }
+
+  failed = json_object_has_member (object, "failed") ?
+           json_object_get_object_member (object, "failed") : NULL;
+  if (failed && json_object_get_size (failed) > 0) {
+    batch_upload_fail (upload, "Server rejected %u records", json_object_get_size (failed));
+    json_node_unref (node);
+    return FALSE;
+  }
+
+  if (batch_id) {
+    if (!json_object_has_member (object, "batch")) {
+      batch_upload_fail (upload, "Server did not start a batch");
+      json_node_unref (node);
+      return FALSE;
+    }
+    *batch_id = soup_uri_encode (json_object_get_string_member (object, "batch"), NULL);
+  }
+
+  json_node_unref (node);
+  return TRUE;
+}
+
+static void
+post_chunk_cb (SoupSession *session,
+               SoupMessage *msg,
+               gpointer     user_data)
+{
+  GTask *task = user_data;
+  BatchUpload *upload = g_task_get_task_data (task);
+
+  upload->in_flight--;
+
+  if (upload->starting) {
+    upload->starting = FALSE;
+    if (check_post_response (upload, msg, &upload->batch_id))
+      LOG ("Started batch %s in collection %s", upload->batch_id, upload->collection);
+  } else if (check_post_response (upload, msg, NULL)) {
+    LOG ("Successfully uploaded records to batch %s", upload->batch_id);
+  }
+
+  batch_upload_pump (task);
+  g_object_unref (task);
+}
+
+static void
+commit_batch_cb (SoupSession *session,
+                 SoupMessage *msg,
+                 gpointer     user_data)
+{
+  GTask *task = user_data;
+  BatchUpload *upload = g_task_get_task_data (task);
+  const char *last_modified;
+
+  upload->in_flight--;
+  upload->committing = FALSE;
+
+  /* 412 means someone else changed the collection since it was downloaded. */
+  if (msg->status_code != 200) {
+    batch_upload_fail (upload, "Failed to commit batch. Status code: %u, response: %s",
+                       msg->status_code, msg->response_body->data);
+  } else {
+    LOG ("Successfully committed batch %s", upload->batch_id);
+    last_modified = soup_message_headers_get_one (msg->response_headers, "X-Last-Modified");
+    if (last_modified) {
+      upload->last_modified = ceil (g_ascii_strtod (last_modified, NULL));
+      upload->unmodified_since = upload->last_modified;
+    }
+    g_clear_pointer (&upload->batch_id, g_free);
+  }
+
+  batch_upload_pump (task);
+  g_object_unref (task);
+}
+
+static void
+batch_upload_post_chunk (GTask *task)
+{
+  BatchUpload *upload = g_task_get_task_data (task);
+  g_autofree char *endpoint = NULL;
+  g_autofree char *body = NULL;
+
+  body = g_steal_pointer (&upload->bodies[upload->next_post++]);
+  upload->ready--;
+  upload->in_flight++;
+
+  if (!upload->batch_id) {
+    upload->starting = TRUE;
+    upload->batch_end = MIN (upload->next_post - 1 + EPHY_SYNC_MAX_BATCHES, upload->n_chunks);
+    endpoint = g_strdup_printf ("storage/%s?batch=true", upload->collection);
+  } else {
+    endpoint = g_strdup_printf ("storage/%s?batch=%s", upload->collection, upload->batch_id);
+  }
+
+  upload->request_func (upload->source_object, endpoint, SOUP_METHOD_POST, body, -1,
+                        post_chunk_cb, g_object_ref (task));
+}
+
+static void
+batch_upload_commit (GTask *task)
+{
+  BatchUpload *upload = g_task_get_task_data (task);
+  g_autofree char *endpoint = NULL;
+
+  upload->committing = TRUE;
+  upload->in_flight++;
+
+  endpoint = g_strdup_printf ("storage/%s?commit=true&batch=%s", upload->collection, upload->batch_id);
+  upload->request_func (upload->source_object, endpoint, SOUP_METHOD_POST, "[]",
+                        upload->unmodified_since, commit_batch_cb, g_object_ref (task));
+}
+
+static void
+batch_upload_pump (GTask *task)
+{
+  BatchUpload *upload = g_task_get_task_data (task);
+
+  if (upload->error) {
+    /* A server batch that is never committed is discarded by the server. */
+    if (upload->encoding == 0 && upload->in_flight == 0)
+      g_task_return_error (task, g_steal_pointer (&upload->error));
+    return;
+  }
+
+  while (upload->next_encode < upload->n_chunks &&
+         upload->encoding + upload->ready < MAX_CHUNKS_AHEAD)
+    batch_upload_encode_chunk (task);
+
+  /* Records of the next server batch wait for the commit of this one. */
+  if (upload->starting || upload->committing)
+    return;
+
+  if (!upload->batch_id) {
+    if (upload->next_post == upload->n_chunks) {
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+    /* The chunk starting a server batch has to return its id first. */
+    if (upload->bodies[upload->next_post])
+      batch_upload_post_chunk (task);
+    return;
+  }
+
+  while (upload->next_post < upload->batch_end &&
+         upload->in_flight < MAX_REQUESTS_IN_FLIGHT &&
+         upload->bodies[upload->next_post])
+    batch_upload_post_chunk (task);
+
+  if (upload->next_post == upload->batch_end && upload->in_flight == 0)
+    batch_upload_commit (task);
+}
+
+/**
+ * ephy_sync_batch_upload_async:
+ * @source_object: the object passed to @request_func
+ * @request_func: function that sends storage requests
+ * @collection: the name of the collection to upload to
+ * @records: (element-type EphySyncBatchRecord): the records to upload
+ * @bundle: (transfer full): the key bundle of @collection
+ * @unmodified_since: the timestamp of @collection when it was downloaded,
+ *   or -1 to not check it
+ * @callback: called when every record is committed or the upload failed
+ * @user_data: data for @callback
+ *
+ * Encrypts @records on worker threads and uploads them with the batch API
+ * of Sync 1.5, keeping several POST requests in flight at once.
+ *
+ * Each commit carries X-If-Unmodified-Since with the latest timestamp of
+ * the collection, so a commit fails rather than overwrite changes that
+ * other clients made in the meantime. If a request fails, the server batch
+ * it belongs to is not committed and no further records are uploaded.
+ **/
+void
+ephy_sync_batch_upload_async (GObject                    *source_object,
+                              EphySyncStorageRequestFunc  request_func,
+                              const char                 *collection,
+                              GPtrArray                  *records,
+                              SyncCryptoKeyBundle        *bundle,
+                              gint64                      unmodified_since,
+                              GAsyncReadyCallback         callback,
+                              gpointer                    user_data)
+{
+  BatchUpload *upload;
+  GTask *task;
+
+  g_assert (G_IS_OBJECT (source_object));
+  g_assert (request_func);
+  g_assert (collection);
+  g_assert (records);
+  g_assert (bundle);
+
+  upload = g_new0 (BatchUpload, 1);
+  upload->source_object = g_object_ref (source_object);
+  upload->request_func = request_func;
+  upload->collection = g_strdup (collection);
+  upload->records = g_ptr_array_ref (records);
+  upload->bundle = bundle;
+  upload->unmodified_since = unmodified_since;
+  upload->last_modified = -1;
+  upload->n_chunks = (records->len + EPHY_SYNC_BATCH_SIZE - 1) / EPHY_SYNC_BATCH_SIZE;
+  upload->bodies = g_new0 (char *, upload->n_chunks);
+
+  task = g_task_new (NULL, NULL, callback, user_data);
+  g_task_set_source_tag (task, ephy_sync_batch_upload_async);
+  g_task_set_task_data (task, upload, (GDestroyNotify)batch_upload_free);
+
+  batch_upload_pump (task);
+  g_object_unref (task);
+}
+
+/**
+ * ephy_sync_batch_upload_finish:
+ * @result: a #GAsyncResult
+ * @last_modified: (out): the timestamp of the collection after the last
+ *   successful commit, or -1 if nothing was committed
+ * @error: return location for a #GError
+ *
+ * Returns: %TRUE if every record was committed
+ **/
+gboolean
+ephy_sync_batch_upload_finish (GAsyncResult  *result,
+                               gint64        *last_modified,
+                               GError       **error)
+{
+  BatchUpload *upload;
+
+  g_assert (g_task_is_valid (result, NULL));
+
+  upload = g_task_get_task_data (G_TASK (result));
+  if (last_modified)
+    *last_modified = upload->last_modified;
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
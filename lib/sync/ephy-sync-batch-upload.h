@@ -0,0 +1,64 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ephy-sync-crypto.h"
+
+#include <gio/gio.h>
+#include <json-glib/json-glib.h>
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+/* Sends a request to the storage server, relative to its endpoint. */
+typedef void (*EphySyncStorageRequestFunc) (GObject             *source_object,
+                                            const char          *endpoint,
+                                            const char          *method,
+                                            const char          *request_body,
+                                            gint64               unmodified_since,
+                                            SoupSessionCallback  callback,
+                                            gpointer             user_data);
+
+/* Either @cleartext, which the upload encrypts, or a ready @bso. */
+typedef struct {
+  char *id;
+  char *cleartext;
+  JsonNode *bso;
+} EphySyncBatchRecord;
+
+EphySyncBatchRecord *ephy_sync_batch_record_new          (const char                 *id,
+                                                          const char                 *cleartext);
+EphySyncBatchRecord *ephy_sync_batch_record_new_from_bso (JsonNode                   *bso);
+void                 ephy_sync_batch_record_free         (EphySyncBatchRecord        *record);
+
+void                 ephy_sync_batch_upload_async        (GObject                    *source_object,
+                                                          EphySyncStorageRequestFunc  request_func,
+                                                          const char                 *collection,
+                                                          GPtrArray                  *records,
+                                                          SyncCryptoKeyBundle        *bundle,
+                                                          gint64                      unmodified_since,
+                                                          GAsyncReadyCallback         callback,
+                                                          gpointer                    user_data);
+gboolean             ephy_sync_batch_upload_finish       (GAsyncResult               *result,
+                                                          gint64                     *last_modified,
+                                                          GError                    **error);
+
+G_END_DECLS
@@ -0,0 +1,509 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ephy-sync-collection-download.h"
+
+#include "ephy-debug.h"
+#include "ephy-sync-utils.h"
+#include "ephy-synchronizable.h"
+#include "ephy-trace.h"
+
+#include <inttypes.h>
+#include <json-glib/json-glib.h>
+#include <math.h>
+
+typedef struct {
+  GList *remotes_deleted;
+  GList *remotes_updated;
+} CollectionPage;
+
+typedef struct {
+  GBytes              *body;
+  GType                type;
+  SyncCryptoKeyBundle *bundle;
+} DecodePageData;
+
+typedef struct {
+  GObject                    *source_object;
+  EphySyncStorageRequestFunc  request_func;
+  EphySynchronizableManager  *manager;
+  SyncCryptoKeyBundle        *bundle;
+  gboolean                    is_initial;
+  gint64                      newer;
+  /* Server timestamp of the first page. Later pages are requested with
+   * X-If-Unmodified-Since so that they belong to the same snapshot. */
+  gint64                      last_modified;
+  gboolean                    request_pending;
+  gboolean                    download_done;
+  guint                       pages_decoding;
+  GQueue                     *pages;
+  CollectionPage             *merging_page;
+  gboolean                    is_merging;
+  gboolean                    is_merged;
+  GList                      *remotes_deleted;
+  GList                      *remotes_updated;
+  /* Uploads are held back until the whole collection is downloaded, or the
+   * server would reject the remaining pages as modified. */
+  GPtrArray                  *to_upload;
+  GHashTable                 *to_upload_ids;
+  GError                     *error;
+  /* Merges may call back synchronously, so the task can be finished from
+   * within a callback that then tries to finish it again. */
+  gboolean                    is_finished;
+  /* Trace start times of the pending request and the running merge. */
+  gint64                      request_begin;
+  gint64                      merge_begin;
+} CollectionDownload;
+
+static void collection_download_request_page (GTask      *task,
+                                              const char *offset);
+static void collection_download_merge_next (GTask *task);
+
+static void
+collection_page_free (CollectionPage *page)
+{
+  g_assert (page);
+
+  g_list_free_full (page->remotes_deleted, g_object_unref);
+  g_list_free_full (page->remotes_updated, g_object_unref);
+  g_free (page);
+}
+
+static void
+decode_page_data_free (DecodePageData *data)
+{
+  g_assert (data);
+
+  g_bytes_unref (data->body);
+  ephy_sync_crypto_key_bundle_unref (data->bundle);
+  g_free (data);
+}
+
+static void
+collection_download_free (CollectionDownload *download)
+{
+  g_object_unref (download->source_object);
+  g_object_unref (download->manager);
+  ephy_sync_crypto_key_bundle_unref (download->bundle);
+  g_queue_free_full (download->pages, (GDestroyNotify)collection_page_free);
+  if (download->merging_page)
+    collection_page_free (download->merging_page);
+  g_list_free_full (download->remotes_deleted, g_object_unref);
+  g_list_free_full (download->remotes_updated, g_object_unref);
+  g_ptr_array_unref (download->to_upload);
+  g_hash_table_unref (download->to_upload_ids);
+  g_clear_error (&download->error);
+  g_free (download);
+}
+
+static void
+collection_download_fail (CollectionDownload *download,
+                          GError             *error)
+{
+  /* Only the first failure is reported. */
+  if (download->error)
+    g_error_free (error);
+  else
+    download->error = error;
+}
+
+static void
+collection_download_maybe_finish (GTask *task)
+{
+  CollectionDownload *download = g_task_get_task_data (task);
+
+  if (download->is_finished)
+    return;
+
+  if (!download->download_done || download->request_pending ||
+      download->pages_decoding > 0 || download->is_merging ||
+      !g_queue_is_empty (download->pages))
+    return;
+
+  /* The initial merge decides what to upload by looking at the whole remote
+   * collection, so it only runs once every page has been decoded. A partial
+   * download is discarded and retried on the next sync. */
+  if (download->is_initial && !download->error && !download->is_merged) {
+    collection_download_merge_next (task);
+    return;
+  }
+
+  download->is_finished = TRUE;
+  if (download->error)
+    g_task_return_error (task, g_error_copy (download->error));
+  else
+    g_task_return_pointer (task, g_ptr_array_ref (download->to_upload),
+                           (GDestroyNotify)g_ptr_array_unref);
+}
+
+static void
+merge_finished_cb (GPtrArray *to_upload,
+                   gpointer   user_data)
+{
+  GTask *task = user_data;
+  CollectionDownload *download = g_task_get_task_data (task);
+
+  EPHY_TRACE_END (download->merge_begin, EPHY_TRACE_SYNC, "merge");
+
+  for (guint i = 0; to_upload && i < to_upload->len; i++) {
+    EphySynchronizable *synchronizable = g_ptr_array_index (to_upload, i);
+    const char *id = ephy_synchronizable_get_id (synchronizable);
+
+    /* Managers may report the same object again for later pages. */
+    if (g_hash_table_contains (download->to_upload_ids, id))
+      continue;
+
+    g_hash_table_add (download->to_upload_ids, g_strdup (id));
+    g_ptr_array_add (download->to_upload, g_object_ref (synchronizable));
+  }
+
+  if (to_upload)
+    g_ptr_array_unref (to_upload);
+
+  g_clear_pointer (&download->merging_page, collection_page_free);
+  download->is_merging = FALSE;
+
+  collection_download_merge_next (task);
+  collection_download_maybe_finish (task);
+  g_object_unref (task);
+}
+
+static void
+collection_download_merge_next (GTask *task)
+{
+  CollectionDownload *download = g_task_get_task_data (task);
+  const char *collection = ephy_synchronizable_manager_get_collection_name (download->manager);
+
+  if (download->is_merging)
+    return;
+
+  if (download->is_initial) {
+    if (download->is_merged)
+      return;
+
+    LOG ("Found %u deleted objects and %u new/updated objects in %s collection",
+         g_list_length (download->remotes_deleted),
+         g_list_length (download->remotes_updated),
+         collection);
+
+    download->is_merging = TRUE;
+    download->is_merged = TRUE;
+    download->merge_begin = ephy_trace_now ();
+    ephy_synchronizable_manager_merge (download->manager, TRUE,
+                                       download->remotes_deleted, download->remotes_updated,
+                                       merge_finished_cb, g_object_ref (task));
+    return;
+  }
+
+  if (g_queue_is_empty (download->pages))
+    return;
+
+  download->merging_page = g_queue_pop_head (download->pages);
+  download->is_merging = TRUE;
+  download->merge_begin = ephy_trace_now ();
+
+  LOG ("Merging %u deleted objects and %u new/updated objects in %s collection",
+       g_list_length (download->merging_page->remotes_deleted),
+       g_list_length (download->merging_page->remotes_updated),
+       collection);
+
+  ephy_synchronizable_manager_merge (download->manager, FALSE,
+                                     download->merging_page->remotes_deleted,
+                                     download->merging_page->remotes_updated,
+                                     merge_finished_cb, g_object_ref (task));
+}
+
+static void
+decode_page_thread (GTask        *task,
+                    gpointer      source_object,
+                    gpointer      task_data,
+                    GCancellable *cancellable)
+{
+  DecodePageData *data = task_data;
+  CollectionPage *page;
+  EphySynchronizable *remote;
+  JsonNode *node;
+  JsonArray *array;
+  GPtrArray *payloads;
+  GPtrArray *cleartexts;
+  GArray *modified;
+  GError *error = NULL;
+  gboolean is_deleted;
+  EPHY_TRACE_BEGIN (begin);
+
+  node = json_from_string (g_bytes_get_data (data->body, NULL), &error);
+  if (error) {
+    g_task_return_error (task, error);
+    return;
+  }
+
+  array = json_node_get_array (node);
+  if (!array) {
+    json_node_unref (node);
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             "JSON node does not hold an array");
+    return;
+  }
+
+  /* Collect the payloads first, so that they are decrypted as one vector. */
+  payloads = g_ptr_array_new ();
+  modified = g_array_new (FALSE, FALSE, sizeof (double));
+  for (guint i = 0; i < json_array_get_length (array); i++) {
+    JsonObject *bso = json_array_get_object_element (array, i);
+    const char *payload = bso ? json_object_get_string_member (bso, "payload") : NULL;
+    double server_time_modified = bso ? json_object_get_double_member (bso, "modified") : 0;
+
+    if (!payload || !server_time_modified) {
+      g_warning ("JSON object has missing or invalid members, skipping...");
+      continue;
+    }
+    g_ptr_array_add (payloads, (char *)payload);
+    g_array_append_val (modified, server_time_modified);
+  }
+  cleartexts = ephy_sync_crypto_decrypt_records (payloads, data->bundle);
+
+  page = g_new0 (CollectionPage, 1);
+  for (guint i = 0; i < cleartexts->len; i++) {
+    const char *cleartext = g_ptr_array_index (cleartexts, i);
+
+    remote = NULL;
+    if (cleartext)
+      remote = EPHY_SYNCHRONIZABLE (ephy_synchronizable_from_cleartext (cleartext, data->type,
+                                                                        g_array_index (modified, double, i),
+                                                                        &is_deleted));
+    if (!remote) {
+      g_warning ("Failed to create synchronizable object from BSO, skipping...");
+      continue;
+    }
+    if (is_deleted)
+      page->remotes_deleted = g_list_prepend (page->remotes_deleted, remote);
+    else
+      page->remotes_updated = g_list_prepend (page->remotes_updated, remote);
+  }
+
+  g_ptr_array_unref (cleartexts);
+  g_array_unref (modified);
+  g_ptr_array_unref (payloads);
+  json_node_unref (node);
+  EPHY_TRACE_END (begin, EPHY_TRACE_SYNC, "decode-page");
+  g_task_return_pointer (task, page, (GDestroyNotify)collection_page_free);
+}
+
+static void
+decode_page_cb (GObject      *source_object,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  GTask *task = user_data;
+  CollectionDownload *download = g_task_get_task_data (task);
+  CollectionPage *page;
+  GError *error = NULL;
+
+  download->pages_decoding--;
+
+  page = g_task_propagate_pointer (G_TASK (result), &error);
+  if (error) {
+    collection_download_fail (download, error);
+  } else if (download->is_initial) {
+    download->remotes_deleted = g_list_concat (page->remotes_deleted, download->remotes_deleted);
+    download->remotes_updated = g_list_concat (page->remotes_updated, download->remotes_updated);
+    page->remotes_deleted = NULL;
+    page->remotes_updated = NULL;
+    collection_page_free (page);
+  } else {
+    g_queue_push_tail (download->pages, page);
+    collection_download_merge_next (task);
+  }
+
+  collection_download_maybe_finish (task);
+  g_object_unref (task);
+}
+
+static void
+request_page_cb (SoupSession *session,
+                 SoupMessage *msg,
+                 gpointer     user_data)
+{
+  GTask *task = user_data;
+  CollectionDownload *download = g_task_get_task_data (task);
+  DecodePageData *data;
+  GTask *decode_task;
+  const char *collection;
+  const char *last_modified;
+  const char *next_offset;
+
+  collection = ephy_synchronizable_manager_get_collection_name (download->manager);
+  download->request_pending = FALSE;
+  EPHY_TRACE_END (download->request_begin, EPHY_TRACE_SYNC, "download-page");
+
+  if (msg->status_code != 200) {
+    /* 412 means the collection changed while we were paging through it. */
+    collection_download_fail (download,
+                              g_error_new (G_IO_ERROR, G_IO_ERROR_FAILED,
+                                           "Failed to get records in collection %s. Status code: %u, response: %s",
+                                           collection, msg->status_code, msg->response_body->data));
+    download->download_done = TRUE;
+    collection_download_maybe_finish (task);
+    g_object_unref (task);
+    return;
+  }
+
+  if (download->last_modified < 0) {
+    last_modified = soup_message_headers_get_one (msg->response_headers, "X-Last-Modified");
+    if (last_modified)
+      download->last_modified = ceil (g_ascii_strtod (last_modified, NULL));
+  }
+
+  /* Ask for the next page right away, so that it downloads while this one
+   * is being decrypted. */
+  next_offset = soup_message_headers_get_one (msg->response_headers, "X-Weave-Next-Offset");
+  if (next_offset && !download->error)
+    collection_download_request_page (task, next_offset);
+  else
+    download->download_done = TRUE;
+
+  /* Parsing and decrypting thousands of records takes a while, keep it off
+   * the main thread. */
+  data = g_new (DecodePageData, 1);
+  data->body = g_bytes_new (msg->response_body->data, msg->response_body->length + 1);
+  data->type = ephy_synchronizable_manager_get_synchronizable_type (download->manager);
+  data->bundle = ephy_sync_crypto_key_bundle_ref (download->bundle);
+
+  decode_task = g_task_new (NULL, NULL, decode_page_cb, task);
+  g_task_set_task_data (decode_task, data, (GDestroyNotify)decode_page_data_free);
+  download->pages_decoding++;
+  g_task_run_in_thread (decode_task, decode_page_thread);
+  g_object_unref (decode_task);
+
+  /* The reference held for the request now belongs to the decode task. */
+}
+
+static void
+collection_download_request_page (GTask      *task,
+                                  const char *offset)
+{
+  CollectionDownload *download = g_task_get_task_data (task);
+  GString *endpoint;
+  const char *collection;
+  char *offset_safe;
+
+  collection = ephy_synchronizable_manager_get_collection_name (download->manager);
+  endpoint = g_string_new (NULL);
+  g_string_printf (endpoint, "storage/%s?full=true&sort=oldest&limit=%d",
+                   collection, EPHY_SYNC_DOWNLOAD_PAGE_SIZE);
+  if (!download->is_initial)
+    g_string_append_printf (endpoint, "&newer=%"PRId64, download->newer);
+  if (offset) {
+    offset_safe = soup_uri_encode (offset, "&=+");
+    g_string_append_printf (endpoint, "&offset=%s", offset_safe);
+    g_free (offset_safe);
+  }
+
+  download->request_pending = TRUE;
+  download->request_begin = ephy_trace_now ();
+  download->request_func (download->source_object, endpoint->str, SOUP_METHOD_GET,
+                          NULL, download->last_modified,
+                          request_page_cb, g_object_ref (task));
+
+  g_string_free (endpoint, TRUE);
+}
+
+/**
+ * ephy_sync_collection_download_async:
+ * @source_object: the object passed to @request_func
+ * @request_func: function that sends storage requests
+ * @manager: the #EphySynchronizableManager of the collection
+ * @bundle: (transfer full): the key bundle of the collection
+ * @callback: called when the collection is downloaded and merged, or the
+ *   download failed
+ * @user_data: data for @callback
+ *
+ * Downloads the collection of @manager in pages of
+ * %EPHY_SYNC_DOWNLOAD_PAGE_SIZE records, or only the records newer than its
+ * last sync if this is not the initial sync. The next page is requested as
+ * soon as a page arrives, and pages are decrypted on worker threads.
+ *
+ * On a regular sync, pages are merged into @manager as they arrive, one
+ * merge at a time. The initial merge needs the complete remote collection,
+ * so it only runs once every page has been decoded, and not at all if the
+ * download fails.
+ **/
+void
+ephy_sync_collection_download_async (GObject                    *source_object,
+                                     EphySyncStorageRequestFunc  request_func,
+                                     EphySynchronizableManager  *manager,
+                                     SyncCryptoKeyBundle        *bundle,
+                                     GAsyncReadyCallback         callback,
+                                     gpointer                    user_data)
+{
+  CollectionDownload *download;
+  GTask *task;
+
+  g_assert (G_IS_OBJECT (source_object));
+  g_assert (request_func);
+  g_assert (EPHY_IS_SYNCHRONIZABLE_MANAGER (manager));
+  g_assert (bundle);
+
+  download = g_new0 (CollectionDownload, 1);
+  download->source_object = g_object_ref (source_object);
+  download->request_func = request_func;
+  download->manager = g_object_ref (manager);
+  download->bundle = bundle;
+  download->is_initial = ephy_synchronizable_manager_is_initial_sync (manager);
+  download->newer = ephy_synchronizable_manager_get_sync_time (manager);
+  download->last_modified = -1;
+  download->pages = g_queue_new ();
+  download->to_upload = g_ptr_array_new_with_free_func (g_object_unref);
+  download->to_upload_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  task = g_task_new (NULL, NULL, callback, user_data);
+  g_task_set_source_tag (task, ephy_sync_collection_download_async);
+  g_task_set_task_data (task, download, (GDestroyNotify)collection_download_free);
+
+  collection_download_request_page (task, NULL);
+  g_object_unref (task);
+}
+
+/**
+ * ephy_sync_collection_download_finish:
+ * @result: a #GAsyncResult
+ * @last_modified: (out): the timestamp of the collection on the server,
+ *   or -1 if no page was downloaded
+ * @error: return location for a #GError
+ *
+ * Returns: (transfer full) (element-type EphySynchronizable): the objects
+ *   that the merges asked to upload, or %NULL if the download failed
+ **/
+GPtrArray *
+ephy_sync_collection_download_finish (GAsyncResult  *result,
+                                      gint64        *last_modified,
+                                      GError       **error)
+{
+  CollectionDownload *download;
+
+  g_assert (g_task_is_valid (result, NULL));
+
+  download = g_task_get_task_data (G_TASK (result));
+  if (last_modified)
+    *last_modified = download->last_modified;
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
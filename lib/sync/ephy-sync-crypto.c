@@ -445,6 +445,34 @@ ephy_sync_crypto_rsa_key_pair_free (SyncCryptoRSAKeyPair *key_pair)
   g_free (key_pair);
 }
 
+struct _SyncCryptoKeyBundle {
+  volatile gint ref_count;
+
+  /* Expanded once, then only read. */
+  struct aes256_ctx encrypt_ctx;
+  struct aes256_ctx decrypt_ctx;
+  struct hmac_sha256_ctx hmac_ctx;
+};
+
+static SyncCryptoKeyBundle *
+ephy_sync_crypto_key_bundle_new_from_keys (const guint8 *aes_key,
+                                           const guint8 *hmac_key)
+{
+  SyncCryptoKeyBundle *bundle;
+
+  g_assert (aes_key);
+  g_assert (hmac_key);
+
+  bundle = g_new (SyncCryptoKeyBundle, 1);
+  bundle->ref_count = 1;
+  aes256_set_encrypt_key (&bundle->encrypt_ctx, aes_key);
+  aes256_set_decrypt_key (&bundle->decrypt_ctx, aes_key);
+  /* SHA256 expects a 32 bytes key. */
+  hmac_sha256_set_key (&bundle->hmac_ctx, 32, hmac_key);
+
+  return bundle;
+}
+
 SyncCryptoKeyBundle *
 ephy_sync_crypto_key_bundle_new (const char *aes_key_b64,
                                  const char *hmac_key_b64)
@@ -463,9 +491,7 @@ ephy_sync_crypto_key_bundle_new (const char *aes_key_b64,
   hmac_key = g_base64_decode (hmac_key_b64, &hmac_key_len);
   g_assert (hmac_key_len == 32);
 
-  bundle = g_new (SyncCryptoKeyBundle, 1);
-  bundle->aes_key_hex = ephy_sync_utils_encode_hex (aes_key, aes_key_len);
-  bundle->hmac_key_hex = ephy_sync_utils_encode_hex (hmac_key, hmac_key_len);
+  bundle = ephy_sync_crypto_key_bundle_new_from_keys (aes_key, hmac_key);
 
   g_free (aes_key);
   g_free (hmac_key);
@@ -473,15 +499,23 @@ ephy_sync_crypto_key_bundle_new (const char *aes_key_b64,
   return bundle;
 }
 
-void
-ephy_sync_crypto_key_bundle_free (SyncCryptoKeyBundle *bundle)
+SyncCryptoKeyBundle *
+ephy_sync_crypto_key_bundle_ref (SyncCryptoKeyBundle *bundle)
 {
   g_assert (bundle);
 
-  g_free (bundle->aes_key_hex);
-  g_free (bundle->hmac_key_hex);
+  g_atomic_int_inc (&bundle->ref_count);
 
-  g_free (bundle);
+  return bundle;
+}
+
+void
+ephy_sync_crypto_key_bundle_unref (SyncCryptoKeyBundle *bundle)
+{
+  g_assert (bundle);
+
+  if (g_atomic_int_dec_and_test (&bundle->ref_count))
+    g_free (bundle);
 }
 
 static char *
@@ -758,6 +792,7 @@ ephy_sync_crypto_derive_master_bundle (const guint8 *key)
   guint8 *prk;
   guint8 *tmp;
   guint8 *aes_key;
+  guint8 *hmac_key;
   char *prk_hex;
   char *aes_key_hex;
   char *hmac_key_hex;
@@ -790,12 +825,14 @@ ephy_sync_crypto_derive_master_bundle (const guint8 *key)
                                           prk, len,
                                           tmp, len + strlen (info) + 1);
 
-  bundle = g_new (SyncCryptoKeyBundle, 1);
-  bundle->aes_key_hex = g_strdup (aes_key_hex);
-  bundle->hmac_key_hex = g_strdup (hmac_key_hex);
+  hmac_key = ephy_sync_utils_decode_hex (hmac_key_hex);
+
+  bundle = ephy_sync_crypto_key_bundle_new_from_keys (aes_key, hmac_key);
 
+  g_free (hmac_key);
   g_free (hmac_key_hex);
   g_free (tmp);
+  g_free (aes_key);
   g_free (aes_key_hex);
   g_free (prk);
   g_free (prk_hex);
@@ -934,27 +971,28 @@ ephy_sync_crypto_pad (const char *text,
 }
 
 static guint8 *
-ephy_sync_crypto_aes_256_encrypt (const char   *text,
-                                  const guint8 *key,
-                                  const guint8 *iv,
-                                  gsize        *out_len)
+ephy_sync_crypto_aes_256_encrypt (const char               *text,
+                                  const struct aes256_ctx  *ctx,
+                                  const guint8             *iv,
+                                  gsize                    *out_len)
 {
   guint8 *padded;
   guint8 *encrypted;
+  guint8 iv_copy[IV_LEN];
   gsize padded_len;
-  struct CBC_CTX(struct aes256_ctx, AES_BLOCK_SIZE) ctx;
 
   g_assert (text);
-  g_assert (key);
+  g_assert (ctx);
   g_assert (iv);
   g_assert (out_len);
 
   padded = ephy_sync_crypto_pad (text, AES_BLOCK_SIZE, &padded_len);
   encrypted = g_malloc (padded_len);
 
-  aes256_set_encrypt_key(&ctx.ctx, key);
-  CBC_SET_IV(&ctx, iv);
-  CBC_ENCRYPT(&ctx, aes256_encrypt, padded_len, encrypted, padded);
+  /* CBC updates the IV as it goes, the cipher context is left untouched. */
+  memcpy (iv_copy, iv, IV_LEN);
+  cbc_encrypt (ctx, (nettle_cipher_func *)aes256_encrypt, AES_BLOCK_SIZE,
+               iv_copy, padded_len, encrypted, padded);
 
   *out_len = padded_len;
   g_free (padded);
@@ -962,9 +1000,28 @@ ephy_sync_crypto_aes_256_encrypt (const char   *text,
   return encrypted;
 }
 
-char *
-ephy_sync_crypto_encrypt_record (const char          *cleartext,
-                                 SyncCryptoKeyBundle *bundle)
+static char *
+ephy_sync_crypto_compute_hmac (const char          *text,
+                               SyncCryptoKeyBundle *bundle)
+{
+  struct hmac_sha256_ctx ctx;
+  guint8 digest[SHA256_DIGEST_SIZE];
+
+  g_assert (text);
+  g_assert (bundle);
+
+  /* Start from the keyed state instead of hashing the key again. */
+  ctx = bundle->hmac_ctx;
+  hmac_sha256_update (&ctx, strlen (text), (const guint8 *)text);
+  hmac_sha256_digest (&ctx, SHA256_DIGEST_SIZE, digest);
+
+  return ephy_sync_utils_encode_hex (digest, SHA256_DIGEST_SIZE);
+}
+
+static char *
+ephy_sync_crypto_encrypt_record_with_iv (const char          *cleartext,
+                                         SyncCryptoKeyBundle *bundle,
+                                         const guint8        *iv)
 {
   JsonNode *node;
   JsonObject *object;
@@ -972,32 +1029,19 @@ ephy_sync_crypto_encrypt_record (const char          *cleartext,
   char *iv_b64;
   char *ciphertext_b64;
   char *hmac;
-  guint8 *aes_key;
-  guint8 *hmac_key;
   guint8 *ciphertext;
-  guint8 *iv;
   gsize ciphertext_len;
 
   g_assert (cleartext);
   g_assert (bundle);
-
-  /* Get the encryption key and the HMAC key. */
-  aes_key = ephy_sync_utils_decode_hex (bundle->aes_key_hex);
-  hmac_key = ephy_sync_utils_decode_hex (bundle->hmac_key_hex);
-
-  /* Generate a random 16 bytes initialization vector. */
-  iv = g_malloc (IV_LEN);
-  ephy_sync_utils_generate_random_bytes (NULL, IV_LEN, iv);
+  g_assert (iv);
 
   /* Encrypt the record using the AES key. */
-  ciphertext = ephy_sync_crypto_aes_256_encrypt (cleartext, aes_key,
+  ciphertext = ephy_sync_crypto_aes_256_encrypt (cleartext, &bundle->encrypt_ctx,
                                                  iv, &ciphertext_len);
   ciphertext_b64 = g_base64_encode (ciphertext, ciphertext_len);
   iv_b64 = g_base64_encode (iv, IV_LEN);
-  /* SHA256 expects a 32 bytes key. */
-  hmac = g_compute_hmac_for_string (G_CHECKSUM_SHA256,
-                                    hmac_key, 32,
-                                    ciphertext_b64, -1);
+  hmac = ephy_sync_crypto_compute_hmac (ciphertext_b64, bundle);
 
   node = json_node_new (JSON_NODE_OBJECT);
   object = json_object_new ();
@@ -1013,27 +1057,38 @@ ephy_sync_crypto_encrypt_record (const char          *cleartext,
   g_free (iv_b64);
   g_free (ciphertext_b64);
   g_free (ciphertext);
-  g_free (iv);
-  g_free (aes_key);
-  g_free (hmac_key);
 
   return payload;
 }
 
+char *
+ephy_sync_crypto_encrypt_record (const char          *cleartext,
+                                 SyncCryptoKeyBundle *bundle)
+{
+  guint8 iv[IV_LEN];
+
+  g_assert (cleartext);
+  g_assert (bundle);
+
+  /* Generate a random 16 bytes initialization vector. */
+  ephy_sync_utils_generate_random_bytes (NULL, IV_LEN, iv);
+
+  return ephy_sync_crypto_encrypt_record_with_iv (cleartext, bundle, iv);
+}
+
 static gboolean
-ephy_sync_crypto_hmac_is_valid (const char   *text,
-                                const guint8 *key,
-                                const char   *expected)
+ephy_sync_crypto_hmac_is_valid (const char          *text,
+                                SyncCryptoKeyBundle *bundle,
+                                const char          *expected)
 {
   char *hmac;
   gboolean retval;
 
   g_assert (text);
-  g_assert (key);
+  g_assert (bundle);
   g_assert (expected);
 
-  /* SHA256 expects a 32 bytes key. */
-  hmac = g_compute_hmac_for_string (G_CHECKSUM_SHA256, key, 32, text, -1);
+  hmac = ephy_sync_crypto_compute_hmac (text, bundle);
   retval = g_strcmp0 (hmac, expected) == 0;
   g_free (hmac);
 
@@ -1063,24 +1118,22 @@ ephy_sync_crypto_unpad (const guint8 *data,
 }
 
 static char *
-ephy_sync_crypto_aes_256_decrypt (const guint8 *data,
-                                  gsize         data_len,
-                                  const guint8 *key,
-                                  const guint8 *iv)
+ephy_sync_crypto_aes_256_decrypt (const guint8             *data,
+                                  gsize                     data_len,
+                                  const struct aes256_ctx  *ctx,
+                                  guint8                   *iv)
 {
   guint8 *decrypted;
   char *unpadded;
-  struct CBC_CTX(struct aes256_ctx, AES_BLOCK_SIZE) ctx;
 
   g_assert (data);
-  g_assert (key);
+  g_assert (ctx);
   g_assert (iv);
 
   decrypted = g_malloc (data_len);
 
-  aes256_set_decrypt_key (&ctx.ctx, key);
-  CBC_SET_IV (&ctx, iv);
-  CBC_DECRYPT (&ctx, aes256_decrypt, data_len, decrypted, data);
+  cbc_decrypt (ctx, (nettle_cipher_func *)aes256_decrypt, AES_BLOCK_SIZE,
+               iv, data_len, decrypted, data);
 
   unpadded = ephy_sync_crypto_unpad (decrypted, data_len, AES_BLOCK_SIZE);
   g_free (decrypted);
@@ -1095,8 +1148,6 @@ ephy_sync_crypto_decrypt_record (const char          *payload,
   JsonNode *node = NULL;
   JsonObject *json = NULL;
   GError *error = NULL;
-  guint8 *aes_key = NULL;
-  guint8 *hmac_key = NULL;
   guint8 *ciphertext = NULL;
   guint8 *iv = NULL;
   char *cleartext = NULL;
@@ -1128,14 +1179,10 @@ ephy_sync_crypto_decrypt_record (const char          *payload,
     goto out;
   }
 
-  /* Get the encryption key and the HMAC key. */
-  aes_key = ephy_sync_utils_decode_hex (bundle->aes_key_hex);
-  hmac_key = ephy_sync_utils_decode_hex (bundle->hmac_key_hex);
-
   /* Under no circumstances should a client try to decrypt a record
    * if the HMAC verification fails.
    */
-  if (!ephy_sync_crypto_hmac_is_valid (ciphertext_b64, hmac_key, hmac)) {
+  if (!ephy_sync_crypto_hmac_is_valid (ciphertext_b64, bundle, hmac)) {
     g_warning ("Incorrect HMAC value");
     goto out;
   }
@@ -1143,14 +1190,16 @@ ephy_sync_crypto_decrypt_record (const char          *payload,
   /* Finally, decrypt the record. */
   ciphertext = g_base64_decode (ciphertext_b64, &ciphertext_len);
   iv = g_base64_decode (iv_b64, &iv_len);
+  if (iv_len != IV_LEN || ciphertext_len == 0 || ciphertext_len % AES_BLOCK_SIZE != 0) {
+    g_warning ("Ciphertext or IV have an invalid length");
+    goto out;
+  }
   cleartext = ephy_sync_crypto_aes_256_decrypt (ciphertext, ciphertext_len,
-                                                aes_key, iv);
+                                                &bundle->decrypt_ctx, iv);
 
 out:
   g_free (ciphertext);
   g_free (iv);
-  g_free (aes_key);
-  g_free (hmac_key);
   if (node)
     json_node_unref (node);
   if (error)
@@ -1158,3 +1207,170 @@ out:
 
   return cleartext;
 }
+
+/* Records are handed to the worker pool in slices of this size. Vectors up
+ * to one slice are processed on the calling thread.
+ */
+#define RECORDS_PER_JOB 64
+
+typedef struct {
+  GMutex mutex;
+  GCond cond;
+  guint pending;
+} CryptoBatch;
+
+typedef struct {
+  CryptoBatch *batch;
+  SyncCryptoKeyBundle *bundle;
+  gboolean encrypt;
+  char **in;
+  char **out;
+  guint len;
+} CryptoJob;
+
+static void
+crypto_job_run (CryptoJob *job)
+{
+  guint8 *ivs = NULL;
+
+  if (job->encrypt) {
+    /* Read the IVs of the whole slice at once. */
+    ivs = g_malloc (IV_LEN * job->len);
+    ephy_sync_utils_generate_random_bytes (NULL, IV_LEN * job->len, ivs);
+  }
+
+  for (guint i = 0; i < job->len; i++) {
+    if (job->encrypt)
+      job->out[i] = ephy_sync_crypto_encrypt_record_with_iv (job->in[i], job->bundle,
+                                                             ivs + i * IV_LEN);
+    else
+      job->out[i] = ephy_sync_crypto_decrypt_record (job->in[i], job->bundle);
+  }
+
+  g_free (ivs);
+}
+
+static void
+crypto_worker_func (gpointer data,
+                    gpointer user_data)
+{
+  CryptoJob *job = data;
+  CryptoBatch *batch = job->batch;
+
+  crypto_job_run (job);
+
+  g_mutex_lock (&batch->mutex);
+  if (--batch->pending == 0)
+    g_cond_signal (&batch->cond);
+  g_mutex_unlock (&batch->mutex);
+}
+
+static GThreadPool *
+crypto_worker_pool (void)
+{
+  static gsize pool = 0;
+
+  if (g_once_init_enter (&pool)) {
+    GThreadPool *new_pool = g_thread_pool_new (crypto_worker_func, NULL,
+                                               g_get_num_processors (),
+                                               FALSE, NULL);
+    g_once_init_leave (&pool, (gsize)new_pool);
+  }
+
+  return (GThreadPool *)pool;
+}
+
+static GPtrArray *
+ephy_sync_crypto_process_records (GPtrArray           *in,
+                                  SyncCryptoKeyBundle *bundle,
+                                  gboolean             encrypt)
+{
+  GPtrArray *out;
+  CryptoBatch batch;
+  CryptoJob *jobs;
+  guint n_jobs;
+
+  out = g_ptr_array_new_full (in->len, g_free);
+  g_ptr_array_set_size (out, in->len);
+  if (in->len == 0)
+    return out;
+
+  n_jobs = (in->len + RECORDS_PER_JOB - 1) / RECORDS_PER_JOB;
+  jobs = g_new (CryptoJob, n_jobs);
+  g_mutex_init (&batch.mutex);
+  g_cond_init (&batch.cond);
+  batch.pending = n_jobs - 1;
+
+  for (guint i = 0; i < n_jobs; i++) {
+    guint offset = i * RECORDS_PER_JOB;
+
+    jobs[i].batch = &batch;
+    jobs[i].bundle = bundle;
+    jobs[i].encrypt = encrypt;
+    jobs[i].in = (char **)in->pdata + offset;
+    jobs[i].out = (char **)out->pdata + offset;
+    jobs[i].len = MIN (RECORDS_PER_JOB, in->len - offset);
+  }
+
+  /* The calling thread takes the first slice rather than sit idle. */
+  for (guint i = 1; i < n_jobs; i++)
+    g_thread_pool_push (crypto_worker_pool (), &jobs[i], NULL);
+  crypto_job_run (&jobs[0]);
+
+  g_mutex_lock (&batch.mutex);
+  while (batch.pending > 0)
+    g_cond_wait (&batch.cond, &batch.mutex);
+  g_mutex_unlock (&batch.mutex);
+
+  g_mutex_clear (&batch.mutex);
+  g_cond_clear (&batch.cond);
+  g_free (jobs);
+
+  return out;
+}
+
+/**
+ * ephy_sync_crypto_encrypt_records:
+ * @cleartexts: (element-type utf8): the cleartexts to encrypt
+ * @bundle: a %SyncCryptoKeyBundle holding the encryption key and the HMAC key
+ *
+ * Encrypts each of @cleartexts into a BSO payload, like
+ * ephy_sync_crypto_encrypt_record() does. Large vectors are split across a
+ * pool of worker threads. This blocks until every record is done, so it is
+ * meant to be called from a thread of its own.
+ *
+ * Return value: (transfer full) (element-type utf8): the payloads, in the
+ *               same order as @cleartexts
+ **/
+GPtrArray *
+ephy_sync_crypto_encrypt_records (GPtrArray           *cleartexts,
+                                  SyncCryptoKeyBundle *bundle)
+{
+  g_assert (cleartexts);
+  g_assert (bundle);
+
+  return ephy_sync_crypto_process_records (cleartexts, bundle, TRUE);
+}
+
+/**
+ * ephy_sync_crypto_decrypt_records:
+ * @payloads: (element-type utf8): the BSO payloads to decrypt
+ * @bundle: a %SyncCryptoKeyBundle holding the encryption key and the HMAC key
+ *
+ * Decrypts each of @payloads, like ephy_sync_crypto_decrypt_record() does.
+ * Large vectors are split across a pool of worker threads. This blocks until
+ * every record is done, so it is meant to be called from a thread of its own.
+ *
+ * Return value: (transfer full) (element-type utf8): the cleartexts, in the
+ *               same order as @payloads; %NULL for payloads that could not
+ *               be decrypted
+ **/
+GPtrArray *
+ephy_sync_crypto_decrypt_records (GPtrArray           *payloads,
+                                  SyncCryptoKeyBundle *bundle)
+{
+  g_assert (payloads);
+  g_assert (bundle);
+
+  return ephy_sync_crypto_process_records (payloads, bundle, FALSE);
+}
@@ -60,10 +60,10 @@ typedef struct {
   struct rsa_private_key private;
 } SyncCryptoRSAKeyPair;
 
-typedef struct {
-  char *aes_key_hex;
-  char *hmac_key_hex;
-} SyncCryptoKeyBundle;
+/* Holds the expanded AES and HMAC keys of a collection. It is immutable
+ * once created, so it may be shared between threads.
+ */
+typedef struct _SyncCryptoKeyBundle SyncCryptoKeyBundle;
 
 SyncCryptoHawkOptions *ephy_sync_crypto_hawk_options_new        (const char *app,
                                                                  const char *dlg,
@@ -89,7 +89,8 @@ void                   ephy_sync_crypto_rsa_key_pair_free       (SyncCryptoRSAKe
 
 SyncCryptoKeyBundle   *ephy_sync_crypto_key_bundle_new          (const char *aes_key_b64,
                                                                  const char *hmac_key_b64);
-void                   ephy_sync_crypto_key_bundle_free         (SyncCryptoKeyBundle *bundle);
+SyncCryptoKeyBundle   *ephy_sync_crypto_key_bundle_ref          (SyncCryptoKeyBundle *bundle);
+void                   ephy_sync_crypto_key_bundle_unref        (SyncCryptoKeyBundle *bundle);
 
 void                   ephy_sync_crypto_derive_session_token    (const char  *session_token,
                                                                  guint8     **token_id,
@@ -118,5 +119,9 @@ char                  *ephy_sync_crypto_encrypt_record          (const char
                                                                  SyncCryptoKeyBundle *bundle);
 char                  *ephy_sync_crypto_decrypt_record          (const char          *payload,
                                                                  SyncCryptoKeyBundle *bundle);
+GPtrArray             *ephy_sync_crypto_encrypt_records         (GPtrArray           *cleartexts,
+                                                                 SyncCryptoKeyBundle *bundle);
+GPtrArray             *ephy_sync_crypto_decrypt_records         (GPtrArray           *payloads,
+                                                                 SyncCryptoKeyBundle *bundle);
 
 G_END_DECLS
@@ -24,8 +24,11 @@
 #include "ephy-debug.h"
 #include "ephy-notification.h"
 #include "ephy-settings.h"
+#include "ephy-sync-batch-upload.h"
+#include "ephy-sync-collection-download.h"
 #include "ephy-sync-crypto.h"
 #include "ephy-sync-utils.h"
+#include "ephy-trace.h"
 #include "ephy-user-agent.h"
 
 #include <glib/gi18n.h>
@@ -46,6 +49,10 @@ struct _EphySyncService {
   GHashTable  *secrets;
   GSList      *managers;
 
+  /* Collection name -> SyncCryptoKeyBundle, built from key_bundles_source. */
+  GHashTable  *key_bundles;
+  char        *key_bundles_source;
+
   gboolean     locked;
   char        *storage_endpoint;
   char        *storage_credentials_id;
@@ -120,10 +127,8 @@ typedef struct {
 typedef struct {
   EphySyncService           *service;
   EphySynchronizableManager *manager;
-  gboolean                   is_initial;
   gboolean                   is_last;
-  GList                     *remotes_deleted;
-  GList                     *remotes_updated;
+  gint64                     sync_begin;
 } SyncCollectionAsyncData;
 
 typedef struct {
@@ -135,12 +140,8 @@ typedef struct {
 typedef struct {
   EphySyncService           *service;
   EphySynchronizableManager *manager;
-  GPtrArray                 *synchronizables;
-  guint                      start;
-  guint                      end;
-  char                      *batch_id;
-  gboolean                   batch_is_last;
   gboolean                   sync_done;
+  gint64                     upload_begin;
 } BatchUploadAsyncData;
 
 static StorageRequestAsyncData *
@@ -227,7 +228,6 @@ sign_in_async_data_free (SignInAsyncData *data)
 static SyncCollectionAsyncData *
 sync_collection_async_data_new (EphySyncService           *service,
                                 EphySynchronizableManager *manager,
-                                gboolean                   is_initial,
                                 gboolean                   is_last)
 {
   SyncCollectionAsyncData *data;
@@ -235,10 +235,8 @@ sync_collection_async_data_new (EphySyncService           *service,
   data = g_new (SyncCollectionAsyncData, 1);
   data->service = g_object_ref (service);
   data->manager = g_object_ref (manager);
-  data->is_initial = is_initial;
   data->is_last = is_last;
-  data->remotes_deleted = NULL;
-  data->remotes_updated = NULL;
+  data->sync_begin = ephy_trace_now ();
 
   return data;
 }
@@ -250,8 +248,6 @@ sync_collection_async_data_free (SyncCollectionAsyncData *data)
 
   g_object_unref (data->service);
   g_object_unref (data->manager);
-  g_list_free_full (data->remotes_deleted, g_object_unref);
-  g_list_free_full (data->remotes_updated, g_object_unref);
   g_free (data);
 }
 
@@ -284,11 +280,6 @@ sync_async_data_free (SyncAsyncData *data)
 static inline BatchUploadAsyncData *
 batch_upload_async_data_new (EphySyncService           *service,
                              EphySynchronizableManager *manager,
-                             GPtrArray                 *synchronizables,
-                             guint                      start,
-                             guint                      end,
-                             const char                *batch_id,
-                             gboolean                   batch_is_last,
                              gboolean                   sync_done)
 {
   BatchUploadAsyncData *data;
@@ -296,27 +287,12 @@ batch_upload_async_data_new (EphySyncService           *service,
   data = g_new (BatchUploadAsyncData, 1);
   data->service = g_object_ref (service);
   data->manager = g_object_ref (manager);
-  data->synchronizables = g_ptr_array_ref (synchronizables);
-  data->start = start;
-  data->end = end;
-  data->batch_id = g_strdup (batch_id);
-  data->batch_is_last = batch_is_last;
   data->sync_done = sync_done;
+  data->upload_begin = ephy_trace_now ();
 
   return data;
 }
 
-static inline BatchUploadAsyncData *
-batch_upload_async_data_dup (BatchUploadAsyncData *data)
-{
-  g_assert (data);
-
-  return batch_upload_async_data_new (data->service, data->manager,
-                                      data->synchronizables, data->start,
-                                      data->end, data->batch_id,
-                                      data->batch_is_last, data->sync_done);
-}
-
 static inline void
 batch_upload_async_data_free (BatchUploadAsyncData *data)
 {
@@ -324,8 +300,6 @@ batch_upload_async_data_free (BatchUploadAsyncData *data)
 
   g_object_unref (data->service);
   g_object_unref (data->manager);
-  g_ptr_array_unref (data->synchronizables);
-  g_free (data->batch_id);
   g_free (data);
 }
 
@@ -406,6 +380,17 @@ ephy_sync_service_get_key_bundle (EphySyncService *self,
     return NULL;
   }
 
+  /* Bundles are kept until crypto/keys changes. */
+  if (g_strcmp0 (crypto_keys, self->key_bundles_source) != 0) {
+    g_hash_table_remove_all (self->key_bundles);
+    g_free (self->key_bundles_source);
+    self->key_bundles_source = g_strdup (crypto_keys);
+  }
+
+  bundle = g_hash_table_lookup (self->key_bundles, collection);
+  if (bundle)
+    return ephy_sync_crypto_key_bundle_ref (bundle);
+
   node = json_from_string (crypto_keys, &error);
   g_assert (!error);
   json = json_node_get_object (node);
@@ -415,6 +400,8 @@ ephy_sync_service_get_key_bundle (EphySyncService *self,
           json_object_get_array_member (json, "default");
   bundle = ephy_sync_crypto_key_bundle_new (json_array_get_string_element (array, 0),
                                             json_array_get_string_element (array, 1));
+  g_hash_table_insert (self->key_bundles, g_strdup (collection),
+                       ephy_sync_crypto_key_bundle_ref (bundle));
 
   json_node_unref (node);
 
@@ -1150,7 +1137,7 @@ ephy_sync_service_delete_synchronizable (EphySyncService           *self,
   g_free (body);
   json_object_unref (object);
   json_node_unref (node);
-  ephy_sync_crypto_key_bundle_free (bundle);
+  ephy_sync_crypto_key_bundle_unref (bundle);
 }
 
 static void
@@ -1205,7 +1192,7 @@ out:
   if (error)
     g_error_free (error);
   if (bundle)
-    ephy_sync_crypto_key_bundle_free (bundle);
+    ephy_sync_crypto_key_bundle_unref (bundle);
   sync_async_data_free (data);
 }
 
@@ -1316,275 +1303,128 @@ ephy_sync_service_upload_synchronizable (EphySyncService           *self,
   g_free (body);
   g_free (endpoint);
   json_node_unref (bso);
-  ephy_sync_crypto_key_bundle_free (bundle);
-}
-
-static GPtrArray *
-ephy_sync_service_split_into_batches (EphySyncService           *self,
-                                      EphySynchronizableManager *manager,
-                                      GPtrArray                 *synchronizables,
-                                      guint                      start,
-                                      guint                      end)
-{
-  SyncCryptoKeyBundle *bundle;
-  GPtrArray *batches;
-  const char *collection;
-
-  g_assert (EPHY_IS_SYNC_SERVICE (self));
-  g_assert (EPHY_IS_SYNCHRONIZABLE_MANAGER (manager));
-  g_assert (synchronizables);
-
-  collection = ephy_synchronizable_manager_get_collection_name (manager);
-  bundle = ephy_sync_service_get_key_bundle (self, collection);
-  if (!bundle)
-    return NULL;
-
-  batches = g_ptr_array_new_with_free_func (g_free);
-
-  for (guint i = start; i < end; i += EPHY_SYNC_BATCH_SIZE) {
-    JsonNode *node = json_node_new (JSON_NODE_ARRAY);
-    JsonArray *array = json_array_new ();
-
-    for (guint k = i; k < MIN (i + EPHY_SYNC_BATCH_SIZE, end); k++) {
-      EphySynchronizable *synchronizable = g_ptr_array_index (synchronizables, k);
-      JsonNode *bso = ephy_synchronizable_to_bso (synchronizable, bundle);
-      JsonObject *object = json_object_ref (json_node_get_object (bso));
-
-      json_array_add_object_element (array, object);
-      json_node_unref (bso);
-    }
-
-    json_node_take_array (node, array);
-    g_ptr_array_add (batches, json_to_string (node, FALSE));
-    json_node_unref (node);
-  }
-
-  ephy_sync_crypto_key_bundle_free (bundle);
-
-  return batches;
+  ephy_sync_crypto_key_bundle_unref (bundle);
 }
 
 static void
-commit_batch_cb (SoupSession *session,
-                 SoupMessage *msg,
-                 gpointer     user_data)
+batch_upload_request (GObject             *source_object,
+                      const char          *endpoint,
+                      const char          *method,
+                      const char          *request_body,
+                      gint64               unmodified_since,
+                      SoupSessionCallback  callback,
+                      gpointer             user_data)
 {
-  BatchUploadAsyncData *data = user_data;
-  const char *last_modified;
-
-  if (msg->status_code != 200) {
-    g_warning ("Failed to commit batch. Status code: %u, response: %s",
-               msg->status_code, msg->response_body->data);
-  } else {
-    LOG ("Successfully committed batches");
-    /* Update sync time. */
-    last_modified = soup_message_headers_get_one (msg->response_headers, "X-Last-Modified");
-    ephy_synchronizable_manager_set_sync_time (data->manager, g_ascii_strtod (last_modified, NULL));
-  }
-
-  if (data->sync_done)
-    g_signal_emit (data->service, signals[SYNC_FINISHED], 0);
-  batch_upload_async_data_free (data);
+  ephy_sync_service_queue_storage_request (EPHY_SYNC_SERVICE (source_object),
+                                           endpoint, method, request_body,
+                                           -1, unmodified_since,
+                                           callback, user_data);
 }
 
 static void
-upload_batch_cb (SoupSession *session,
-                 SoupMessage *msg,
-                 gpointer     user_data)
+upload_collection_cb (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
 {
   BatchUploadAsyncData *data = user_data;
-  const char *collection;
-  char *endpoint = NULL;
+  GError *error = NULL;
+  gint64 last_modified;
 
-  /* Note: "202 Accepted" status code. */
-  if (msg->status_code != 202) {
-    g_warning ("Failed to upload batch. Status code: %u, response: %s",
-               msg->status_code, msg->response_body->data);
-  } else {
-    LOG ("Successfully uploaded batch");
+  if (!ephy_sync_batch_upload_finish (result, &last_modified, &error)) {
+    g_warning ("Failed to upload records in collection %s: %s",
+               ephy_synchronizable_manager_get_collection_name (data->manager),
+               error->message);
+    g_error_free (error);
   }
 
-  if (!data->batch_is_last)
-    goto out;
+  /* Batches committed before a failure are on the server nonetheless. */
+  if (last_modified >= 0)
+    ephy_synchronizable_manager_set_sync_time (data->manager, last_modified);
 
-  collection = ephy_synchronizable_manager_get_collection_name (data->manager);
-  endpoint = g_strdup_printf ("storage/%s?commit=true&batch=%s", collection, data->batch_id);
-  ephy_sync_service_queue_storage_request (data->service, endpoint,
-                                           SOUP_METHOD_POST, "[]", -1, -1,
-                                           commit_batch_cb,
-                                           batch_upload_async_data_dup (data));
+  EPHY_TRACE_END (data->upload_begin, EPHY_TRACE_SYNC, "upload");
 
-out:
-  g_free (endpoint);
-  /* Remove last reference to the array with the items to upload. */
-  if (data->batch_is_last)
-    g_ptr_array_unref (data->synchronizables);
+  if (data->sync_done)
+    g_signal_emit (data->service, signals[SYNC_FINISHED], 0);
   batch_upload_async_data_free (data);
 }
 
 static void
-start_batch_upload_cb (SoupSession *session,
-                       SoupMessage *msg,
-                       gpointer     user_data)
+ephy_sync_service_upload_collection (EphySyncService           *self,
+                                     EphySynchronizableManager *manager,
+                                     GPtrArray                 *to_upload,
+                                     gint64                     last_modified,
+                                     gboolean                   is_last)
 {
-  BatchUploadAsyncData *data = user_data;
-  GPtrArray *batches = NULL;
-  JsonNode *node = NULL;
-  JsonObject *object;
-  GError *error = NULL;
+  SyncCryptoKeyBundle *bundle;
+  GPtrArray *records;
   const char *collection;
-  char *endpoint = NULL;
 
-  /* Note: "202 Accepted" status code. */
-  if (msg->status_code != 202) {
-    g_warning ("Failed to start batch upload. Status code: %u, response: %s",
-               msg->status_code, msg->response_body->data);
-    goto out;
+  collection = ephy_synchronizable_manager_get_collection_name (manager);
+  bundle = to_upload->len > 0 ? ephy_sync_service_get_key_bundle (self, collection) : NULL;
+  if (!bundle) {
+    if (is_last)
+      g_signal_emit (self, signals[SYNC_FINISHED], 0);
+    return;
   }
 
-  node = json_from_string (msg->response_body->data, &error);
-  if (error) {
-    g_warning ("Response is not a valid JSON: %s", error->message);
-    g_error_free (error);
-    goto out;
-  }
+  /* The objects live on the main thread, so they are serialized here. The
+   * default to_bso () just encrypts the cleartext, which the batch upload
+   * then does on worker threads. Types with their own to_bso () are
+   * converted here instead. */
+  records = g_ptr_array_new_with_free_func ((GDestroyNotify)ephy_sync_batch_record_free);
+  for (guint i = 0; i < to_upload->len; i++) {
+    EphySynchronizable *synchronizable = g_ptr_array_index (to_upload, i);
+    EphySyncBatchRecord *record;
 
-  object = json_node_get_object (node);
-  data->batch_id = soup_uri_encode (json_object_get_string_member (object, "batch"), NULL);
-  collection = ephy_synchronizable_manager_get_collection_name (data->manager);
-  endpoint = g_strdup_printf ("storage/%s?batch=%s", collection, data->batch_id);
+    if (EPHY_SYNCHRONIZABLE_GET_IFACE (synchronizable)->to_bso == ephy_synchronizable_default_to_bso) {
+      char *cleartext = ephy_synchronizable_to_cleartext (synchronizable);
 
-  batches = ephy_sync_service_split_into_batches (data->service, data->manager,
-                                                  data->synchronizables,
-                                                  data->start, data->end);
-  for (guint i = 0; i < batches->len; i++) {
-    BatchUploadAsyncData *data_dup = batch_upload_async_data_dup (data);
+      record = ephy_sync_batch_record_new (ephy_synchronizable_get_id (synchronizable), cleartext);
+      g_free (cleartext);
+    } else {
+      JsonNode *bso = ephy_synchronizable_to_bso (synchronizable, bundle);
 
-    if (i == batches->len - 1)
-      data_dup->batch_is_last = TRUE;
+      record = ephy_sync_batch_record_new_from_bso (bso);
+      json_node_unref (bso);
+    }
 
-    ephy_sync_service_queue_storage_request (data->service, endpoint, SOUP_METHOD_POST,
-                                             g_ptr_array_index (batches, i), -1, -1,
-                                             upload_batch_cb, data_dup);
+    g_ptr_array_add (records, record);
   }
 
-out:
-  g_free (endpoint);
-  if (node)
-    json_node_unref (node);
-  if (batches)
-    g_ptr_array_unref (batches);
-  batch_upload_async_data_free (data);
+  ephy_sync_batch_upload_async (G_OBJECT (self), batch_upload_request,
+                                collection, records, bundle, last_modified,
+                                upload_collection_cb,
+                                batch_upload_async_data_new (self, manager, is_last));
+  g_ptr_array_unref (records);
 }
 
 static void
-merge_collection_finished_cb (GPtrArray *to_upload,
-                              gpointer   user_data)
+sync_collection_cb (GObject      *source_object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
 {
   SyncCollectionAsyncData *data = user_data;
-  BatchUploadAsyncData *bdata;
-  guint step = EPHY_SYNC_MAX_BATCHES * EPHY_SYNC_BATCH_SIZE;
-  const char *collection;
-  char *endpoint = NULL;
+  GPtrArray *to_upload;
+  GError *error = NULL;
+  gint64 last_modified;
 
-  if (!to_upload || to_upload->len == 0) {
+  to_upload = ephy_sync_collection_download_finish (result, &last_modified, &error);
+  if (!to_upload) {
+    g_warning ("Failed to sync collection %s: %s",
+               ephy_synchronizable_manager_get_collection_name (data->manager),
+               error->message);
+    g_error_free (error);
     if (data->is_last)
       g_signal_emit (data->service, signals[SYNC_FINISHED], 0);
-    goto out;
-  }
-
-  collection = ephy_synchronizable_manager_get_collection_name (data->manager);
-  endpoint = g_strdup_printf ("storage/%s?batch=true", collection);
-
-  for (guint i = 0; i < to_upload->len; i += step) {
-    bdata = batch_upload_async_data_new (data->service, data->manager,
-                                         to_upload, i,
-                                         MIN (i + step, to_upload->len),
-                                         NULL, FALSE,
-                                         data->is_last && i + step >= to_upload->len);
-    ephy_sync_service_queue_storage_request (data->service, endpoint,
-                                             SOUP_METHOD_POST, "[]", -1, -1,
-                                             start_batch_upload_cb, bdata);
-  }
-
-out:
-  g_free (endpoint);
-  sync_collection_async_data_free (data);
-}
-
-static void
-sync_collection_cb (SoupSession *session,
-                    SoupMessage *msg,
-                    gpointer     user_data)
-{
-  SyncCollectionAsyncData *data = (SyncCollectionAsyncData *)user_data;
-  EphySynchronizable *remote;
-  SyncCryptoKeyBundle *bundle = NULL;
-  JsonNode *node = NULL;
-  JsonArray *array = NULL;
-  GError *error = NULL;
-  GType type;
-  const char *collection;
-  gboolean is_deleted;
-
-  collection = ephy_synchronizable_manager_get_collection_name (data->manager);
-
-  if (msg->status_code != 200) {
-    g_warning ("Failed to get records in collection %s. Status code: %u, response: %s",
-               collection, msg->status_code, msg->response_body->data);
-    goto out_error;
-  }
-  node = json_from_string (msg->response_body->data, &error);
-  if (error) {
-    g_warning ("Response is not a valid JSON: %s", error->message);
-    goto out_error;
-  }
-  array = json_node_get_array (node);
-  if (!array) {
-    g_warning ("JSON node does not hold an array");
-    goto out_error;
-  }
-
-  type = ephy_synchronizable_manager_get_synchronizable_type (data->manager);
-  bundle = ephy_sync_service_get_key_bundle (data->service, collection);
-  if (!bundle)
-    goto out_error;
-
-  for (guint i = 0; i < json_array_get_length (array); i++) {
-    remote = EPHY_SYNCHRONIZABLE (ephy_synchronizable_from_bso (json_array_get_element (array, i),
-                                                                type, bundle, &is_deleted));
-    if (!remote) {
-      g_warning ("Failed to create synchronizable object from BSO, skipping...");
-      continue;
-    }
-    if (is_deleted)
-      data->remotes_deleted = g_list_prepend (data->remotes_deleted, remote);
-    else
-      data->remotes_updated = g_list_prepend (data->remotes_updated, remote);
+  } else {
+    ephy_synchronizable_manager_set_is_initial_sync (data->manager, FALSE);
+    ephy_sync_service_upload_collection (data->service, data->manager,
+                                         to_upload, last_modified, data->is_last);
+    g_ptr_array_unref (to_upload);
   }
 
-  LOG ("Found %u deleted objects and %u new/updated objects in %s collection",
-       g_list_length (data->remotes_deleted),
-       g_list_length (data->remotes_updated),
-       collection);
-
-  ephy_synchronizable_manager_set_is_initial_sync (data->manager, FALSE);
-  ephy_synchronizable_manager_merge (data->manager, data->is_initial,
-                                     data->remotes_deleted, data->remotes_updated,
-                                     merge_collection_finished_cb, data);
-  goto out_no_error;
-
-out_error:
-  if (data->is_last)
-    g_signal_emit (data->service, signals[SYNC_FINISHED], 0);
+  EPHY_TRACE_END (data->sync_begin, EPHY_TRACE_SYNC, "collection");
   sync_collection_async_data_free (data);
-out_no_error:
-  if (bundle)
-    ephy_sync_crypto_key_bundle_free (bundle);
-  if (node)
-    json_node_unref (node);
-  if (error)
-    g_error_free (error);
 }
 
 static void
@@ -1592,32 +1432,26 @@ ephy_sync_service_sync_collection (EphySyncService           *self,
                                    EphySynchronizableManager *manager,
                                    gboolean                   is_last)
 {
-  SyncCollectionAsyncData *data;
+  SyncCryptoKeyBundle *bundle;
   const char *collection;
-  char *endpoint;
-  gboolean is_initial;
 
   g_assert (EPHY_IS_SYNC_SERVICE (self));
   g_assert (EPHY_IS_SYNCHRONIZABLE_MANAGER (manager));
   g_assert (ephy_sync_utils_user_is_signed_in ());
 
   collection = ephy_synchronizable_manager_get_collection_name (manager);
-  is_initial = ephy_synchronizable_manager_is_initial_sync (manager);
-
-  if (is_initial) {
-    endpoint = g_strdup_printf ("storage/%s?full=true", collection);
-  } else {
-    endpoint = g_strdup_printf ("storage/%s?newer=%"PRId64"&full=true", collection,
-                                ephy_synchronizable_manager_get_sync_time (manager));
+  bundle = ephy_sync_service_get_key_bundle (self, collection);
+  if (!bundle) {
+    if (is_last)
+      g_signal_emit (self, signals[SYNC_FINISHED], 0);
+    return;
   }
 
-  LOG ("Syncing %s collection %s...", collection, is_initial ? "initial" : "regular");
-  data = sync_collection_async_data_new (self, manager, is_initial, is_last);
-  ephy_sync_service_queue_storage_request (self, endpoint, SOUP_METHOD_GET,
-                                           NULL, -1, -1,
-                                           sync_collection_cb, data);
-
-  g_free (endpoint);
+  LOG ("Syncing %s collection %s...", collection,
+       ephy_synchronizable_manager_is_initial_sync (manager) ? "initial" : "regular");
+  ephy_sync_collection_download_async (G_OBJECT (self), batch_upload_request,
+                                       manager, bundle, sync_collection_cb,
+                                       sync_collection_async_data_new (self, manager, is_last));
 }
 
 static gboolean
@@ -1920,7 +1754,7 @@ ephy_sync_service_upload_client_record (EphySyncService *self)
   g_free (body);
   json_object_unref (bso);
   json_node_unref (node);
-  ephy_sync_crypto_key_bundle_free (bundle);
+  ephy_sync_crypto_key_bundle_unref (bundle);
 }
 
 static void
@@ -1935,6 +1769,7 @@ ephy_sync_service_finalize (GObject *object)
     ephy_sync_crypto_rsa_key_pair_free (self->key_pair);
 
   g_free (self->crypto_keys);
+  g_free (self->key_bundles_source);
   g_slist_free (self->managers);
   g_queue_free_full (self->storage_queue, (GDestroyNotify)storage_request_async_data_free);
   ephy_sync_service_clear_storage_credentials (self);
@@ -1949,6 +1784,7 @@ ephy_sync_service_dispose (GObject *object)
 
   g_clear_object (&self->session);
   g_clear_pointer (&self->secrets, g_hash_table_unref);
+  g_clear_pointer (&self->key_bundles, g_hash_table_unref);
 
   G_OBJECT_CLASS (ephy_sync_service_parent_class)->dispose (object);
 }
@@ -1973,9 +1809,12 @@ ephy_sync_service_constructed (GObject *object)
 static void
 ephy_sync_service_init (EphySyncService *self)
 {
-  self->session = soup_session_new ();
+  /* Batch uploads keep several requests in flight. */
+  self->session = soup_session_new_with_options (SOUP_SESSION_MAX_CONNS_PER_HOST, 4, NULL);
   self->storage_queue = g_queue_new ();
   self->secrets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  self->key_bundles = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify)ephy_sync_crypto_key_bundle_unref);
 
   if (ephy_sync_utils_user_is_signed_in ())
     ephy_sync_service_load_secrets (self);
@@ -2097,7 +1936,7 @@ ephy_sync_service_upload_crypto_keys (EphySyncService *self)
   g_free (kb);
   json_object_unref (record);
   json_node_unref (node);
-  ephy_sync_crypto_key_bundle_free (bundle);
+  ephy_sync_crypto_key_bundle_unref (bundle);
 }
 
 static void
@@ -2162,7 +2001,7 @@ out_error:
                                           NULL, TRUE);
 out_no_error:
   if (bundle)
-    ephy_sync_crypto_key_bundle_free (bundle);
+    ephy_sync_crypto_key_bundle_unref (bundle);
   if (node)
     json_node_unref (node);
   if (error)
@@ -32,6 +32,7 @@ ephy_synchronizable_default_init (EphySynchronizableInterface *iface)
   iface->get_server_time_modified = ephy_synchronizable_get_server_time_modified;
   iface->set_server_time_modified = ephy_synchronizable_set_server_time_modified;
   iface->to_bso = ephy_synchronizable_to_bso;
+  iface->to_cleartext = ephy_synchronizable_default_to_cleartext;
 }
 
 /**
@@ -118,6 +119,84 @@ ephy_synchronizable_to_bso (EphySynchronizable  *synchronizable,
   return iface->to_bso (synchronizable, bundle);
 }
 
+/**
+ * ephy_synchronizable_to_cleartext:
+ * @synchronizable: an #EphySynchronizable
+ *
+ * Converts an #EphySynchronizable into the cleartext payload of its Basic
+ * Storage Object, i.e. what the default to_bso() encrypts. Batched uploads
+ * encrypt it off the main thread for types that keep the default to_bso().
+ *
+ * Return value: (transfer full): @synchronizable's payload as a JSON string
+ **/
+char *
+ephy_synchronizable_to_cleartext (EphySynchronizable *synchronizable)
+{
+  EphySynchronizableInterface *iface;
+
+  g_assert (EPHY_IS_SYNCHRONIZABLE (synchronizable));
+
+  iface = EPHY_SYNCHRONIZABLE_GET_IFACE (synchronizable);
+  return iface->to_cleartext (synchronizable);
+}
+
+/**
+ * ephy_synchronizable_from_cleartext:
+ * @cleartext: the decrypted payload of a Basic Storage Object
+ * @gtype: the #GType of object to construct
+ * @server_time_modified: the %modified field of the Basic Storage Object
+ * @is_deleted: return value for a flag that says whether the object
+ *              was marked as deleted
+ *
+ * Like ephy_synchronizable_from_bso(), but for a payload that was already
+ * decrypted, e.g. by ephy_sync_crypto_decrypt_records().
+ *
+ * Return value: (transfer full): a #GObject or %NULL
+ **/
+GObject *
+ephy_synchronizable_from_cleartext (const char *cleartext,
+                                    GType       gtype,
+                                    double      server_time_modified,
+                                    gboolean   *is_deleted)
+{
+  GObject *object = NULL;
+  GError *error = NULL;
+  JsonNode *node = NULL;
+  JsonObject *json;
+
+  g_assert (cleartext);
+  g_assert (is_deleted);
+
+  node = json_from_string (cleartext, &error);
+  if (error) {
+    g_warning ("Decrypted text is not a valid JSON: %s", error->message);
+    goto out;
+  }
+  json = json_node_get_object (node);
+  if (!json) {
+    g_warning ("Decrypted JSON node does not hold a JSON object");
+    goto out;
+  }
+  *is_deleted = json_object_has_member (json, "deleted");
+
+  object = json_gobject_from_data (gtype, cleartext, -1, &error);
+  if (error) {
+    g_warning ("Failed to create GObject from BSO: %s", error->message);
+    goto out;
+  }
+
+  ephy_synchronizable_set_server_time_modified (EPHY_SYNCHRONIZABLE (object),
+                                                ceil (server_time_modified));
+
+out:
+  if (node)
+    json_node_unref (node);
+  if (error)
+    g_error_free (error);
+
+  return object;
+}
+
 /**
  * ephy_synchronizable_from_bso:
  * @bso: a #JsonNode representing the Basic Storage Object
@@ -146,8 +225,6 @@ ephy_synchronizable_from_bso (JsonNode            *bso,
                               gboolean            *is_deleted)
 {
   GObject *object = NULL;
-  GError *error = NULL;
-  JsonNode *node = NULL;
   JsonObject *json;
   char *serialized = NULL;
   const char *payload = NULL;
@@ -174,32 +251,10 @@ ephy_synchronizable_from_bso (JsonNode            *bso,
     g_warning ("Failed to decrypt the BSO payload");
     goto out;
   }
-  node = json_from_string (serialized, &error);
-  if (error) {
-    g_warning ("Decrypted text is not a valid JSON: %s", error->message);
-    goto out;
-  }
-  json = json_node_get_object (node);
-  if (!json) {
-    g_warning ("Decrypted JSON node does not hold a JSON object");
-    goto out;
-  }
-  *is_deleted = json_object_has_member (json, "deleted");
-
-  object = json_gobject_from_data (gtype, serialized, -1, &error);
-  if (error) {
-    g_warning ("Failed to create GObject from BSO: %s", error->message);
-    goto out;
-  }
-
-  ephy_synchronizable_set_server_time_modified (EPHY_SYNCHRONIZABLE (object),
-                                                ceil (server_time_modified));
+  object = ephy_synchronizable_from_cleartext (serialized, gtype,
+                                               server_time_modified, is_deleted);
 
 out:
-  if (node)
-    json_node_unref (node);
-  if (error)
-    g_error_free (error);
   g_free (serialized);
 
   return object;
@@ -232,7 +287,7 @@ ephy_synchronizable_default_to_bso (EphySynchronizable  *synchronizable,
   g_assert (EPHY_IS_SYNCHRONIZABLE (synchronizable));
   g_assert (bundle);
 
-  serialized = json_gobject_to_data (G_OBJECT (synchronizable), NULL);
+  serialized = ephy_synchronizable_to_cleartext (synchronizable);
   payload = ephy_sync_crypto_encrypt_record (serialized, bundle);
   bso = json_node_new (JSON_NODE_OBJECT);
   object = json_object_new ();
@@ -246,3 +301,21 @@ ephy_synchronizable_default_to_bso (EphySynchronizable  *synchronizable,
 
   return bso;
 }
+
+/**
+ * ephy_synchronizable_default_to_cleartext:
+ * @synchronizable: an #EphySynchronizable
+ *
+ * Calls the default implementation of the #EphySynchronizable
+ * #EphySynchronizableInterface.to_cleartext() virtual function, which
+ * serializes the object's properties through #JsonSerializable.
+ *
+ * Return value: (transfer full): @synchronizable's payload as a JSON string
+ **/
+char *
+ephy_synchronizable_default_to_cleartext (EphySynchronizable *synchronizable)
+{
+  g_assert (EPHY_IS_SYNCHRONIZABLE (synchronizable));
+
+  return json_gobject_to_data (G_OBJECT (synchronizable), NULL);
+}
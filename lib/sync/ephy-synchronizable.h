@@ -40,6 +40,7 @@ struct _EphySynchronizableInterface {
                                             gint64               time_modified);
   JsonNode *   (*to_bso)                   (EphySynchronizable  *synchronizable,
                                             SyncCryptoKeyBundle *bundle);
+  char *       (*to_cleartext)             (EphySynchronizable  *synchronizable);
 };
 
 const char *ephy_synchronizable_get_id                    (EphySynchronizable  *synchronizable);
@@ -48,13 +49,19 @@ void        ephy_synchronizable_set_server_time_modified  (EphySynchronizable  *
                                                            gint64               time_modified);
 JsonNode   *ephy_synchronizable_to_bso                    (EphySynchronizable  *synchronizable,
                                                            SyncCryptoKeyBundle *bundle);
+char       *ephy_synchronizable_to_cleartext              (EphySynchronizable  *synchronizable);
 /* This can't be an interface method because we lack the EphySynchronizable object. */
 GObject    *ephy_synchronizable_from_bso                  (JsonNode            *bso,
                                                            GType                gtype,
                                                            SyncCryptoKeyBundle *bundle,
                                                            gboolean            *is_deleted);
+GObject    *ephy_synchronizable_from_cleartext            (const char          *cleartext,
+                                                           GType                gtype,
+                                                           double               server_time_modified,
+                                                           gboolean            *is_deleted);
 /* Default implementations. */
 JsonNode   *ephy_synchronizable_default_to_bso            (EphySynchronizable  *synchronizable,
                                                            SyncCryptoKeyBundle *bundle);
+char       *ephy_synchronizable_default_to_cleartext      (EphySynchronizable  *synchronizable);
 
 G_END_DECLS
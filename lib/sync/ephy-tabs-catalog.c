@@ -23,10 +23,40 @@
 
 G_DEFINE_INTERFACE (EphyTabsCatalog, ephy_tabs_catalog, G_TYPE_OBJECT);
 
+static guint64
+ephy_tabs_catalog_real_get_version (EphyTabsCatalog *catalog)
+{
+  return 0;
+}
+
+static gboolean
+ephy_tabs_catalog_real_get_changes (EphyTabsCatalog  *catalog,
+                                    guint64           since_version,
+                                    GList           **changes,
+                                    guint64          *version)
+{
+  GList *tabs_info;
+  guint64 id = 0;
+
+  /* Without change tracking, every call is a full snapshot. */
+  tabs_info = ephy_tabs_catalog_get_tabs_info (catalog);
+  *changes = NULL;
+  for (GList *l = tabs_info; l && l->data; l = l->next)
+    *changes = g_list_prepend (*changes, ephy_tab_change_new (++id, l->data));
+  *changes = g_list_reverse (*changes);
+  *version = 0;
+
+  g_list_free (tabs_info);
+
+  return FALSE;
+}
+
 static void
 ephy_tabs_catalog_default_init (EphyTabsCatalogInterface *iface)
 {
   iface->get_tabs_info = ephy_tabs_catalog_get_tabs_info;
+  iface->get_version = ephy_tabs_catalog_real_get_version;
+  iface->get_changes = ephy_tabs_catalog_real_get_changes;
 }
 
 /**
@@ -48,6 +78,60 @@ ephy_tabs_catalog_get_tabs_info (EphyTabsCatalog *catalog)
   return iface->get_tabs_info (catalog);
 }
 
+/**
+ * ephy_tabs_catalog_get_version:
+ * @catalog: an #EphyTabsCatalog
+ *
+ * Returns a number that grows every time a tab of @catalog is opened,
+ * closed, or changes its title, URL or favicon.
+ *
+ * Return value: the current version of @catalog
+ **/
+guint64
+ephy_tabs_catalog_get_version (EphyTabsCatalog *catalog)
+{
+  EphyTabsCatalogInterface *iface;
+
+  g_assert (EPHY_IS_TABS_CATALOG (catalog));
+
+  iface = EPHY_TABS_CATALOG_GET_IFACE (catalog);
+  return iface->get_version (catalog);
+}
+
+/**
+ * ephy_tabs_catalog_get_changes:
+ * @catalog: an #EphyTabsCatalog
+ * @since_version: a version previously returned by @catalog, or 0
+ * @changes: (out) (transfer full): return location for a #GList of
+ *           #EphyTabChange
+ * @version: (out): return location for the version @changes lead to
+ *
+ * Gets the tabs that were opened, changed or closed after @since_version.
+ * Each tab is reported once, with its latest state.
+ *
+ * If @catalog no longer knows what changed since @since_version, @changes
+ * holds every listed tab instead, and the caller should forget the tabs it
+ * knew about before applying them.
+ *
+ * Return value: %TRUE if @changes only holds the changes since
+ *               @since_version, %FALSE if it is a full snapshot
+ **/
+gboolean
+ephy_tabs_catalog_get_changes (EphyTabsCatalog  *catalog,
+                               guint64           since_version,
+                               GList           **changes,
+                               guint64          *version)
+{
+  EphyTabsCatalogInterface *iface;
+
+  g_assert (EPHY_IS_TABS_CATALOG (catalog));
+  g_assert (changes);
+  g_assert (version);
+
+  iface = EPHY_TABS_CATALOG_GET_IFACE (catalog);
+  return iface->get_changes (catalog, since_version, changes, version);
+}
+
 EphyTabInfo *
 ephy_tab_info_new (const char *title,
                    const char *url,
@@ -73,3 +157,26 @@ ephy_tab_info_free (EphyTabInfo *info)
   g_free (info->favicon);
   g_slice_free (EphyTabInfo, info);
 }
+
+EphyTabChange *
+ephy_tab_change_new (guint64      id,
+                     EphyTabInfo *info)
+{
+  EphyTabChange *change;
+
+  change = g_slice_new (EphyTabChange);
+  change->id = id;
+  change->info = info;
+
+  return change;
+}
+
+void
+ephy_tab_change_free (EphyTabChange *change)
+{
+  g_assert (change);
+
+  if (change->info)
+    ephy_tab_info_free (change->info);
+  g_slice_free (EphyTabChange, change);
+}
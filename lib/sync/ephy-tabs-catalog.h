@@ -31,10 +31,20 @@ G_DECLARE_INTERFACE (EphyTabsCatalog, ephy_tabs_catalog, EPHY, TABS_CATALOG, GOb
 struct _EphyTabsCatalogInterface {
   GTypeInterface parent_iface;
 
-  GList * (*get_tabs_info) (EphyTabsCatalog *catalog);
+  GList *  (*get_tabs_info) (EphyTabsCatalog  *catalog);
+  guint64  (*get_version)   (EphyTabsCatalog  *catalog);
+  gboolean (*get_changes)   (EphyTabsCatalog  *catalog,
+                             guint64           since_version,
+                             GList           **changes,
+                             guint64          *version);
 };
 
-GList *ephy_tabs_catalog_get_tabs_info (EphyTabsCatalog *catalog);
+GList    *ephy_tabs_catalog_get_tabs_info (EphyTabsCatalog  *catalog);
+guint64   ephy_tabs_catalog_get_version   (EphyTabsCatalog  *catalog);
+gboolean  ephy_tabs_catalog_get_changes   (EphyTabsCatalog  *catalog,
+                                           guint64           since_version,
+                                           GList           **changes,
+                                           guint64          *version);
 
 typedef struct {
   char *title;
@@ -47,4 +57,13 @@ EphyTabInfo *ephy_tab_info_new  (const char *title,
                                  const char *favicon);
 void         ephy_tab_info_free (EphyTabInfo *info);
 
+typedef struct {
+  guint64 id;
+  EphyTabInfo *info; /* NULL if the tab was closed or is no longer listed. */
+} EphyTabChange;
+
+EphyTabChange *ephy_tab_change_new  (guint64      id,
+                                     EphyTabInfo *info);
+void           ephy_tab_change_free (EphyTabChange *change);
+
 G_END_DECLS
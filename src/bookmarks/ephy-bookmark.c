@@ -309,6 +309,7 @@ ephy_bookmark_set_time_added (EphyBookmark *self,
   g_assert (time_added >= 0);
 
   self->time_added = time_added;
+  g_object_notify_by_pspec (G_OBJECT (self), obj_properties[PROP_TIME_ADDED]);
 }
 
 gint64
@@ -364,6 +365,7 @@ ephy_bookmark_set_id (EphyBookmark *self,
 
   g_free (self->id);
   self->id = g_strdup (id);
+  g_object_notify_by_pspec (G_OBJECT (self), obj_properties[PROP_ID]);
 }
 
 const char *
@@ -617,4 +619,5 @@ ephy_synchronizable_iface_init (EphySynchronizableInterface *iface)
   iface->get_server_time_modified = synchronizable_get_server_time_modified;
   iface->set_server_time_modified = synchronizable_set_server_time_modified;
   iface->to_bso = ephy_synchronizable_default_to_bso;
+  iface->to_cleartext = ephy_synchronizable_default_to_cleartext;
 }
@@ -37,6 +37,58 @@ typedef enum {
   BOOKMARKS_IMPORT_ERROR_BOOKMARKS = 1002
 } BookmarksImportErrorCode;
 
+/**
+ * ephy_bookmarks_import_bookmark_from_table:
+ * @table: the bookmarks table of an Epiphany bookmarks file
+ * @url: the url of the bookmark
+ *
+ * Returns: (transfer full) (nullable): a new bookmark built from the entry
+ * for @url, or %NULL if there is none
+ **/
+EphyBookmark *
+ephy_bookmarks_import_bookmark_from_table (GvdbTable  *table,
+                                           const char *url)
+{
+  EphyBookmark *bookmark;
+  GVariant *value;
+  GVariantIter *iter;
+  GSequence *tags;
+  char *tag;
+  const char *title;
+  gint64 time_added;
+  char *id;
+  gint64 server_time_modified;
+  gboolean is_uploaded;
+
+  /* Obtain the corresponding GVariant. */
+  value = gvdb_table_get_value (table, url);
+  if (!value)
+    return NULL;
+
+  g_variant_get (value, "(x&s&sxbas)",
+                 &time_added, &title, &id,
+                 &server_time_modified, &is_uploaded, &iter);
+
+  /* Add all stored tags in a GSequence. */
+  tags = g_sequence_new (g_free);
+  while (g_variant_iter_next (iter, "s", &tag)) {
+    g_sequence_insert_sorted (tags, tag,
+                              (GCompareDataFunc)ephy_bookmark_tags_compare,
+                              NULL);
+  }
+  g_variant_iter_free (iter);
+
+  /* Create the new bookmark. */
+  bookmark = ephy_bookmark_new (url, title, tags, id);
+  ephy_bookmark_set_time_added (bookmark, time_added);
+  ephy_synchronizable_set_server_time_modified (EPHY_SYNCHRONIZABLE (bookmark), server_time_modified);
+  ephy_bookmark_set_is_uploaded (bookmark, is_uploaded);
+
+  g_variant_unref (value);
+
+  return bookmark;
+}
+
 static GSequence *
 get_bookmarks_from_table (GvdbTable *table)
 {
@@ -50,41 +102,10 @@ get_bookmarks_from_table (GvdbTable *table)
   /* Iterate over all keys (url's) in the table. */
   list = gvdb_table_get_names (table, &length);
   for (i = 0; i < length; i++) {
-    EphyBookmark *bookmark;
-    GVariant *value;
-    GVariantIter *iter;
-    GSequence *tags;
-    char *tag;
-    const char *title;
-    gint64 time_added;
-    char *id;
-    gint64 server_time_modified;
-    gboolean is_uploaded;
-
-    /* Obtain the corresponding GVariant. */
-    value = gvdb_table_get_value (table, list[i]);
-
-    g_variant_get (value, "(x&s&sxbas)",
-                   &time_added, &title, &id,
-                   &server_time_modified, &is_uploaded, &iter);
-
-    /* Add all stored tags in a GSequence. */
-    tags = g_sequence_new (g_free);
-    while (g_variant_iter_next (iter, "s", &tag)) {
-      g_sequence_insert_sorted (tags, tag,
-                                (GCompareDataFunc)ephy_bookmark_tags_compare,
-                                NULL);
-    }
-    g_variant_iter_free (iter);
-
-    /* Create the new bookmark. */
-    bookmark = ephy_bookmark_new (list[i], title, tags, id);
-    ephy_bookmark_set_time_added (bookmark, time_added);
-    ephy_synchronizable_set_server_time_modified (EPHY_SYNCHRONIZABLE (bookmark), server_time_modified);
-    ephy_bookmark_set_is_uploaded (bookmark, is_uploaded);
-    g_sequence_prepend (bookmarks, bookmark);
+    EphyBookmark *bookmark = ephy_bookmarks_import_bookmark_from_table (table, list[i]);
 
-    g_variant_unref (value);
+    if (bookmark)
+      g_sequence_prepend (bookmarks, bookmark);
   }
 
   g_strfreev (list);
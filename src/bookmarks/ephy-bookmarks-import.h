@@ -21,6 +21,7 @@
 #pragma once
 
 #include "ephy-bookmarks-manager.h"
+#include "gvdb-reader.h"
 
 G_BEGIN_DECLS
 
@@ -36,4 +37,7 @@ gboolean    ephy_bookmarks_import_from_firefox  (EphyBookmarksManager  *manager,
                                                  const gchar           *profile,
                                                  GError               **error);
 
+EphyBookmark *ephy_bookmarks_import_bookmark_from_table (GvdbTable             *table,
+                                                         const char            *url);
+
 G_END_DECLS
@@ -39,6 +39,18 @@ struct _EphyBookmarksManager {
   GSequence  *bookmarks;
   GSequence  *tags;
 
+  /* Bookmarks by tag, each sorted like bookmarks. */
+  GHashTable *tag_index;
+  GSequence  *untagged;
+  GSequence  *no_bookmarks;
+
+  /* Until everything is needed, bookmarks are read from the mapped file
+   * as they are asked for and kept in materialized, keyed by their url in
+   * the file. Edits to them are held there until the next save. */
+  GvdbTable  *table;
+  GHashTable *materialized;
+  GHashTable *urls_by_id;
+
   gchar      *gvdb_filename;
 };
 
@@ -65,6 +77,8 @@ enum {
 
 static guint       signals[LAST_SIGNAL];
 
+static void ephy_bookmarks_manager_ensure_loaded (EphyBookmarksManager *self);
+
 static void
 ephy_bookmarks_manager_save_to_file (EphyBookmarksManager *self, GTask *task)
 {
@@ -106,6 +120,107 @@ ephy_bookmarks_manager_create_tags_from_bookmark (EphyBookmarksManager *self,
     ephy_bookmarks_manager_create_tag (self, g_sequence_get (iter));
 }
 
+static GSequenceIter *
+tag_index_find (GSequence    *bookmarks,
+                EphyBookmark *bookmark)
+{
+  GSequenceIter *iter;
+
+  iter = g_sequence_lookup (bookmarks, bookmark,
+                            (GCompareDataFunc)ephy_bookmark_bookmarks_compare_func,
+                            NULL);
+  if (iter && g_sequence_get (iter) == bookmark)
+    return iter;
+
+  /* The sort key changed since the bookmark was indexed. */
+  for (iter = g_sequence_get_begin_iter (bookmarks);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter)) {
+    if (g_sequence_get (iter) == bookmark)
+      return iter;
+  }
+
+  return NULL;
+}
+
+static void
+tag_index_insert (GSequence    *bookmarks,
+                  EphyBookmark *bookmark)
+{
+  if (g_sequence_lookup (bookmarks, bookmark,
+                         (GCompareDataFunc)ephy_bookmark_bookmarks_compare_func,
+                         NULL))
+    return;
+
+  g_sequence_insert_sorted (bookmarks, g_object_ref (bookmark),
+                            (GCompareDataFunc)ephy_bookmark_bookmarks_compare_func,
+                            NULL);
+}
+
+static void
+tag_index_remove (GSequence    *bookmarks,
+                  EphyBookmark *bookmark)
+{
+  GSequenceIter *iter = tag_index_find (bookmarks, bookmark);
+
+  if (iter)
+    g_sequence_remove (iter);
+}
+
+static void
+ephy_bookmarks_manager_index_tag (EphyBookmarksManager *self,
+                                  EphyBookmark         *bookmark,
+                                  const char           *tag)
+{
+  GSequence *bookmarks;
+
+  bookmarks = g_hash_table_lookup (self->tag_index, tag);
+  if (!bookmarks) {
+    bookmarks = g_sequence_new (g_object_unref);
+    g_hash_table_insert (self->tag_index, g_strdup (tag), bookmarks);
+  }
+
+  tag_index_insert (bookmarks, bookmark);
+}
+
+static void
+ephy_bookmarks_manager_index_bookmark (EphyBookmarksManager *self,
+                                       EphyBookmark         *bookmark)
+{
+  GSequence *tags = ephy_bookmark_get_tags (bookmark);
+
+  if (g_sequence_is_empty (tags)) {
+    tag_index_insert (self->untagged, bookmark);
+    return;
+  }
+
+  for (GSequenceIter *iter = g_sequence_get_begin_iter (tags);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
+    ephy_bookmarks_manager_index_tag (self, bookmark, g_sequence_get (iter));
+}
+
+static void
+ephy_bookmarks_manager_unindex_bookmark (EphyBookmarksManager *self,
+                                         EphyBookmark         *bookmark)
+{
+  GSequence *tags = ephy_bookmark_get_tags (bookmark);
+
+  if (g_sequence_is_empty (tags)) {
+    tag_index_remove (self->untagged, bookmark);
+    return;
+  }
+
+  for (GSequenceIter *iter = g_sequence_get_begin_iter (tags);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter)) {
+    GSequence *bookmarks = g_hash_table_lookup (self->tag_index, g_sequence_get (iter));
+
+    if (bookmarks)
+      tag_index_remove (bookmarks, bookmark);
+  }
+}
+
 static void
 ephy_bookmarks_manager_finalize (GObject *object)
 {
@@ -113,6 +228,13 @@ ephy_bookmarks_manager_finalize (GObject *object)
 
   g_sequence_free (self->bookmarks);
   g_sequence_free (self->tags);
+  g_hash_table_unref (self->tag_index);
+  g_sequence_free (self->untagged);
+  g_sequence_free (self->no_bookmarks);
+
+  g_clear_pointer (&self->table, gvdb_table_free);
+  g_clear_pointer (&self->materialized, g_hash_table_unref);
+  g_clear_pointer (&self->urls_by_id, g_hash_table_unref);
 
   g_free (self->gvdb_filename);
 
@@ -211,6 +333,10 @@ ephy_bookmarks_manager_init (EphyBookmarksManager *self)
 
   self->bookmarks = g_sequence_new (g_object_unref);
   self->tags = g_sequence_new (g_free);
+  self->tag_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, (GDestroyNotify)g_sequence_free);
+  self->untagged = g_sequence_new (g_object_unref);
+  self->no_bookmarks = g_sequence_new (NULL);
 
   g_sequence_insert_sorted (self->tags,
                             g_strdup (EPHY_BOOKMARKS_FAVORITES_TAG),
@@ -224,19 +350,58 @@ ephy_bookmarks_manager_init (EphyBookmarksManager *self)
   ephy_bookmarks_manager_load_from_file (self);
 }
 
+static void
+ephy_bookmarks_manager_resort_bookmark (EphyBookmarksManager *self,
+                                        EphyBookmark         *bookmark)
+{
+  GSequence *tags = ephy_bookmark_get_tags (bookmark);
+  GSequenceIter *iter;
+
+  if (g_sequence_is_empty (tags)) {
+    iter = tag_index_find (self->untagged, bookmark);
+    if (iter)
+      g_sequence_sort_changed (iter, (GCompareDataFunc)ephy_bookmark_bookmarks_compare_func, NULL);
+  }
+
+  for (GSequenceIter *tag_iter = g_sequence_get_begin_iter (tags);
+       !g_sequence_iter_is_end (tag_iter);
+       tag_iter = g_sequence_iter_next (tag_iter)) {
+    GSequence *bookmarks = g_hash_table_lookup (self->tag_index, g_sequence_get (tag_iter));
+
+    iter = bookmarks ? tag_index_find (bookmarks, bookmark) : NULL;
+    if (iter)
+      g_sequence_sort_changed (iter, (GCompareDataFunc)ephy_bookmark_bookmarks_compare_func, NULL);
+  }
+}
+
 static void
 bookmark_title_changed_cb (EphyBookmark         *bookmark,
                            GParamSpec           *pspec,
                            EphyBookmarksManager *self)
 {
+  /* The title is part of the sort key. */
+  ephy_bookmarks_manager_resort_bookmark (self, bookmark);
+
   g_signal_emit (self, signals[BOOKMARK_TITLE_CHANGED], 0, bookmark);
 }
 
+static void
+bookmark_sort_key_changed_cb (EphyBookmark         *bookmark,
+                              GParamSpec           *pspec,
+                              EphyBookmarksManager *self)
+{
+  /* Sync merges change the time added and the id of indexed bookmarks. */
+  ephy_bookmarks_manager_resort_bookmark (self, bookmark);
+}
+
 static void
 bookmark_url_changed_cb (EphyBookmark         *bookmark,
                          GParamSpec           *pspec,
                          EphyBookmarksManager *self)
 {
+  /* materialized is keyed by the url in the file. */
+  ephy_bookmarks_manager_ensure_loaded (self);
+
   g_signal_emit (self, signals[BOOKMARK_URL_CHANGED], 0, bookmark);
 }
 
@@ -245,6 +410,10 @@ bookmark_tag_added_cb (EphyBookmark         *bookmark,
                        const char           *tag,
                        EphyBookmarksManager *self)
 {
+  ephy_bookmarks_manager_index_tag (self, bookmark, tag);
+  if (g_sequence_get_length (ephy_bookmark_get_tags (bookmark)) == 1)
+    tag_index_remove (self->untagged, bookmark);
+
   g_signal_emit (self, signals[BOOKMARK_TAG_ADDED], 0, bookmark, tag);
 }
 
@@ -253,6 +422,13 @@ bookmark_tag_removed_cb (EphyBookmark         *bookmark,
                          const char           *tag,
                          EphyBookmarksManager *self)
 {
+  GSequence *bookmarks = g_hash_table_lookup (self->tag_index, tag);
+
+  if (bookmarks)
+    tag_index_remove (bookmarks, bookmark);
+  if (g_sequence_is_empty (ephy_bookmark_get_tags (bookmark)))
+    tag_index_insert (self->untagged, bookmark);
+
   g_signal_emit (self, signals[BOOKMARK_TAG_REMOVED], 0, bookmark, tag);
 }
 
@@ -268,6 +444,10 @@ ephy_bookmarks_manager_watch_bookmark (EphyBookmarksManager *self,
 {
   g_signal_connect_object (bookmark, "notify::title",
                            G_CALLBACK (bookmark_title_changed_cb), self, 0);
+  g_signal_connect_object (bookmark, "notify::time-added",
+                           G_CALLBACK (bookmark_sort_key_changed_cb), self, 0);
+  g_signal_connect_object (bookmark, "notify::id",
+                           G_CALLBACK (bookmark_sort_key_changed_cb), self, 0);
   g_signal_connect_object (bookmark, "notify::bmkUri",
                            G_CALLBACK (bookmark_url_changed_cb), self, 0);
   g_signal_connect_object (bookmark, "tag-added",
@@ -281,6 +461,7 @@ ephy_bookmarks_manager_unwatch_bookmark (EphyBookmarksManager *self,
                                          EphyBookmark         *bookmark)
 {
   g_signal_handlers_disconnect_by_func (bookmark, bookmark_title_changed_cb, self);
+  g_signal_handlers_disconnect_by_func (bookmark, bookmark_sort_key_changed_cb, self);
   g_signal_handlers_disconnect_by_func (bookmark, bookmark_url_changed_cb, self);
   g_signal_handlers_disconnect_by_func (bookmark, bookmark_tag_added_cb, self);
   g_signal_handlers_disconnect_by_func (bookmark, bookmark_tag_removed_cb, self);
@@ -306,6 +487,55 @@ ephy_bookmarks_search_and_insert_bookmark (GSequence     *bookmarks,
   return NULL;
 }
 
+static EphyBookmark *
+ephy_bookmarks_manager_materialize (EphyBookmarksManager *self,
+                                    const char           *url)
+{
+  EphyBookmark *bookmark;
+
+  bookmark = g_hash_table_lookup (self->materialized, url);
+  if (bookmark)
+    return bookmark;
+
+  bookmark = ephy_bookmarks_import_bookmark_from_table (self->table, url);
+  if (!bookmark)
+    return NULL;
+
+  g_hash_table_insert (self->materialized, g_strdup (url), bookmark);
+  ephy_bookmarks_manager_watch_bookmark (self, bookmark);
+
+  return bookmark;
+}
+
+static void
+ephy_bookmarks_manager_ensure_loaded (EphyBookmarksManager *self)
+{
+  char **names;
+  int length;
+
+  if (!self->table)
+    return;
+
+  names = gvdb_table_get_names (self->table, &length);
+  for (int i = 0; i < length; i++) {
+    EphyBookmark *bookmark = ephy_bookmarks_manager_materialize (self, names[i]);
+
+    if (!bookmark)
+      continue;
+
+    if (ephy_bookmarks_search_and_insert_bookmark (self->bookmarks, g_object_ref (bookmark)))
+      ephy_bookmarks_manager_index_bookmark (self, bookmark);
+    else
+      g_object_unref (bookmark);
+  }
+  g_strfreev (names);
+
+  /* Nothing has seen the list model yet, so no items-changed here. */
+  g_clear_pointer (&self->table, gvdb_table_free);
+  g_clear_pointer (&self->materialized, g_hash_table_unref);
+  g_clear_pointer (&self->urls_by_id, g_hash_table_unref);
+}
+
 static void
 ephy_bookmarks_manager_add_bookmark_internal (EphyBookmarksManager *self,
                                               EphyBookmark         *bookmark,
@@ -317,6 +547,8 @@ ephy_bookmarks_manager_add_bookmark_internal (EphyBookmarksManager *self,
   g_assert (EPHY_IS_BOOKMARKS_MANAGER (self));
   g_assert (EPHY_IS_BOOKMARK (bookmark));
 
+  ephy_bookmarks_manager_ensure_loaded (self);
+
   iter = ephy_bookmarks_search_and_insert_bookmark (self->bookmarks,
                                                     g_object_ref (bookmark));
   if (iter) {
@@ -324,6 +556,7 @@ ephy_bookmarks_manager_add_bookmark_internal (EphyBookmarksManager *self,
     position = g_sequence_iter_get_position (iter);
     g_list_model_items_changed (G_LIST_MODEL (self), position, 0, 1);
 
+    ephy_bookmarks_manager_index_bookmark (self, bookmark);
     g_signal_emit (self, signals[BOOKMARK_ADDED], 0, bookmark);
     ephy_bookmarks_manager_watch_bookmark (self, bookmark);
   }
@@ -377,6 +610,8 @@ ephy_bookmarks_manager_remove_bookmark_internal (EphyBookmarksManager *self,
   g_assert (EPHY_IS_BOOKMARKS_MANAGER (self));
   g_assert (EPHY_IS_BOOKMARK (bookmark));
 
+  ephy_bookmarks_manager_ensure_loaded (self);
+
   for (iter = g_sequence_get_begin_iter (self->bookmarks);
          !g_sequence_iter_is_end (iter);
          iter = g_sequence_iter_next (iter)) {
@@ -393,6 +628,7 @@ ephy_bookmarks_manager_remove_bookmark_internal (EphyBookmarksManager *self,
   g_object_ref (bookmark);
   position = g_sequence_iter_get_position (iter);
   g_sequence_remove (iter);
+  ephy_bookmarks_manager_unindex_bookmark (self, bookmark);
   g_list_model_items_changed (G_LIST_MODEL (self), position, 1, 0);
   g_signal_emit (self, signals[BOOKMARK_REMOVED], 0, bookmark);
 
@@ -423,6 +659,9 @@ ephy_bookmarks_manager_get_bookmark_by_url (EphyBookmarksManager *self,
   g_assert (EPHY_IS_BOOKMARKS_MANAGER (self));
   g_assert (url != NULL);
 
+  if (self->table)
+    return ephy_bookmarks_manager_materialize (self, url);
+
   for (iter = g_sequence_get_begin_iter (self->bookmarks);
          !g_sequence_iter_is_end (iter);
          iter = g_sequence_iter_next (iter)) {
@@ -435,6 +674,58 @@ ephy_bookmarks_manager_get_bookmark_by_url (EphyBookmarksManager *self,
   return NULL;
 }
 
+static void
+build_urls_by_id (EphyBookmarksManager *self)
+{
+  char **names;
+  int length;
+
+  self->urls_by_id = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  /* Only the ids are read, no bookmark is created. */
+  names = gvdb_table_get_names (self->table, &length);
+  for (int i = 0; i < length; i++) {
+    GVariant *value = gvdb_table_get_value (self->table, names[i]);
+    char *id;
+
+    if (!value) {
+      g_free (names[i]);
+      continue;
+    }
+
+    g_variant_get_child (value, 2, "s", &id);
+    g_hash_table_insert (self->urls_by_id, id, names[i]);
+    g_variant_unref (value);
+  }
+  g_free (names);
+}
+
+static EphyBookmark *
+get_materialized_bookmark_by_id (EphyBookmarksManager *self,
+                                 const char           *id)
+{
+  EphyBookmark *bookmark;
+  const char *url;
+  GHashTableIter iter;
+
+  if (!self->urls_by_id)
+    build_urls_by_id (self);
+
+  url = g_hash_table_lookup (self->urls_by_id, id);
+  bookmark = url ? ephy_bookmarks_manager_materialize (self, url) : NULL;
+  if (bookmark && g_strcmp0 (ephy_bookmark_get_id (bookmark), id) == 0)
+    return bookmark;
+
+  /* The id of a materialized bookmark may have changed since. */
+  g_hash_table_iter_init (&iter, self->materialized);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&bookmark)) {
+    if (g_strcmp0 (ephy_bookmark_get_id (bookmark), id) == 0)
+      return bookmark;
+  }
+
+  return NULL;
+}
+
 EphyBookmark *
 ephy_bookmarks_manager_get_bookmark_by_id (EphyBookmarksManager *self,
                                            const char           *id)
@@ -444,6 +735,9 @@ ephy_bookmarks_manager_get_bookmark_by_id (EphyBookmarksManager *self,
   g_assert (EPHY_IS_BOOKMARKS_MANAGER (self));
   g_assert (id != NULL);
 
+  if (self->table)
+    return get_materialized_bookmark_by_id (self, id);
+
   for (iter = g_sequence_get_begin_iter (self->bookmarks);
        !g_sequence_iter_is_end (iter);
        iter = g_sequence_iter_next (iter)) {
@@ -500,6 +794,12 @@ ephy_bookmarks_manager_delete_tag (EphyBookmarksManager *self, const char *tag)
 
   g_sequence_remove (iter);
 
+  ephy_bookmarks_manager_ensure_loaded (self);
+
+  /* Dropped first, so that the removals below need not look for each
+   * bookmark in it. */
+  g_hash_table_remove (self->tag_index, tag);
+
   /* Also remove the tag from each bookmark if they have it */
   g_sequence_foreach (self->bookmarks, (GFunc)ephy_bookmark_remove_tag, (gpointer)tag);
 
@@ -527,48 +827,92 @@ ephy_bookmarks_manager_get_bookmarks (EphyBookmarksManager *self)
 {
   g_assert (EPHY_IS_BOOKMARKS_MANAGER (self));
 
+  ephy_bookmarks_manager_ensure_loaded (self);
+
   return self->bookmarks;
 }
 
+/**
+ * ephy_bookmarks_manager_foreach_url_and_title:
+ * @self: an #EphyBookmarksManager
+ * @func: (scope call): the function to call for each bookmark
+ * @user_data: data to pass to @func
+ *
+ * Calls @func with the address and title of every bookmark. Unlike
+ * ephy_bookmarks_manager_get_bookmarks(), this reads the bookmarks that
+ * were not asked for yet straight from the file, without creating them;
+ * @func gets a %NULL bookmark for those.
+ **/
+void
+ephy_bookmarks_manager_foreach_url_and_title (EphyBookmarksManager            *self,
+                                              EphyBookmarksManagerForeachFunc  func,
+                                              gpointer                         user_data)
+{
+  g_assert (EPHY_IS_BOOKMARKS_MANAGER (self));
+  g_assert (func != NULL);
+
+  if (self->table) {
+    char **names;
+    int length;
+
+    names = gvdb_table_get_names (self->table, &length);
+    for (int i = 0; i < length; i++) {
+      EphyBookmark *bookmark = g_hash_table_lookup (self->materialized, names[i]);
+      GVariant *value;
+      const char *title;
+
+      /* It may have been edited since it was read. */
+      if (bookmark) {
+        func (bookmark, ephy_bookmark_get_url (bookmark), ephy_bookmark_get_title (bookmark), user_data);
+        continue;
+      }
+
+      value = gvdb_table_get_value (self->table, names[i]);
+      if (!value)
+        continue;
+
+      g_variant_get_child (value, 1, "&s", &title);
+      func (NULL, names[i], title, user_data);
+      g_variant_unref (value);
+    }
+    g_strfreev (names);
+
+    return;
+  }
+
+  for (GSequenceIter *iter = g_sequence_get_begin_iter (self->bookmarks);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter)) {
+    EphyBookmark *bookmark = g_sequence_get (iter);
+
+    func (bookmark, ephy_bookmark_get_url (bookmark), ephy_bookmark_get_title (bookmark), user_data);
+  }
+}
+
+/**
+ * ephy_bookmarks_manager_get_bookmarks_with_tag:
+ * @self: an #EphyBookmarksManager
+ * @tag: (nullable): a tag, or %NULL for bookmarks without tags
+ *
+ * Returns: (transfer none): the bookmarks with @tag, sorted. The sequence
+ * is kept up to date by @self and must not be modified.
+ **/
 GSequence *
 ephy_bookmarks_manager_get_bookmarks_with_tag (EphyBookmarksManager *self,
                                                const char           *tag)
 {
   GSequence *bookmarks;
-  GSequenceIter *iter;
 
   g_assert (EPHY_IS_BOOKMARKS_MANAGER (self));
 
-  bookmarks = g_sequence_new (g_object_unref);
+  ephy_bookmarks_manager_ensure_loaded (self);
 
-  if (tag == NULL) {
-    for (iter = g_sequence_get_begin_iter (self->bookmarks);
-         !g_sequence_iter_is_end (iter);
-         iter = g_sequence_iter_next (iter)) {
-      EphyBookmark *bookmark = g_sequence_get (iter);
+  if (tag == NULL)
+    return self->untagged;
 
-      if (g_sequence_is_empty (ephy_bookmark_get_tags (bookmark))) {
-        g_sequence_insert_sorted (bookmarks,
-                                  g_object_ref (bookmark),
-                                  (GCompareDataFunc)ephy_bookmark_bookmarks_compare_func,
-                                  NULL);
-      }
-    }
-  } else {
-    for (iter = g_sequence_get_begin_iter (self->bookmarks);
-         !g_sequence_iter_is_end (iter);
-         iter = g_sequence_iter_next (iter)) {
-      EphyBookmark *bookmark = g_sequence_get (iter);
+  bookmarks = g_hash_table_lookup (self->tag_index, tag);
 
-      if (ephy_bookmark_has_tag (bookmark, tag))
-        g_sequence_insert_sorted (bookmarks,
-                                  g_object_ref (bookmark),
-                                  (GCompareDataFunc)ephy_bookmark_bookmarks_compare_func,
-                                  NULL);
-    }
-  }
-
-  return bookmarks;
+  return bookmarks ? bookmarks : self->no_bookmarks;
 }
 
 GSequence *
@@ -604,10 +948,43 @@ ephy_bookmarks_manager_save_to_file_finish (EphyBookmarksManager *self,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+/* Only tags are read here. The bookmarks table stays mapped and is read
+ * from as bookmarks are asked for. */
 void
 ephy_bookmarks_manager_load_from_file (EphyBookmarksManager *self)
 {
-  ephy_bookmarks_import (self, self->gvdb_filename, NULL);
+  GvdbTable *root_table;
+  GvdbTable *tags_table;
+  GvdbTable *table;
+  char **names;
+  int length;
+
+  ephy_bookmarks_manager_ensure_loaded (self);
+
+  root_table = gvdb_table_new (self->gvdb_filename, TRUE, NULL);
+  if (!root_table)
+    return;
+
+  tags_table = gvdb_table_get_table (root_table, "tags");
+  table = gvdb_table_get_table (root_table, "bookmarks");
+  gvdb_table_free (root_table);
+
+  if (!tags_table || !table) {
+    g_warning ("File is not a valid Epiphany bookmarks file: %s", self->gvdb_filename);
+    g_clear_pointer (&tags_table, gvdb_table_free);
+    g_clear_pointer (&table, gvdb_table_free);
+    return;
+  }
+
+  names = gvdb_table_get_names (tags_table, &length);
+  for (int i = 0; i < length; i++)
+    ephy_bookmarks_manager_create_tag (self, names[i]);
+  g_strfreev (names);
+  gvdb_table_free (tags_table);
+
+  self->table = table;
+  self->materialized = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, g_object_unref);
 }
 
 void
@@ -637,6 +1014,8 @@ ephy_bookmarks_manager_list_model_get_n_items (GListModel *model)
 {
   EphyBookmarksManager *self = EPHY_BOOKMARKS_MANAGER (model);
 
+  ephy_bookmarks_manager_ensure_loaded (self);
+
   return g_sequence_get_length (self->bookmarks);
 }
 
@@ -647,6 +1026,8 @@ ephy_bookmarks_manager_list_model_get_item (GListModel *model,
   EphyBookmarksManager *self = EPHY_BOOKMARKS_MANAGER (model);
   GSequenceIter *iter;
 
+  ephy_bookmarks_manager_ensure_loaded (self);
+
   iter = g_sequence_get_iter_at_pos (self->bookmarks, position);
 
   return g_object_ref (g_sequence_get (iter));
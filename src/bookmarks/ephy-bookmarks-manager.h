@@ -35,6 +35,11 @@ G_DECLARE_FINAL_TYPE (EphyBookmarksManager, ephy_bookmarks_manager, EPHY, BOOKMA
 #define EPHY_BOOKMARKS_MOBILE_TAG       N_("Mobile")
 #define FIREFOX_BOOKMARKS_MOBILE_FOLDER "Mobile Bookmarks"
 
+typedef void (*EphyBookmarksManagerForeachFunc) (EphyBookmark *bookmark,
+                                                 const char   *url,
+                                                 const char   *title,
+                                                 gpointer      user_data);
+
 EphyBookmarksManager *ephy_bookmarks_manager_new                  (void);
 
 void         ephy_bookmarks_manager_add_bookmark                  (EphyBookmarksManager *self,
@@ -56,6 +61,9 @@ gboolean     ephy_bookmarks_manager_tag_exists                    (EphyBookmarks
                                                                    const char           *tag);
 
 GSequence   *ephy_bookmarks_manager_get_bookmarks                 (EphyBookmarksManager *self);
+void         ephy_bookmarks_manager_foreach_url_and_title         (EphyBookmarksManager            *self,
+                                                                   EphyBookmarksManagerForeachFunc  func,
+                                                                   gpointer                         user_data);
 GSequence   *ephy_bookmarks_manager_get_bookmarks_with_tag        (EphyBookmarksManager *self,
                                                                    const char           *tag);
 GSequence   *ephy_bookmarks_manager_get_tags                      (EphyBookmarksManager *self);
@@ -43,6 +43,7 @@ struct _EphyBookmarksPopover {
   char                  *tag_detail_tag;
 
   EphyBookmarksManager  *manager;
+  gboolean               is_populated;
 };
 
 G_DEFINE_TYPE (EphyBookmarksPopover, ephy_bookmarks_popover, GTK_TYPE_POPOVER)
@@ -468,45 +469,14 @@ ephy_bookmarks_popover_finalize (GObject *object)
   G_OBJECT_CLASS (ephy_bookmarks_popover_parent_class)->finalize (object);
 }
 
+/* Listing bookmarks loads all of them, which is too slow to do while the
+ * first window is built, so it waits until the popover is first shown. */
 static void
-ephy_bookmarks_popover_class_init (EphyBookmarksPopoverClass *klass)
-{
-  GObjectClass *object_class = G_OBJECT_CLASS (klass);
-  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
-
-  object_class->finalize = ephy_bookmarks_popover_finalize;
-
-  gtk_widget_class_set_template_from_resource (widget_class, "/org/gnome/epiphany/gtk/bookmarks-popover.ui");
-  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, toplevel_stack);
-  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, bookmarks_list_box);
-  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, tags_list_box);
-  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, tag_detail_list_box);
-  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, tag_detail_back_button);
-  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, tag_detail_label);
-}
-
-static const GActionEntry entries[] = {
-  { "tag-detail-back", ephy_bookmarks_popover_actions_tag_detail_back }
-};
-
-static void
-ephy_bookmarks_popover_init (EphyBookmarksPopover *self)
+ephy_bookmarks_popover_populate (EphyBookmarksPopover *self)
 {
   GSequence *tags;
   GSequence *bookmarks;
   GSequenceIter *iter;
-  GSimpleActionGroup *group;
-
-  gtk_widget_init_template (GTK_WIDGET (self));
-
-  self->manager = ephy_shell_get_bookmarks_manager (ephy_shell_get_default ());
-
-  group = g_simple_action_group_new ();
-  g_action_map_add_action_entries (G_ACTION_MAP (group), entries,
-                                   G_N_ELEMENTS (entries), self);
-  gtk_widget_insert_action_group (GTK_WIDGET (self), "popover",
-                                  G_ACTION_GROUP (group));
-  g_object_unref (group);
 
   gtk_list_box_bind_model (GTK_LIST_BOX (self->bookmarks_list_box),
                            G_LIST_MODEL (self->manager),
@@ -516,13 +486,6 @@ ephy_bookmarks_popover_init (EphyBookmarksPopover *self)
   if (g_list_model_get_n_items (G_LIST_MODEL (self->manager)) == 0)
     gtk_stack_set_visible_child_name (GTK_STACK (self->toplevel_stack), "empty-state");
 
-  gtk_list_box_set_sort_func (GTK_LIST_BOX (self->tags_list_box),
-                              (GtkListBoxSortFunc)tags_list_box_sort_func,
-                              NULL, NULL);
-  gtk_list_box_set_sort_func (GTK_LIST_BOX (self->tag_detail_list_box),
-                              (GtkListBoxSortFunc)tags_list_box_sort_func,
-                              NULL, NULL);
-
   tags = ephy_bookmarks_manager_get_tags (self->manager);
   for (iter = g_sequence_get_begin_iter (tags);
        !g_sequence_iter_is_end (iter);
@@ -566,6 +529,66 @@ ephy_bookmarks_popover_init (EphyBookmarksPopover *self)
   g_signal_connect_object (self->manager, "bookmark-tag-removed",
                            G_CALLBACK (ephy_bookmarks_popover_bookmark_tag_removed_cb),
                            self, G_CONNECT_SWAPPED);
+}
+
+static void
+ephy_bookmarks_popover_map (GtkWidget *widget)
+{
+  EphyBookmarksPopover *self = EPHY_BOOKMARKS_POPOVER (widget);
+
+  if (!self->is_populated) {
+    self->is_populated = TRUE;
+    ephy_bookmarks_popover_populate (self);
+  }
+
+  GTK_WIDGET_CLASS (ephy_bookmarks_popover_parent_class)->map (widget);
+}
+
+static void
+ephy_bookmarks_popover_class_init (EphyBookmarksPopoverClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->finalize = ephy_bookmarks_popover_finalize;
+
+  widget_class->map = ephy_bookmarks_popover_map;
+
+  gtk_widget_class_set_template_from_resource (widget_class, "/org/gnome/epiphany/gtk/bookmarks-popover.ui");
+  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, toplevel_stack);
+  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, bookmarks_list_box);
+  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, tags_list_box);
+  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, tag_detail_list_box);
+  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, tag_detail_back_button);
+  gtk_widget_class_bind_template_child (widget_class, EphyBookmarksPopover, tag_detail_label);
+}
+
+static const GActionEntry entries[] = {
+  { "tag-detail-back", ephy_bookmarks_popover_actions_tag_detail_back }
+};
+
+static void
+ephy_bookmarks_popover_init (EphyBookmarksPopover *self)
+{
+  GSimpleActionGroup *group;
+
+  gtk_widget_init_template (GTK_WIDGET (self));
+
+  self->manager = ephy_shell_get_bookmarks_manager (ephy_shell_get_default ());
+
+  group = g_simple_action_group_new ();
+  g_action_map_add_action_entries (G_ACTION_MAP (group), entries,
+                                   G_N_ELEMENTS (entries), self);
+  gtk_widget_insert_action_group (GTK_WIDGET (self), "popover",
+                                  G_ACTION_GROUP (group));
+  g_object_unref (group);
+
+  gtk_list_box_set_sort_func (GTK_LIST_BOX (self->tags_list_box),
+                              (GtkListBoxSortFunc)tags_list_box_sort_func,
+                              NULL, NULL);
+  gtk_list_box_set_sort_func (GTK_LIST_BOX (self->tag_detail_list_box),
+                              (GtkListBoxSortFunc)tags_list_box_sort_func,
+                              NULL, NULL);
 
   g_signal_connect_object (self->bookmarks_list_box, "row-activated",
                            G_CALLBACK (ephy_bookmarks_popover_list_box_row_activated_cb),
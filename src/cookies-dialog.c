@@ -32,6 +32,9 @@
 
 #include "cookies-dialog.h"
 
+/* Pages tend to set several cookies in a row while loading. */
+#define REFRESH_DELAY_MS 500
+
 enum {
   COL_COOKIES_HOST,
   COL_COOKIES_HOST_KEY,
@@ -50,6 +53,11 @@ struct _EphyCookiesDialog {
   GActionGroup *action_group;
 
   WebKitWebsiteDataManager *data_manager;
+  GCancellable *cancellable;
+  GHashTable *rows; /* domain -> GtkTreeIter in liststore */
+  guint refresh_id;
+  gboolean fetching;
+  gboolean refresh_pending;
   gboolean filled;
 
   char *search_text;
@@ -58,36 +66,57 @@ struct _EphyCookiesDialog {
 G_DEFINE_TYPE (EphyCookiesDialog, ephy_cookies_dialog, GTK_TYPE_DIALOG)
 
 static void populate_model (EphyCookiesDialog *dialog);
-static void cookie_changed_cb (WebKitCookieManager *cookie_manager,
-                               EphyCookiesDialog   *dialog);
 
-static void
-reload_model (EphyCookiesDialog *dialog)
+static gboolean
+refresh_timeout_cb (EphyCookiesDialog *dialog)
 {
-  g_signal_handlers_disconnect_by_func (webkit_website_data_manager_get_cookie_manager (dialog->data_manager), cookie_changed_cb, dialog);
-  gtk_list_store_clear (GTK_LIST_STORE (dialog->liststore));
-  dialog->filled = FALSE;
-  populate_model (dialog);
+  dialog->refresh_id = 0;
+
+  /* WebKit can only list every domain, so refresh once the current fetch
+   * is done. The result is diffed against the model. */
+  if (dialog->fetching)
+    dialog->refresh_pending = TRUE;
+  else
+    populate_model (dialog);
+
+  return G_SOURCE_REMOVE;
 }
 
 static void
 cookie_changed_cb (WebKitCookieManager *cookie_manager,
                    EphyCookiesDialog   *dialog)
 {
-  reload_model (dialog);
+  if (dialog->refresh_id == 0)
+    dialog->refresh_id = g_timeout_add (REFRESH_DELAY_MS, (GSourceFunc)refresh_timeout_cb, dialog);
 }
 
 static void
 ephy_cookies_dialog_dispose (GObject *object)
 {
-  g_signal_handlers_disconnect_by_func (webkit_website_data_manager_get_cookie_manager (EPHY_COOKIES_DIALOG (object)->data_manager), cookie_changed_cb, object);
+  EphyCookiesDialog *dialog = EPHY_COOKIES_DIALOG (object);
+
+  g_signal_handlers_disconnect_by_func (webkit_website_data_manager_get_cookie_manager (dialog->data_manager), cookie_changed_cb, object);
+
+  if (dialog->refresh_id) {
+    g_source_remove (dialog->refresh_id);
+    dialog->refresh_id = 0;
+  }
+
+  if (dialog->cancellable) {
+    g_cancellable_cancel (dialog->cancellable);
+    g_clear_object (&dialog->cancellable);
+  }
+
   G_OBJECT_CLASS (ephy_cookies_dialog_parent_class)->dispose (object);
 }
 
 static void
 ephy_cookies_dialog_finalize (GObject *object)
 {
-  g_free (EPHY_COOKIES_DIALOG (object)->search_text);
+  EphyCookiesDialog *dialog = EPHY_COOKIES_DIALOG (object);
+
+  g_hash_table_unref (dialog->rows);
+  g_free (dialog->search_text);
   G_OBJECT_CLASS (ephy_cookies_dialog_parent_class)->finalize (object);
 }
 
@@ -155,6 +184,7 @@ forget (GSimpleAction *action,
                                                       &child_iter,
                                                       &filter_iter);
 
+    g_hash_table_remove (dialog->rows, webkit_website_data_get_name (data_to_remove->data));
     gtk_list_store_remove (GTK_LIST_STORE (dialog->liststore), &child_iter);
 
     gtk_tree_row_reference_free ((GtkTreeRowReference *)r->data);
@@ -221,7 +251,8 @@ forget_all (GSimpleAction *action,
   EphyCookiesDialog *dialog = EPHY_COOKIES_DIALOG (user_data);
 
   webkit_website_data_manager_clear (dialog->data_manager, WEBKIT_WEBSITE_DATA_COOKIES, 0, NULL, NULL, NULL);
-  reload_model (dialog);
+  g_hash_table_remove_all (dialog->rows);
+  gtk_list_store_clear (GTK_LIST_STORE (dialog->liststore));
 }
 
 static void
@@ -298,6 +329,9 @@ cookie_add (EphyCookiesDialog *dialog,
                                       column, value,
                                       G_N_ELEMENTS (value));
 
+  /* List store iters persist, so they can be kept around. */
+  g_hash_table_insert (dialog->rows, g_strdup (domain), gtk_tree_iter_copy (&iter));
+
   g_value_unset (&value[0]);
   g_value_unset (&value[1]);
   g_value_unset (&value[2]);
@@ -331,16 +365,48 @@ get_domains_with_cookies_cb (WebKitWebsiteDataManager *data_manager,
                              EphyCookiesDialog        *dialog)
 {
   GList *data_list;
+  GHashTable *domains;
+  GHashTableIter iter;
+  gpointer key, value;
+  g_autoptr(GError) error = NULL;
 
-  data_list = webkit_website_data_manager_fetch_finish (data_manager, result, NULL);
-  if (!data_list)
+  data_list = webkit_website_data_manager_fetch_finish (data_manager, result, &error);
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
     return;
 
-  for (GList *l = data_list; l && l->data; l = g_list_next (l))
-    cookie_add (dialog, (WebKitWebsiteData *)l->data);
+  dialog->fetching = FALSE;
+  if (dialog->refresh_pending) {
+    dialog->refresh_pending = FALSE;
+    populate_model (dialog);
+  }
 
-  /* The list items have been consumed, so we need only to free the list. */
-  g_list_free (data_list);
+  if (error)
+    return;
+
+  /* Only touch the rows of domains that came or went. */
+  domains = g_hash_table_new (g_str_hash, g_str_equal);
+  for (GList *l = data_list; l && l->data; l = g_list_next (l)) {
+    WebKitWebsiteData *data = l->data;
+    const char *domain = webkit_website_data_get_name (data);
+
+    if (!g_hash_table_contains (dialog->rows, domain))
+      cookie_add (dialog, webkit_website_data_ref (data));
+    g_hash_table_add (domains, (gpointer)domain);
+  }
+
+  g_hash_table_iter_init (&iter, dialog->rows);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    if (!g_hash_table_contains (domains, key)) {
+      gtk_list_store_remove (GTK_LIST_STORE (dialog->liststore), value);
+      g_hash_table_iter_remove (&iter);
+    }
+  }
+
+  g_hash_table_unref (domains);
+  g_list_free_full (data_list, (GDestroyNotify)webkit_website_data_unref);
+
+  if (dialog->filled)
+    return;
 
   /* Now turn on sorting */
   gtk_tree_sortable_set_sort_func (GTK_TREE_SORTABLE (dialog->liststore),
@@ -351,11 +417,6 @@ get_domains_with_cookies_cb (WebKitWebsiteDataManager *data_manager,
                                         COL_COOKIES_HOST_KEY,
                                         GTK_SORT_ASCENDING);
 
-  g_signal_connect (webkit_website_data_manager_get_cookie_manager (data_manager),
-                    "changed",
-                    G_CALLBACK (cookie_changed_cb),
-                    dialog);
-
   dialog->filled = TRUE;
 }
 
@@ -385,11 +446,10 @@ row_visible_func (GtkTreeModel      *model,
 static void
 populate_model (EphyCookiesDialog *dialog)
 {
-  g_assert (dialog->filled == FALSE);
-
+  dialog->fetching = TRUE;
   webkit_website_data_manager_fetch (dialog->data_manager,
                                      WEBKIT_WEBSITE_DATA_COOKIES,
-                                     NULL,
+                                     dialog->cancellable,
                                      (GAsyncReadyCallback)get_domains_with_cookies_cb,
                                      dialog);
 }
@@ -434,6 +494,14 @@ ephy_cookies_dialog_init (EphyCookiesDialog *dialog)
 
   web_context = ephy_embed_shell_get_web_context (shell);
   dialog->data_manager = webkit_web_context_get_website_data_manager (web_context);
+  dialog->cancellable = g_cancellable_new ();
+  dialog->rows = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free, (GDestroyNotify)gtk_tree_iter_free);
+
+  g_signal_connect (webkit_website_data_manager_get_cookie_manager (dialog->data_manager),
+                    "changed",
+                    G_CALLBACK (cookie_changed_cb),
+                    dialog);
 
   setup_page (dialog);
 
@@ -57,13 +57,15 @@ struct _EphyHistoryDialog {
 
   GActionGroup *action_group;
 
-  GList *urls;
-  guint sorter_source;
+  GHashTable *rows; /* url -> GtkListBoxRow */
+  GCancellable *page_cancellable;
+  EphyHistoryCursor *cursor;
+  gboolean fetching;
+  gboolean has_more;
+  gboolean clear_on_next_page;
 
   char *search_text;
 
-  gint num_fetch;
-
   GtkWidget *confirmation_dialog;
 };
 
@@ -77,7 +79,7 @@ enum {
 
 static GParamSpec *obj_properties[LAST_PROP];
 
-static gboolean add_urls_source (EphyHistoryDialog *self);
+static GtkWidget *create_row (EphyHistoryDialog *self, EphyHistoryURL *url);
 
 static EphyHistoryURL *
 get_url_from_row (GtkListBoxRow *row)
@@ -90,11 +92,13 @@ get_url_from_row (GtkListBoxRow *row)
 }
 
 static void
-clear_listbox (GtkWidget *listbox)
+clear_listbox (EphyHistoryDialog *self)
 {
   GList *children, *iter;
 
-  children = gtk_container_get_children (GTK_CONTAINER (listbox));
+  g_hash_table_remove_all (self->rows);
+
+  children = gtk_container_get_children (GTK_CONTAINER (self->listbox));
 
   for (iter = children; iter != NULL; iter = g_list_next (iter)) {
     gtk_widget_destroy (GTK_WIDGET (iter->data));
@@ -104,23 +108,62 @@ clear_listbox (GtkWidget *listbox)
 }
 
 static void
-on_find_urls_cb (gpointer service,
-                 gboolean success,
-                 gpointer result_data,
-                 gpointer user_data)
+insert_row (EphyHistoryDialog *self,
+            EphyHistoryURL    *url,
+            int                position)
+{
+  GtkWidget *row = create_row (self, url);
+
+  g_hash_table_insert (self->rows, g_strdup (url->url), row);
+  gtk_list_box_insert (GTK_LIST_BOX (self->listbox), row, position);
+}
+
+static void
+remove_row (EphyHistoryDialog *self,
+            GtkWidget         *row)
+{
+  g_hash_table_remove (self->rows, g_object_get_data (G_OBJECT (row), "url"));
+  gtk_widget_destroy (row);
+}
+
+static void
+on_find_urls_page_cb (gpointer service,
+                      gboolean success,
+                      gpointer result_data,
+                      gpointer user_data)
 {
   EphyHistoryDialog *self = EPHY_HISTORY_DIALOG (user_data);
+  GList *urls = (GList *)result_data;
+  GList *last;
+
+  self->fetching = FALSE;
 
   if (success != TRUE)
     return;
 
+  /* Keep showing the old rows until the new ones are ready. */
+  if (self->clear_on_next_page) {
+    clear_listbox (self);
+    self->clear_on_next_page = FALSE;
+  }
+
+  for (GList *l = urls; l; l = l->next) {
+    EphyHistoryURL *url = l->data;
 
-  self->urls = (GList *)result_data;
+    /* Already shown after a change that raced with this page. */
+    if (!g_hash_table_contains (self->rows, url->url))
+      insert_row (self, url, -1);
+  }
 
-  clear_listbox (self->listbox);
+  last = g_list_last (urls);
+  if (last) {
+    g_clear_pointer (&self->cursor, ephy_history_cursor_free);
+    self->cursor = ephy_history_cursor_new_for_url (last->data);
+  }
+  self->has_more = g_list_length (urls) == NUM_FETCH_LIMIT;
 
-  self->num_fetch = NUM_FETCH_LIMIT;
-  self->sorter_source = g_idle_add ((GSourceFunc)add_urls_source, self);
+  g_list_free_full (urls, (GDestroyNotify)ephy_history_url_free);
+  gtk_widget_queue_draw (self->listbox);
 }
 
 static GList *
@@ -144,41 +187,117 @@ substrings_filter (EphyHistoryDialog *self)
 }
 
 static void
-remove_pending_sorter_source (EphyHistoryDialog *self,
-                              gboolean           free_urls)
+fetch_next_page (EphyHistoryDialog *self)
 {
-  if (self->sorter_source != 0) {
-    g_source_remove (self->sorter_source);
-    self->sorter_source = 0;
-  }
+  if (self->fetching || !self->has_more)
+    return;
 
-  if (free_urls && self->urls != NULL) {
-    g_list_free_full (self->urls, (GDestroyNotify)ephy_history_url_free);
-    self->urls = NULL;
+  self->fetching = TRUE;
+  ephy_history_service_find_urls_page (self->history_service,
+                                       substrings_filter (self),
+                                       self->cursor,
+                                       NUM_FETCH_LIMIT,
+                                       self->page_cancellable,
+                                       (EphyHistoryJobCallback)on_find_urls_page_cb, self);
+}
+
+static void
+cancel_page_fetch (EphyHistoryDialog *self)
+{
+  if (self->page_cancellable) {
+    g_cancellable_cancel (self->page_cancellable);
+    g_clear_object (&self->page_cancellable);
   }
+
+  self->fetching = FALSE;
 }
 
 static void
 filter_now (EphyHistoryDialog *self)
 {
-  gint64 from, to;
-  GList *substrings;
-  EphyHistorySortType type;
-  substrings = substrings_filter (self);
+  /* Start over from the first page. */
+  cancel_page_fetch (self);
+  self->page_cancellable = g_cancellable_new ();
+
+  g_clear_pointer (&self->cursor, ephy_history_cursor_free);
+  self->has_more = TRUE;
+  self->clear_on_next_page = TRUE;
+
+  fetch_next_page (self);
+}
+
+/* Mirrors the LIKE matching done by the urls query. */
+static gboolean
+url_matches_filter (EphyHistoryDialog *self,
+                    EphyHistoryURL    *url)
+{
+  g_autofree char *url_folded = NULL;
+  g_autofree char *title_folded = NULL;
+  char **tokens;
+  gboolean matches = TRUE;
+
+  if (self->search_text == NULL)
+    return TRUE;
+
+  url_folded = g_utf8_casefold (url->url, -1);
+  title_folded = url->title ? g_utf8_casefold (url->title, -1) : NULL;
+  tokens = g_strsplit (self->search_text, " ", -1);
+
+  for (char **p = tokens; *p && matches; p++) {
+    g_autofree char *token = g_utf8_casefold (*p, -1);
+
+    matches = strstr (url_folded, token) ||
+              (title_folded && strstr (title_folded, token));
+  }
+
+  g_strfreev (tokens);
+
+  return matches;
+}
+
+static gboolean
+sorts_before (EphyHistoryCursor *a,
+              EphyHistoryCursor *b)
+{
+  if (a->last_visit_time != b->last_visit_time)
+    return a->last_visit_time > b->last_visit_time;
+
+  return a->id > b->id;
+}
+
+static void
+apply_url_change (EphyHistoryDialog    *self,
+                  EphyHistoryURLChange *change)
+{
+  GtkWidget *row;
+  EphyHistoryCursor *key;
+  int position;
+
+  row = g_hash_table_lookup (self->rows, change->url->url);
+  if (row)
+    remove_row (self, row);
+
+  if (change->type == EPHY_HISTORY_URL_CHANGE_DELETED ||
+      !url_matches_filter (self, change->url))
+    return;
 
-  from = to = -1;       /* all */
+  /* Rows after the last loaded one will come with a later page. */
+  key = ephy_history_cursor_new_for_url (change->url);
+  if (self->has_more && (!self->cursor || !sorts_before (key, self->cursor))) {
+    ephy_history_cursor_free (key);
+    return;
+  }
 
-  type = EPHY_HISTORY_SORT_MOST_RECENTLY_VISITED;
+  /* Changes are mostly new visits, which go to the top. */
+  for (position = 0;; position++) {
+    GtkListBoxRow *next = gtk_list_box_get_row_at_index (GTK_LIST_BOX (self->listbox), position);
 
-  remove_pending_sorter_source (self, TRUE);
+    if (!next || sorts_before (key, g_object_get_data (G_OBJECT (next), "cursor")))
+      break;
+  }
 
-  ephy_history_service_find_urls (self->history_service,
-                                  from, to,
-                                  -1, 0,
-                                  substrings,
-                                  type,
-                                  self->cancellable,
-                                  (EphyHistoryJobCallback)on_find_urls_cb, self);
+  insert_row (self, change->url, position);
+  ephy_history_cursor_free (key);
 }
 
 static GList *
@@ -201,20 +320,6 @@ get_selection (EphyHistoryDialog *self)
   return g_list_reverse (list);
 }
 
-static void
-on_browse_history_deleted_cb (gpointer service,
-                              gboolean success,
-                              gpointer result_data,
-                              gpointer user_data)
-{
-  EphyHistoryDialog *self = EPHY_HISTORY_DIALOG (user_data);
-
-  if (success != TRUE)
-    return;
-
-  filter_now (self);
-}
-
 static void
 delete_selected (EphyHistoryDialog *self)
 {
@@ -222,7 +327,7 @@ delete_selected (EphyHistoryDialog *self)
 
   selected = get_selection (self);
   ephy_history_service_delete_urls (self->history_service, selected, self->cancellable,
-                                    (EphyHistoryJobCallback)on_browse_history_deleted_cb, self);
+                                    NULL, NULL);
 
   for (GList *l = selected; l; l = l->next)
     ephy_snapshot_service_delete_snapshot_for_url (self->snapshot_service, ((EphyHistoryURL *)l->data)->url);
@@ -257,8 +362,10 @@ create_row (EphyHistoryDialog *self,
 
   /* Row */
   row = gtk_list_box_row_new ();
-  g_object_set_data (G_OBJECT (row), "title", g_strdup (url->title));
-  g_object_set_data (G_OBJECT (row), "url", g_strdup (url->url));
+  g_object_set_data_full (G_OBJECT (row), "title", g_strdup (url->title), g_free);
+  g_object_set_data_full (G_OBJECT (row), "url", g_strdup (url->url), g_free);
+  g_object_set_data_full (G_OBJECT (row), "cursor", ephy_history_cursor_new_for_url (url),
+                          (GDestroyNotify)ephy_history_cursor_free);
 
   /* Grid */
   grid = gtk_grid_new ();
@@ -320,39 +427,6 @@ create_row (EphyHistoryDialog *self,
   return row;
 }
 
-static gboolean
-add_urls_source (EphyHistoryDialog *self)
-{
-  EphyHistoryURL *url;
-  GList *element;
-  GtkWidget *row;
-
-  if (self->urls == NULL || !self->num_fetch) {
-    self->sorter_source = 0;
-    gtk_widget_queue_draw (self->listbox);
-    return G_SOURCE_REMOVE;
-  }
-
-  element = self->urls;
-  url = element->data;
-
-  row = create_row (self, url);
-  gtk_list_box_insert (GTK_LIST_BOX(self->listbox), row, -1);
-
-  self->urls = g_list_remove_link (self->urls, element);
-  ephy_history_url_free (url);
-  g_list_free_1 (element);
-
-  self->num_fetch--;
-
-  if (!self->num_fetch) {
-    self->sorter_source = 0;
-    return G_SOURCE_REMOVE;
-  }
-
-  return G_SOURCE_CONTINUE;
-}
-
 static void
 confirmation_dialog_response_cb (GtkWidget         *dialog,
                                  int                response,
@@ -363,7 +437,6 @@ confirmation_dialog_response_cb (GtkWidget         *dialog,
   if (response == GTK_RESPONSE_ACCEPT) {
     ephy_history_service_clear (self->history_service,
                                 NULL, NULL, NULL);
-    filter_now (self);
 
     ephy_snapshot_service_delete_all_snapshots (self->snapshot_service);
   }
@@ -616,13 +689,32 @@ on_listbox_button_press_event (GtkWidget         *widget,
 }
 
 
-static gboolean
-on_urls_visited_cb (EphyHistoryService *service,
+static void
+on_urls_changed_cb (EphyHistoryService *service,
+                    GList              *changes,
                     EphyHistoryDialog  *self)
+{
+  /* A fresh first page is on its way and will include these. */
+  if (self->clear_on_next_page)
+    return;
+
+  for (GList *l = changes; l; l = l->next)
+    apply_url_change (self, l->data);
+}
+
+static void
+on_history_cleared_cb (EphyHistoryService *service,
+                       EphyHistoryDialog  *self)
 {
   filter_now (self);
+}
 
-  return FALSE;
+static void
+on_host_deleted_cb (EphyHistoryService *service,
+                    const char         *host,
+                    EphyHistoryDialog  *self)
+{
+  filter_now (self);
 }
 
 static void
@@ -633,16 +725,20 @@ set_history_service (EphyHistoryDialog  *self,
     return;
 
   if (self->history_service != NULL) {
-    g_signal_handlers_disconnect_by_func (self->history_service,
-                                          on_urls_visited_cb,
-                                          self);
+    g_signal_handlers_disconnect_by_data (self->history_service, self);
     g_clear_object (&self->history_service);
   }
 
   if (history_service != NULL) {
     self->history_service = g_object_ref (history_service);
     g_signal_connect_after (self->history_service,
-                            "urls-visited", G_CALLBACK (on_urls_visited_cb),
+                            "urls-changed", G_CALLBACK (on_urls_changed_cb),
+                            self);
+    g_signal_connect_after (self->history_service,
+                            "cleared", G_CALLBACK (on_history_cleared_cb),
+                            self);
+    g_signal_connect_after (self->history_service,
+                            "host-deleted", G_CALLBACK (on_host_deleted_cb),
                             self);
   }
 
@@ -699,12 +795,12 @@ ephy_history_dialog_dispose (GObject *object)
   }
 
   if (self->history_service != NULL)
-    g_signal_handlers_disconnect_by_func (self->history_service,
-                                          on_urls_visited_cb,
-                                          self);
+    g_signal_handlers_disconnect_by_data (self->history_service, self);
   g_clear_object (&self->history_service);
 
-  remove_pending_sorter_source (self, TRUE);
+  cancel_page_fetch (self);
+  g_clear_pointer (&self->cursor, ephy_history_cursor_free);
+  g_clear_pointer (&self->rows, g_hash_table_unref);
 
   G_OBJECT_CLASS (ephy_history_dialog_parent_class)->dispose (object);
 }
@@ -736,12 +832,8 @@ on_edge_reached (GtkScrolledWindow *scrolled,
 {
   EphyHistoryDialog *self = EPHY_HISTORY_DIALOG (user_data);
 
-  if (pos == GTK_POS_BOTTOM) {
-    remove_pending_sorter_source (self, FALSE);
-
-    self->num_fetch += NUM_FETCH_LIMIT;
-    self->sorter_source = g_idle_add ((GSourceFunc)add_urls_source, self);
-  }
+  if (pos == GTK_POS_BOTTOM)
+    fetch_next_page (self);
 }
 
 static void
@@ -823,8 +915,8 @@ ephy_history_dialog_init (EphyHistoryDialog *self)
   self->snapshot_service = ephy_snapshot_service_get_default ();
   self->cancellable = g_cancellable_new ();
 
-  self->urls = NULL;
-  self->sorter_source = 0;
+  self->has_more = TRUE;
+  self->rows = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
   gtk_list_box_set_header_func (GTK_LIST_BOX (self->listbox), box_header_func, NULL, NULL);
   ephy_gui_ensure_window_group (GTK_WINDOW (self));
@@ -39,6 +39,9 @@
 #include <gtk/gtk.h>
 #include <string.h>
 
+/* Keystrokes closer together than this are coalesced into one query. */
+#define SUGGESTIONS_QUERY_DELAY_MS 50
+
 /**
  * SECTION:ephy-location-controller
  * @short_description: An #EphyLink implementation
@@ -57,6 +60,8 @@ struct _EphyLocationController {
   gboolean sync_address_is_blocked;
   EphySearchEngineManager *search_engine_manager;
   guint num_search_engines_actions;
+  GCancellable *suggestions_cancellable;
+  guint suggestions_timeout_id;
 };
 
 static void ephy_location_controller_finalize (GObject *object);
@@ -173,20 +178,39 @@ entry_activate_cb (GtkEntry               *entry,
 }
 
 
-static void
-user_changed_cb (GtkWidget *widget, EphyLocationController *controller)
+static gboolean
+query_suggestions_cb (EphyLocationController *controller)
 {
   const char *address;
-  DzlSuggestionEntry *entry = DZL_SUGGESTION_ENTRY (ephy_location_entry_get_entry (EPHY_LOCATION_ENTRY (widget)));
+  DzlSuggestionEntry *entry = DZL_SUGGESTION_ENTRY (ephy_location_entry_get_entry (EPHY_LOCATION_ENTRY (controller->title_widget)));
   GListModel *model;
 
+  controller->suggestions_timeout_id = 0;
+
   address = dzl_suggestion_entry_get_typed_text (entry);
 
-  LOG ("user_changed_cb, address %s", address);
+  LOG ("query_suggestions_cb, address %s", address);
+
+  g_cancellable_cancel (controller->suggestions_cancellable);
+  g_clear_object (&controller->suggestions_cancellable);
+  controller->suggestions_cancellable = g_cancellable_new ();
 
   model = dzl_suggestion_entry_get_model (entry);
 
-  ephy_suggestion_model_query_async (EPHY_SUGGESTION_MODEL (model), address, NULL, NULL, NULL);
+  ephy_suggestion_model_query_async (EPHY_SUGGESTION_MODEL (model), address,
+                                     controller->suggestions_cancellable,
+                                     NULL, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+user_changed_cb (GtkWidget *widget, EphyLocationController *controller)
+{
+  g_clear_handle_id (&controller->suggestions_timeout_id, g_source_remove);
+  controller->suggestions_timeout_id = g_timeout_add (SUGGESTIONS_QUERY_DELAY_MS,
+                                                      (GSourceFunc)query_suggestions_cb,
+                                                      controller);
 }
 
 static void
@@ -411,6 +435,10 @@ ephy_location_controller_dispose (GObject *object)
   EphyLocationController *controller = EPHY_LOCATION_CONTROLLER (object);
   GtkWidget *notebook;
 
+  g_clear_handle_id (&controller->suggestions_timeout_id, g_source_remove);
+  g_cancellable_cancel (controller->suggestions_cancellable);
+  g_clear_object (&controller->suggestions_cancellable);
+
   notebook = ephy_window_get_notebook (controller->window);
 
   if (notebook == NULL ||
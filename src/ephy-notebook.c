@@ -55,6 +55,9 @@ struct _EphyNotebook {
   guint tabs_vis_notifier_id;
 
   GMenu *tab_menu;
+  GPtrArray *tab_menu_embeds; /* Embeds in tab menu order, not owned */
+  GHashTable *pending_title_updates; /* Set of embeds, not owned */
+  guint title_updates_id;
 
   guint tabs_allowed : 1;
 };
@@ -526,6 +529,8 @@ ephy_notebook_constructed (GObject *object)
   gtk_widget_show (button);
 
   notebook->tab_menu = g_menu_new ();
+  notebook->tab_menu_embeds = g_ptr_array_new ();
+  notebook->pending_title_updates = g_hash_table_new (NULL, NULL);
   /* Remove this when popover menus become scrollable. */
   gtk_menu_button_set_use_popover (GTK_MENU_BUTTON (button), TRUE);
 
@@ -551,6 +556,11 @@ ephy_notebook_finalize (GObject *object)
 
   g_list_free (notebook->focused_pages);
 
+  if (notebook->title_updates_id)
+    g_source_remove (notebook->title_updates_id);
+  g_hash_table_unref (notebook->pending_title_updates);
+  g_ptr_array_unref (notebook->tab_menu_embeds);
+
   G_OBJECT_CLASS (ephy_notebook_parent_class)->finalize (object);
 }
 
@@ -593,32 +603,77 @@ ellipsize_tab_label (const char *label)
   return result;
 }
 
+static gboolean
+tab_menu_item_is_current (EphyNotebook *notebook,
+                          int           position,
+                          const char   *label)
+{
+  g_autofree char *old_label = NULL;
+  g_autoptr(GVariant) old_target = NULL;
+
+  if (!g_menu_model_get_item_attribute (G_MENU_MODEL (notebook->tab_menu), position,
+                                        G_MENU_ATTRIBUTE_LABEL, "s", &old_label))
+    return FALSE;
+
+  old_target = g_menu_model_get_item_attribute_value (G_MENU_MODEL (notebook->tab_menu), position,
+                                                      G_MENU_ATTRIBUTE_TARGET, G_VARIANT_TYPE_UINT32);
+
+  return old_target != NULL &&
+         g_variant_get_uint32 (old_target) == (guint32)position &&
+         g_strcmp0 (old_label, label) == 0;
+}
+
+/* Brings the menu items from @first to @last (inclusive) in sync with their
+ * tabs, replacing only the ones whose title or position changed. */
 static void
-ephy_notebook_rebuild_tab_menu (EphyNotebook *notebook)
+ephy_notebook_update_tab_menu_items (EphyNotebook *notebook,
+                                     int           first,
+                                     int           last)
 {
   GMenuItem *item;
-  const char *text;
   char *ellipsized_text;
-  int num_pages;
-  GtkWidget *window;
-  GActionGroup *group;
-  GAction *action;
-  gint current_page;
-
-  g_menu_remove_all (notebook->tab_menu);
-
-  num_pages = gtk_notebook_get_n_pages (GTK_NOTEBOOK (notebook));
 
   /* TODO: Add favicon as well. Will have to ditch GMenu. :( */
-  for (int i = 0; i < num_pages; i++) {
-    text = get_nth_tab_label_text (GTK_NOTEBOOK (notebook), i);
-    ellipsized_text = ellipsize_tab_label (text);
-    item = g_menu_item_new (ellipsized_text, NULL);
-    g_menu_item_set_action_and_target (item, "win.show-tab", "u", (guint)i, NULL);
-    g_menu_append_item (notebook->tab_menu, item);
+  for (int i = first; i <= last; i++) {
+    ellipsized_text = ellipsize_tab_label (get_nth_tab_label_text (GTK_NOTEBOOK (notebook), i));
+
+    if (!tab_menu_item_is_current (notebook, i, ellipsized_text)) {
+      item = g_menu_item_new (ellipsized_text, NULL);
+      g_menu_item_set_action_and_target (item, "win.show-tab", "u", (guint)i, NULL);
+      g_menu_remove (notebook->tab_menu, i);
+      g_menu_insert_item (notebook->tab_menu, i, item);
+      g_object_unref (item);
+    }
+
     g_free (ellipsized_text);
-    g_object_unref (item);
   }
+}
+
+static void
+ephy_notebook_insert_tab_menu_item (EphyNotebook *notebook,
+                                    GtkWidget    *child,
+                                    int           position)
+{
+  char *ellipsized_text;
+  GMenuItem *item;
+
+  ellipsized_text = ellipsize_tab_label (get_nth_tab_label_text (GTK_NOTEBOOK (notebook), position));
+  item = g_menu_item_new (ellipsized_text, NULL);
+  g_menu_item_set_action_and_target (item, "win.show-tab", "u", (guint)position, NULL);
+  g_menu_insert_item (notebook->tab_menu, position, item);
+  g_ptr_array_insert (notebook->tab_menu_embeds, position, child);
+
+  g_free (ellipsized_text);
+  g_object_unref (item);
+}
+
+static void
+ephy_notebook_update_show_tab_state (EphyNotebook *notebook)
+{
+  GtkWidget *window;
+  GActionGroup *group;
+  GAction *action;
+  gint current_page;
 
   current_page = gtk_notebook_get_current_page (GTK_NOTEBOOK (notebook));
   if (current_page < 0)
@@ -634,6 +689,26 @@ ephy_notebook_rebuild_tab_menu (EphyNotebook *notebook)
   g_simple_action_set_state (G_SIMPLE_ACTION (action), g_variant_new_uint32 ((guint32)current_page));
 }
 
+static gboolean
+flush_title_updates_cb (EphyNotebook *notebook)
+{
+  GHashTableIter iter;
+  gpointer embed;
+  int position;
+
+  g_hash_table_iter_init (&iter, notebook->pending_title_updates);
+  while (g_hash_table_iter_next (&iter, &embed, NULL)) {
+    position = gtk_notebook_page_num (GTK_NOTEBOOK (notebook), embed);
+    if (position >= 0)
+      ephy_notebook_update_tab_menu_items (notebook, position, position);
+  }
+
+  g_hash_table_remove_all (notebook->pending_title_updates);
+  notebook->title_updates_id = 0;
+
+  return G_SOURCE_REMOVE;
+}
+
 static void
 sync_load_status (EphyWebView *view, GParamSpec *pspec, GtkWidget *proxy)
 {
@@ -680,12 +755,20 @@ sync_label (EphyEmbed *embed, GParamSpec *pspec, GtkWidget *label)
   gtk_widget_set_tooltip_text (label, title);
 }
 
+/* Title changes come in waves while tabs load, so they are applied to the
+ * tab menu at most once per frame. */
 static void
-rebuild_tab_menu_cb (EphyEmbed    *embed,
-                     GParamSpec   *pspec,
-                     EphyNotebook *notebook)
+tab_title_changed_cb (EphyEmbed    *embed,
+                      GParamSpec   *pspec,
+                      EphyNotebook *notebook)
 {
-  ephy_notebook_rebuild_tab_menu (notebook);
+  g_hash_table_add (notebook->pending_title_updates, embed);
+
+  if (notebook->title_updates_id == 0) {
+    notebook->title_updates_id = g_idle_add_full (GDK_PRIORITY_REDRAW - 1,
+                                                  (GSourceFunc)flush_title_updates_cb,
+                                                  notebook, NULL);
+  }
 }
 
 static void
@@ -826,7 +909,7 @@ build_tab_label (EphyNotebook *nb, EphyEmbed *embed)
   g_signal_connect_object (embed, "notify::title",
                            G_CALLBACK (sync_label), label, 0);
   g_signal_connect_object (embed, "notify::title",
-                           G_CALLBACK (rebuild_tab_menu_cb), nb, 0);
+                           G_CALLBACK (tab_title_changed_cb), nb, 0);
   g_signal_connect_object (view, "load-changed",
                            G_CALLBACK (load_changed_cb), box, 0);
   g_signal_connect_object (view, "notify::is-playing-audio",
@@ -975,7 +1058,8 @@ ephy_notebook_remove (GtkContainer *container,
   g_signal_handlers_disconnect_by_func
     (tab_widget, G_CALLBACK (sync_label), tab_label_label);
   g_signal_handlers_disconnect_by_func
-    (tab_widget, G_CALLBACK (sync_label), notebook);
+    (tab_widget, G_CALLBACK (tab_title_changed_cb), notebook);
+  g_hash_table_remove (notebook->pending_title_updates, tab_widget);
   g_signal_handlers_disconnect_by_func
     (view, G_CALLBACK (sync_load_status), tab_label);
   g_signal_handlers_disconnect_by_func
@@ -994,7 +1078,11 @@ ephy_notebook_page_added (GtkNotebook *notebook,
   if (GTK_NOTEBOOK_CLASS (ephy_notebook_parent_class)->page_added != NULL)
     GTK_NOTEBOOK_CLASS (ephy_notebook_parent_class)->page_added (notebook, child, page_num);
 
-  ephy_notebook_rebuild_tab_menu (EPHY_NOTEBOOK (notebook));
+  ephy_notebook_insert_tab_menu_item (EPHY_NOTEBOOK (notebook), child, page_num);
+  /* Only the positions of the following tabs changed. */
+  ephy_notebook_update_tab_menu_items (EPHY_NOTEBOOK (notebook), page_num + 1,
+                                       gtk_notebook_get_n_pages (notebook) - 1);
+  ephy_notebook_update_show_tab_state (EPHY_NOTEBOOK (notebook));
 }
 
 static void
@@ -1002,20 +1090,39 @@ ephy_notebook_page_removed (GtkNotebook *notebook,
                             GtkWidget   *child,
                             guint        page_num)
 {
+  EphyNotebook *self = EPHY_NOTEBOOK (notebook);
+
   if (GTK_NOTEBOOK_CLASS (ephy_notebook_parent_class)->page_removed != NULL)
     GTK_NOTEBOOK_CLASS (ephy_notebook_parent_class)->page_removed (notebook, child, page_num);
 
-  ephy_notebook_rebuild_tab_menu (EPHY_NOTEBOOK (notebook));
+  g_ptr_array_remove_index (self->tab_menu_embeds, page_num);
+  g_menu_remove (self->tab_menu, page_num);
+  ephy_notebook_update_tab_menu_items (self, page_num,
+                                       gtk_notebook_get_n_pages (notebook) - 1);
+  ephy_notebook_update_show_tab_state (self);
 }
 
 static void ephy_notebook_page_reordered (GtkNotebook *notebook,
                                           GtkWidget   *child,
                                           guint        page_num)
 {
+  EphyNotebook *self = EPHY_NOTEBOOK (notebook);
+  guint old_num = page_num;
+
   if (GTK_NOTEBOOK_CLASS (ephy_notebook_parent_class)->page_reordered != NULL)
     GTK_NOTEBOOK_CLASS (ephy_notebook_parent_class)->page_reordered (notebook, child, page_num);
 
-  ephy_notebook_rebuild_tab_menu (EPHY_NOTEBOOK (notebook));
+  g_ptr_array_find (self->tab_menu_embeds, child, &old_num);
+  if (old_num == page_num)
+    return;
+
+  g_ptr_array_remove_index (self->tab_menu_embeds, old_num);
+  g_menu_remove (self->tab_menu, old_num);
+  ephy_notebook_insert_tab_menu_item (self, child, page_num);
+
+  /* Only the tabs between the old and the new position moved. */
+  ephy_notebook_update_tab_menu_items (self, MIN (old_num, page_num), MAX (old_num, page_num));
+  ephy_notebook_update_show_tab_state (self);
 }
 
 /**
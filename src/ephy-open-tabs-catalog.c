@@ -0,0 +1,404 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ephy-open-tabs-catalog.h"
+
+#include "ephy-embed-container.h"
+#include "ephy-embed-shell.h"
+#include "ephy-embed-utils.h"
+#include "ephy-embed.h"
+#include "ephy-window.h"
+
+#include <glib/gi18n.h>
+
+/* Closed tabs are remembered for consumers that are a few versions behind.
+ * Those further behind get a full snapshot. */
+#define MAX_CLOSED_TABS 256
+
+typedef struct {
+  EphyOpenTabsCatalog *catalog;
+  EphyEmbed *embed;     /* NULL once the tab is closed. */
+  EphyWebView *view;
+  guint64 id;
+  guint64 version;      /* The catalog version of the last change. */
+  char *title;
+  char *url;
+  char *favicon;
+} CatalogTab;
+
+struct _EphyOpenTabsCatalog {
+  GObject parent_instance;
+
+  GHashTable *tabs;         /* EphyEmbed -> CatalogTab */
+  GQueue *closed_tabs;      /* CatalogTab, oldest first */
+  guint64 version;
+  guint64 next_id;
+  guint64 forgotten_version;
+};
+
+static void ephy_tabs_catalog_iface_init (EphyTabsCatalogInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (EphyOpenTabsCatalog, ephy_open_tabs_catalog, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (EPHY_TYPE_TABS_CATALOG,
+                                                ephy_tabs_catalog_iface_init))
+
+static void
+catalog_tab_disconnect (CatalogTab *tab)
+{
+  if (!tab->embed)
+    return;
+
+  g_signal_handlers_disconnect_by_data (tab->view, tab);
+  g_signal_handlers_disconnect_by_data (tab->embed, tab);
+  g_clear_object (&tab->view);
+  g_clear_object (&tab->embed);
+}
+
+static void
+catalog_tab_free (CatalogTab *tab)
+{
+  catalog_tab_disconnect (tab);
+  g_free (tab->title);
+  g_free (tab->url);
+  g_free (tab->favicon);
+  g_free (tab);
+}
+
+static gboolean
+catalog_tab_is_listed (CatalogTab *tab)
+{
+  return tab->embed &&
+         g_strcmp0 (tab->title, _(BLANK_PAGE_TITLE)) &&
+         g_strcmp0 (tab->title, _(OVERVIEW_PAGE_TITLE));
+}
+
+static EphyTabChange *
+catalog_tab_to_change (CatalogTab *tab)
+{
+  EphyTabInfo *info = NULL;
+
+  if (catalog_tab_is_listed (tab))
+    info = ephy_tab_info_new (tab->title, tab->url, tab->favicon);
+
+  return ephy_tab_change_new (tab->id, info);
+}
+
+static int
+compare_tabs (gconstpointer a,
+              gconstpointer b)
+{
+  const CatalogTab *tab_a = *(const CatalogTab **)a;
+  const CatalogTab *tab_b = *(const CatalogTab **)b;
+
+  return tab_a->id < tab_b->id ? -1 : tab_a->id > tab_b->id;
+}
+
+static GPtrArray *
+ephy_open_tabs_catalog_get_open_tabs (EphyOpenTabsCatalog *self)
+{
+  GHashTableIter iter;
+  GPtrArray *tabs;
+  gpointer tab;
+
+  tabs = g_ptr_array_sized_new (g_hash_table_size (self->tabs));
+  g_hash_table_iter_init (&iter, self->tabs);
+  while (g_hash_table_iter_next (&iter, NULL, &tab))
+    g_ptr_array_add (tabs, tab);
+
+  return tabs;
+}
+
+static void
+catalog_tab_update (CatalogTab *tab)
+{
+  WebKitFaviconDatabase *database;
+  const char *title;
+  const char *url;
+  char *favicon;
+
+  title = ephy_embed_get_title (tab->embed);
+  url = ephy_web_view_get_display_address (tab->view);
+  database = webkit_web_context_get_favicon_database (ephy_embed_shell_get_web_context (ephy_embed_shell_get_default ()));
+  favicon = webkit_favicon_database_get_favicon_uri (database, url);
+
+  if (tab->version != 0 &&
+      g_strcmp0 (tab->title, title) == 0 &&
+      g_strcmp0 (tab->url, url) == 0 &&
+      g_strcmp0 (tab->favicon, favicon) == 0) {
+    g_free (favicon);
+    return;
+  }
+
+  g_free (tab->title);
+  tab->title = g_strdup (title);
+  g_free (tab->url);
+  tab->url = g_strdup (url);
+  g_free (tab->favicon);
+  tab->favicon = favicon;
+  tab->version = ++tab->catalog->version;
+}
+
+static void
+tab_changed_cb (GObject    *object,
+                GParamSpec *pspec,
+                CatalogTab *tab)
+{
+  catalog_tab_update (tab);
+}
+
+static void
+ephy_open_tabs_catalog_add_tab (EphyOpenTabsCatalog *self,
+                                EphyEmbed           *embed)
+{
+  CatalogTab *tab;
+
+  if (g_hash_table_contains (self->tabs, embed))
+    return;
+
+  tab = g_new0 (CatalogTab, 1);
+  tab->catalog = self;
+  tab->embed = g_object_ref (embed);
+  tab->view = g_object_ref (ephy_embed_get_web_view (embed));
+  tab->id = ++self->next_id;
+  g_hash_table_insert (self->tabs, embed, tab);
+
+  g_signal_connect (tab->embed, "notify::title",
+                    G_CALLBACK (tab_changed_cb), tab);
+  g_signal_connect (tab->view, "notify::address",
+                    G_CALLBACK (tab_changed_cb), tab);
+  g_signal_connect (tab->view, "notify::icon",
+                    G_CALLBACK (tab_changed_cb), tab);
+
+  catalog_tab_update (tab);
+}
+
+static void
+ephy_open_tabs_catalog_remove_tab (EphyOpenTabsCatalog *self,
+                                   EphyEmbed           *embed)
+{
+  CatalogTab *tab;
+
+  tab = g_hash_table_lookup (self->tabs, embed);
+  if (!tab)
+    return;
+
+  g_hash_table_steal (self->tabs, embed);
+  catalog_tab_disconnect (tab);
+  g_clear_pointer (&tab->title, g_free);
+  g_clear_pointer (&tab->url, g_free);
+  g_clear_pointer (&tab->favicon, g_free);
+  tab->version = ++self->version;
+  g_queue_push_tail (self->closed_tabs, tab);
+
+  if (g_queue_get_length (self->closed_tabs) > MAX_CLOSED_TABS) {
+    tab = g_queue_pop_head (self->closed_tabs);
+    self->forgotten_version = tab->version;
+    catalog_tab_free (tab);
+  }
+}
+
+static void
+notebook_page_added_cb (GtkNotebook         *notebook,
+                        GtkWidget           *child,
+                        guint                page_num,
+                        EphyOpenTabsCatalog *self)
+{
+  ephy_open_tabs_catalog_add_tab (self, EPHY_EMBED (child));
+}
+
+static void
+notebook_page_removed_cb (GtkNotebook         *notebook,
+                          GtkWidget           *child,
+                          guint                page_num,
+                          EphyOpenTabsCatalog *self)
+{
+  ephy_open_tabs_catalog_remove_tab (self, EPHY_EMBED (child));
+}
+
+static void
+window_added_cb (GtkApplication      *application,
+                 GtkWindow           *window,
+                 EphyOpenTabsCatalog *self)
+{
+  GtkWidget *notebook;
+  GList *tabs;
+
+  if (!EPHY_IS_WINDOW (window))
+    return;
+
+  /* Closing a window removes all of its pages, so there is no need to
+   * watch for removed windows. */
+  notebook = ephy_window_get_notebook (EPHY_WINDOW (window));
+  g_signal_connect_object (notebook, "page-added",
+                           G_CALLBACK (notebook_page_added_cb), self, 0);
+  g_signal_connect_object (notebook, "page-removed",
+                           G_CALLBACK (notebook_page_removed_cb), self, 0);
+
+  tabs = ephy_embed_container_get_children (EPHY_EMBED_CONTAINER (window));
+  for (GList *l = tabs; l && l->data; l = l->next)
+    ephy_open_tabs_catalog_add_tab (self, l->data);
+  g_list_free (tabs);
+}
+
+static GList *
+ephy_open_tabs_catalog_get_tabs_info (EphyTabsCatalog *catalog)
+{
+  EphyOpenTabsCatalog *self = EPHY_OPEN_TABS_CATALOG (catalog);
+  GPtrArray *tabs;
+  GList *tabs_info = NULL;
+
+  tabs = ephy_open_tabs_catalog_get_open_tabs (self);
+  g_ptr_array_sort (tabs, compare_tabs);
+
+  for (guint i = 0; i < tabs->len; i++) {
+    CatalogTab *tab = g_ptr_array_index (tabs, i);
+
+    if (catalog_tab_is_listed (tab))
+      tabs_info = g_list_prepend (tabs_info,
+                                  ephy_tab_info_new (tab->title, tab->url, tab->favicon));
+  }
+
+  g_ptr_array_unref (tabs);
+
+  return g_list_reverse (tabs_info);
+}
+
+static guint64
+ephy_open_tabs_catalog_get_version (EphyTabsCatalog *catalog)
+{
+  return EPHY_OPEN_TABS_CATALOG (catalog)->version;
+}
+
+static gboolean
+ephy_open_tabs_catalog_get_changes (EphyTabsCatalog  *catalog,
+                                    guint64           since_version,
+                                    GList           **changes,
+                                    guint64          *version)
+{
+  EphyOpenTabsCatalog *self = EPHY_OPEN_TABS_CATALOG (catalog);
+  GPtrArray *tabs;
+  gboolean is_complete;
+
+  *changes = NULL;
+  *version = self->version;
+  is_complete = since_version >= self->forgotten_version && since_version <= self->version;
+
+  tabs = ephy_open_tabs_catalog_get_open_tabs (self);
+  if (is_complete) {
+    /* Closed tabs are ordered by version, only the newest ones matter. */
+    for (GList *l = self->closed_tabs->tail; l && l->data; l = l->prev) {
+      CatalogTab *tab = l->data;
+
+      if (tab->version <= since_version)
+        break;
+      g_ptr_array_add (tabs, tab);
+    }
+  }
+  g_ptr_array_sort (tabs, compare_tabs);
+
+  for (guint i = 0; i < tabs->len; i++) {
+    CatalogTab *tab = g_ptr_array_index (tabs, i);
+
+    if (is_complete ? tab->version > since_version : catalog_tab_is_listed (tab))
+      *changes = g_list_prepend (*changes, catalog_tab_to_change (tab));
+  }
+  *changes = g_list_reverse (*changes);
+
+  g_ptr_array_unref (tabs);
+
+  return is_complete;
+}
+
+static void
+ephy_tabs_catalog_iface_init (EphyTabsCatalogInterface *iface)
+{
+  iface->get_tabs_info = ephy_open_tabs_catalog_get_tabs_info;
+  iface->get_version = ephy_open_tabs_catalog_get_version;
+  iface->get_changes = ephy_open_tabs_catalog_get_changes;
+}
+
+static void
+ephy_open_tabs_catalog_dispose (GObject *object)
+{
+  EphyOpenTabsCatalog *self = EPHY_OPEN_TABS_CATALOG (object);
+
+  if (self->tabs)
+    g_hash_table_remove_all (self->tabs);
+
+  G_OBJECT_CLASS (ephy_open_tabs_catalog_parent_class)->dispose (object);
+}
+
+static void
+ephy_open_tabs_catalog_finalize (GObject *object)
+{
+  EphyOpenTabsCatalog *self = EPHY_OPEN_TABS_CATALOG (object);
+
+  g_hash_table_unref (self->tabs);
+  g_queue_free_full (self->closed_tabs, (GDestroyNotify)catalog_tab_free);
+
+  G_OBJECT_CLASS (ephy_open_tabs_catalog_parent_class)->finalize (object);
+}
+
+static void
+ephy_open_tabs_catalog_class_init (EphyOpenTabsCatalogClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = ephy_open_tabs_catalog_dispose;
+  object_class->finalize = ephy_open_tabs_catalog_finalize;
+}
+
+static void
+ephy_open_tabs_catalog_init (EphyOpenTabsCatalog *self)
+{
+  self->tabs = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)catalog_tab_free);
+  self->closed_tabs = g_queue_new ();
+}
+
+/**
+ * ephy_open_tabs_catalog_new:
+ * @application: the #GtkApplication whose windows to watch
+ *
+ * Creates an #EphyTabsCatalog of the tabs open in the windows of
+ * @application. It is kept up to date as tabs are opened, closed or
+ * navigated, so that asking for it does not walk every tab.
+ *
+ * Return value: (transfer full): a new #EphyOpenTabsCatalog
+ **/
+EphyOpenTabsCatalog *
+ephy_open_tabs_catalog_new (GtkApplication *application)
+{
+  EphyOpenTabsCatalog *self;
+  GList *windows;
+
+  g_assert (GTK_IS_APPLICATION (application));
+
+  self = g_object_new (EPHY_TYPE_OPEN_TABS_CATALOG, NULL);
+
+  g_signal_connect_object (application, "window-added",
+                           G_CALLBACK (window_added_cb), self, 0);
+
+  windows = gtk_application_get_windows (application);
+  for (GList *l = windows; l && l->data; l = l->next)
+    window_added_cb (application, l->data, self);
+
+  return self;
+}
@@ -37,6 +37,7 @@
 #include "ephy-settings.h"
 #include "ephy-shell.h"
 #include "ephy-string.h"
+#include "ephy-trace.h"
 #include "ephy-window.h"
 
 #include <glib/gi18n.h>
@@ -874,6 +875,7 @@ save_session_sync (GTask        *task,
   xmlTextWriterPtr writer;
   GList *w;
   int ret = -1;
+  EPHY_TRACE_BEGIN (begin);
 
   /* If any web view has an insane URL, then something has probably gone wrong
    * inside WebKit. For instance, if the web process is nonfunctional, the UI
@@ -896,8 +898,6 @@ save_session_sync (GTask        *task,
   if (ret < 0)
     goto out;
 
-  START_PROFILER ("Saving session")
-
   ret = xmlTextWriterStartDocument (writer, "1.0", NULL, NULL);
   if (ret < 0)
     goto out;
@@ -948,7 +948,7 @@ save_session_sync (GTask        *task,
 
   g_task_return_boolean (task, TRUE);
 
-  STOP_PROFILER ("Saving session")
+  EPHY_TRACE_END (begin, EPHY_TRACE_SESSION, "save");
 }
 
 static EphySession *
@@ -32,6 +32,7 @@
 #include "ephy-history-dialog.h"
 #include "ephy-lockdown.h"
 #include "ephy-notification.h"
+#include "ephy-open-tabs-catalog.h"
 #include "ephy-prefs.h"
 #include "ephy-session.h"
 #include "ephy-settings.h"
@@ -57,6 +58,7 @@ struct _EphyShell {
   EphyBookmarksManager *bookmarks_manager;
   EphyHistoryManager *history_manager;
   EphyOpenTabsManager *open_tabs_manager;
+  EphySuggestionIndex *suggestion_index;
   GNetworkMonitor *network_monitor;
   GtkWidget *history_dialog;
   GObject *prefs_dialog;
@@ -688,6 +690,7 @@ ephy_shell_dispose (GObject *object)
   g_clear_object (&shell->bookmarks_manager);
   g_clear_object (&shell->history_manager);
   g_clear_object (&shell->open_tabs_manager);
+  g_clear_object (&shell->suggestion_index);
 
   g_slist_free_full (shell->open_uris_idle_ids, remove_open_uris_idle_cb);
   shell->open_uris_idle_ids = NULL;
@@ -919,12 +922,43 @@ ephy_shell_get_open_tabs_manager (EphyShell *shell)
 {
   g_assert (EPHY_IS_SHELL (shell));
 
-  if (shell->open_tabs_manager == NULL)
-    shell->open_tabs_manager = ephy_open_tabs_manager_new (EPHY_TABS_CATALOG (shell));
+  if (shell->open_tabs_manager == NULL) {
+    EphyOpenTabsCatalog *catalog = ephy_open_tabs_catalog_new (GTK_APPLICATION (shell));
+
+    shell->open_tabs_manager = ephy_open_tabs_manager_new (EPHY_TABS_CATALOG (catalog));
+    g_object_unref (catalog);
+  }
 
   return shell->open_tabs_manager;
 }
 
+/**
+ * ephy_shell_get_suggestion_index:
+ * @shell: the #EphyShell
+ *
+ * Returns the index of the global history and bookmarks that all address
+ * bar suggestions are looked up in.
+ *
+ * Return value: (transfer none): An #EphySuggestionIndex.
+ */
+EphySuggestionIndex *
+ephy_shell_get_suggestion_index (EphyShell *shell)
+{
+  EphyEmbedShell *embed_shell;
+  EphyHistoryService *service;
+
+  g_assert (EPHY_IS_SHELL (shell));
+
+  if (shell->suggestion_index == NULL) {
+    embed_shell = EPHY_EMBED_SHELL (shell);
+    service = ephy_embed_shell_get_global_history_service (embed_shell);
+    shell->suggestion_index = ephy_suggestion_index_new (service,
+                                                         ephy_shell_get_bookmarks_manager (shell));
+  }
+
+  return shell->suggestion_index;
+}
+
 /**
  * ephy_shell_get_net_monitor:
  *
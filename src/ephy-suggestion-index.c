@@ -0,0 +1,1002 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ephy-suggestion-index.h"
+
+#include <string.h>
+
+/* The most visited URLs are indexed; the rest of the history is only
+ * searched when the index can't fill the suggestions. */
+#define MAX_INDEXED_HISTORY_URLS 5000
+
+/* Substrings are found through the byte trigrams of the folded address and
+ * title: a word can only be contained in an entry that has all of its
+ * trigrams. */
+#define TRIGRAM_LENGTH 3
+
+typedef enum {
+  STATE_IDLE,
+  STATE_BUILDING,
+  STATE_READY
+} IndexState;
+
+typedef struct {
+  char *url;
+  char *title;
+  int visit_count;
+  gboolean is_bookmark;
+  /* Bookmarks not loaded yet are only looked up once they match a query, so
+   * that indexing does not load every bookmark. */
+  EphyBookmark *bookmark;
+  char *folded_url;
+  char *folded_title;
+  guint heap_position;
+} Entry;
+
+typedef enum {
+  BOOKMARK_UPDATED,
+  BOOKMARK_URL_CHANGED,
+  BOOKMARK_REMOVED
+} BookmarkChange;
+
+/* A change seen while the index was being built. */
+typedef struct {
+  EphyHistoryURLChange *change;
+  EphyBookmark *bookmark;
+  BookmarkChange bookmark_change;
+} PendingChange;
+
+typedef struct {
+  GPtrArray *entries;
+  GHashTable *postings;
+} BuildData;
+
+struct _EphySuggestionIndex {
+  GObject parent_instance;
+
+  EphyHistoryService *history_service;
+  EphyBookmarksManager *bookmarks_manager;
+
+  IndexState state;
+  gboolean build_is_stale;
+  GCancellable *cancellable;
+  GQueue pending;
+
+  GHashTable *history;   /* url -> Entry */
+  GHashTable *bookmarks; /* url -> Entry */
+  GHashTable *postings;  /* trigram -> set of Entry */
+  /* History entries, least visited first, to pick the one to evict. */
+  GPtrArray *eviction_heap;
+  /* Whether every history URL is indexed. If not, none of the missing ones
+   * was visited more often than unindexed_visit_count. */
+  gboolean history_complete;
+  int unindexed_visit_count;
+
+  /* Matches of the last query. Typing narrows them down, so they are
+   * searched instead of the whole index when the query grows. */
+  char *last_query;
+  GPtrArray *last_matches;
+};
+
+G_DEFINE_TYPE (EphySuggestionIndex, ephy_suggestion_index, G_TYPE_OBJECT)
+
+static Entry *
+entry_new (const char   *url,
+           const char   *title,
+           int           visit_count,
+           gboolean      is_bookmark,
+           EphyBookmark *bookmark)
+{
+  Entry *entry = g_new0 (Entry, 1);
+
+  entry->url = g_strdup (url);
+  entry->title = g_strdup (title ? title : "");
+  entry->visit_count = visit_count;
+  entry->is_bookmark = is_bookmark;
+  entry->bookmark = bookmark ? g_object_ref (bookmark) : NULL;
+
+  return entry;
+}
+
+static void
+entry_fold (Entry *entry)
+{
+  entry->folded_url = g_utf8_casefold (entry->url, -1);
+  entry->folded_title = g_utf8_casefold (entry->title, -1);
+}
+
+static void
+entry_free (Entry *entry)
+{
+  g_free (entry->url);
+  g_free (entry->title);
+  g_free (entry->folded_url);
+  g_free (entry->folded_title);
+  g_clear_object (&entry->bookmark);
+  g_free (entry);
+}
+
+static void
+pending_change_free (PendingChange *pending)
+{
+  g_clear_pointer (&pending->change, ephy_history_url_change_free);
+  g_clear_object (&pending->bookmark);
+  g_free (pending);
+}
+
+static void
+build_data_free (BuildData *data)
+{
+  g_ptr_array_unref (data->entries);
+  g_hash_table_unref (data->postings);
+  g_free (data);
+}
+
+static inline gpointer
+trigram_at (const char *text)
+{
+  /* Never 0, as text is a C string. */
+  return GUINT_TO_POINTER ((guint)(guchar)text[0] << 16 |
+                           (guint)(guchar)text[1] << 8 |
+                           (guint)(guchar)text[2]);
+}
+
+static GHashTable *
+postings_new (void)
+{
+  return g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_hash_table_unref);
+}
+
+static void
+postings_add_text (GHashTable *postings,
+                   const char *text,
+                   Entry      *entry)
+{
+  gsize length = strlen (text);
+
+  for (gsize i = 0; i + TRIGRAM_LENGTH <= length; i++) {
+    gpointer trigram = trigram_at (text + i);
+    GHashTable *entries = g_hash_table_lookup (postings, trigram);
+
+    if (!entries) {
+      entries = g_hash_table_new (NULL, NULL);
+      g_hash_table_insert (postings, trigram, entries);
+    }
+    g_hash_table_add (entries, entry);
+  }
+}
+
+static void
+postings_add (GHashTable *postings,
+              Entry      *entry)
+{
+  postings_add_text (postings, entry->folded_url, entry);
+  postings_add_text (postings, entry->folded_title, entry);
+}
+
+static void
+postings_remove_text (GHashTable *postings,
+                      const char *text,
+                      Entry      *entry)
+{
+  gsize length = strlen (text);
+
+  for (gsize i = 0; i + TRIGRAM_LENGTH <= length; i++) {
+    gpointer trigram = trigram_at (text + i);
+    GHashTable *entries = g_hash_table_lookup (postings, trigram);
+
+    if (entries && g_hash_table_remove (entries, entry) && g_hash_table_size (entries) == 0)
+      g_hash_table_remove (postings, trigram);
+  }
+}
+
+static void
+postings_remove (GHashTable *postings,
+                 Entry      *entry)
+{
+  postings_remove_text (postings, entry->folded_url, entry);
+  postings_remove_text (postings, entry->folded_title, entry);
+}
+
+static void
+heap_swap (GPtrArray *heap,
+           guint      i,
+           guint      j)
+{
+  Entry *entry_i = heap->pdata[i];
+  Entry *entry_j = heap->pdata[j];
+
+  heap->pdata[i] = entry_j;
+  heap->pdata[j] = entry_i;
+  entry_j->heap_position = i;
+  entry_i->heap_position = j;
+}
+
+static void
+heap_sift_up (GPtrArray *heap,
+              guint      i)
+{
+  while (i > 0) {
+    guint parent = (i - 1) / 2;
+
+    if (((Entry *)heap->pdata[parent])->visit_count <= ((Entry *)heap->pdata[i])->visit_count)
+      break;
+
+    heap_swap (heap, i, parent);
+    i = parent;
+  }
+}
+
+static void
+heap_sift_down (GPtrArray *heap,
+                guint      i)
+{
+  for (;;) {
+    guint least = i;
+    guint left = 2 * i + 1;
+    guint right = 2 * i + 2;
+
+    if (left < heap->len &&
+        ((Entry *)heap->pdata[left])->visit_count < ((Entry *)heap->pdata[least])->visit_count)
+      least = left;
+    if (right < heap->len &&
+        ((Entry *)heap->pdata[right])->visit_count < ((Entry *)heap->pdata[least])->visit_count)
+      least = right;
+    if (least == i)
+      break;
+
+    heap_swap (heap, i, least);
+    i = least;
+  }
+}
+
+static void
+heap_push (GPtrArray *heap,
+           Entry     *entry)
+{
+  entry->heap_position = heap->len;
+  g_ptr_array_add (heap, entry);
+  heap_sift_up (heap, entry->heap_position);
+}
+
+static void
+heap_update (GPtrArray *heap,
+             Entry     *entry)
+{
+  heap_sift_up (heap, entry->heap_position);
+  heap_sift_down (heap, entry->heap_position);
+}
+
+static void
+heap_remove (GPtrArray *heap,
+             Entry     *entry)
+{
+  guint position = entry->heap_position;
+  Entry *last;
+
+  g_assert (heap->pdata[position] == entry);
+
+  last = g_ptr_array_remove_index (heap, heap->len - 1);
+  if (last == entry)
+    return;
+
+  heap->pdata[position] = last;
+  last->heap_position = position;
+  heap_update (heap, last);
+}
+
+static void
+clear_pending (EphySuggestionIndex *self)
+{
+  g_queue_foreach (&self->pending, (GFunc)pending_change_free, NULL);
+  g_queue_clear (&self->pending);
+}
+
+static void
+forget_last_query (EphySuggestionIndex *self)
+{
+  g_clear_pointer (&self->last_query, g_free);
+  g_clear_pointer (&self->last_matches, g_ptr_array_unref);
+}
+
+/* Takes an entry that is already folded. */
+static void
+insert_entry (EphySuggestionIndex *self,
+              Entry               *entry)
+{
+  if (entry->is_bookmark) {
+    g_hash_table_insert (self->bookmarks, entry->url, entry);
+  } else {
+    g_hash_table_insert (self->history, entry->url, entry);
+    heap_push (self->eviction_heap, entry);
+  }
+}
+
+static void
+add_entry (EphySuggestionIndex *self,
+           Entry               *entry)
+{
+  forget_last_query (self);
+
+  entry_fold (entry);
+  postings_add (self->postings, entry);
+  insert_entry (self, entry);
+}
+
+static void
+remove_entry (EphySuggestionIndex *self,
+              Entry               *entry)
+{
+  forget_last_query (self);
+
+  postings_remove (self->postings, entry);
+  if (entry->is_bookmark) {
+    g_hash_table_remove (self->bookmarks, entry->url);
+  } else {
+    heap_remove (self->eviction_heap, entry);
+    g_hash_table_remove (self->history, entry->url);
+  }
+}
+
+static void
+add_bookmark_entry_cb (EphyBookmark *bookmark,
+                       const char   *url,
+                       const char   *title,
+                       GPtrArray    *entries)
+{
+  g_ptr_array_add (entries, entry_new (url, title, 0, TRUE, bookmark));
+}
+
+static void
+reload_bookmarks (EphySuggestionIndex *self)
+{
+  g_autoptr (GPtrArray) entries = g_ptr_array_new ();
+  GHashTableIter iter;
+  Entry *entry;
+
+  g_hash_table_iter_init (&iter, self->bookmarks);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry))
+    g_ptr_array_add (entries, entry);
+  for (guint i = 0; i < entries->len; i++)
+    remove_entry (self, entries->pdata[i]);
+
+  g_ptr_array_set_size (entries, 0);
+  ephy_bookmarks_manager_foreach_url_and_title (self->bookmarks_manager,
+                                                (EphyBookmarksManagerForeachFunc)add_bookmark_entry_cb,
+                                                entries);
+  for (guint i = 0; i < entries->len; i++)
+    add_entry (self, entries->pdata[i]);
+}
+
+static Entry *
+find_bookmark_entry (EphySuggestionIndex *self,
+                     EphyBookmark        *bookmark)
+{
+  GHashTableIter iter;
+  Entry *entry;
+
+  g_hash_table_iter_init (&iter, self->bookmarks);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry)) {
+    if (entry->bookmark == bookmark)
+      return entry;
+  }
+
+  return NULL;
+}
+
+static void
+index_bookmark (EphySuggestionIndex *self,
+                EphyBookmark        *bookmark,
+                BookmarkChange       change)
+{
+  Entry *entry;
+
+  if (change == BOOKMARK_URL_CHANGED) {
+    /* Entries are keyed by address, so the old one can only be found if
+     * the bookmark was looked up already. Otherwise start over. */
+    entry = find_bookmark_entry (self, bookmark);
+    if (!entry) {
+      reload_bookmarks (self);
+      return;
+    }
+  } else {
+    entry = g_hash_table_lookup (self->bookmarks, ephy_bookmark_get_url (bookmark));
+  }
+
+  if (entry)
+    remove_entry (self, entry);
+
+  if (change != BOOKMARK_REMOVED)
+    add_entry (self, entry_new (ephy_bookmark_get_url (bookmark),
+                                ephy_bookmark_get_title (bookmark),
+                                0, TRUE, bookmark));
+}
+
+static void
+index_history_change (EphySuggestionIndex  *self,
+                      EphyHistoryURLChange *change)
+{
+  EphyHistoryURL *url = change->url;
+  Entry *entry;
+  Entry *least;
+
+  entry = g_hash_table_lookup (self->history, url->url);
+
+  if (change->type == EPHY_HISTORY_URL_CHANGE_DELETED) {
+    if (entry)
+      remove_entry (self, entry);
+    return;
+  }
+
+  if (entry && g_strcmp0 (entry->title, url->title ? url->title : "") == 0) {
+    entry->visit_count = url->visit_count;
+    heap_update (self->eviction_heap, entry);
+    return;
+  }
+
+  if (entry) {
+    remove_entry (self, entry);
+  } else if (g_hash_table_size (self->history) >= MAX_INDEXED_HISTORY_URLS) {
+    /* Keep the most visited URLs, and remember how popular the ones left
+     * out can be. */
+    least = self->eviction_heap->pdata[0];
+    self->history_complete = FALSE;
+
+    if (url->visit_count <= least->visit_count) {
+      self->unindexed_visit_count = MAX (self->unindexed_visit_count, url->visit_count);
+      return;
+    }
+
+    self->unindexed_visit_count = MAX (self->unindexed_visit_count, least->visit_count);
+    remove_entry (self, least);
+  }
+
+  add_entry (self, entry_new (url->url, url->title, url->visit_count, FALSE, NULL));
+}
+
+static void
+reset (EphySuggestionIndex *self)
+{
+  if (self->state == STATE_BUILDING) {
+    self->build_is_stale = TRUE;
+    return;
+  }
+
+  forget_last_query (self);
+  g_ptr_array_set_size (self->eviction_heap, 0);
+  g_hash_table_remove_all (self->postings);
+  g_hash_table_remove_all (self->history);
+  g_hash_table_remove_all (self->bookmarks);
+  self->state = STATE_IDLE;
+}
+
+static void
+build_thread (GTask        *task,
+              gpointer      source_object,
+              BuildData    *data,
+              GCancellable *cancellable)
+{
+  for (guint i = 0; i < data->entries->len; i++) {
+    Entry *entry = data->entries->pdata[i];
+
+    entry_fold (entry);
+    postings_add (data->postings, entry);
+  }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+build_cb (EphySuggestionIndex *self,
+          GAsyncResult        *result,
+          gpointer             user_data)
+{
+  BuildData *data = g_task_get_task_data (G_TASK (result));
+  PendingChange *pending;
+
+  if (self->build_is_stale) {
+    g_ptr_array_foreach (data->entries, (GFunc)entry_free, NULL);
+    clear_pending (self);
+    self->build_is_stale = FALSE;
+    self->state = STATE_IDLE;
+    return;
+  }
+
+  for (guint i = 0; i < data->entries->len; i++)
+    insert_entry (self, data->entries->pdata[i]);
+
+  g_hash_table_unref (self->postings);
+  self->postings = g_steal_pointer (&data->postings);
+  data->postings = postings_new ();
+
+  self->state = STATE_READY;
+
+  while ((pending = g_queue_pop_head (&self->pending))) {
+    if (pending->change)
+      index_history_change (self, pending->change);
+    else
+      index_bookmark (self, pending->bookmark, pending->bookmark_change);
+    pending_change_free (pending);
+  }
+}
+
+static void
+history_loaded_cb (EphyHistoryService  *service,
+                   gboolean             success,
+                   GList               *urls,
+                   EphySuggestionIndex *self)
+{
+  BuildData *data;
+  GTask *task;
+  guint n_urls = 0;
+  int least_visit_count = 0;
+
+  data = g_new (BuildData, 1);
+  data->entries = g_ptr_array_new ();
+  data->postings = postings_new ();
+
+  /* Sorted by visit count, most visited first. */
+  for (GList *l = urls; l; l = l->next) {
+    EphyHistoryURL *url = l->data;
+
+    g_ptr_array_add (data->entries, entry_new (url->url, url->title, url->visit_count, FALSE, NULL));
+    least_visit_count = url->visit_count;
+    n_urls++;
+  }
+  self->history_complete = success && n_urls < MAX_INDEXED_HISTORY_URLS;
+  self->unindexed_visit_count = self->history_complete ? 0 : least_visit_count;
+
+  ephy_bookmarks_manager_foreach_url_and_title (self->bookmarks_manager,
+                                                (EphyBookmarksManagerForeachFunc)add_bookmark_entry_cb,
+                                                data->entries);
+
+  /* Case folding thousands of strings is the expensive part. */
+  task = g_task_new (self, NULL, (GAsyncReadyCallback)build_cb, NULL);
+  g_task_set_source_tag (task, history_loaded_cb);
+  g_task_set_task_data (task, data, (GDestroyNotify)build_data_free);
+  g_task_run_in_thread (task, (GTaskThreadFunc)build_thread);
+  g_object_unref (task);
+}
+
+static void
+start_build (EphySuggestionIndex *self)
+{
+  g_assert (self->state == STATE_IDLE);
+
+  self->state = STATE_BUILDING;
+
+  ephy_history_service_find_urls (self->history_service,
+                                  0, 0,
+                                  MAX_INDEXED_HISTORY_URLS, 0,
+                                  NULL,
+                                  EPHY_HISTORY_SORT_MOST_VISITED,
+                                  self->cancellable,
+                                  (EphyHistoryJobCallback)history_loaded_cb,
+                                  self);
+}
+
+static void
+bookmark_changed (EphySuggestionIndex *self,
+                  EphyBookmark        *bookmark,
+                  BookmarkChange       change)
+{
+  PendingChange *pending;
+
+  switch (self->state) {
+    case STATE_IDLE:
+      break;
+    case STATE_BUILDING:
+      pending = g_new0 (PendingChange, 1);
+      pending->bookmark = g_object_ref (bookmark);
+      pending->bookmark_change = change;
+      g_queue_push_tail (&self->pending, pending);
+      break;
+    case STATE_READY:
+      index_bookmark (self, bookmark, change);
+      break;
+    default:
+      g_assert_not_reached ();
+  }
+}
+
+static void
+bookmark_updated_cb (EphyBookmarksManager *manager,
+                     EphyBookmark         *bookmark,
+                     EphySuggestionIndex  *self)
+{
+  bookmark_changed (self, bookmark, BOOKMARK_UPDATED);
+}
+
+static void
+bookmark_url_changed_cb (EphyBookmarksManager *manager,
+                         EphyBookmark         *bookmark,
+                         EphySuggestionIndex  *self)
+{
+  bookmark_changed (self, bookmark, BOOKMARK_URL_CHANGED);
+}
+
+static void
+bookmark_removed_cb (EphyBookmarksManager *manager,
+                     EphyBookmark         *bookmark,
+                     EphySuggestionIndex  *self)
+{
+  bookmark_changed (self, bookmark, BOOKMARK_REMOVED);
+}
+
+static void
+urls_changed_cb (EphyHistoryService  *service,
+                 GList               *changes,
+                 EphySuggestionIndex *self)
+{
+  for (GList *l = changes; l; l = l->next) {
+    EphyHistoryURLChange *change = l->data;
+    PendingChange *pending;
+
+    switch (self->state) {
+      case STATE_IDLE:
+        return;
+      case STATE_BUILDING:
+        pending = g_new0 (PendingChange, 1);
+        pending->change = ephy_history_url_change_new (change->type, change->url);
+        g_queue_push_tail (&self->pending, pending);
+        break;
+      case STATE_READY:
+        index_history_change (self, change);
+        break;
+      default:
+        g_assert_not_reached ();
+    }
+  }
+}
+
+static void
+history_cleared_cb (EphyHistoryService  *service,
+                    EphySuggestionIndex *self)
+{
+  reset (self);
+}
+
+static void
+host_deleted_cb (EphyHistoryService  *service,
+                 const char          *host,
+                 EphySuggestionIndex *self)
+{
+  reset (self);
+}
+
+static void
+ephy_suggestion_index_finalize (GObject *object)
+{
+  EphySuggestionIndex *self = EPHY_SUGGESTION_INDEX (object);
+
+  g_cancellable_cancel (self->cancellable);
+  g_clear_object (&self->cancellable);
+
+  clear_pending (self);
+
+  forget_last_query (self);
+  g_ptr_array_unref (self->eviction_heap);
+  g_hash_table_unref (self->postings);
+  g_hash_table_unref (self->history);
+  g_hash_table_unref (self->bookmarks);
+
+  g_clear_object (&self->history_service);
+  g_clear_object (&self->bookmarks_manager);
+
+  G_OBJECT_CLASS (ephy_suggestion_index_parent_class)->finalize (object);
+}
+
+static void
+ephy_suggestion_index_class_init (EphySuggestionIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ephy_suggestion_index_finalize;
+}
+
+static void
+ephy_suggestion_index_init (EphySuggestionIndex *self)
+{
+  self->cancellable = g_cancellable_new ();
+  g_queue_init (&self->pending);
+  self->history = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         NULL, (GDestroyNotify)entry_free);
+  self->bookmarks = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           NULL, (GDestroyNotify)entry_free);
+  self->postings = postings_new ();
+  self->eviction_heap = g_ptr_array_new ();
+}
+
+/**
+ * ephy_suggestion_index_new:
+ * @history_service: the history to index
+ * @bookmarks_manager: the bookmarks to index
+ *
+ * Creates an in-memory index of all bookmarks and of the most visited
+ * history URLs. The index is built off the main thread the first
+ * time it is queried, and kept up to date from then on. Bookmarks are
+ * indexed by address and title only, and are not loaded until they match
+ * a query.
+ *
+ * Returns: (transfer full): a new #EphySuggestionIndex
+ **/
+EphySuggestionIndex *
+ephy_suggestion_index_new (EphyHistoryService   *history_service,
+                           EphyBookmarksManager *bookmarks_manager)
+{
+  EphySuggestionIndex *self;
+
+  g_assert (EPHY_IS_HISTORY_SERVICE (history_service));
+  g_assert (EPHY_IS_BOOKMARKS_MANAGER (bookmarks_manager));
+
+  self = g_object_new (EPHY_TYPE_SUGGESTION_INDEX, NULL);
+  self->history_service = g_object_ref (history_service);
+  self->bookmarks_manager = g_object_ref (bookmarks_manager);
+
+  g_signal_connect_object (history_service, "urls-changed",
+                           G_CALLBACK (urls_changed_cb), self, 0);
+  g_signal_connect_object (history_service, "cleared",
+                           G_CALLBACK (history_cleared_cb), self, 0);
+  g_signal_connect_object (history_service, "host-deleted",
+                           G_CALLBACK (host_deleted_cb), self, 0);
+
+  g_signal_connect_object (bookmarks_manager, "bookmark-added",
+                           G_CALLBACK (bookmark_updated_cb), self, 0);
+  g_signal_connect_object (bookmarks_manager, "bookmark-title-changed",
+                           G_CALLBACK (bookmark_updated_cb), self, 0);
+  g_signal_connect_object (bookmarks_manager, "bookmark-url-changed",
+                           G_CALLBACK (bookmark_url_changed_cb), self, 0);
+  g_signal_connect_object (bookmarks_manager, "bookmark-removed",
+                           G_CALLBACK (bookmark_removed_cb), self, 0);
+
+  return self;
+}
+
+gboolean
+ephy_suggestion_index_is_ready (EphySuggestionIndex *self)
+{
+  g_assert (EPHY_IS_SUGGESTION_INDEX (self));
+
+  return self->state == STATE_READY;
+}
+
+/**
+ * ephy_suggestion_index_terms_match:
+ * @terms: the case-folded words of a query
+ * @folded_url: the case-folded address of a page
+ * @folded_title: the case-folded title of a page
+ *
+ * The matching rule of the index, for callers that filter suggestions on
+ * their own.
+ *
+ * Returns: whether every word of @terms is contained in either the address
+ * or the title
+ **/
+gboolean
+ephy_suggestion_index_terms_match (char       **terms,
+                                   const char  *folded_url,
+                                   const char  *folded_title)
+{
+  for (char **term = terms; *term; term++) {
+    if (**term == '\0')
+      continue;
+
+    if (!strstr (folded_url, *term) && !strstr (folded_title, *term))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+entry_matches (Entry  *entry,
+               char  **terms)
+{
+  return ephy_suggestion_index_terms_match (terms, entry->folded_url, entry->folded_title);
+}
+
+static int
+compare_bookmarks (gconstpointer a,
+                   gconstpointer b)
+{
+  return ephy_bookmark_bookmarks_compare_func (*(EphyBookmark **)a, *(EphyBookmark **)b);
+}
+
+static int
+compare_visit_counts (gconstpointer a,
+                      gconstpointer b)
+{
+  const Entry *entry_a = *(Entry **)a;
+  const Entry *entry_b = *(Entry **)b;
+
+  return entry_b->visit_count - entry_a->visit_count;
+}
+
+static void
+add_if_matches (Entry      *entry,
+                char      **terms,
+                GPtrArray  *matches)
+{
+  if (entry_matches (entry, terms))
+    g_ptr_array_add (matches, entry);
+}
+
+/* Returns the smallest set of entries that all matches of @terms are in,
+ * or %NULL if no word is long enough to have a trigram. @no_match is set
+ * when a trigram of some word appears nowhere. */
+static GHashTable *
+find_candidates (EphySuggestionIndex  *self,
+                 char                **terms,
+                 gboolean             *no_match)
+{
+  GHashTable *candidates = NULL;
+
+  *no_match = FALSE;
+
+  for (char **term = terms; *term; term++) {
+    gsize length = strlen (*term);
+
+    for (gsize i = 0; i + TRIGRAM_LENGTH <= length; i++) {
+      GHashTable *entries = g_hash_table_lookup (self->postings, trigram_at (*term + i));
+
+      if (!entries) {
+        *no_match = TRUE;
+        return NULL;
+      }
+
+      if (!candidates || g_hash_table_size (entries) < g_hash_table_size (candidates))
+        candidates = entries;
+    }
+  }
+
+  return candidates;
+}
+
+static EphyBookmark *
+entry_get_bookmark (EphySuggestionIndex *self,
+                    Entry               *entry)
+{
+  EphyBookmark *bookmark;
+
+  if (!entry->bookmark) {
+    bookmark = ephy_bookmarks_manager_get_bookmark_by_url (self->bookmarks_manager, entry->url);
+    entry->bookmark = bookmark ? g_object_ref (bookmark) : NULL;
+  }
+
+  return entry->bookmark;
+}
+
+/**
+ * ephy_suggestion_index_query:
+ * @self: an #EphySuggestionIndex
+ * @query: the text typed by the user
+ * @history_limit: the maximum number of history URLs to return
+ * @bookmarks: (out) (transfer container): the matching bookmarks
+ * @history_urls: (out) (transfer full) (element-type EphyHistoryURL): the
+ *   most visited matching history URLs
+ * @history_complete: (out): whether the database can't have better
+ *   history matches than @history_urls
+ *
+ * Finds the bookmarks and history URLs whose title or address contains
+ * every word of @query, ignoring case, like the history database does.
+ * Only the entries that have every trigram of the words are compared, so
+ * a full scan is left for queries whose words are all shorter than that.
+ *
+ * Returns: %FALSE if the index is not ready yet, in which case it starts
+ * being built and nothing is returned
+ **/
+gboolean
+ephy_suggestion_index_query (EphySuggestionIndex  *self,
+                             const char           *query,
+                             guint                 history_limit,
+                             GPtrArray           **bookmarks,
+                             GList               **history_urls,
+                             gboolean             *history_complete)
+{
+  g_autofree char *folded = NULL;
+  char **terms;
+  GPtrArray *matches;
+  GPtrArray *history;
+  GHashTable *candidates;
+  GHashTableIter iter;
+  gboolean no_match;
+  Entry *entry;
+
+  g_assert (EPHY_IS_SUGGESTION_INDEX (self));
+  g_assert (query != NULL);
+
+  if (self->state != STATE_READY) {
+    if (self->state == STATE_IDLE)
+      start_build (self);
+    return FALSE;
+  }
+
+  *bookmarks = g_ptr_array_new ();
+  *history_urls = NULL;
+  *history_complete = TRUE;
+
+  folded = g_utf8_casefold (query, -1);
+  if (strspn (folded, " ") == strlen (folded))
+    return TRUE;
+
+  terms = g_strsplit (folded, " ", -1);
+  matches = g_ptr_array_new ();
+
+  candidates = find_candidates (self, terms, &no_match);
+
+  if (no_match) {
+    /* Some word has a trigram that no entry has. */
+  } else if (self->last_query && g_str_has_prefix (folded, self->last_query) &&
+             (!candidates || self->last_matches->len < g_hash_table_size (candidates))) {
+    /* Each word of the previous query is contained in a word of this one,
+     * so nothing outside its matches can match. */
+    for (guint i = 0; i < self->last_matches->len; i++)
+      add_if_matches (self->last_matches->pdata[i], terms, matches);
+  } else if (candidates) {
+    g_hash_table_iter_init (&iter, candidates);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&entry, NULL))
+      add_if_matches (entry, terms, matches);
+  } else {
+    g_hash_table_iter_init (&iter, self->history);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry))
+      add_if_matches (entry, terms, matches);
+    g_hash_table_iter_init (&iter, self->bookmarks);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry))
+      add_if_matches (entry, terms, matches);
+  }
+
+  history = g_ptr_array_new ();
+  for (guint i = 0; i < matches->len; i++) {
+    entry = matches->pdata[i];
+
+    if (!entry->is_bookmark)
+      g_ptr_array_add (history, entry);
+    else if (entry_get_bookmark (self, entry))
+      g_ptr_array_add (*bookmarks, entry->bookmark);
+  }
+
+  g_ptr_array_sort (*bookmarks, compare_bookmarks);
+
+  /* URLs left out of the index were visited at most unindexed_visit_count
+   * times, so a full page of matches visited at least that often is as good
+   * as what the database would give. */
+  g_ptr_array_sort (history, compare_visit_counts);
+  for (guint i = MIN (history->len, history_limit); i > 0; i--) {
+    entry = history->pdata[i - 1];
+
+    *history_urls = g_list_prepend (*history_urls,
+                                    ephy_history_url_new (entry->url, entry->title,
+                                                          entry->visit_count, 0, 0));
+  }
+  *history_complete = self->history_complete ||
+                      (history_limit > 0 && history->len >= history_limit &&
+                       ((Entry *)history->pdata[history_limit - 1])->visit_count >= self->unindexed_visit_count);
+
+  g_free (self->last_query);
+  self->last_query = g_steal_pointer (&folded);
+  g_clear_pointer (&self->last_matches, g_ptr_array_unref);
+  self->last_matches = matches;
+
+  g_ptr_array_free (history, TRUE);
+  g_strfreev (terms);
+
+  return TRUE;
+}
@@ -0,0 +1,48 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ephy-bookmarks-manager.h"
+#include "ephy-history-service.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define EPHY_TYPE_SUGGESTION_INDEX (ephy_suggestion_index_get_type ())
+
+G_DECLARE_FINAL_TYPE (EphySuggestionIndex, ephy_suggestion_index, EPHY, SUGGESTION_INDEX, GObject)
+
+EphySuggestionIndex *ephy_suggestion_index_new      (EphyHistoryService    *history_service,
+                                                     EphyBookmarksManager  *bookmarks_manager);
+gboolean             ephy_suggestion_index_is_ready (EphySuggestionIndex   *self);
+gboolean             ephy_suggestion_index_query    (EphySuggestionIndex   *self,
+                                                     const char            *query,
+                                                     guint                  history_limit,
+                                                     GPtrArray            **bookmarks,
+                                                     GList                **history_urls,
+                                                     gboolean              *history_complete);
+
+gboolean             ephy_suggestion_index_terms_match (char                 **terms,
+                                                        const char            *folded_url,
+                                                        const char            *folded_title);
+
+G_END_DECLS
@@ -21,20 +21,28 @@
 
 #include "ephy-embed-shell.h"
 #include "ephy-search-engine-manager.h"
+#include "ephy-shell.h"
 #include "ephy-suggestion.h"
+#include "ephy-suggestion-index.h"
 
 #include <dazzle.h>
 #include <glib/gi18n.h>
 
 #define MAX_COMPLETION_HISTORY_URLS 8
+#define MAX_DIFF_CELLS (64 * 1024)
 
 struct _EphySuggestionModel {
   GObject               parent;
   EphyHistoryService   *history_service;
   EphyBookmarksManager *bookmarks_manager;
+  EphySuggestionIndex  *index;
   GSequence            *items;
   gchar               **search_terms;
   GCancellable         *icon_cancellable;
+  GCancellable         *query_cancellable;
+  GCancellable         *caller_cancellable;
+  gulong                caller_cancelled_id;
+  GTask                *query_task;
 };
 
 enum {
@@ -51,6 +59,65 @@ G_DEFINE_TYPE_WITH_CODE (EphySuggestionModel, ephy_suggestion_model, G_TYPE_OBJE
 
 static GParamSpec *properties[N_PROPS];
 
+static void unlink_caller_cancellable (EphySuggestionModel *self);
+
+static gboolean
+abort_query (GTask *task)
+{
+  EphySuggestionModel *self = g_task_get_source_object (task);
+
+  /* The history service drops cancelled jobs without calling back. */
+  if (self->query_task == task) {
+    g_clear_object (&self->query_task);
+    unlink_caller_cancellable (self);
+    g_task_return_error_if_cancelled (task);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+caller_cancelled_cb (GCancellable *cancellable,
+                     GTask        *task)
+{
+  EphySuggestionModel *self = g_task_get_source_object (task);
+
+  g_cancellable_cancel (self->query_cancellable);
+
+  /* Disconnecting from within this handler would deadlock. */
+  g_idle_add_full (G_PRIORITY_DEFAULT, (GSourceFunc)abort_query,
+                   g_object_ref (task), g_object_unref);
+}
+
+/* The history job only knows about query_cancellable, so cancelling the
+ * caller's cancellable is forwarded to it until the query is over. */
+static void
+link_caller_cancellable (EphySuggestionModel *self,
+                         GTask               *task)
+{
+  GCancellable *cancellable = g_task_get_cancellable (task);
+
+  if (!cancellable)
+    return;
+
+  self->caller_cancellable = g_object_ref (cancellable);
+  self->caller_cancelled_id = g_cancellable_connect (cancellable,
+                                                     G_CALLBACK (caller_cancelled_cb),
+                                                     g_object_ref (task),
+                                                     g_object_unref);
+}
+
+static void
+unlink_caller_cancellable (EphySuggestionModel *self)
+{
+  if (!self->caller_cancellable)
+    return;
+
+  g_cancellable_disconnect (self->caller_cancellable, self->caller_cancelled_id);
+  self->caller_cancelled_id = 0;
+  g_clear_object (&self->caller_cancellable);
+}
+
 static void
 ephy_suggestion_model_finalize (GObject *object)
 {
@@ -58,11 +125,15 @@ ephy_suggestion_model_finalize (GObject *object)
 
   g_clear_object (&self->bookmarks_manager);
   g_clear_object (&self->history_service);
+  g_clear_object (&self->index);
   g_clear_pointer (&self->items, g_sequence_free);
 
   g_cancellable_cancel (self->icon_cancellable);
   g_clear_object (&self->icon_cancellable);
 
+  unlink_caller_cancellable (self);
+  g_clear_object (&self->query_cancellable);
+
   g_strfreev (self->search_terms);
 
   G_OBJECT_CLASS (ephy_suggestion_model_parent_class)->finalize (object);
@@ -138,6 +209,7 @@ static void
 ephy_suggestion_model_init (EphySuggestionModel *self)
 {
   self->items = g_sequence_new (g_object_unref);
+  self->icon_cancellable = g_cancellable_new ();
 }
 
 static GType
@@ -193,127 +265,144 @@ static void
 update_search_terms (EphySuggestionModel *self,
                      const char          *text)
 {
+  g_autofree char *folded = NULL;
+
   g_assert (EPHY_IS_SUGGESTION_MODEL (self));
 
   g_strfreev (self->search_terms);
 
-  self->search_terms = g_strsplit (text, " ", -1);
+  folded = g_utf8_casefold (text, -1);
+  self->search_terms = g_strsplit (folded, " ", -1);
 }
 
-static gboolean
-should_add_bookmark_to_model (EphySuggestionModel *self,
-                              const char          *search_string,
-                              const char          *title,
-                              const char          *location)
+static void
+icon_loaded_cb (GObject      *source,
+                GAsyncResult *result,
+                gpointer      user_data)
 {
-  gboolean ret = TRUE;
-
-  if (self->search_terms) {
-    guint len = g_strv_length (self->search_terms);
-    guint i;
-
-    for (i = 0; i < len; i++) {
-      gchar *str = self->search_terms[i];
+  EphySuggestion *suggestion = EPHY_SUGGESTION (user_data);
+  cairo_surface_t *favicon;
 
-      if (!strstr (str, title ? title : "") && !strstr (str, location ? location : "")) {
-        ret = FALSE;
-        break;
-      }
-    }
+  favicon = ephy_favicon_cache_load_finish (EPHY_FAVICON_CACHE (source), result, NULL);
+  if (favicon) {
+    ephy_suggestion_set_favicon (suggestion, favicon);
+    cairo_surface_destroy (favicon);
   }
 
-  return ret;
+  g_object_unref (suggestion);
 }
 
 static void
-icon_loaded_cb (GObject      *source,
-                GAsyncResult *result,
-                gpointer      user_data)
+load_favicon (EphySuggestionModel *model,
+              EphySuggestion      *suggestion)
 {
-  WebKitFaviconDatabase *database = WEBKIT_FAVICON_DATABASE (source);
-  EphySuggestion *suggestion;
-  GError *error = NULL;
+  EphyEmbedShell *shell = ephy_embed_shell_get_default ();
+  EphyFaviconCache *cache = ephy_embed_shell_get_favicon_cache (shell);
+  const char *url = ephy_suggestion_get_uri (suggestion);
   cairo_surface_t *favicon;
-  gdouble x_scale, y_scale;
-  int x, y;
-
-  favicon = webkit_favicon_database_get_favicon_finish (database, result, &error);
 
-  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) || favicon == NULL)
+  if (ephy_favicon_cache_lookup (cache, url, &favicon)) {
+    if (favicon)
+      ephy_suggestion_set_favicon (suggestion, favicon);
     return;
+  }
+
+  ephy_favicon_cache_load_async (cache, url,
+                                 model->icon_cancellable,
+                                 icon_loaded_cb,
+                                 g_object_ref (suggestion));
+}
 
-  suggestion = EPHY_SUGGESTION (user_data);
+typedef struct {
+  char      **terms;
+  GPtrArray  *found;
+  GPtrArray  *unloaded_urls;
+} FindBookmarksData;
 
-  x = cairo_image_surface_get_width (favicon);
-  y = cairo_image_surface_get_height (favicon);
-  x_scale = (gdouble)x / 16;
-  y_scale = (gdouble)y / 16;
+static void
+find_bookmark_cb (EphyBookmark      *bookmark,
+                  const char        *url,
+                  const char        *title,
+                  FindBookmarksData *data)
+{
+  g_autofree char *folded_url = g_utf8_casefold (url, -1);
+  g_autofree char *folded_title = g_utf8_casefold (title ? title : "", -1);
 
-  cairo_surface_set_device_scale (favicon, x_scale, y_scale);
+  if (!ephy_suggestion_index_terms_match (data->terms, folded_url, folded_title))
+    return;
 
-  ephy_suggestion_set_favicon (suggestion, favicon);
+  if (bookmark)
+    g_ptr_array_add (data->found, bookmark);
+  else
+    g_ptr_array_add (data->unloaded_urls, g_strdup (url));
 }
 
-static void
-load_favicon (EphySuggestionModel *model,
-              EphySuggestion      *suggestion,
-              const char          *url)
+static int
+compare_bookmarks (gconstpointer a,
+                   gconstpointer b)
 {
-  EphyEmbedShell *shell = ephy_embed_shell_get_default ();
-  WebKitWebContext *context = ephy_embed_shell_get_web_context (shell);
-  WebKitFaviconDatabase *database = webkit_web_context_get_favicon_database (context);
-
-  webkit_favicon_database_get_favicon (database,
-                                       url,
-                                       model->icon_cancellable,
-                                       icon_loaded_cb,
-                                       suggestion);
+  return ephy_bookmark_bookmarks_compare_func (*(EphyBookmark **)a, *(EphyBookmark **)b);
 }
 
-static guint
-add_bookmarks (EphySuggestionModel *self,
-               const char          *query)
+/* Only used until the suggestion index is ready. Matches like the index,
+ * and loads only the bookmarks that match. */
+static GPtrArray *
+find_bookmarks (EphySuggestionModel *self)
 {
-  GSequence *bookmarks;
-  guint added = 0;
+  FindBookmarksData data;
 
-  bookmarks = ephy_bookmarks_manager_get_bookmarks (self->bookmarks_manager);
+  data.terms = self->search_terms;
+  data.found = g_ptr_array_new ();
+  data.unloaded_urls = g_ptr_array_new_with_free_func (g_free);
 
-  for (GSequenceIter *iter = g_sequence_get_begin_iter (bookmarks);
-       !g_sequence_iter_is_end (iter);
-       iter = g_sequence_iter_next (iter)) {
+  ephy_bookmarks_manager_foreach_url_and_title (self->bookmarks_manager,
+                                                (EphyBookmarksManagerForeachFunc)find_bookmark_cb,
+                                                &data);
+
+  for (guint i = 0; i < data.unloaded_urls->len; i++) {
     EphyBookmark *bookmark;
-    const char *url, *title;
 
-    bookmark = g_sequence_get (iter);
+    bookmark = ephy_bookmarks_manager_get_bookmark_by_url (self->bookmarks_manager,
+                                                           data.unloaded_urls->pdata[i]);
+    if (bookmark)
+      g_ptr_array_add (data.found, bookmark);
+  }
+  g_ptr_array_sort (data.found, compare_bookmarks);
+
+  g_ptr_array_unref (data.unloaded_urls);
+
+  return data.found;
+}
+
+static void
+add_bookmarks (GPtrArray  *items,
+               GPtrArray  *bookmarks,
+               const char *query)
+{
+
+  for (guint i = 0; i < bookmarks->len; i++) {
+    EphyBookmark *bookmark = bookmarks->pdata[i];
+    EphySuggestion *suggestion;
+    const char *url, *title;
+    g_autofree gchar *escaped_title = NULL;
+    g_autofree gchar *markup = NULL;
 
     url = ephy_bookmark_get_url (bookmark);
     title = ephy_bookmark_get_title (bookmark);
 
-    if (should_add_bookmark_to_model (self, query, title, url)) {
-      EphySuggestion *suggestion;
-      g_autofree gchar *escaped_title = NULL;
-      g_autofree gchar *markup = NULL;
-
-      escaped_title = g_markup_escape_text (title, -1);
-      markup = dzl_fuzzy_highlight (escaped_title, query, FALSE);
-      suggestion = ephy_suggestion_new (markup, url);
-      load_favicon (self, suggestion, url);
+    escaped_title = g_markup_escape_text (title, -1);
+    markup = dzl_fuzzy_highlight (escaped_title, query, FALSE);
+    suggestion = ephy_suggestion_new (markup, url);
 
-      g_sequence_append (self->items, suggestion);
-      added++;
-    }
+    g_ptr_array_add (items, suggestion);
   }
-
-  return added;
 }
 
-static guint
-add_history (EphySuggestionModel *self,
-             GList               *urls,
-             const char          *query)
+static void
+add_history (GPtrArray  *items,
+             GList      *urls,
+             const char *query)
 {
-  guint added = 0;
 
   for (const GList *p = urls; p != NULL; p = p->next) {
     EphyHistoryURL *url = (EphyHistoryURL *)p->data;
@@ -324,23 +413,18 @@ add_history (EphySuggestionModel *self,
     escaped_title = g_markup_escape_text (url->title, -1);
     markup = dzl_fuzzy_highlight (escaped_title, query, FALSE);
     suggestion = ephy_suggestion_new (markup, url->url);
-    load_favicon (self, suggestion, url->url);
 
-    g_sequence_append (self->items, suggestion);
-    added++;
+    g_ptr_array_add (items, suggestion);
   }
-
-  return added;
 }
 
-static guint
-add_search_engines (EphySuggestionModel *self,
-                    const char          *query)
+static void
+add_search_engines (GPtrArray  *items,
+                    const char *query)
 {
   EphyEmbedShell *shell;
   EphySearchEngineManager *manager;
   char **engines;
-  guint added = 0;
 
   shell = ephy_embed_shell_get_default ();
   manager = ephy_embed_shell_get_search_engine_manager (shell);
@@ -356,58 +440,231 @@ add_search_engines (EphySuggestionModel *self,
     escaped_title = g_markup_escape_text (engines[i], -1);
     markup = dzl_fuzzy_highlight (escaped_title, query, FALSE);
     suggestion = ephy_suggestion_new_without_subtitle (markup, address);
-    load_favicon (self, suggestion, address);
 
-    g_sequence_append (self->items, suggestion);
-    added++;
+    g_ptr_array_add (items, suggestion);
 
     g_free (address);
   }
 
   g_strfreev (engines);
+}
+
+typedef struct {
+  char *query;
+  GPtrArray *bookmarks;
+} QueryData;
+
+static void
+query_data_free (QueryData *data)
+{
+  g_free (data->query);
+  g_clear_pointer (&data->bookmarks, g_ptr_array_unref);
+  g_free (data);
+}
 
-  return added;
+/* Titles are highlighted for the query, so they change with every
+ * keystroke; rows are matched by address and retitled in place. */
+static gboolean
+suggestions_equal (DzlSuggestion *a,
+                   DzlSuggestion *b)
+{
+  return g_strcmp0 (dzl_suggestion_get_id (a), dzl_suggestion_get_id (b)) == 0;
 }
 
+/* Replaces @removed items at @position with @added items of @items. */
 static void
-query_completed_cb (EphyHistoryService *service,
-                    gboolean            success,
-                    gpointer            result_data,
-                    gpointer            user_data)
-{
-  GTask *task = user_data;
-  EphySuggestionModel *self;
-  const gchar *query;
-  GList *urls;
-  guint removed;
-  guint added = 0;
+splice_items (EphySuggestionModel *self,
+              guint                position,
+              guint                removed,
+              GPtrArray           *items,
+              guint                first,
+              guint                added)
+{
+  GSequenceIter *iter;
 
-  self = g_task_get_source_object (task);
-  query = g_task_get_task_data (task);
-  urls = (GList *)result_data;
+  iter = g_sequence_get_iter_at_pos (self->items, position);
+  if (removed > 0) {
+    GSequenceIter *end = g_sequence_get_iter_at_pos (self->items, position + removed);
 
-  g_cancellable_cancel (self->icon_cancellable);
-  g_clear_object (&self->icon_cancellable);
+    g_sequence_remove_range (iter, end);
+    iter = end;
+  }
 
-  self->icon_cancellable = g_cancellable_new ();
+  for (guint i = first; i < first + added; i++) {
+    EphySuggestion *suggestion = items->pdata[i];
 
-  removed = g_sequence_get_length (self->items);
+    load_favicon (self, suggestion);
+    g_sequence_insert_before (iter, g_object_ref (suggestion));
+  }
 
-  g_clear_pointer (&self->items, g_sequence_free);
-  self->items = g_sequence_new (g_object_unref);
+  g_list_model_items_changed (G_LIST_MODEL (self), position, removed, added);
+}
+
+/* Emits items-changed only for the ranges that differ, so that the list
+ * box keeps the rows of unchanged items and their favicons. Lists are
+ * short, so the longest common subsequence is computed outright; past
+ * MAX_DIFF_CELLS the middle is replaced at once. */
+static void
+splice_changed_items (EphySuggestionModel *self,
+                      GPtrArray           *items)
+{
+  g_autoptr (GPtrArray) old = NULL;
+  g_autofree guint *lcs = NULL;
+  guint n_old, n_new;
+  guint prefix = 0;
+  guint suffix = 0;
+  guint position, removed, added;
+  guint i, j;
+
+  old = g_ptr_array_new_with_free_func (g_object_unref);
+  for (GSequenceIter *iter = g_sequence_get_begin_iter (self->items);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
+    g_ptr_array_add (old, g_object_ref (g_sequence_get (iter)));
+
+  while (prefix < old->len && prefix < items->len &&
+         suggestions_equal (old->pdata[prefix], items->pdata[prefix]))
+    prefix++;
+  while (suffix < old->len - prefix && suffix < items->len - prefix &&
+         suggestions_equal (old->pdata[old->len - suffix - 1], items->pdata[items->len - suffix - 1]))
+    suffix++;
+
+  n_old = old->len - prefix - suffix;
+  n_new = items->len - prefix - suffix;
+  if (n_old == 0 && n_new == 0)
+    return;
+
+  if (n_old == 0 || n_new == 0 || (gsize)(n_old + 1) * (n_new + 1) > MAX_DIFF_CELLS) {
+    splice_items (self, prefix, n_old, items, prefix, n_new);
+    return;
+  }
+
+#define LCS(i, j) lcs[(i) * (n_new + 1) + (j)]
+  /* LCS (i, j) is the length of the longest common subsequence of the
+   * middle parts from old item i and new item j on. */
+  lcs = g_new0 (guint, (n_old + 1) * (n_new + 1));
+  for (i = n_old; i-- > 0;) {
+    for (j = n_new; j-- > 0;) {
+      if (suggestions_equal (old->pdata[prefix + i], items->pdata[prefix + j]))
+        LCS (i, j) = LCS (i + 1, j + 1) + 1;
+      else
+        LCS (i, j) = MAX (LCS (i + 1, j), LCS (i, j + 1));
+    }
+  }
+
+  position = prefix;
+  removed = added = 0;
+  i = j = 0;
+  while (i < n_old || j < n_new) {
+    if (i < n_old && j < n_new &&
+        suggestions_equal (old->pdata[prefix + i], items->pdata[prefix + j])) {
+      if (removed > 0 || added > 0) {
+        splice_items (self, position, removed, items, prefix + j - added, added);
+        position += added;
+        removed = added = 0;
+      }
+      position++;
+      i++;
+      j++;
+    } else if (j == n_new || (i < n_old && LCS (i + 1, j) >= LCS (i, j + 1))) {
+      removed++;
+      i++;
+    } else {
+      added++;
+      j++;
+    }
+  }
+#undef LCS
+
+  if (removed > 0 || added > 0)
+    splice_items (self, position, removed, items, prefix + j - added, added);
+}
+
+/* Moves the model to @items. */
+static void
+update_items (EphySuggestionModel *self,
+              GPtrArray           *items)
+{
+  GSequenceIter *iter;
+
+  splice_changed_items (self, items);
+
+  /* Kept rows still show the highlighting of the previous query. */
+  iter = g_sequence_get_begin_iter (self->items);
+  for (guint i = 0; i < items->len; i++, iter = g_sequence_iter_next (iter)) {
+    EphySuggestion *kept = g_sequence_get (iter);
+    EphySuggestion *suggestion = items->pdata[i];
+
+    if (kept != suggestion &&
+        g_strcmp0 (dzl_suggestion_get_title (DZL_SUGGESTION (kept)),
+                   dzl_suggestion_get_title (DZL_SUGGESTION (suggestion))) != 0)
+      ephy_suggestion_set_title (kept, ephy_suggestion_get_unescaped_title (suggestion));
+  }
+}
+
+static void
+update_items_for_query (EphySuggestionModel *self,
+                        const char          *query,
+                        GPtrArray           *bookmarks,
+                        GList               *urls)
+{
+  g_autoptr (GPtrArray) items = NULL;
+
+  items = g_ptr_array_new_with_free_func (g_object_unref);
 
   if (strlen (query) > 0) {
-    added = add_bookmarks (self, query);
-    added += add_history (self, urls, query);
-    added += add_search_engines (self, query);
+    add_bookmarks (items, bookmarks, query);
+    add_history (items, urls, query);
+    add_search_engines (items, query);
+  }
+
+  update_items (self, items);
+}
+
+static void
+query_completed_cb (EphyHistoryService  *service,
+                    gboolean             success,
+                    gpointer             result_data,
+                    EphySuggestionModel *self)
+{
+  GTask *task;
+  QueryData *data;
+
+  /* Superseded queries are cancelled, so this is the newest one. */
+  task = g_steal_pointer (&self->query_task);
+  g_assert (task != NULL);
+  unlink_caller_cancellable (self);
+
+  if (g_task_return_error_if_cancelled (task)) {
+    g_object_unref (task);
+    return;
   }
 
-  g_list_model_items_changed (G_LIST_MODEL (self), 0, removed, added);
+  data = g_task_get_task_data (task);
+  if (!data->bookmarks)
+    data->bookmarks = find_bookmarks (self);
+
+  update_items_for_query (self, data->query, data->bookmarks, (GList *)result_data);
 
   g_task_return_boolean (task, TRUE);
   g_object_unref (task);
 }
 
+static EphySuggestionIndex *
+get_suggestion_index (EphySuggestionModel *self)
+{
+  EphyShell *shell = ephy_shell_get_default ();
+
+  /* All models over the global history and bookmarks share the index of
+   * the shell. */
+  if (shell &&
+      self->history_service == ephy_embed_shell_get_global_history_service (EPHY_EMBED_SHELL (shell)) &&
+      self->bookmarks_manager == ephy_shell_get_bookmarks_manager (shell))
+    return g_object_ref (ephy_shell_get_suggestion_index (shell));
+
+  return ephy_suggestion_index_new (self->history_service, self->bookmarks_manager);
+}
+
 void
 ephy_suggestion_model_query_async (EphySuggestionModel *self,
                                    const gchar         *query,
@@ -416,6 +673,10 @@ ephy_suggestion_model_query_async (EphySuggestionModel *self,
                                    gpointer             user_data)
 {
   GTask *task = NULL;
+  QueryData *data;
+  GPtrArray *bookmarks;
+  GList *urls;
+  gboolean history_complete;
   char **strings;
   GList *qlist = NULL;
 
@@ -423,25 +684,65 @@ ephy_suggestion_model_query_async (EphySuggestionModel *self,
   g_assert (query != NULL);
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
+  /* Drop the previous query, so that its results never reach the model. The
+   * history service won't run it if it is still queued. */
+  if (self->query_task) {
+    g_cancellable_cancel (self->query_cancellable);
+    g_task_return_new_error (self->query_task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                             "Superseded by a newer query");
+    g_clear_object (&self->query_task);
+  }
+  unlink_caller_cancellable (self);
+  g_clear_object (&self->query_cancellable);
+  self->query_cancellable = g_cancellable_new ();
+
   task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, ephy_suggestion_model_query_async);
-  g_task_set_task_data (task, g_strdup (query), g_free);
+
+  data = g_new0 (QueryData, 1);
+  data->query = g_strdup (query);
+  g_task_set_task_data (task, data, (GDestroyNotify)query_data_free);
+
+  update_search_terms (self, query);
+
+  if (!self->index)
+    self->index = get_suggestion_index (self);
+
+  if (ephy_suggestion_index_query (self->index, query, MAX_COMPLETION_HISTORY_URLS,
+                                   &bookmarks, &urls, &history_complete)) {
+    if (history_complete) {
+      if (!g_task_return_error_if_cancelled (task)) {
+        update_items_for_query (self, query, bookmarks, urls);
+        g_task_return_boolean (task, TRUE);
+      }
+      g_ptr_array_unref (bookmarks);
+      ephy_history_url_list_free (urls);
+      g_object_unref (task);
+      return;
+    }
+
+    /* Deep history might have better matches. */
+    data->bookmarks = bookmarks;
+    ephy_history_url_list_free (urls);
+  }
 
   /* Split the search string. */
   strings = g_strsplit (query, " ", -1);
   for (guint i = 0; strings[i]; i++)
     qlist = g_list_append (qlist, g_strdup (strings[i]));
 
-  update_search_terms (self, query);
+  /* The task keeps self alive until the query completes or is dropped. */
+  self->query_task = task;
+  link_caller_cancellable (self, task);
 
   ephy_history_service_find_urls (self->history_service,
                                   0, 0,
                                   MAX_COMPLETION_HISTORY_URLS, 0,
                                   qlist,
                                   EPHY_HISTORY_SORT_MOST_VISITED,
-                                  cancellable,
+                                  self->query_cancellable,
                                   (EphyHistoryJobCallback)query_completed_cb,
-                                  task);
+                                  self);
 
   g_strfreev (strings);
 }
@@ -198,85 +198,81 @@ response_cb (PrefsAutofillDialog *dialog,
 }
 
 static void
-init_personal_data (PrefsAutofillDialog *dialog)
+init_personal_data (PrefsAutofillDialog *dialog,
+                    GHashTable *values)
 {
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_FIRSTNAME,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->firstname_entry);
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_LASTNAME,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->lastname_entry);
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_USERNAME,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->username_entry);
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_EMAIL,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->email_entry);
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_PHONE,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->phone_entry);
-
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_STREET_ADDRESS,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->street_address_entry);
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_ORGANIZATION,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->organization_entry);
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_POSTAL_CODE,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->postal_code_entry);
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_COUNTRY_CODE,
-                     prefs_autofill_utils_get_combo_box_text_cb,
-                     dialog->country_combo_box_text);
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_STATE,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->state_entry);
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_CITY,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->city_entry);
+  prefs_autofill_utils_set_entry (dialog->firstname_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_FIRSTNAME));
+  prefs_autofill_utils_set_entry (dialog->lastname_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_LASTNAME));
+  prefs_autofill_utils_set_entry (dialog->username_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_USERNAME));
+  prefs_autofill_utils_set_entry (dialog->email_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_EMAIL));
+  prefs_autofill_utils_set_entry (dialog->phone_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_PHONE));
+
+  prefs_autofill_utils_set_entry (dialog->street_address_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_STREET_ADDRESS));
+  prefs_autofill_utils_set_entry (dialog->organization_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_ORGANIZATION));
+  prefs_autofill_utils_set_entry (dialog->postal_code_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_POSTAL_CODE));
+  prefs_autofill_utils_set_combo_box_text (dialog->country_combo_box_text,
+                                           ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_COUNTRY_CODE));
+  prefs_autofill_utils_set_entry (dialog->state_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_STATE));
+  prefs_autofill_utils_set_entry (dialog->city_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_CITY));
 }
 
 static void
-init_card_data (PrefsAutofillDialog *dialog)
+init_card_data (PrefsAutofillDialog *dialog,
+                GHashTable *values)
 {
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_CARD_EXPDATE_MONTH_M,
-                     prefs_autofill_utils_get_combo_box_text_cb,
-                     dialog->expdate_month_combo_box_text);
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_CARD_EXPDATE_YEAR_YY,
-                     prefs_autofill_utils_get_combo_box_text_cb,
-                     dialog->expdate_year_combo_box_text);
-
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_NAME_ON_CARD,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->name_on_card_entry);
+  prefs_autofill_utils_set_combo_box_text (dialog->expdate_month_combo_box_text,
+                                           ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_CARD_EXPDATE_MONTH_M));
+  prefs_autofill_utils_set_combo_box_text (dialog->expdate_year_combo_box_text,
+                                           ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_CARD_EXPDATE_YEAR_YY));
+  prefs_autofill_utils_set_entry (dialog->name_on_card_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_NAME_ON_CARD));
+  prefs_autofill_utils_set_entry (dialog->card_number_entry,
+                                  ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_CARD_NUMBER));
+  prefs_autofill_utils_set_combo_box_text (dialog->card_type_combo_box_text,
+                                           ephy_autofill_lookup (values, EPHY_AUTOFILL_FIELD_CARD_TYPE_CODE));
+}
 
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_CARD_NUMBER,
-                     prefs_autofill_utils_get_entry_cb,
-                     dialog->card_number_entry);
+static void
+get_all_cb (GObject *source_object,
+            GAsyncResult *res,
+            gpointer user_data)
+{
+  GWeakRef *dialog_ref = user_data;
+  PrefsAutofillDialog *dialog = g_weak_ref_get (dialog_ref);
+  GHashTable *values = ephy_autofill_get_all_finish (res);
+
+  /* The dialog might have been closed before the values arrived. */
+  if (dialog != NULL && values != NULL) {
+    init_personal_data (dialog, values);
+    init_card_data (dialog, values);
+  }
 
-  ephy_autofill_get (EPHY_AUTOFILL_FIELD_CARD_TYPE_CODE,
-                     prefs_autofill_utils_get_combo_box_text_cb,
-                     dialog->card_type_combo_box_text);
+  g_clear_pointer (&values, g_hash_table_unref);
+  g_clear_object (&dialog);
+  g_weak_ref_clear (dialog_ref);
+  g_free (dialog_ref);
 }
 
 static void
 prefs_autofill_dialog_init (PrefsAutofillDialog *dialog)
 {
+  GWeakRef *dialog_ref;
+
   gtk_widget_init_template (GTK_WIDGET (dialog));
 
-  init_personal_data (dialog);
-  init_card_data (dialog);
+  dialog_ref = g_new0 (GWeakRef, 1);
+  g_weak_ref_init (dialog_ref, dialog);
+  ephy_autofill_get_all (get_all_cb, dialog_ref);
 }
 
 static void
@@ -25,31 +25,19 @@
 #include "ephy-autofill.h"
 
 void
-prefs_autofill_utils_get_combo_box_text_cb (GObject *source_object,
-                                            GAsyncResult *res,
-                                            gpointer user_data)
+prefs_autofill_utils_set_combo_box_text (GtkComboBoxText *combo_box,
+                                         const char *autofill_value)
 {
-  GtkComboBoxText *combo_box = user_data;
-  char *autofill_value = ephy_autofill_get_finish (res);
-
-  if (autofill_value != NULL) {
+  if (autofill_value != NULL)
     gtk_combo_box_set_active_id (GTK_COMBO_BOX (combo_box), autofill_value);
-    g_free (autofill_value);
-  }
 }
 
 void
-prefs_autofill_utils_get_entry_cb (GObject *source_object,
-                                   GAsyncResult *res,
-                                   gpointer user_data)
+prefs_autofill_utils_set_entry (GtkEntry *entry,
+                                const char *autofill_value)
 {
-  GtkEntry *entry = user_data;
-  char *autofill_value = ephy_autofill_get_finish (res);
-
-  if (autofill_value != NULL) {
+  if (autofill_value != NULL)
     gtk_entry_set_text (entry, autofill_value);
-    g_free (autofill_value);
-  }
 }
 
 const char *
@@ -28,17 +28,15 @@
 
 G_BEGIN_DECLS
 
-void prefs_autofill_utils_get_combo_box_text_cb (GObject *source_object,
-                                                 GAsyncResult *res,
-                                                 gpointer user_data);
+void prefs_autofill_utils_set_combo_box_text (GtkComboBoxText *combo_box,
+                                              const char *autofill_value);
 
 void prefs_autofill_utils_set_free_cb (GObject *source_object,
                                        GAsyncResult *res,
                                        gpointer user_data);
 
-void prefs_autofill_utils_get_entry_cb (GObject *source_object,
-                                        GAsyncResult *res,
-                                        gpointer user_data);
+void prefs_autofill_utils_set_entry (GtkEntry *entry,
+                                     const char *autofill_value);
 
 const char *prefs_autofill_utils_get_active_id (GtkComboBoxText *combo_box_text);
 
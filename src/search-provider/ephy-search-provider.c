@@ -27,6 +27,7 @@
 #include "ephy-prefs.h"
 #include "ephy-profile-utils.h"
 #include "ephy-shell.h"
+#include "ephy-suggestion-index.h"
 #include "ephy-suggestion-model.h"
 #include "ephy-uri-helpers.h"
 
@@ -45,6 +46,11 @@ struct _EphySearchProvider {
   GSettings                *settings;
   EphyBookmarksManager     *bookmarks_manager;
   EphySuggestionModel      *model;
+
+  /* The last result set, which subsearches refine in memory. */
+  char                     *cached_query;
+  GPtrArray                *cached_results;
+  GHashTable               *titles;
 };
 
 struct _EphySearchProviderClass {
@@ -53,7 +59,127 @@ struct _EphySearchProviderClass {
 
 G_DEFINE_TYPE (EphySearchProvider, ephy_search_provider, G_TYPE_APPLICATION)
 
-#define INACTIVITY_TIMEOUT 60 * 1000 /* One minute, in milliseconds */
+/* Search engine rows have the query in their address and no subtitle.
+ * They would be stale after a refinement, so only history and bookmark
+ * rows are kept, and the engine rows are built anew for the new query. */
+static void
+cache_results (EphySearchProvider *self,
+               const char         *search_string,
+               GListModel         *model)
+{
+  guint n_items;
+
+  g_free (self->cached_query);
+  self->cached_query = g_utf8_casefold (search_string, -1);
+
+  g_clear_pointer (&self->cached_results, g_ptr_array_unref);
+  self->cached_results = g_ptr_array_new_with_free_func (g_free);
+  g_hash_table_remove_all (self->titles);
+
+  n_items = g_list_model_get_n_items (model);
+  for (guint i = 0; i < n_items; i++) {
+    g_autoptr (EphySuggestion) suggestion = g_list_model_get_item (model, i);
+    const char *uri = ephy_suggestion_get_uri (suggestion);
+
+    if (!dzl_suggestion_get_subtitle (DZL_SUGGESTION (suggestion)))
+      continue;
+
+    g_ptr_array_add (self->cached_results, g_strdup (uri));
+    g_hash_table_insert (self->titles, g_strdup (uri),
+                         g_strdup (ephy_suggestion_get_unescaped_title (suggestion)));
+  }
+}
+
+/* Everything matching @search_string matched the cached query if each of
+ * the cached terms is part of one of the new terms. */
+static gboolean
+can_refine_cached_results (EphySearchProvider *self,
+                           const char         *search_string)
+{
+  g_autofree char *folded = NULL;
+  g_auto (GStrv) old_terms = NULL;
+  g_auto (GStrv) new_terms = NULL;
+
+  if (!self->cached_query || !*self->cached_query)
+    return FALSE;
+
+  folded = g_utf8_casefold (search_string, -1);
+  old_terms = g_strsplit (self->cached_query, " ", -1);
+  new_terms = g_strsplit (folded, " ", -1);
+
+  for (guint i = 0; old_terms[i]; i++) {
+    gboolean found = FALSE;
+
+    for (guint j = 0; new_terms[j] && !found; j++)
+      found = strstr (new_terms[j], old_terms[i]) != NULL;
+
+    if (!found)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Like the search engine rows of the suggestion model. The model still
+ * holds the rows of the cached query, so the titles are remembered here. */
+static void
+add_search_engines (EphySearchProvider *self,
+                    GPtrArray          *results,
+                    const char         *search_string)
+{
+  EphyEmbedShell *shell;
+  EphySearchEngineManager *manager;
+  g_auto (GStrv) engines = NULL;
+
+  shell = ephy_embed_shell_get_default ();
+  manager = ephy_embed_shell_get_search_engine_manager (shell);
+  engines = ephy_search_engine_manager_get_names (manager);
+
+  for (guint i = 0; engines[i]; i++) {
+    char *address;
+
+    address = ephy_search_engine_manager_build_search_address (manager, engines[i], search_string);
+    g_hash_table_insert (self->titles, g_strdup (address), g_strdup (engines[i]));
+    g_ptr_array_add (results, address);
+  }
+}
+
+static char **
+refine_cached_results (EphySearchProvider *self,
+                       const char         *search_string)
+{
+  g_autofree char *folded = NULL;
+  g_auto (GStrv) terms = NULL;
+  GPtrArray *results;
+  GPtrArray *kept;
+
+  folded = g_utf8_casefold (search_string, -1);
+  terms = g_strsplit (folded, " ", -1);
+
+  kept = g_ptr_array_new_with_free_func (g_free);
+  for (guint i = 0; i < self->cached_results->len; i++) {
+    const char *uri = self->cached_results->pdata[i];
+    g_autofree char *folded_uri = g_utf8_casefold (uri, -1);
+    g_autofree char *folded_title = g_utf8_casefold (g_hash_table_lookup (self->titles, uri), -1);
+
+    if (ephy_suggestion_index_terms_match (terms, folded_uri, folded_title))
+      g_ptr_array_add (kept, g_strdup (uri));
+  }
+
+  g_free (self->cached_query);
+  self->cached_query = g_steal_pointer (&folded);
+  g_ptr_array_unref (self->cached_results);
+  self->cached_results = kept;
+
+  results = g_ptr_array_new ();
+  for (guint i = 0; i < kept->len; i++)
+    g_ptr_array_add (results, g_strdup (kept->pdata[i]));
+  add_search_engines (self, results, search_string);
+  g_ptr_array_add (results, g_strdup_printf ("special:search:%s", search_string));
+  g_ptr_array_add (results, NULL);
+
+  return (char **)g_ptr_array_free (results, FALSE);
+}
 
 static void
 on_model_updated (GObject      *source_object,
@@ -68,6 +194,8 @@ on_model_updated (GObject      *source_object,
   GError *error = NULL;
   results = g_ptr_array_new ();
 
+  search_string = g_task_get_task_data (task);
+
   if (ephy_suggestion_model_query_finish (self->model,
                                           result,
                                           &error)) {
@@ -75,13 +203,17 @@ on_model_updated (GObject      *source_object,
     for (guint i = 0; i < n_items; i++) {
       suggestion = g_list_model_get_item (G_LIST_MODEL (self->model), i);
       g_ptr_array_add (results, g_strdup (ephy_suggestion_get_uri (suggestion)));
+      g_object_unref (suggestion);
     }
+
+    cache_results (self, search_string, G_LIST_MODEL (self->model));
   } else {
     g_warning ("Failed to query suggestion model: %s", error->message);
     g_error_free (error);
+
+    g_clear_pointer (&self->cached_query, g_free);
   }
 
-  search_string = g_task_get_task_data (task);
   g_ptr_array_add (results, g_strdup_printf ("special:search:%s", search_string));
   g_ptr_array_add (results, NULL);
 
@@ -164,6 +296,17 @@ handle_get_subsearch_result_set (EphyShellSearchProvider2 *skeleton,
                                  char                    **terms,
                                  EphySearchProvider       *self)
 {
+  g_autofree char *search_string = g_strjoinv (" ", terms);
+
+  /* The shell only wants a subset of the previous results here. */
+  if (can_refine_cached_results (self, search_string)) {
+    g_auto (GStrv) results = refine_cached_results (self, search_string);
+
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("(^as)", results));
+    return TRUE;
+  }
+
   g_application_hold (G_APPLICATION (self));
   g_cancellable_reset (self->cancellable);
 
@@ -204,9 +347,12 @@ handle_get_result_metas (EphyShellSearchProvider2 *skeleton,
       const char *uri;
       char *decoded_uri;
 
-      suggestion = ephy_suggestion_model_get_suggestion_with_uri (self->model, results[i]);
-      title = ephy_suggestion_get_unescaped_title (suggestion);
-      uri = ephy_suggestion_get_uri (suggestion);
+      uri = results[i];
+      title = g_hash_table_lookup (self->titles, uri);
+      if (!title) {
+        suggestion = ephy_suggestion_model_get_suggestion_with_uri (self->model, uri);
+        title = ephy_suggestion_get_unescaped_title (suggestion);
+      }
       decoded_uri = ephy_uri_decode (uri);
 
       g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
@@ -340,14 +486,41 @@ ephy_search_provider_init (EphySearchProvider *self)
   self->settings = g_settings_new (EPHY_PREFS_SCHEMA);
 
   filename = g_build_filename (ephy_profile_dir (), EPHY_HISTORY_FILE, NULL);
-  self->bookmarks_manager = ephy_bookmarks_manager_new ();
+  /* The manager of the shell, so that the model shares its suggestion index. */
+  self->bookmarks_manager = g_object_ref (ephy_shell_get_bookmarks_manager (EPHY_SHELL (shell)));
   self->model = ephy_suggestion_model_new (ephy_embed_shell_get_global_history_service (shell),
                                            self->bookmarks_manager);
   g_free (filename);
 
   self->cancellable = g_cancellable_new ();
+  self->titles = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  g_application_set_inactivity_timeout (G_APPLICATION (self),
+                                        g_settings_get_uint (self->settings,
+                                                             EPHY_PREFS_SEARCH_PROVIDER_INACTIVITY_TIMEOUT) * 1000);
+}
+
+static void
+prefetch_cb (GObject            *source_object,
+             GAsyncResult       *result,
+             EphySearchProvider *self)
+{
+  ephy_suggestion_model_query_finish (self->model, result, NULL);
+  g_application_release (G_APPLICATION (self));
+}
+
+static void
+ephy_search_provider_startup (GApplication *application)
+{
+  EphySearchProvider *self = EPHY_SEARCH_PROVIDER (application);
+
+  G_APPLICATION_CLASS (ephy_search_provider_parent_class)->startup (application);
 
-  g_application_set_inactivity_timeout (G_APPLICATION (self), INACTIVITY_TIMEOUT);
+  /* Open the history database and start building the suggestion index now,
+   * rather than when the shell sends the first search. */
+  g_application_hold (application);
+  ephy_suggestion_model_query_async (self->model, "", NULL,
+                                     (GAsyncReadyCallback)prefetch_cb, self);
 }
 
 static gboolean
@@ -402,6 +575,9 @@ ephy_search_provider_dispose (GObject *object)
   g_clear_object (&self->cancellable);
   g_clear_object (&self->model);
   g_clear_object (&self->bookmarks_manager);
+  g_clear_pointer (&self->cached_query, g_free);
+  g_clear_pointer (&self->cached_results, g_ptr_array_unref);
+  g_clear_pointer (&self->titles, g_hash_table_unref);
 
   G_OBJECT_CLASS (ephy_search_provider_parent_class)->dispose (object);
 }
@@ -414,6 +590,7 @@ ephy_search_provider_class_init (EphySearchProviderClass *klass)
 
   object_class->dispose = ephy_search_provider_dispose;
 
+  application_class->startup = ephy_search_provider_startup;
   application_class->dbus_register = ephy_search_provider_dbus_register;
   application_class->dbus_unregister = ephy_search_provider_dbus_unregister;
 }
@@ -0,0 +1,137 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ephy-autofill-matchers.h"
+
+#include <glib.h>
+
+typedef struct {
+  const char *element_key;
+  EphyAutofillMatch matches;
+} ClassifyTest;
+
+/* Every pattern matching a key must be reported, as if each one had been
+ * searched for on its own. */
+static const ClassifyTest classify_tests[] = {
+  { "first_name", EPHY_AUTOFILL_MATCH_FIRSTNAME },
+  { "FirstName", EPHY_AUTOFILL_MATCH_FIRSTNAME },
+  { "lname", EPHY_AUTOFILL_MATCH_LASTNAME },
+  { "name", EPHY_AUTOFILL_MATCH_FULLNAME },
+  { "full_name", EPHY_AUTOFILL_MATCH_FULLNAME },
+  { "name_first_last", EPHY_AUTOFILL_MATCH_FULLNAME | EPHY_AUTOFILL_MATCH_LASTNAME },
+  { "username", EPHY_AUTOFILL_MATCH_USERNAME },
+  { "E-Mail", EPHY_AUTOFILL_MATCH_EMAIL },
+  { "email_line", EPHY_AUTOFILL_MATCH_EMAIL | EPHY_AUTOFILL_MATCH_STREET_ADDRESS },
+  { "mobile_phone", EPHY_AUTOFILL_MATCH_PHONE },
+  { "billing_address", EPHY_AUTOFILL_MATCH_STREET_ADDRESS },
+  { "address_line1", EPHY_AUTOFILL_MATCH_STREET_ADDRESS },
+  { "company", EPHY_AUTOFILL_MATCH_ORGANIZATION },
+  { "post_code", EPHY_AUTOFILL_MATCH_POSTAL_CODE },
+  { "country", EPHY_AUTOFILL_MATCH_COUNTRY },
+  { "state", EPHY_AUTOFILL_MATCH_STATE },
+  { "united state", EPHY_AUTOFILL_MATCH_NONE },
+  { "city", EPHY_AUTOFILL_MATCH_CITY },
+  { "cc_exp_month", EPHY_AUTOFILL_MATCH_CARD_EXPDATE_MONTH | EPHY_AUTOFILL_MATCH_CARD_EXPDATE_YEAR | EPHY_AUTOFILL_MATCH_MONTH },
+  { "exp_year", EPHY_AUTOFILL_MATCH_CARD_EXPDATE_YEAR | EPHY_AUTOFILL_MATCH_YEAR },
+  { "expiration_date", EPHY_AUTOFILL_MATCH_CARD_EXPDATE_MONTH | EPHY_AUTOFILL_MATCH_CARD_EXPDATE_YEAR | EPHY_AUTOFILL_MATCH_CARD_EXPDATE },
+  { "ccmonth", EPHY_AUTOFILL_MATCH_CARD_EXPDATE_MONTH | EPHY_AUTOFILL_MATCH_MONTH },
+  { "/yy", EPHY_AUTOFILL_MATCH_CARD_EXPDATE_YEAR },
+  { "cardholder", EPHY_AUTOFILL_MATCH_NAME_ON_CARD },
+  { "name on card", EPHY_AUTOFILL_MATCH_FULLNAME | EPHY_AUTOFILL_MATCH_NAME_ON_CARD },
+  { "card_number", EPHY_AUTOFILL_MATCH_CARD_NUMBER },
+  { "card_type", EPHY_AUTOFILL_MATCH_CARD_TYPE },
+  { "favourite_colour", EPHY_AUTOFILL_MATCH_NONE },
+  { "search", EPHY_AUTOFILL_MATCH_NONE }
+};
+
+static void
+test_classify (void)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (classify_tests); i++) {
+    const ClassifyTest *test = &classify_tests[i];
+
+    g_test_message ("Classifying %s", test->element_key);
+    g_assert_cmphex (ephy_autofill_matchers_classify (test->element_key), ==, test->matches);
+  }
+
+  g_assert_cmphex (ephy_autofill_matchers_classify (NULL), ==, EPHY_AUTOFILL_MATCH_NONE);
+}
+
+static void
+test_classify_cached (void)
+{
+  GHashTable *cache = ephy_autofill_matchers_cache_new ();
+
+  for (guint i = 0; i < G_N_ELEMENTS (classify_tests); i++) {
+    const ClassifyTest *test = &classify_tests[i];
+
+    g_assert_cmphex (ephy_autofill_matchers_classify_cached (cache, test->element_key), ==, test->matches);
+    g_assert_true (g_hash_table_contains (cache, test->element_key));
+  }
+  g_assert_cmpuint (g_hash_table_size (cache), ==, G_N_ELEMENTS (classify_tests));
+
+  /* Seen keys are answered from the cache, without growing it. */
+  for (guint i = 0; i < G_N_ELEMENTS (classify_tests); i++) {
+    const ClassifyTest *test = &classify_tests[i];
+
+    g_assert_cmphex (ephy_autofill_matchers_classify_cached (cache, test->element_key), ==, test->matches);
+  }
+  g_assert_cmpuint (g_hash_table_size (cache), ==, G_N_ELEMENTS (classify_tests));
+
+  g_hash_table_destroy (cache);
+}
+
+static void
+test_cache_is_used (void)
+{
+  GHashTable *cache = ephy_autofill_matchers_cache_new ();
+  GHashTable *other_cache = ephy_autofill_matchers_cache_new ();
+
+  /* A remembered result is returned as is, so the key is not scanned again. */
+  g_hash_table_insert (cache, g_strdup ("zip"), GUINT_TO_POINTER (EPHY_AUTOFILL_MATCH_EMAIL));
+  g_assert_cmphex (ephy_autofill_matchers_classify_cached (cache, "zip"), ==, EPHY_AUTOFILL_MATCH_EMAIL);
+
+  /* Each form has its own cache. */
+  g_assert_cmphex (ephy_autofill_matchers_classify_cached (other_cache, "zip"), ==, EPHY_AUTOFILL_MATCH_POSTAL_CODE);
+
+  /* Keys that match nothing are remembered too. */
+  g_assert_cmphex (ephy_autofill_matchers_classify_cached (cache, "search"), ==, EPHY_AUTOFILL_MATCH_NONE);
+  g_assert_true (g_hash_table_contains (cache, "search"));
+
+  g_hash_table_destroy (cache);
+  g_hash_table_destroy (other_cache);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/lib/autofill/matchers/classify",
+                   test_classify);
+  g_test_add_func ("/lib/autofill/matchers/classify_cached",
+                   test_classify_cached);
+  g_test_add_func ("/lib/autofill/matchers/cache_is_used",
+                   test_cache_is_used);
+
+  return g_test_run ();
+}
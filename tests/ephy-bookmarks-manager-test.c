@@ -0,0 +1,417 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ephy-bookmarks-manager.h"
+#include "ephy-debug.h"
+#include "ephy-file-helpers.h"
+#include "gvdb-builder.h"
+
+#include <glib.h>
+#include <unistd.h>
+
+#define N_BOOKMARKS 100000
+
+/* Loading every bookmark up front takes several times these. */
+#define MAX_STARTUP_TIME (G_USEC_PER_SEC / 2)
+#define MAX_STARTUP_RSS (16 * 1024 * 1024)
+
+static char *
+fixture_url (int i)
+{
+  return g_strdup_printf ("https://example.com/%d", i);
+}
+
+static char *
+fixture_id (int i)
+{
+  return g_strdup_printf ("fixture-id-%d", i);
+}
+
+static void
+write_fixture (void)
+{
+  GHashTable *root_table;
+  GHashTable *table;
+  char *filename;
+  GError *error = NULL;
+
+  root_table = gvdb_hash_table_new (NULL, NULL);
+
+  table = gvdb_hash_table_new (root_table, "tags");
+  gvdb_hash_table_insert (table, "Fixture");
+  g_hash_table_unref (table);
+
+  table = gvdb_hash_table_new (root_table, "bookmarks");
+  for (int i = 0; i < N_BOOKMARKS; i++) {
+    const char *tags[] = { "Fixture", NULL };
+    char *url = fixture_url (i);
+    char *title = g_strdup_printf ("Bookmark %d", i);
+    char *id = fixture_id (i);
+    GvdbItem *item;
+
+    item = gvdb_hash_table_insert (table, url);
+    gvdb_item_set_value (item, g_variant_new ("(xssxb^as)",
+                                              (gint64)i, title, id,
+                                              (gint64)0, FALSE,
+                                              i % 10 == 0 ? tags : tags + 1));
+    g_free (url);
+    g_free (title);
+    g_free (id);
+  }
+  g_hash_table_unref (table);
+
+  filename = g_build_filename (ephy_profile_dir (), "bookmarks.gvdb", NULL);
+  gvdb_table_write_contents (root_table, filename, FALSE, &error);
+  g_assert_no_error (error);
+
+  g_hash_table_unref (root_table);
+  g_free (filename);
+}
+
+static gboolean
+sequence_contains (GSequence    *bookmarks,
+                   EphyBookmark *bookmark)
+{
+  for (GSequenceIter *iter = g_sequence_get_begin_iter (bookmarks);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter)) {
+    if (g_sequence_get (iter) == bookmark)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static void
+assert_sorted (GSequence *bookmarks)
+{
+  GSequenceIter *iter = g_sequence_get_begin_iter (bookmarks);
+
+  if (g_sequence_iter_is_end (iter))
+    return;
+
+  for (GSequenceIter *next = g_sequence_iter_next (iter);
+       !g_sequence_iter_is_end (next);
+       iter = next, next = g_sequence_iter_next (next))
+    g_assert_cmpint (ephy_bookmark_bookmarks_compare_func (g_sequence_get (iter), g_sequence_get (next)), <, 0);
+}
+
+static gsize
+get_rss (void)
+{
+  char *contents = NULL;
+  gsize pages = 0;
+
+  if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    sscanf (contents, "%*u %" G_GSIZE_FORMAT, &pages);
+  g_free (contents);
+
+  return pages * sysconf (_SC_PAGESIZE);
+}
+
+static void
+test_startup (void)
+{
+  EphyBookmarksManager *manager;
+
+  manager = ephy_bookmarks_manager_new ();
+
+  g_assert_true (ephy_bookmarks_manager_tag_exists (manager, "Fixture"));
+
+  g_object_unref (manager);
+}
+
+static void
+test_startup_cost (void)
+{
+  EphyBookmarksManager *manager;
+  gint64 begin;
+  gint64 elapsed;
+  gsize rss;
+
+  rss = get_rss ();
+  begin = g_get_monotonic_time ();
+  manager = ephy_bookmarks_manager_new ();
+  elapsed = g_get_monotonic_time () - begin;
+
+  g_test_minimized_result (elapsed / (double)G_USEC_PER_SEC,
+                           "Started with %d bookmarks in %.3f s", N_BOOKMARKS,
+                           elapsed / (double)G_USEC_PER_SEC);
+  g_assert_cmpint (elapsed, <, MAX_STARTUP_TIME);
+  if (rss)
+    g_assert_cmpuint (get_rss () - rss, <, MAX_STARTUP_RSS);
+
+  g_object_unref (manager);
+}
+
+static void
+test_lookup_by_url (void)
+{
+  EphyBookmarksManager *manager;
+  EphyBookmark *bookmark;
+  char *url = fixture_url (4242);
+
+  manager = ephy_bookmarks_manager_new ();
+
+  bookmark = ephy_bookmarks_manager_get_bookmark_by_url (manager, url);
+  g_assert_nonnull (bookmark);
+  g_assert_cmpstr (ephy_bookmark_get_title (bookmark), ==, "Bookmark 4242");
+  g_assert_cmpint (ephy_bookmark_get_time_added (bookmark), ==, 4242);
+  g_assert_true (ephy_bookmarks_manager_get_bookmark_by_url (manager, url) == bookmark);
+
+  g_assert_null (ephy_bookmarks_manager_get_bookmark_by_url (manager, "https://example.org/"));
+
+  g_object_unref (manager);
+  g_free (url);
+}
+
+static void
+test_lookup_by_id (void)
+{
+  EphyBookmarksManager *manager;
+  EphyBookmark *bookmark;
+  char *url = fixture_url (1234);
+  char *id = fixture_id (1234);
+
+  manager = ephy_bookmarks_manager_new ();
+
+  bookmark = ephy_bookmarks_manager_get_bookmark_by_id (manager, id);
+  g_assert_nonnull (bookmark);
+  g_assert_cmpstr (ephy_bookmark_get_url (bookmark), ==, url);
+  g_assert_true (ephy_bookmarks_manager_get_bookmark_by_url (manager, url) == bookmark);
+
+  g_assert_null (ephy_bookmarks_manager_get_bookmark_by_id (manager, "no-such-id"));
+
+  /* A changed id must be found under the new one only. */
+  ephy_bookmark_set_id (bookmark, "changed-id");
+  g_assert_true (ephy_bookmarks_manager_get_bookmark_by_id (manager, "changed-id") == bookmark);
+  g_assert_null (ephy_bookmarks_manager_get_bookmark_by_id (manager, id));
+
+  g_object_unref (manager);
+  g_free (url);
+  g_free (id);
+}
+
+static void
+test_full_load (void)
+{
+  EphyBookmarksManager *manager;
+  EphyBookmark *bookmark;
+  char *url = fixture_url (7);
+
+  manager = ephy_bookmarks_manager_new ();
+
+  /* Bookmarks handed out before must stay the same objects. */
+  bookmark = ephy_bookmarks_manager_get_bookmark_by_url (manager, url);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (manager)), ==, N_BOOKMARKS);
+  g_assert_true (ephy_bookmarks_manager_get_bookmark_by_url (manager, url) == bookmark);
+
+  g_assert_cmpint (g_sequence_get_length (ephy_bookmarks_manager_get_bookmarks_with_tag (manager, "Fixture")),
+                   ==, N_BOOKMARKS / 10);
+  g_assert_cmpint (g_sequence_get_length (ephy_bookmarks_manager_get_bookmarks_with_tag (manager, NULL)),
+                   ==, N_BOOKMARKS - N_BOOKMARKS / 10);
+
+  g_object_unref (manager);
+  g_free (url);
+}
+
+static void
+test_edit_is_saved (void)
+{
+  EphyBookmarksManager *manager;
+  EphyBookmark *bookmark;
+  char *url = fixture_url (99);
+
+  manager = ephy_bookmarks_manager_new ();
+  bookmark = ephy_bookmarks_manager_get_bookmark_by_url (manager, url);
+  ephy_bookmark_set_title (bookmark, "Edited");
+  ephy_bookmarks_manager_save_to_file_async (manager, NULL, NULL, NULL);
+  g_object_unref (manager);
+
+  manager = ephy_bookmarks_manager_new ();
+  bookmark = ephy_bookmarks_manager_get_bookmark_by_url (manager, url);
+  g_assert_cmpstr (ephy_bookmark_get_title (bookmark), ==, "Edited");
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (manager)), ==, N_BOOKMARKS);
+  g_object_unref (manager);
+
+  write_fixture ();
+  g_free (url);
+}
+
+static void
+test_tag_index (void)
+{
+  EphyBookmarksManager *manager;
+  GSequence *tagged;
+  GSequence *untagged;
+
+  manager = ephy_bookmarks_manager_new ();
+  tagged = ephy_bookmarks_manager_get_bookmarks_with_tag (manager, "Fixture");
+  untagged = ephy_bookmarks_manager_get_bookmarks_with_tag (manager, NULL);
+
+  g_assert_cmpint (g_sequence_get_length (tagged), ==, N_BOOKMARKS / 10);
+  assert_sorted (tagged);
+  for (GSequenceIter *iter = g_sequence_get_begin_iter (tagged);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
+    g_assert_true (ephy_bookmark_has_tag (g_sequence_get (iter), "Fixture"));
+
+  g_assert_cmpint (g_sequence_get_length (untagged), ==, N_BOOKMARKS - N_BOOKMARKS / 10);
+  assert_sorted (untagged);
+  for (GSequenceIter *iter = g_sequence_get_begin_iter (untagged);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
+    g_assert_true (g_sequence_is_empty (ephy_bookmark_get_tags (g_sequence_get (iter))));
+
+  g_assert_cmpint (g_sequence_get_length (ephy_bookmarks_manager_get_bookmarks_with_tag (manager, "No such tag")), ==, 0);
+
+  g_object_unref (manager);
+}
+
+static void
+test_tag_index_follows_tags (void)
+{
+  EphyBookmarksManager *manager;
+  EphyBookmark *bookmark;
+  GSequence *tagged;
+  GSequence *untagged;
+  char *url = fixture_url (5);
+
+  manager = ephy_bookmarks_manager_new ();
+  tagged = ephy_bookmarks_manager_get_bookmarks_with_tag (manager, "Fixture");
+  untagged = ephy_bookmarks_manager_get_bookmarks_with_tag (manager, NULL);
+  bookmark = ephy_bookmarks_manager_get_bookmark_by_url (manager, url);
+  g_assert_true (sequence_contains (untagged, bookmark));
+
+  /* The first tag takes the bookmark out of the untagged ones. */
+  ephy_bookmark_add_tag (bookmark, "Fixture");
+  g_assert_true (sequence_contains (tagged, bookmark));
+  g_assert_false (sequence_contains (untagged, bookmark));
+  g_assert_cmpint (g_sequence_get_length (tagged), ==, N_BOOKMARKS / 10 + 1);
+  assert_sorted (tagged);
+
+  ephy_bookmark_add_tag (bookmark, "Other");
+  g_assert_true (sequence_contains (ephy_bookmarks_manager_get_bookmarks_with_tag (manager, "Other"), bookmark));
+
+  /* And removing the last one puts it back. */
+  ephy_bookmark_remove_tag (bookmark, "Fixture");
+  g_assert_false (sequence_contains (tagged, bookmark));
+  g_assert_false (sequence_contains (untagged, bookmark));
+  ephy_bookmark_remove_tag (bookmark, "Other");
+  g_assert_false (sequence_contains (ephy_bookmarks_manager_get_bookmarks_with_tag (manager, "Other"), bookmark));
+  g_assert_true (sequence_contains (untagged, bookmark));
+  g_assert_cmpint (g_sequence_get_length (untagged), ==, N_BOOKMARKS - N_BOOKMARKS / 10);
+  assert_sorted (untagged);
+
+  g_object_unref (manager);
+  g_free (url);
+}
+
+static void
+test_tag_index_resorts (void)
+{
+  EphyBookmarksManager *manager;
+  EphyBookmark *bookmark;
+  EphyBookmark *other;
+  GSequence *tagged;
+  GSequence *untagged;
+  char *url = fixture_url (50);
+  char *first_url = fixture_url (1);
+  char *other_url = fixture_url (51);
+
+  manager = ephy_bookmarks_manager_new ();
+  tagged = ephy_bookmarks_manager_get_bookmarks_with_tag (manager, "Fixture");
+  untagged = ephy_bookmarks_manager_get_bookmarks_with_tag (manager, NULL);
+
+  /* Newest first. */
+  bookmark = ephy_bookmarks_manager_get_bookmark_by_url (manager, url);
+  ephy_bookmark_set_time_added (bookmark, N_BOOKMARKS);
+  assert_sorted (tagged);
+  g_assert_true (g_sequence_get (g_sequence_get_begin_iter (tagged)) == bookmark);
+
+  ephy_bookmark_set_title (bookmark, "Edited");
+  assert_sorted (tagged);
+
+  /* Give two untagged bookmarks the same time and title, so that only
+   * their ids tell them apart. */
+  bookmark = ephy_bookmarks_manager_get_bookmark_by_url (manager, first_url);
+  other = ephy_bookmarks_manager_get_bookmark_by_url (manager, other_url);
+  ephy_bookmark_set_time_added (other, 1);
+  ephy_bookmark_set_title (other, ephy_bookmark_get_title (bookmark));
+  assert_sorted (untagged);
+  g_assert_true (g_sequence_get (g_sequence_iter_prev (g_sequence_get_end_iter (untagged))) == other);
+
+  ephy_bookmark_set_id (other, "0");
+  assert_sorted (untagged);
+  g_assert_true (g_sequence_get (g_sequence_iter_prev (g_sequence_get_end_iter (untagged))) == bookmark);
+
+  /* A moved bookmark can still be taken out of the index. */
+  ephy_bookmarks_manager_remove_bookmark (manager, other);
+  g_assert_false (sequence_contains (untagged, other));
+  g_assert_cmpint (g_sequence_get_length (untagged), ==, N_BOOKMARKS - N_BOOKMARKS / 10 - 1);
+  assert_sorted (untagged);
+
+  g_object_unref (manager);
+
+  write_fixture ();
+  g_free (url);
+  g_free (first_url);
+  g_free (other_url);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  ephy_debug_init ();
+
+  if (!ephy_file_helpers_init (NULL,
+                               EPHY_FILE_HELPERS_TESTING_MODE | EPHY_FILE_HELPERS_ENSURE_EXISTS,
+                               NULL)) {
+    g_debug ("Something wrong happened with ephy_file_helpers_init()");
+    return -1;
+  }
+
+  write_fixture ();
+
+  g_test_add_func ("/src/bookmarks/manager/startup", test_startup);
+  g_test_add_func ("/src/bookmarks/manager/lookup_by_url", test_lookup_by_url);
+  g_test_add_func ("/src/bookmarks/manager/lookup_by_id", test_lookup_by_id);
+  g_test_add_func ("/src/bookmarks/manager/full_load", test_full_load);
+  g_test_add_func ("/src/bookmarks/manager/edit_is_saved", test_edit_is_saved);
+  g_test_add_func ("/src/bookmarks/manager/tag_index", test_tag_index);
+  g_test_add_func ("/src/bookmarks/manager/tag_index_follows_tags", test_tag_index_follows_tags);
+  g_test_add_func ("/src/bookmarks/manager/tag_index_resorts", test_tag_index_resorts);
+
+  /* Run with -m perf. */
+  if (g_test_perf ())
+    g_test_add_func ("/src/bookmarks/manager/startup_cost", test_startup_cost);
+
+  ret = g_test_run ();
+
+  ephy_file_helpers_shutdown ();
+
+  return ret;
+}
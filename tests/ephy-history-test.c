@@ -482,6 +482,464 @@ test_clear (void)
   gtk_main ();
 }
 
+static EphyHistoryPageVisit *
+page_visit_new_with_sync_id (const char *url,
+                             gint64      visit_time,
+                             const char *sync_id)
+{
+  EphyHistoryPageVisit *visit = ephy_history_page_visit_new (url, visit_time, EPHY_PAGE_VISIT_TYPED);
+
+  visit->url->sync_id = g_strdup (sync_id);
+
+  return visit;
+}
+
+static EphyHistoryURL *
+remote_url_new (const char *url,
+                gint64      last_visit_time,
+                const char *sync_id)
+{
+  EphyHistoryURL *remote = ephy_history_url_new (url, NULL, 0, 0, last_visit_time);
+
+  remote->sync_id = g_strdup (sync_id);
+
+  return remote;
+}
+
+static EphyHistoryURL *
+find_url_in_list (GList      *urls,
+                  const char *url)
+{
+  for (GList *l = urls; l; l = l->next) {
+    if (g_strcmp0 (((EphyHistoryURL *)l->data)->url, url) == 0)
+      return l->data;
+  }
+
+  return NULL;
+}
+
+static void
+verify_merged_urls (EphyHistoryService *service,
+                    gboolean            success,
+                    gpointer            result_data,
+                    gpointer            user_data)
+{
+  GList *urls = (GList *)result_data;
+  EphyHistoryURL *url;
+
+  g_assert_true (success);
+  g_assert_cmpint (g_list_length (urls), ==, 4);
+
+  /* Matched by sync id, the newer remote visit was recorded. */
+  url = find_url_in_list (urls, "http://www.gnome.org/");
+  g_assert_nonnull (url);
+  g_assert_cmpstr (url->sync_id, ==, "gnome");
+  g_assert_cmpint (url->visit_count, ==, 2);
+  g_assert_cmpint (url->last_visit_time, ==, 200);
+
+  /* Matched by address, the local sync id is kept. */
+  url = find_url_in_list (urls, "http://www.webkitgtk.org/");
+  g_assert_nonnull (url);
+  g_assert_cmpstr (url->sync_id, ==, "webkitgtk");
+  g_assert_cmpint (url->visit_count, ==, 2);
+  g_assert_cmpint (url->last_visit_time, ==, 300);
+
+  /* The remote visit is older than the local one, so it was skipped. */
+  url = find_url_in_list (urls, "http://www.wikipedia.org/");
+  g_assert_nonnull (url);
+  g_assert_cmpstr (url->sync_id, ==, "wikipedia");
+  g_assert_cmpint (url->visit_count, ==, 1);
+  g_assert_cmpint (url->last_visit_time, ==, 500);
+
+  /* Unknown locally, so added with the remote sync id. */
+  url = find_url_in_list (urls, "http://www.freedesktop.org/");
+  g_assert_nonnull (url);
+  g_assert_cmpstr (url->sync_id, ==, "freedesktop");
+  g_assert_cmpint (url->visit_count, ==, 1);
+  g_assert_cmpint (url->last_visit_time, ==, 50);
+
+  ephy_history_url_list_free (urls);
+  g_object_unref (service);
+  gtk_main_quit ();
+}
+
+static void
+urls_merged (EphyHistoryService *service,
+             gboolean            success,
+             gpointer            result_data,
+             gpointer            user_data)
+{
+  GList *urls = (GList *)result_data;
+  EphyHistoryURL *url;
+  EphyHistoryQuery *query;
+
+  g_assert_true (success);
+
+  /* The local URLs with a sync id, as they were before the merge. */
+  g_assert_cmpint (g_list_length (urls), ==, 3);
+  url = find_url_in_list (urls, "http://www.gnome.org/");
+  g_assert_nonnull (url);
+  g_assert_cmpstr (url->sync_id, ==, "gnome");
+  g_assert_cmpint (url->last_visit_time, ==, 100);
+  url = find_url_in_list (urls, "http://www.webkitgtk.org/");
+  g_assert_nonnull (url);
+  g_assert_cmpint (url->last_visit_time, ==, 100);
+  url = find_url_in_list (urls, "http://www.wikipedia.org/");
+  g_assert_nonnull (url);
+  g_assert_cmpint (url->last_visit_time, ==, 500);
+  g_assert_null (find_url_in_list (urls, "http://www.freedesktop.org/"));
+  ephy_history_url_list_free (urls);
+
+  query = ephy_history_query_new ();
+  query->sort_type = EPHY_HISTORY_SORT_MOST_VISITED;
+  ephy_history_service_query_urls (service, query, NULL, verify_merged_urls, NULL);
+  ephy_history_query_free (query);
+}
+
+static void
+merge_remote_urls (EphyHistoryService *service,
+                   gboolean            success,
+                   gpointer            result_data,
+                   gpointer            user_data)
+{
+  GList *remote_urls = NULL;
+
+  g_assert_true (success);
+
+  remote_urls = g_list_append (remote_urls, remote_url_new ("http://www.gnome.org/", 200, "gnome"));
+  remote_urls = g_list_append (remote_urls, remote_url_new ("http://www.webkitgtk.org/", 300, "remote-webkitgtk"));
+  remote_urls = g_list_append (remote_urls, remote_url_new ("http://www.wikipedia.org/", 400, "wikipedia"));
+  remote_urls = g_list_append (remote_urls, remote_url_new ("http://www.freedesktop.org/", 50, "freedesktop"));
+
+  ephy_history_service_merge_urls (service, remote_urls, NULL, urls_merged, NULL);
+  ephy_history_url_list_free (remote_urls);
+}
+
+static void
+test_merge_urls (void)
+{
+  EphyHistoryService *service = ensure_empty_history (test_db_filename ());
+  GList *visits = NULL;
+
+  visits = g_list_append (visits, page_visit_new_with_sync_id ("http://www.gnome.org/", 100, "gnome"));
+  visits = g_list_append (visits, page_visit_new_with_sync_id ("http://www.webkitgtk.org/", 100, "webkitgtk"));
+  visits = g_list_append (visits, page_visit_new_with_sync_id ("http://www.wikipedia.org/", 500, "wikipedia"));
+
+  ephy_history_service_add_visits (service, visits, NULL, merge_remote_urls, NULL);
+  ephy_history_page_visit_list_free (visits);
+
+  gtk_main ();
+}
+
+#define N_PAGED_URLS 25
+#define PAGE_SIZE 4
+
+typedef struct {
+  GHashTable *seen;
+  EphyHistoryURL *last;
+  GCancellable *cancellable;
+} PagingData;
+
+static GList *
+create_visits_with_equal_times (void)
+{
+  GList *visits = NULL;
+
+  /* Groups of URLs sharing a last visit time, so that page boundaries fall
+   * in the middle of a group. */
+  for (int i = 0; i < N_PAGED_URLS; i++) {
+    char *url = g_strdup_printf ("http://www.example%d.org/", i);
+
+    visits = g_list_append (visits, ephy_history_page_visit_new (url, 100 * (i / 7), EPHY_PAGE_VISIT_TYPED));
+    g_free (url);
+  }
+
+  return visits;
+}
+
+static void
+paging_data_free (PagingData *data)
+{
+  g_hash_table_unref (data->seen);
+  g_clear_pointer (&data->last, ephy_history_url_free);
+  g_clear_object (&data->cancellable);
+  g_free (data);
+}
+
+static void request_next_page (EphyHistoryService    *service,
+                               PagingData            *data,
+                               EphyHistoryJobCallback callback);
+
+static void
+verify_page (EphyHistoryService *service,
+             gboolean            success,
+             gpointer            result_data,
+             gpointer            user_data)
+{
+  PagingData *data = user_data;
+  GList *urls = (GList *)result_data;
+
+  g_assert_true (success);
+  g_assert_cmpint (g_list_length (urls), <=, PAGE_SIZE);
+
+  for (GList *l = urls; l; l = l->next) {
+    EphyHistoryURL *url = l->data;
+
+    /* Strictly after the previous row in (last visit time, id) order. */
+    if (data->last) {
+      g_assert_cmpint (url->last_visit_time, <=, data->last->last_visit_time);
+      if (url->last_visit_time == data->last->last_visit_time)
+        g_assert_cmpint (url->id, <, data->last->id);
+    }
+
+    g_assert_false (g_hash_table_contains (data->seen, url->url));
+    g_hash_table_add (data->seen, g_strdup (url->url));
+
+    g_clear_pointer (&data->last, ephy_history_url_free);
+    data->last = ephy_history_url_copy (url);
+  }
+
+  if (g_list_length (urls) < PAGE_SIZE) {
+    /* Nothing was skipped. */
+    g_assert_cmpint (g_hash_table_size (data->seen), ==, N_PAGED_URLS);
+
+    ephy_history_url_list_free (urls);
+    paging_data_free (data);
+    g_object_unref (service);
+    gtk_main_quit ();
+    return;
+  }
+
+  ephy_history_url_list_free (urls);
+  request_next_page (service, data, verify_page);
+}
+
+static void
+request_next_page (EphyHistoryService    *service,
+                   PagingData            *data,
+                   EphyHistoryJobCallback callback)
+{
+  EphyHistoryCursor *cursor = data->last ? ephy_history_cursor_new_for_url (data->last) : NULL;
+
+  ephy_history_service_find_urls_page (service, NULL, cursor, PAGE_SIZE,
+                                       data->cancellable, callback, data);
+  ephy_history_cursor_free (cursor);
+}
+
+static void
+start_paging (EphyHistoryService *service,
+              gboolean            success,
+              gpointer            result_data,
+              gpointer            user_data)
+{
+  PagingData *data;
+
+  g_assert_true (success);
+
+  data = g_new0 (PagingData, 1);
+  data->seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  request_next_page (service, data, verify_page);
+}
+
+static void
+test_find_urls_page_equal_times (void)
+{
+  EphyHistoryService *service = ensure_empty_history (test_db_filename ());
+  GList *visits = create_visits_with_equal_times ();
+
+  ephy_history_service_add_visits (service, visits, NULL, start_paging, NULL);
+  ephy_history_page_visit_list_free (visits);
+
+  gtk_main ();
+}
+
+static void
+cancelled_page (EphyHistoryService *service,
+                gboolean            success,
+                gpointer            result_data,
+                gpointer            user_data)
+{
+  /* Cancelled jobs never call back. */
+  g_assert_not_reached ();
+}
+
+static void
+first_page_for_cancel (EphyHistoryService *service,
+                       gboolean            success,
+                       gpointer            result_data,
+                       gpointer            user_data)
+{
+  PagingData *data = user_data;
+  GList *urls = (GList *)result_data;
+
+  g_assert_true (success);
+  g_assert_cmpint (g_list_length (urls), ==, PAGE_SIZE);
+
+  for (GList *l = urls; l; l = l->next)
+    g_hash_table_add (data->seen, g_strdup (((EphyHistoryURL *)l->data)->url));
+  data->last = ephy_history_url_copy (g_list_last (urls)->data);
+  ephy_history_url_list_free (urls);
+
+  /* Cancel the next page while it is queued, then page on from the same
+   * cursor: the remaining pages must be unaffected. */
+  data->cancellable = g_cancellable_new ();
+  request_next_page (service, data, cancelled_page);
+  g_cancellable_cancel (data->cancellable);
+  g_clear_object (&data->cancellable);
+
+  request_next_page (service, data, verify_page);
+}
+
+static void
+start_paging_with_cancel (EphyHistoryService *service,
+                          gboolean            success,
+                          gpointer            result_data,
+                          gpointer            user_data)
+{
+  PagingData *data;
+
+  g_assert_true (success);
+
+  data = g_new0 (PagingData, 1);
+  data->seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  request_next_page (service, data, first_page_for_cancel);
+}
+
+static void
+test_find_urls_page_cancel (void)
+{
+  EphyHistoryService *service = ensure_empty_history (test_db_filename ());
+  GList *visits = create_visits_with_equal_times ();
+
+  ephy_history_service_add_visits (service, visits, NULL, start_paging_with_cancel, NULL);
+  ephy_history_page_visit_list_free (visits);
+
+  gtk_main ();
+}
+
+static void
+record_url_changes (EphyHistoryService *service,
+                    GList              *changes,
+                    GPtrArray          *recorded)
+{
+  for (GList *l = changes; l; l = l->next)
+    g_ptr_array_add (recorded, ephy_history_url_change_new (((EphyHistoryURLChange *)l->data)->type,
+                                                            ((EphyHistoryURLChange *)l->data)->url));
+}
+
+/* The changes made by an operation are signalled before its callback runs. */
+static void
+assert_single_url_change (GPtrArray               *recorded,
+                          EphyHistoryURLChangeType type,
+                          const char              *title)
+{
+  EphyHistoryURLChange *change;
+
+  g_assert_cmpuint (recorded->len, ==, 1);
+  change = recorded->pdata[0];
+  g_assert_cmpint (change->type, ==, type);
+  g_assert_cmpstr (change->url->url, ==, "http://www.gnome.org");
+  if (title)
+    g_assert_cmpstr (change->url->title, ==, title);
+  if (type != EPHY_HISTORY_URL_CHANGE_DELETED)
+    g_assert_cmpint (change->url->id, !=, -1);
+
+  g_ptr_array_set_size (recorded, 0);
+}
+
+static void
+history_cleared (EphyHistoryService *service,
+                 GPtrArray          *recorded)
+{
+  /* Clearing is only reported through ::cleared. */
+  g_assert_cmpuint (recorded->len, ==, 0);
+
+  g_signal_handlers_disconnect_by_data (service, recorded);
+  g_ptr_array_unref (recorded);
+  g_object_unref (service);
+  gtk_main_quit ();
+}
+
+static void
+url_change_readded (EphyHistoryService *service,
+                    gboolean            success,
+                    gpointer            result_data,
+                    gpointer            user_data)
+{
+  GPtrArray *recorded = user_data;
+
+  g_assert_true (success);
+  assert_single_url_change (recorded, EPHY_HISTORY_URL_CHANGE_INSERTED, NULL);
+
+  g_signal_connect (service, "cleared", G_CALLBACK (history_cleared), recorded);
+  ephy_history_service_clear (service, NULL, NULL, NULL);
+}
+
+static void
+url_change_deleted (EphyHistoryService *service,
+                    gboolean            success,
+                    gpointer            result_data,
+                    gpointer            user_data)
+{
+  GPtrArray *recorded = user_data;
+  EphyHistoryPageVisit *visit;
+
+  g_assert_true (success);
+  assert_single_url_change (recorded, EPHY_HISTORY_URL_CHANGE_DELETED, NULL);
+
+  /* Have something to clear. */
+  visit = ephy_history_page_visit_new ("http://www.gnome.org", 30, EPHY_PAGE_VISIT_TYPED);
+  ephy_history_service_add_visit (service, visit, NULL, url_change_readded, recorded);
+  ephy_history_page_visit_free (visit);
+}
+
+static void
+url_change_title_set (EphyHistoryService *service,
+                      gboolean            success,
+                      gpointer            result_data,
+                      gpointer            user_data)
+{
+  GPtrArray *recorded = user_data;
+  GList *urls;
+
+  g_assert_true (success);
+  assert_single_url_change (recorded, EPHY_HISTORY_URL_CHANGE_UPDATED, "GNOME");
+
+  urls = g_list_prepend (NULL, ephy_history_url_new ("http://www.gnome.org", NULL, 0, 0, 0));
+  ephy_history_service_delete_urls (service, urls, NULL, url_change_deleted, recorded);
+  ephy_history_url_list_free (urls);
+}
+
+static void
+url_change_visit_added (EphyHistoryService *service,
+                        gboolean            success,
+                        gpointer            result_data,
+                        gpointer            user_data)
+{
+  GPtrArray *recorded = user_data;
+
+  g_assert_true (success);
+  assert_single_url_change (recorded, EPHY_HISTORY_URL_CHANGE_INSERTED, NULL);
+
+  ephy_history_service_set_url_title (service, "http://www.gnome.org", "GNOME", NULL, url_change_title_set, recorded);
+}
+
+static void
+test_urls_changed (void)
+{
+  EphyHistoryService *service = ensure_empty_history (test_db_filename ());
+  GPtrArray *recorded = g_ptr_array_new_with_free_func ((GDestroyNotify)ephy_history_url_change_free);
+  EphyHistoryPageVisit *visit;
+
+  g_signal_connect (service, "urls-changed", G_CALLBACK (record_url_changes), recorded);
+
+  visit = ephy_history_page_visit_new ("http://www.gnome.org", 10, EPHY_PAGE_VISIT_TYPED);
+  ephy_history_service_add_visit (service, visit, NULL, url_change_visit_added, recorded);
+  ephy_history_page_visit_free (visit);
+
+  gtk_main ();
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -511,6 +969,10 @@ main (int argc, char *argv[])
   g_test_add_func ("/embed/history/test_complex_url_query", test_complex_url_query);
   g_test_add_func ("/embed/history/test_complex_url_query_with_time_range", test_complex_url_query_with_time_range);
   g_test_add_func ("/embed/history/test_clear", test_clear);
+  g_test_add_func ("/embed/history/test_merge_urls", test_merge_urls);
+  g_test_add_func ("/embed/history/test_find_urls_page_equal_times", test_find_urls_page_equal_times);
+  g_test_add_func ("/embed/history/test_find_urls_page_cancel", test_find_urls_page_cancel);
+  g_test_add_func ("/embed/history/test_urls_changed", test_urls_changed);
 
   ret = g_test_run ();
 
@@ -0,0 +1,357 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ephy-debug.h"
+#include "ephy-embed-utils.h"
+#include "ephy-embed.h"
+#include "ephy-file-helpers.h"
+#include "ephy-open-tabs-catalog.h"
+#include "ephy-open-tabs-manager.h"
+#include "ephy-settings.h"
+#include "ephy-shell.h"
+#include "ephy-window.h"
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+
+/* As in ephy-open-tabs-catalog.c. */
+#define MAX_CLOSED_TABS 256
+
+static EphyEmbed *
+open_tab (EphyWindow *window,
+          const char *title)
+{
+  return ephy_shell_new_tab_full (ephy_shell_get_default (), title, NULL, window, NULL,
+                                  EPHY_NEW_TAB_DONT_SHOW_WINDOW, 0);
+}
+
+static void
+title_changed_cb (EphyEmbed  *embed,
+                  GParamSpec *pspec,
+                  GMainLoop  *loop)
+{
+  g_main_loop_quit (loop);
+}
+
+static void
+load_page (EphyEmbed  *embed,
+           const char *title,
+           const char *url)
+{
+  g_autofree char *html = g_strdup_printf ("<html><head><title>%s</title></head></html>", title);
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  gulong id;
+
+  id = g_signal_connect (embed, "notify::title", G_CALLBACK (title_changed_cb), loop);
+  webkit_web_view_load_html (WEBKIT_WEB_VIEW (ephy_embed_get_web_view (embed)), html, url);
+  while (g_strcmp0 (ephy_embed_get_title (embed), title) != 0)
+    g_main_loop_run (loop);
+
+  g_signal_handler_disconnect (embed, id);
+  g_main_loop_unref (loop);
+}
+
+static GList *
+get_changes (EphyOpenTabsCatalog *catalog,
+             guint64              since_version,
+             gboolean             expect_complete)
+{
+  GList *changes;
+  guint64 version;
+
+  g_assert_cmpint (ephy_tabs_catalog_get_changes (EPHY_TABS_CATALOG (catalog), since_version,
+                                                  &changes, &version), ==, expect_complete);
+  g_assert_cmpuint (version, ==, ephy_tabs_catalog_get_version (EPHY_TABS_CATALOG (catalog)));
+
+  return changes;
+}
+
+static void
+free_changes (GList *changes)
+{
+  g_list_free_full (changes, (GDestroyNotify)ephy_tab_change_free);
+}
+
+static void
+assert_tabs_info (EphyOpenTabsCatalog *catalog,
+                  const char          *first_title,
+                  ...)
+{
+  GList *tabs_info = ephy_tabs_catalog_get_tabs_info (EPHY_TABS_CATALOG (catalog));
+  GList *l = tabs_info;
+  const char *title = first_title;
+  va_list args;
+
+  va_start (args, first_title);
+  for (; title; title = va_arg (args, const char *), l = l->next) {
+    g_assert_nonnull (l);
+    g_assert_cmpstr (((EphyTabInfo *)l->data)->title, ==, title);
+  }
+  va_end (args);
+
+  g_assert_null (l);
+  g_list_free_full (tabs_info, (GDestroyNotify)ephy_tab_info_free);
+}
+
+static void
+test_tab_changes (void)
+{
+  EphyOpenTabsCatalog *catalog;
+  EphyWindow *window;
+  EphyEmbed *alpha;
+  EphyTabChange *change;
+  GList *changes;
+  guint64 version;
+  guint64 alpha_id;
+
+  window = ephy_window_new ();
+  catalog = ephy_open_tabs_catalog_new (GTK_APPLICATION (ephy_shell_get_default ()));
+  version = ephy_tabs_catalog_get_version (EPHY_TABS_CATALOG (catalog));
+
+  alpha = open_tab (window, "Alpha");
+  open_tab (window, "Beta");
+  assert_tabs_info (catalog, "Alpha", "Beta", NULL);
+
+  changes = get_changes (catalog, version, TRUE);
+  g_assert_cmpuint (g_list_length (changes), ==, 2);
+  change = changes->data;
+  g_assert_cmpstr (change->info->title, ==, "Alpha");
+  alpha_id = change->id;
+  change = changes->next->data;
+  g_assert_cmpstr (change->info->title, ==, "Beta");
+  g_assert_cmpuint (change->id, >, alpha_id);
+  free_changes (changes);
+
+  /* Only the retitled tab changed. */
+  version = ephy_tabs_catalog_get_version (EPHY_TABS_CATALOG (catalog));
+  load_page (alpha, "Gamma", "http://gamma.example/");
+  assert_tabs_info (catalog, "Gamma", "Beta", NULL);
+
+  changes = get_changes (catalog, version, TRUE);
+  g_assert_cmpuint (g_list_length (changes), ==, 1);
+  change = changes->data;
+  g_assert_cmpuint (change->id, ==, alpha_id);
+  g_assert_cmpstr (change->info->title, ==, "Gamma");
+  g_assert_cmpstr (change->info->url, ==, "http://gamma.example/");
+  free_changes (changes);
+
+  /* A closed tab is reported without info. */
+  version = ephy_tabs_catalog_get_version (EPHY_TABS_CATALOG (catalog));
+  gtk_widget_destroy (GTK_WIDGET (alpha));
+  assert_tabs_info (catalog, "Beta", NULL);
+
+  changes = get_changes (catalog, version, TRUE);
+  g_assert_cmpuint (g_list_length (changes), ==, 1);
+  change = changes->data;
+  g_assert_cmpuint (change->id, ==, alpha_id);
+  g_assert_null (change->info);
+  free_changes (changes);
+
+  /* Nothing happened since. */
+  changes = get_changes (catalog, ephy_tabs_catalog_get_version (EPHY_TABS_CATALOG (catalog)), TRUE);
+  g_assert_null (changes);
+
+  gtk_widget_destroy (GTK_WIDGET (window));
+  g_object_unref (catalog);
+}
+
+static void
+test_blank_tabs_are_not_listed (void)
+{
+  EphyOpenTabsCatalog *catalog;
+  EphyWindow *window;
+  EphyEmbed *blank;
+  GList *changes;
+  guint64 version;
+
+  window = ephy_window_new ();
+  catalog = ephy_open_tabs_catalog_new (GTK_APPLICATION (ephy_shell_get_default ()));
+  version = ephy_tabs_catalog_get_version (EPHY_TABS_CATALOG (catalog));
+
+  /* Tabs without a title show the blank page title. */
+  blank = open_tab (window, NULL);
+  g_assert_cmpstr (ephy_embed_get_title (blank), ==, _(BLANK_PAGE_TITLE));
+  open_tab (window, _(OVERVIEW_PAGE_TITLE));
+  open_tab (window, "Alpha");
+  assert_tabs_info (catalog, "Alpha", NULL);
+
+  /* Unlisted tabs are reported like closed ones. */
+  changes = get_changes (catalog, version, TRUE);
+  g_assert_cmpuint (g_list_length (changes), ==, 3);
+  g_assert_null (((EphyTabChange *)changes->data)->info);
+  g_assert_null (((EphyTabChange *)changes->next->data)->info);
+  g_assert_cmpstr (((EphyTabChange *)changes->next->next->data)->info->title, ==, "Alpha");
+  free_changes (changes);
+
+  /* A full snapshot leaves them out. */
+  changes = get_changes (catalog, G_MAXUINT64, FALSE);
+  g_assert_cmpuint (g_list_length (changes), ==, 1);
+  g_assert_cmpstr (((EphyTabChange *)changes->data)->info->title, ==, "Alpha");
+  free_changes (changes);
+
+  /* Loading a page lists the tab. */
+  version = ephy_tabs_catalog_get_version (EPHY_TABS_CATALOG (catalog));
+  load_page (blank, "Beta", "http://beta.example/");
+  assert_tabs_info (catalog, "Beta", "Alpha", NULL);
+
+  changes = get_changes (catalog, version, TRUE);
+  g_assert_cmpuint (g_list_length (changes), ==, 1);
+  g_assert_cmpstr (((EphyTabChange *)changes->data)->info->title, ==, "Beta");
+  free_changes (changes);
+
+  gtk_widget_destroy (GTK_WIDGET (window));
+  g_object_unref (catalog);
+}
+
+static void
+test_windows_are_watched (void)
+{
+  EphyOpenTabsCatalog *catalog;
+  EphyWindow *first;
+  EphyWindow *second;
+  EphyEmbed *embed;
+
+  /* Tabs open before the catalog is created are found... */
+  first = ephy_window_new ();
+  open_tab (first, "Alpha");
+  catalog = ephy_open_tabs_catalog_new (GTK_APPLICATION (ephy_shell_get_default ()));
+  assert_tabs_info (catalog, "Alpha", NULL);
+
+  /* ...and so are those of windows opened later. */
+  second = ephy_window_new ();
+  open_tab (second, "Beta");
+  embed = open_tab (first, "Gamma");
+  assert_tabs_info (catalog, "Alpha", "Beta", "Gamma", NULL);
+
+  gtk_widget_destroy (GTK_WIDGET (embed));
+  assert_tabs_info (catalog, "Alpha", "Beta", NULL);
+
+  /* Closing a window closes its tabs. */
+  gtk_widget_destroy (GTK_WIDGET (first));
+  assert_tabs_info (catalog, "Beta", NULL);
+
+  /* The notebooks are no longer watched once the catalog is gone. */
+  g_object_unref (catalog);
+  open_tab (second, "Delta");
+
+  gtk_widget_destroy (GTK_WIDGET (second));
+}
+
+static void
+test_closed_tabs_are_forgotten (void)
+{
+  EphyOpenTabsCatalog *catalog;
+  EphyOpenTabsManager *manager;
+  EphyOpenTabsRecord *record;
+  EphyWindow *window;
+  EphyEmbed *embed;
+  GList *changes;
+  guint64 version;
+
+  window = ephy_window_new ();
+  catalog = ephy_open_tabs_catalog_new (GTK_APPLICATION (ephy_shell_get_default ()));
+  manager = ephy_open_tabs_manager_new (EPHY_TABS_CATALOG (catalog));
+
+  open_tab (window, "Alpha");
+  record = ephy_open_tabs_manager_get_local_tabs (manager);
+  g_assert_cmpuint (g_list_length (ephy_open_tabs_record_get_tabs (record)), ==, 1);
+  g_object_unref (record);
+  version = ephy_tabs_catalog_get_version (EPHY_TABS_CATALOG (catalog));
+
+  for (guint i = 0; i < MAX_CLOSED_TABS; i++)
+    gtk_widget_destroy (GTK_WIDGET (open_tab (window, "Beta")));
+
+  /* Every closed tab is still remembered. */
+  changes = get_changes (catalog, version, TRUE);
+  g_assert_cmpuint (g_list_length (changes), ==, MAX_CLOSED_TABS);
+  for (GList *l = changes; l; l = l->next)
+    g_assert_null (((EphyTabChange *)l->data)->info);
+  free_changes (changes);
+
+  /* The oldest one is dropped, so a consumer that was behind it gets a
+   * full snapshot instead. */
+  gtk_widget_destroy (GTK_WIDGET (open_tab (window, "Beta")));
+
+  changes = get_changes (catalog, version, FALSE);
+  g_assert_cmpuint (g_list_length (changes), ==, 1);
+  g_assert_cmpstr (((EphyTabChange *)changes->data)->info->title, ==, "Alpha");
+  free_changes (changes);
+
+  /* Consumers that are less far behind still get only the changes. */
+  changes = get_changes (catalog, ephy_tabs_catalog_get_version (EPHY_TABS_CATALOG (catalog)) - 2, TRUE);
+  g_assert_cmpuint (g_list_length (changes), ==, 1);
+  g_assert_null (((EphyTabChange *)changes->data)->info);
+  free_changes (changes);
+
+  /* The manager picks up the snapshot. */
+  embed = open_tab (window, "Gamma");
+  record = ephy_open_tabs_manager_get_local_tabs (manager);
+  g_assert_cmpuint (g_list_length (ephy_open_tabs_record_get_tabs (record)), ==, 2);
+  g_object_unref (record);
+
+  gtk_widget_destroy (GTK_WIDGET (embed));
+  record = ephy_open_tabs_manager_get_local_tabs (manager);
+  g_assert_cmpuint (g_list_length (ephy_open_tabs_record_get_tabs (record)), ==, 1);
+  g_object_unref (record);
+
+  gtk_widget_destroy (GTK_WIDGET (window));
+  g_object_unref (manager);
+  g_object_unref (catalog);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int ret;
+
+  gtk_test_init (&argc, &argv);
+
+  ephy_debug_init ();
+
+  if (!ephy_file_helpers_init (NULL, EPHY_FILE_HELPERS_TESTING_MODE | EPHY_FILE_HELPERS_ENSURE_EXISTS, NULL)) {
+    g_debug ("Something wrong happened with ephy_file_helpers_init()");
+    return -1;
+  }
+
+  _ephy_shell_create_instance (EPHY_EMBED_SHELL_MODE_TEST);
+  g_application_register (G_APPLICATION (ephy_embed_shell_get_default ()), NULL, NULL);
+
+  g_settings_set_string (EPHY_SETTINGS_SYNC, EPHY_PREFS_SYNC_DEVICE_ID, "0123456789abcdef0123456789abcdef");
+  g_settings_set_string (EPHY_SETTINGS_SYNC, EPHY_PREFS_SYNC_DEVICE_NAME, "Test device");
+
+  g_test_add_func ("/src/ephy-open-tabs-catalog/tab_changes",
+                   test_tab_changes);
+  g_test_add_func ("/src/ephy-open-tabs-catalog/blank_tabs_are_not_listed",
+                   test_blank_tabs_are_not_listed);
+  g_test_add_func ("/src/ephy-open-tabs-catalog/windows_are_watched",
+                   test_windows_are_watched);
+  g_test_add_func ("/src/ephy-open-tabs-catalog/closed_tabs_are_forgotten",
+                   test_closed_tabs_are_forgotten);
+
+  ret = g_test_run ();
+
+  g_object_unref (ephy_embed_shell_get_default ());
+  ephy_file_helpers_shutdown ();
+
+  return ret;
+}
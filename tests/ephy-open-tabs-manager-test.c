@@ -0,0 +1,383 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ephy-debug.h"
+#include "ephy-open-tabs-manager.h"
+#include "ephy-settings.h"
+#include "ephy-sync-utils.h"
+#include "ephy-synchronizable-manager.h"
+#include "ephy-tabs-catalog.h"
+
+#include <glib.h>
+#include <json-glib/json-glib.h>
+
+#define DEVICE_ID "0123456789abcdef0123456789abcdef"
+#define DEVICE_NAME "Test device"
+
+/* A catalog whose tabs are changed by hand. */
+typedef struct {
+  guint64 id;
+  guint64 version;
+  char *title;
+  char *url;
+  gboolean closed;
+} FakeTab;
+
+#define FAKE_TYPE_CATALOG (fake_catalog_get_type ())
+G_DECLARE_FINAL_TYPE (FakeCatalog, fake_catalog, FAKE, CATALOG, GObject)
+
+struct _FakeCatalog {
+  GObject parent_instance;
+
+  GPtrArray *tabs;
+  guint64 version;
+  guint64 forgotten_version;
+  guint get_changes_calls;
+};
+
+static void fake_catalog_iface_init (EphyTabsCatalogInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (FakeCatalog, fake_catalog, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (EPHY_TYPE_TABS_CATALOG,
+                                                fake_catalog_iface_init))
+
+static void
+fake_tab_free (FakeTab *tab)
+{
+  g_free (tab->title);
+  g_free (tab->url);
+  g_free (tab);
+}
+
+static GList *
+fake_catalog_get_tabs_info (EphyTabsCatalog *catalog)
+{
+  FakeCatalog *self = FAKE_CATALOG (catalog);
+  GList *tabs_info = NULL;
+
+  for (guint i = 0; i < self->tabs->len; i++) {
+    FakeTab *tab = g_ptr_array_index (self->tabs, i);
+
+    if (!tab->closed)
+      tabs_info = g_list_prepend (tabs_info, ephy_tab_info_new (tab->title, tab->url, NULL));
+  }
+
+  return g_list_reverse (tabs_info);
+}
+
+static guint64
+fake_catalog_get_version (EphyTabsCatalog *catalog)
+{
+  return FAKE_CATALOG (catalog)->version;
+}
+
+static gboolean
+fake_catalog_get_changes (EphyTabsCatalog  *catalog,
+                          guint64           since_version,
+                          GList           **changes,
+                          guint64          *version)
+{
+  FakeCatalog *self = FAKE_CATALOG (catalog);
+  gboolean is_complete = since_version >= self->forgotten_version;
+
+  self->get_changes_calls++;
+  *changes = NULL;
+  *version = self->version;
+
+  for (guint i = 0; i < self->tabs->len; i++) {
+    FakeTab *tab = g_ptr_array_index (self->tabs, i);
+    EphyTabInfo *info = NULL;
+
+    if (is_complete ? tab->version <= since_version : tab->closed)
+      continue;
+
+    if (!tab->closed)
+      info = ephy_tab_info_new (tab->title, tab->url, NULL);
+    *changes = g_list_prepend (*changes, ephy_tab_change_new (tab->id, info));
+  }
+  *changes = g_list_reverse (*changes);
+
+  return is_complete;
+}
+
+static void
+fake_catalog_iface_init (EphyTabsCatalogInterface *iface)
+{
+  iface->get_tabs_info = fake_catalog_get_tabs_info;
+  iface->get_version = fake_catalog_get_version;
+  iface->get_changes = fake_catalog_get_changes;
+}
+
+static void
+fake_catalog_finalize (GObject *object)
+{
+  g_ptr_array_unref (FAKE_CATALOG (object)->tabs);
+
+  G_OBJECT_CLASS (fake_catalog_parent_class)->finalize (object);
+}
+
+static void
+fake_catalog_class_init (FakeCatalogClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = fake_catalog_finalize;
+}
+
+static void
+fake_catalog_init (FakeCatalog *self)
+{
+  self->tabs = g_ptr_array_new_with_free_func ((GDestroyNotify)fake_tab_free);
+}
+
+static FakeTab *
+fake_catalog_open (FakeCatalog *self,
+                   const char  *title,
+                   const char  *url)
+{
+  FakeTab *tab = g_new0 (FakeTab, 1);
+
+  tab->id = self->tabs->len + 1;
+  tab->version = ++self->version;
+  tab->title = g_strdup (title);
+  tab->url = g_strdup (url);
+  g_ptr_array_add (self->tabs, tab);
+
+  return tab;
+}
+
+static void
+fake_catalog_set_title (FakeCatalog *self,
+                        FakeTab     *tab,
+                        const char  *title)
+{
+  g_free (tab->title);
+  tab->title = g_strdup (title);
+  tab->version = ++self->version;
+}
+
+static void
+fake_catalog_close (FakeCatalog *self,
+                    FakeTab     *tab)
+{
+  tab->closed = TRUE;
+  tab->version = ++self->version;
+}
+
+static void
+merge_cb (GPtrArray *to_upload,
+          gpointer   user_data)
+{
+  GPtrArray **result = user_data;
+
+  *result = to_upload;
+}
+
+/* Runs a sync of the open tabs collection, and returns what would be
+ * uploaded. */
+static GPtrArray *
+merge (EphyOpenTabsManager *manager,
+       GList               *remotes)
+{
+  GPtrArray *to_upload = NULL;
+
+  ephy_synchronizable_manager_merge (EPHY_SYNCHRONIZABLE_MANAGER (manager), TRUE,
+                                     NULL, remotes, merge_cb, &to_upload);
+  g_assert_nonnull (to_upload);
+
+  return to_upload;
+}
+
+static GList *
+tab_titles (EphyOpenTabsRecord *record)
+{
+  GList *titles = NULL;
+
+  for (GList *l = ephy_open_tabs_record_get_tabs (record); l && l->data; l = l->next)
+    titles = g_list_prepend (titles, (char *)json_object_get_string_member (l->data, "title"));
+
+  return g_list_sort (titles, (GCompareFunc)g_strcmp0);
+}
+
+static void
+assert_tabs (EphyOpenTabsRecord *record,
+             const char         *first_title,
+             ...)
+{
+  GList *titles = tab_titles (record);
+  GList *l = titles;
+  const char *title = first_title;
+  va_list args;
+
+  va_start (args, first_title);
+  for (; title; title = va_arg (args, const char *), l = l->next) {
+    g_assert_nonnull (l);
+    g_assert_cmpstr (l->data, ==, title);
+  }
+  va_end (args);
+
+  g_assert_null (l);
+  g_list_free (titles);
+}
+
+static void
+test_upload_only_changes (void)
+{
+  FakeCatalog *catalog = g_object_new (FAKE_TYPE_CATALOG, NULL);
+  EphyOpenTabsManager *manager = ephy_open_tabs_manager_new (EPHY_TABS_CATALOG (catalog));
+  EphyOpenTabsRecord *on_server;
+  g_autofree char *device_bso_id = ephy_sync_utils_get_device_bso_id ();
+  GPtrArray *to_upload;
+  GList *remotes;
+  FakeTab *a;
+  FakeTab *b;
+
+  a = fake_catalog_open (catalog, "A", "https://a.example/");
+  b = fake_catalog_open (catalog, "B", "https://b.example/");
+
+  /* Nothing was uploaded yet. */
+  to_upload = merge (manager, NULL);
+  g_assert_cmpuint (to_upload->len, ==, 1);
+  assert_tabs (g_ptr_array_index (to_upload, 0), "A", "B", NULL);
+  g_ptr_array_unref (to_upload);
+  ephy_synchronizable_manager_set_sync_time (EPHY_SYNCHRONIZABLE_MANAGER (manager), 100);
+
+  /* Up to date. */
+  on_server = ephy_open_tabs_record_new (device_bso_id, DEVICE_NAME);
+  remotes = g_list_append (NULL, on_server);
+  to_upload = merge (manager, remotes);
+  g_assert_cmpuint (to_upload->len, ==, 0);
+  g_ptr_array_unref (to_upload);
+
+  /* A failed upload is retried on the next sync. */
+  fake_catalog_set_title (catalog, a, "A2");
+  to_upload = merge (manager, remotes);
+  g_assert_cmpuint (to_upload->len, ==, 1);
+  g_ptr_array_unref (to_upload);
+  to_upload = merge (manager, remotes);
+  g_assert_cmpuint (to_upload->len, ==, 1);
+  assert_tabs (g_ptr_array_index (to_upload, 0), "A2", "B", NULL);
+  g_ptr_array_unref (to_upload);
+  ephy_synchronizable_manager_set_sync_time (EPHY_SYNCHRONIZABLE_MANAGER (manager), 200);
+
+  to_upload = merge (manager, remotes);
+  g_assert_cmpuint (to_upload->len, ==, 0);
+  g_ptr_array_unref (to_upload);
+
+  fake_catalog_close (catalog, b);
+  to_upload = merge (manager, remotes);
+  g_assert_cmpuint (to_upload->len, ==, 1);
+  assert_tabs (g_ptr_array_index (to_upload, 0), "A2", NULL);
+  g_ptr_array_unref (to_upload);
+  ephy_synchronizable_manager_set_sync_time (EPHY_SYNCHRONIZABLE_MANAGER (manager), 300);
+
+  /* The record of this device went missing from the server. */
+  to_upload = merge (manager, NULL);
+  g_assert_cmpuint (to_upload->len, ==, 1);
+  g_ptr_array_unref (to_upload);
+
+  /* The device was renamed. */
+  g_settings_set_string (EPHY_SETTINGS_SYNC, EPHY_PREFS_SYNC_DEVICE_NAME, "Renamed device");
+  to_upload = merge (manager, remotes);
+  g_assert_cmpuint (to_upload->len, ==, 1);
+  g_ptr_array_unref (to_upload);
+  g_settings_set_string (EPHY_SETTINGS_SYNC, EPHY_PREFS_SYNC_DEVICE_NAME, DEVICE_NAME);
+
+  g_list_free_full (remotes, g_object_unref);
+  g_object_unref (manager);
+  g_object_unref (catalog);
+}
+
+static void
+test_remote_tabs (void)
+{
+  FakeCatalog *catalog = g_object_new (FAKE_TYPE_CATALOG, NULL);
+  EphyOpenTabsManager *manager = ephy_open_tabs_manager_new (EPHY_TABS_CATALOG (catalog));
+  GPtrArray *to_upload;
+  GList *remotes = NULL;
+  GList *remote_tabs;
+  g_autofree char *device_bso_id = ephy_sync_utils_get_device_bso_id ();
+
+  remotes = g_list_append (remotes, ephy_open_tabs_record_new (device_bso_id, DEVICE_NAME));
+  remotes = g_list_append (remotes, ephy_open_tabs_record_new ("other-device", "Other device"));
+
+  to_upload = merge (manager, remotes);
+  g_ptr_array_unref (to_upload);
+
+  remote_tabs = ephy_open_tabs_manager_get_remote_tabs (manager);
+  g_assert_cmpuint (g_list_length (remote_tabs), ==, 1);
+  g_assert_cmpstr (ephy_open_tabs_record_get_id (remote_tabs->data), ==, "other-device");
+
+  g_list_free_full (remotes, g_object_unref);
+  g_object_unref (manager);
+  g_object_unref (catalog);
+}
+
+static void
+test_catalog_changes (void)
+{
+  FakeCatalog *catalog = g_object_new (FAKE_TYPE_CATALOG, NULL);
+  EphyOpenTabsManager *manager = ephy_open_tabs_manager_new (EPHY_TABS_CATALOG (catalog));
+  EphyOpenTabsRecord *record;
+  FakeTab *a;
+
+  a = fake_catalog_open (catalog, "A", "https://a.example/");
+  fake_catalog_open (catalog, "B", "https://b.example/");
+  record = ephy_open_tabs_manager_get_local_tabs (manager);
+  assert_tabs (record, "A", "B", NULL);
+  g_object_unref (record);
+
+  fake_catalog_close (catalog, a);
+  fake_catalog_open (catalog, "C", "https://c.example/");
+  record = ephy_open_tabs_manager_get_local_tabs (manager);
+  assert_tabs (record, "B", "C", NULL);
+  g_object_unref (record);
+
+  /* The catalog forgot what happened since the last call, and sends
+   * everything again. */
+  catalog->forgotten_version = catalog->version + 1;
+  fake_catalog_open (catalog, "D", "https://d.example/");
+  catalog->version++;
+  record = ephy_open_tabs_manager_get_local_tabs (manager);
+  assert_tabs (record, "B", "C", "D", NULL);
+  g_object_unref (record);
+
+  g_assert_cmpuint (catalog->get_changes_calls, ==, 3);
+
+  g_object_unref (manager);
+  g_object_unref (catalog);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  ephy_debug_init ();
+
+  g_settings_set_string (EPHY_SETTINGS_SYNC, EPHY_PREFS_SYNC_DEVICE_ID, DEVICE_ID);
+  g_settings_set_string (EPHY_SETTINGS_SYNC, EPHY_PREFS_SYNC_DEVICE_NAME, DEVICE_NAME);
+
+  g_test_add_func ("/lib/sync/ephy-open-tabs-manager/upload_only_changes", test_upload_only_changes);
+  g_test_add_func ("/lib/sync/ephy-open-tabs-manager/remote_tabs", test_remote_tabs);
+  g_test_add_func ("/lib/sync/ephy-open-tabs-manager/catalog_changes", test_catalog_changes);
+
+  return g_test_run ();
+}
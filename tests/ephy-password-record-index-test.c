@@ -0,0 +1,250 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ephy-password-record-index.h"
+#include "ephy-synchronizable.h"
+
+#include <glib.h>
+
+static EphyPasswordRecord *
+record_new (const char *id,
+            const char *origin,
+            const char *target_origin,
+            const char *username,
+            const char *password)
+{
+  return ephy_password_record_new (id, origin, target_origin,
+                                   username, password,
+                                   "user", "pass",
+                                   1000, 1000);
+}
+
+static EphyPasswordRecordIndex *
+index_new_with_records (void)
+{
+  EphyPasswordRecordIndex *index;
+  GList *records = NULL;
+
+  records = g_list_prepend (records, record_new ("{a}", "https://a.example", "https://a.example", "alice", "one"));
+  records = g_list_prepend (records, record_new ("{b}", "https://a.example", "https://a.example", "bob", "two"));
+  records = g_list_prepend (records, record_new ("{c}", "https://a.example", "https://login.a.example", "alice", "three"));
+  records = g_list_prepend (records, record_new ("{d}", "https://b.example", "https://b.example", "alice", "four"));
+  index = ephy_password_record_index_new_from_list (records);
+  g_list_free_full (records, g_object_unref);
+
+  return index;
+}
+
+static gboolean
+records_have_ids (GList      *records,
+                  const char *first_id,
+                  ...)
+{
+  GHashTable *ids;
+  va_list args;
+  gboolean result = TRUE;
+
+  ids = g_hash_table_new (g_str_hash, g_str_equal);
+  va_start (args, first_id);
+  for (const char *id = first_id; id; id = va_arg (args, const char *))
+    g_hash_table_add (ids, (gpointer)id);
+  va_end (args);
+
+  if (g_list_length (records) != g_hash_table_size (ids))
+    result = FALSE;
+  for (GList *l = records; l && result; l = l->next)
+    result = g_hash_table_contains (ids, ephy_password_record_get_id (l->data));
+
+  g_hash_table_unref (ids);
+
+  return result;
+}
+
+static void
+test_query_by_id (void)
+{
+  EphyPasswordRecordIndex *index = index_new_with_records ();
+  GList *records;
+
+  records = ephy_password_record_index_query (index, "{c}", NULL, NULL, NULL, NULL, NULL);
+  g_assert_true (records_have_ids (records, "{c}", NULL));
+  g_assert_cmpstr (ephy_password_record_get_password (records->data), ==, "three");
+  g_list_free_full (records, g_object_unref);
+
+  /* The other fields still have to match. */
+  records = ephy_password_record_index_query (index, "{c}", "https://b.example", NULL, NULL, NULL, NULL);
+  g_assert_null (records);
+
+  records = ephy_password_record_index_query (index, "{z}", NULL, NULL, NULL, NULL, NULL);
+  g_assert_null (records);
+
+  ephy_password_record_index_free (index);
+}
+
+static void
+test_query_by_tuple (void)
+{
+  EphyPasswordRecordIndex *index = index_new_with_records ();
+  GList *records;
+
+  records = ephy_password_record_index_query (index, NULL,
+                                              "https://a.example", "https://a.example", "alice",
+                                              NULL, NULL);
+  g_assert_true (records_have_ids (records, "{a}", NULL));
+  g_list_free_full (records, g_object_unref);
+
+  records = ephy_password_record_index_query (index, NULL,
+                                              "https://a.example", "https://a.example", "alice",
+                                              "user", "pass");
+  g_assert_true (records_have_ids (records, "{a}", NULL));
+  g_list_free_full (records, g_object_unref);
+
+  records = ephy_password_record_index_query (index, NULL,
+                                              "https://a.example", "https://a.example", "alice",
+                                              "email", NULL);
+  g_assert_null (records);
+
+  g_assert_nonnull (ephy_password_record_index_lookup_parameters (index,
+                                                                  "https://a.example", "https://login.a.example", "alice",
+                                                                  "user", "pass"));
+  g_assert_null (ephy_password_record_index_lookup_parameters (index,
+                                                               "https://a.example", "https://login.a.example", "bob",
+                                                               "user", "pass"));
+
+  ephy_password_record_index_free (index);
+}
+
+static void
+test_query_by_origin (void)
+{
+  EphyPasswordRecordIndex *index = index_new_with_records ();
+  GList *records;
+
+  records = ephy_password_record_index_query (index, NULL, "https://a.example", NULL, NULL, NULL, NULL);
+  g_assert_true (records_have_ids (records, "{a}", "{b}", "{c}", NULL));
+  g_list_free_full (records, g_object_unref);
+
+  records = ephy_password_record_index_query (index, NULL, "https://a.example", NULL, "alice", NULL, NULL);
+  g_assert_true (records_have_ids (records, "{a}", "{c}", NULL));
+  g_list_free_full (records, g_object_unref);
+
+  records = ephy_password_record_index_query (index, NULL, NULL, NULL, "alice", NULL, NULL);
+  g_assert_true (records_have_ids (records, "{a}", "{c}", "{d}", NULL));
+  g_list_free_full (records, g_object_unref);
+
+  records = ephy_password_record_index_query (index, NULL, NULL, NULL, NULL, NULL, NULL);
+  g_assert_cmpuint (g_list_length (records), ==, 4);
+  g_list_free_full (records, g_object_unref);
+
+  ephy_password_record_index_free (index);
+}
+
+static void
+test_add_replace_remove (void)
+{
+  EphyPasswordRecordIndex *index = ephy_password_record_index_new ();
+  EphyPasswordRecord *record;
+  GList *records;
+
+  record = record_new ("{a}", "https://a.example", "https://a.example", "alice", "one");
+  ephy_password_record_index_add (index, record);
+  g_object_unref (record);
+  g_assert_cmpuint (ephy_password_record_index_get_size (index), ==, 1);
+
+  /* Same id with a new username: the old tuple must not find it anymore. */
+  record = record_new ("{a}", "https://a.example", "https://a.example", "bob", "two");
+  ephy_password_record_index_add (index, record);
+  g_object_unref (record);
+  g_assert_cmpuint (ephy_password_record_index_get_size (index), ==, 1);
+
+  records = ephy_password_record_index_query (index, NULL,
+                                              "https://a.example", "https://a.example", "alice",
+                                              NULL, NULL);
+  g_assert_null (records);
+  records = ephy_password_record_index_query (index, NULL,
+                                              "https://a.example", "https://a.example", "bob",
+                                              NULL, NULL);
+  g_assert_true (records_have_ids (records, "{a}", NULL));
+  g_assert_cmpstr (ephy_password_record_get_password (records->data), ==, "two");
+  g_list_free_full (records, g_object_unref);
+
+  records = ephy_password_record_index_query (index, NULL, "https://a.example", NULL, NULL, NULL, NULL);
+  g_assert_cmpuint (g_list_length (records), ==, 1);
+  g_list_free_full (records, g_object_unref);
+
+  ephy_password_record_index_remove (index, "{a}");
+  g_assert_cmpuint (ephy_password_record_index_get_size (index), ==, 0);
+  g_assert_null (ephy_password_record_index_lookup_id (index, "{a}"));
+  records = ephy_password_record_index_query (index, NULL, "https://a.example", NULL, NULL, NULL, NULL);
+  g_assert_null (records);
+
+  /* Removing an unknown id is harmless. */
+  ephy_password_record_index_remove (index, "{a}");
+
+  ephy_password_record_index_free (index);
+}
+
+static void
+test_records_are_copied (void)
+{
+  EphyPasswordRecordIndex *index = ephy_password_record_index_new ();
+  EphyPasswordRecord *record;
+  GList *records;
+
+  record = record_new ("{a}", "https://a.example", "https://a.example", "alice", "one");
+  ephy_synchronizable_set_server_time_modified (EPHY_SYNCHRONIZABLE (record), 42);
+  ephy_password_record_index_add (index, record);
+
+  /* Neither the added record nor the query results are the indexed ones. */
+  ephy_password_record_set_password (record, "changed");
+  records = ephy_password_record_index_query (index, "{a}", NULL, NULL, NULL, NULL, NULL);
+  g_assert_cmpstr (ephy_password_record_get_password (records->data), ==, "one");
+  g_assert_cmpint (ephy_synchronizable_get_server_time_modified (records->data), ==, 42);
+  g_assert_true (records->data != ephy_password_record_index_lookup_id (index, "{a}"));
+
+  ephy_password_record_set_password (records->data, "changed");
+  g_list_free_full (records, g_object_unref);
+  g_assert_cmpstr (ephy_password_record_get_password (ephy_password_record_index_lookup_id (index, "{a}")), ==, "one");
+
+  g_object_unref (record);
+  ephy_password_record_index_free (index);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/lib/sync/password-record-index/query_by_id",
+                   test_query_by_id);
+  g_test_add_func ("/lib/sync/password-record-index/query_by_tuple",
+                   test_query_by_tuple);
+  g_test_add_func ("/lib/sync/password-record-index/query_by_origin",
+                   test_query_by_origin);
+  g_test_add_func ("/lib/sync/password-record-index/add_replace_remove",
+                   test_add_replace_remove);
+  g_test_add_func ("/lib/sync/password-record-index/records_are_copied",
+                   test_records_are_copied);
+
+  return g_test_run ();
+}
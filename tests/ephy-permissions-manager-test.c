@@ -0,0 +1,248 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ephy-debug.h"
+#include "ephy-file-helpers.h"
+#include "ephy-permissions-manager.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <webkit2/webkit2.h>
+
+static char *
+permissions_filename (void)
+{
+  return g_build_filename (ephy_profile_dir (), "permissions.ini", NULL);
+}
+
+/* Each test starts from a profile without any permission. */
+static EphyPermissionsManager *
+permissions_manager_new_empty (void)
+{
+  g_autofree char *filename = permissions_filename ();
+
+  g_unlink (filename);
+
+  return ephy_permissions_manager_new ();
+}
+
+static void
+test_set_and_get (void)
+{
+  EphyPermissionsManager *manager = permissions_manager_new_empty ();
+
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.com/"),
+                   ==, EPHY_PERMISSION_UNDECIDED);
+
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.com/", EPHY_PERMISSION_PERMIT);
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_WEBCAM, "https://example.com/", EPHY_PERMISSION_DENY);
+
+  /* Every type has its own bits, and any address of the origin finds them. */
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.com/page"),
+                   ==, EPHY_PERMISSION_PERMIT);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_WEBCAM, "https://example.com/"),
+                   ==, EPHY_PERMISSION_DENY);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_MICROPHONE, "https://example.com/"),
+                   ==, EPHY_PERMISSION_UNDECIDED);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS, "https://example.com/"),
+                   ==, EPHY_PERMISSION_UNDECIDED);
+
+  /* Other origins are not affected. */
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "http://example.com/"),
+                   ==, EPHY_PERMISSION_UNDECIDED);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.com:8443/"),
+                   ==, EPHY_PERMISSION_UNDECIDED);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.org/"),
+                   ==, EPHY_PERMISSION_UNDECIDED);
+
+  /* Changing one type leaves the others alone. */
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.com/", EPHY_PERMISSION_DENY);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.com/"),
+                   ==, EPHY_PERMISSION_DENY);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_WEBCAM, "https://example.com/"),
+                   ==, EPHY_PERMISSION_DENY);
+
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.com/", EPHY_PERMISSION_UNDECIDED);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.com/"),
+                   ==, EPHY_PERMISSION_UNDECIDED);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_WEBCAM, "https://example.com/"),
+                   ==, EPHY_PERMISSION_DENY);
+
+  g_object_unref (manager);
+}
+
+static void
+test_saved_and_reloaded (void)
+{
+  EphyPermissionsManager *manager = permissions_manager_new_empty ();
+  g_autofree char *filename = permissions_filename ();
+  g_autoptr (GKeyFile) keyfile = g_key_file_new ();
+  g_autofree char *value = NULL;
+  GError *error = NULL;
+
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_SAVE_PASSWORD, "https://example.com/", EPHY_PERMISSION_DENY);
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS, "https://example.com/", EPHY_PERMISSION_PERMIT);
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.org/", EPHY_PERMISSION_PERMIT);
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.org/", EPHY_PERMISSION_UNDECIDED);
+
+  /* Disposing the manager writes out the pending changes. */
+  g_object_unref (manager);
+
+  /* In the format GSettings used to write. An origin left without any
+   * decision has no group. */
+  g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, &error);
+  g_assert_no_error (error);
+  value = g_key_file_get_value (keyfile, "org/gnome/epiphany/permissions/https/example.com/0", "save-password-permission", NULL);
+  g_assert_cmpstr (value, ==, "'deny'");
+  g_assert_false (g_key_file_has_group (keyfile, "org/gnome/epiphany/permissions/https/example.org/0"));
+
+  manager = ephy_permissions_manager_new ();
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_SAVE_PASSWORD, "https://example.com/"),
+                   ==, EPHY_PERMISSION_DENY);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS, "https://example.com/"),
+                   ==, EPHY_PERMISSION_PERMIT);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.org/"),
+                   ==, EPHY_PERMISSION_UNDECIDED);
+  g_object_unref (manager);
+}
+
+static void
+test_load_existing_file (void)
+{
+  EphyPermissionsManager *manager;
+  g_autofree char *filename = permissions_filename ();
+  GError *error = NULL;
+  const char *contents =
+    "[org/gnome/epiphany/permissions/https/example.com/0]\n"
+    "geolocation-permission='allow'\n"
+    "video-device-permission='deny'\n"
+    "audio-device-permission='undecided'\n"
+    "unknown-permission='allow'\n"
+    "\n"
+    "[org/gnome/epiphany/permissions/http/example.org/8080]\n"
+    "notifications-permission='allow'\n"
+    "\n"
+    "[org/gnome/epiphany/other/https/example.net/0]\n"
+    "geolocation-permission='allow'\n";
+
+  g_file_set_contents (filename, contents, -1, &error);
+  g_assert_no_error (error);
+
+  manager = ephy_permissions_manager_new ();
+
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.com/"),
+                   ==, EPHY_PERMISSION_PERMIT);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_WEBCAM, "https://example.com/"),
+                   ==, EPHY_PERMISSION_DENY);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_MICROPHONE, "https://example.com/"),
+                   ==, EPHY_PERMISSION_UNDECIDED);
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS, "http://example.org:8080/"),
+                   ==, EPHY_PERMISSION_PERMIT);
+
+  /* Groups outside of the permissions path are ignored. */
+  g_assert_cmpint (ephy_permissions_manager_get_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.net/"),
+                   ==, EPHY_PERMISSION_UNDECIDED);
+
+  g_object_unref (manager);
+}
+
+static gboolean
+origins_contain_host (GList      *origins,
+                      const char *host)
+{
+  for (GList *l = origins; l; l = l->next) {
+    if (g_strcmp0 (webkit_security_origin_get_host (l->data), host) == 0)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static void
+test_permitted_and_denied_origins (void)
+{
+  EphyPermissionsManager *manager = permissions_manager_new_empty ();
+  GList *origins;
+
+  g_assert_null (ephy_permissions_manager_get_permitted_origins (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS));
+
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS, "https://example.com/", EPHY_PERMISSION_PERMIT);
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS, "https://example.org/", EPHY_PERMISSION_DENY);
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION, "https://example.net/", EPHY_PERMISSION_PERMIT);
+
+  origins = ephy_permissions_manager_get_permitted_origins (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS);
+  g_assert_cmpuint (g_list_length (origins), ==, 1);
+  g_assert_true (origins_contain_host (origins, "example.com"));
+
+  origins = ephy_permissions_manager_get_denied_origins (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS);
+  g_assert_cmpuint (g_list_length (origins), ==, 1);
+  g_assert_true (origins_contain_host (origins, "example.org"));
+
+  /* The cached lists follow later changes. */
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS, "https://example.org/", EPHY_PERMISSION_PERMIT);
+  origins = ephy_permissions_manager_get_permitted_origins (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS);
+  g_assert_cmpuint (g_list_length (origins), ==, 2);
+  g_assert_true (origins_contain_host (origins, "example.com"));
+  g_assert_true (origins_contain_host (origins, "example.org"));
+  g_assert_null (ephy_permissions_manager_get_denied_origins (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS));
+
+  ephy_permissions_manager_set_permission (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS, "https://example.com/", EPHY_PERMISSION_UNDECIDED);
+  origins = ephy_permissions_manager_get_permitted_origins (manager, EPHY_PERMISSION_TYPE_SHOW_NOTIFICATIONS);
+  g_assert_cmpuint (g_list_length (origins), ==, 1);
+  g_assert_true (origins_contain_host (origins, "example.org"));
+
+  origins = ephy_permissions_manager_get_permitted_origins (manager, EPHY_PERMISSION_TYPE_ACCESS_LOCATION);
+  g_assert_cmpuint (g_list_length (origins), ==, 1);
+  g_assert_true (origins_contain_host (origins, "example.net"));
+
+  g_object_unref (manager);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  int ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  ephy_debug_init ();
+
+  if (!ephy_file_helpers_init (NULL, EPHY_FILE_HELPERS_TESTING_MODE | EPHY_FILE_HELPERS_ENSURE_EXISTS, NULL)) {
+    g_debug ("Something wrong happened with ephy_file_helpers_init()");
+    return -1;
+  }
+
+  g_test_add_func ("/lib/ephy-permissions-manager/set_and_get",
+                   test_set_and_get);
+  g_test_add_func ("/lib/ephy-permissions-manager/saved_and_reloaded",
+                   test_saved_and_reloaded);
+  g_test_add_func ("/lib/ephy-permissions-manager/load_existing_file",
+                   test_load_existing_file);
+  g_test_add_func ("/lib/ephy-permissions-manager/permitted_and_denied_origins",
+                   test_permitted_and_denied_origins);
+
+  ret = g_test_run ();
+
+  ephy_file_helpers_shutdown ();
+
+  return ret;
+}
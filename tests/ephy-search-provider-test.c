@@ -0,0 +1,245 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ephy-debug.h"
+#include "ephy-embed-shell.h"
+#include "ephy-file-helpers.h"
+#include "ephy-history-service.h"
+#include "ephy-search-provider.h"
+#include "ephy-shell.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#define SEARCH_PROVIDER_BUS_NAME "org.gnome.Epiphany.SearchProvider"
+#define SEARCH_PROVIDER_OBJECT_PATH "/org/gnome/Epiphany/SearchProvider"
+
+typedef struct {
+  GMainLoop *loop;
+  char **results;
+} CallData;
+
+static void
+history_job_cb (EphyHistoryService *service,
+                gboolean            success,
+                gpointer            result_data,
+                GMainLoop          *loop)
+{
+  g_assert_true (success);
+  g_main_loop_quit (loop);
+}
+
+static void
+initial_result_set_cb (GObject      *source,
+                       GAsyncResult *result,
+                       CallData     *data)
+{
+  GError *error = NULL;
+
+  ephy_shell_search_provider2_call_get_initial_result_set_finish (EPHY_SHELL_SEARCH_PROVIDER2 (source),
+                                                                  &data->results,
+                                                                  result, &error);
+  g_assert_no_error (error);
+  g_main_loop_quit (data->loop);
+}
+
+static char **
+get_initial_result_set (EphyShellSearchProvider2 *proxy,
+                        const char               *query)
+{
+  char **terms = g_strsplit (query, " ", -1);
+  CallData data = { NULL, };
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  ephy_shell_search_provider2_call_get_initial_result_set (proxy, (const char * const *)terms, NULL,
+                                                          (GAsyncReadyCallback)initial_result_set_cb,
+                                                          &data);
+  g_main_loop_run (data.loop);
+  g_main_loop_unref (data.loop);
+  g_strfreev (terms);
+
+  return data.results;
+}
+
+static void
+subsearch_result_set_cb (GObject      *source,
+                         GAsyncResult *result,
+                         CallData     *data)
+{
+  GError *error = NULL;
+
+  ephy_shell_search_provider2_call_get_subsearch_result_set_finish (EPHY_SHELL_SEARCH_PROVIDER2 (source),
+                                                                    &data->results,
+                                                                    result, &error);
+  g_assert_no_error (error);
+  g_main_loop_quit (data->loop);
+}
+
+static char **
+get_subsearch_result_set (EphyShellSearchProvider2 *proxy,
+                          char                    **previous_results,
+                          const char               *query)
+{
+  char **terms = g_strsplit (query, " ", -1);
+  CallData data = { NULL, };
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  ephy_shell_search_provider2_call_get_subsearch_result_set (proxy,
+                                                            (const char * const *)previous_results,
+                                                            (const char * const *)terms, NULL,
+                                                            (GAsyncReadyCallback)subsearch_result_set_cb,
+                                                            &data);
+  g_main_loop_run (data.loop);
+  g_main_loop_unref (data.loop);
+  g_strfreev (terms);
+
+  return data.results;
+}
+
+/* One kept row, then a row per search engine for @query, then the web search. */
+static void
+assert_refined_results (char       **results,
+                        const char  *uri,
+                        const char  *query)
+{
+  EphySearchEngineManager *manager;
+  g_auto (GStrv) engines = NULL;
+  g_autofree char *special = NULL;
+  guint n_engines;
+
+  manager = ephy_embed_shell_get_search_engine_manager (ephy_embed_shell_get_default ());
+  engines = ephy_search_engine_manager_get_names (manager);
+  n_engines = g_strv_length (engines);
+
+  g_assert_cmpuint (g_strv_length (results), ==, n_engines + 2);
+  g_assert_cmpstr (results[0], ==, uri);
+  for (guint i = 0; i < n_engines; i++) {
+    g_autofree char *address = ephy_search_engine_manager_build_search_address (manager, engines[i], query);
+
+    g_assert_cmpstr (results[i + 1], ==, address);
+  }
+
+  special = g_strdup_printf ("special:search:%s", query);
+  g_assert_cmpstr (results[n_engines + 1], ==, special);
+}
+
+static void
+test_subsearch_refines_cached_results (void)
+{
+  EphyHistoryService *service;
+  EphySearchProvider *provider;
+  EphyShellSearchProvider2 *proxy;
+  GMainLoop *loop;
+  char **initial;
+  char **refined;
+  char **fresh;
+  GError *error = NULL;
+
+  service = ephy_embed_shell_get_global_history_service (ephy_embed_shell_get_default ());
+  loop = g_main_loop_new (NULL, FALSE);
+
+  ephy_history_service_visit_url (service, "http://alpha.example/", NULL,
+                                  g_get_real_time (), EPHY_PAGE_VISIT_TYPED, FALSE);
+  ephy_history_service_set_url_title (service, "http://alpha.example/", "Alpha Centauri", NULL, NULL, NULL);
+  ephy_history_service_visit_url (service, "http://alps.example/", NULL,
+                                  g_get_real_time (), EPHY_PAGE_VISIT_TYPED, FALSE);
+  ephy_history_service_set_url_title (service, "http://alps.example/", "Alps", NULL,
+                                      (EphyHistoryJobCallback)history_job_cb, loop);
+  g_main_loop_run (loop);
+
+  provider = ephy_search_provider_new ();
+  g_application_register (G_APPLICATION (provider), NULL, &error);
+  g_assert_no_error (error);
+
+  proxy = ephy_shell_search_provider2_proxy_new_for_bus_sync (G_BUS_TYPE_SESSION,
+                                                              G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+                                                              G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+                                                              SEARCH_PROVIDER_BUS_NAME,
+                                                              SEARCH_PROVIDER_OBJECT_PATH,
+                                                              NULL, &error);
+  g_assert_no_error (error);
+
+  initial = get_initial_result_set (proxy, "alp");
+  g_assert_true (g_strv_contains ((const char * const *)initial, "http://alpha.example/"));
+  g_assert_true (g_strv_contains ((const char * const *)initial, "http://alps.example/"));
+
+  /* A new query would find nothing now, so the refinement must come from
+   * the cached results. */
+  ephy_history_service_clear (service, NULL,
+                              (EphyHistoryJobCallback)history_job_cb, loop);
+  g_main_loop_run (loop);
+
+  refined = get_subsearch_result_set (proxy, initial, "alpha");
+  assert_refined_results (refined, "http://alpha.example/", "alpha");
+
+  /* Each word may match the title or the address, whatever its case. */
+  g_strfreev (initial);
+  initial = refined;
+  refined = get_subsearch_result_set (proxy, initial, "ALPHA cen");
+  assert_refined_results (refined, "http://alpha.example/", "ALPHA cen");
+
+  fresh = get_initial_result_set (proxy, "alpha");
+  g_assert_false (g_strv_contains ((const char * const *)fresh, "http://alpha.example/"));
+
+  g_strfreev (initial);
+  g_strfreev (refined);
+  g_strfreev (fresh);
+  g_object_unref (proxy);
+  g_object_unref (provider);
+  g_main_loop_unref (loop);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GTestDBus *bus;
+  int ret;
+
+  /* The provider is exported on a private session bus. */
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+
+  gtk_test_init (&argc, &argv);
+
+  ephy_debug_init ();
+
+  if (!ephy_file_helpers_init (NULL, EPHY_FILE_HELPERS_TESTING_MODE | EPHY_FILE_HELPERS_ENSURE_EXISTS, NULL)) {
+    g_debug ("Something wrong happened with ephy_file_helpers_init()");
+    return -1;
+  }
+
+  _ephy_shell_create_instance (EPHY_EMBED_SHELL_MODE_TEST);
+  g_application_register (G_APPLICATION (ephy_embed_shell_get_default ()), NULL, NULL);
+
+  g_test_add_func ("/src/search-provider/subsearch_refines_cached_results",
+                   test_subsearch_refines_cached_results);
+
+  ret = g_test_run ();
+
+  g_object_unref (ephy_embed_shell_get_default ());
+  ephy_file_helpers_shutdown ();
+
+  g_test_dbus_down (bus);
+  g_object_unref (bus);
+
+  return ret;
+}
@@ -0,0 +1,340 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ephy-bookmarks-manager.h"
+#include "ephy-debug.h"
+#include "ephy-file-helpers.h"
+#include "ephy-history-service.h"
+#include "ephy-suggestion-index.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#define HISTORY_LIMIT 8
+
+static const char *
+test_db_filename (void)
+{
+  static char *filename = NULL;
+  if (!filename)
+    filename = g_build_filename (g_get_tmp_dir (), "epiphany-suggestion-index-test.db", NULL);
+  return filename;
+}
+
+static EphyHistoryService *
+create_history (void)
+{
+  if (g_file_test (test_db_filename (), G_FILE_TEST_IS_REGULAR))
+    g_unlink (test_db_filename ());
+
+  return ephy_history_service_new (test_db_filename (), EPHY_SQLITE_CONNECTION_MODE_READWRITE);
+}
+
+static void
+add_history (EphyHistoryService *service,
+             const char         *url,
+             const char         *title,
+             int                 visit_count)
+{
+  GList *visits = NULL;
+
+  for (int i = 0; i < visit_count; i++) {
+    EphyHistoryPageVisit *visit;
+
+    visit = ephy_history_page_visit_new (url, g_get_real_time (), EPHY_PAGE_VISIT_TYPED);
+    visit->url->title = g_strdup (title);
+    visits = g_list_prepend (visits, visit);
+  }
+
+  ephy_history_service_add_visits (service, visits, NULL, NULL, NULL);
+  g_list_free_full (visits, (GDestroyNotify)ephy_history_page_visit_free);
+}
+
+static EphyBookmark *
+create_bookmark (const char *url,
+                 const char *title)
+{
+  static int n_bookmarks = 0;
+  g_autofree char *id = g_strdup_printf ("suggestion-index-test-%d", n_bookmarks++);
+
+  return ephy_bookmark_new (url, title, g_sequence_new (g_free), id);
+}
+
+static void
+remove_all_bookmarks (EphyBookmarksManager *manager)
+{
+  GSequence *bookmarks = ephy_bookmarks_manager_get_bookmarks (manager);
+
+  while (!g_sequence_is_empty (bookmarks))
+    ephy_bookmarks_manager_remove_bookmark (manager, g_sequence_get (g_sequence_get_begin_iter (bookmarks)));
+}
+
+static void
+wait_until_ready (EphySuggestionIndex *index)
+{
+  GPtrArray *bookmarks;
+  GList *urls;
+  gboolean complete;
+
+  g_assert_false (ephy_suggestion_index_query (index, "", HISTORY_LIMIT, &bookmarks, &urls, &complete));
+
+  while (!ephy_suggestion_index_is_ready (index))
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static gboolean
+query_has (EphySuggestionIndex *index,
+           const char          *query,
+           const char          *url)
+{
+  GPtrArray *bookmarks;
+  GList *urls;
+  gboolean complete;
+  gboolean found = FALSE;
+
+  g_assert_true (ephy_suggestion_index_query (index, query, HISTORY_LIMIT, &bookmarks, &urls, &complete));
+
+  for (guint i = 0; i < bookmarks->len; i++)
+    found |= g_strcmp0 (ephy_bookmark_get_url (bookmarks->pdata[i]), url) == 0;
+  for (GList *l = urls; l; l = l->next)
+    found |= g_strcmp0 (((EphyHistoryURL *)l->data)->url, url) == 0;
+
+  g_ptr_array_unref (bookmarks);
+  ephy_history_url_list_free (urls);
+
+  return found;
+}
+
+static void
+test_substring_matching (void)
+{
+  EphyHistoryService *service;
+  EphyBookmarksManager *manager;
+  EphySuggestionIndex *index;
+  EphyBookmark *bookmark;
+
+  service = create_history ();
+  add_history (service, "https://planet.gnome.org/", "Planet GNOME", 3);
+  add_history (service, "https://example.com/recipes/soup", "Soup of the Day", 1);
+  add_history (service, "https://github.com/", "GitHub", 2);
+
+  manager = ephy_bookmarks_manager_new ();
+  bookmark = create_bookmark ("https://www.gnome.org/foundation/", "The GNOME Foundation");
+  ephy_bookmarks_manager_add_bookmark (manager, bookmark);
+
+  index = ephy_suggestion_index_new (service, manager);
+  wait_until_ready (index);
+
+  g_assert_true (query_has (index, "gno", "https://www.gnome.org/foundation/"));
+  g_assert_true (query_has (index, "gno", "https://planet.gnome.org/"));
+  g_assert_true (query_has (index, "Foun GNO", "https://www.gnome.org/foundation/"));
+  g_assert_false (query_has (index, "foun gno", "https://planet.gnome.org/"));
+  g_assert_true (query_has (index, "gnome.org/fo", "https://www.gnome.org/foundation/"));
+  g_assert_true (query_has (index, "recipes", "https://example.com/recipes/soup"));
+  g_assert_true (query_has (index, "day", "https://example.com/recipes/soup"));
+  g_assert_true (query_has (index, "oup", "https://example.com/recipes/soup"));
+  g_assert_true (query_has (index, "hub", "https://github.com/"));
+  g_assert_true (query_has (index, "b.com", "https://github.com/"));
+  g_assert_true (query_has (index, "GNOME.ORG/FOUND", "https://www.gnome.org/foundation/"));
+  g_assert_false (query_has (index, "hub", "https://planet.gnome.org/"));
+  g_assert_false (query_has (index, "oup planet", "https://example.com/recipes/soup"));
+
+  remove_all_bookmarks (manager);
+  g_object_unref (bookmark);
+  g_object_unref (index);
+  g_object_unref (manager);
+  g_object_unref (service);
+}
+
+static void
+test_incremental_updates (void)
+{
+  EphyHistoryService *service;
+  EphyBookmarksManager *manager;
+  EphySuggestionIndex *index;
+  EphyBookmark *bookmark;
+
+  service = create_history ();
+  manager = ephy_bookmarks_manager_new ();
+  index = ephy_suggestion_index_new (service, manager);
+  wait_until_ready (index);
+
+  bookmark = create_bookmark ("https://wiki.gnome.org/", "Community Pages");
+  ephy_bookmarks_manager_add_bookmark (manager, bookmark);
+  g_assert_true (query_has (index, "wiki", "https://wiki.gnome.org/"));
+  g_assert_true (query_has (index, "community", "https://wiki.gnome.org/"));
+
+  ephy_bookmark_set_title (bookmark, "Apps for GNOME");
+  g_assert_true (query_has (index, "apps", "https://wiki.gnome.org/"));
+  g_assert_false (query_has (index, "community", "https://wiki.gnome.org/"));
+  g_assert_true (query_has (index, "apps wiki", "https://wiki.gnome.org/"));
+  g_assert_true (query_has (index, "wiki.gnome", "https://wiki.gnome.org/"));
+
+  ephy_bookmark_set_url (bookmark, "https://apps.gnome.org/");
+  g_assert_true (query_has (index, "apps.gnome", "https://apps.gnome.org/"));
+  g_assert_false (query_has (index, "wiki", "https://wiki.gnome.org/"));
+
+  ephy_bookmarks_manager_remove_bookmark (manager, bookmark);
+  g_assert_false (query_has (index, "apps", "https://apps.gnome.org/"));
+
+  add_history (service, "https://gitlab.gnome.org/", "GitLab", 1);
+  while (!query_has (index, "gitlab", "https://gitlab.gnome.org/"))
+    g_main_context_iteration (NULL, TRUE);
+
+  g_object_unref (bookmark);
+  g_object_unref (index);
+  g_object_unref (manager);
+  g_object_unref (service);
+}
+
+#define BENCHMARK_HISTORY_URLS 5000
+#define BENCHMARK_BOOKMARKS 2000
+#define MAX_P99_LATENCY_US 1000
+
+static const char * const words[] = {
+  "gnome", "epiphany", "webkit", "release", "notes", "planet", "wiki",
+  "download", "search", "news", "weather", "recipes", "mail", "calendar",
+  "photos", "maps", "music", "video", "forum", "documentation"
+};
+
+static int
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+  gint64 time_a = *(const gint64 *)a;
+  gint64 time_b = *(const gint64 *)b;
+
+  return time_a < time_b ? -1 : time_a > time_b;
+}
+
+/* Times every prefix of a few typed queries, as if each keystroke queried
+ * the index. */
+static void
+test_keystroke_latency (void)
+{
+  EphyHistoryService *service;
+  EphyBookmarksManager *manager;
+  EphySuggestionIndex *index;
+  GSequence *bookmarks;
+  GArray *times;
+  GRand *rand;
+  double p99;
+
+  service = create_history ();
+  manager = ephy_bookmarks_manager_new ();
+  rand = g_rand_new_with_seed (42);
+
+  for (int i = 0; i < BENCHMARK_HISTORY_URLS; i++) {
+    g_autofree char *url = g_strdup_printf ("https://%s.example.com/%s/%d",
+                                            words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+                                            words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))], i);
+    g_autofree char *title = g_strdup_printf ("%s %s %d",
+                                              words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+                                              words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))], i);
+
+    add_history (service, url, title, g_rand_int_range (rand, 1, 20));
+  }
+
+  bookmarks = g_sequence_new (g_object_unref);
+  for (int i = 0; i < BENCHMARK_BOOKMARKS; i++) {
+    g_autofree char *url = g_strdup_printf ("https://%s.example.org/%d",
+                                            words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))], i);
+    g_autofree char *title = g_strdup_printf ("%s bookmark %d",
+                                              words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))], i);
+
+    g_sequence_append (bookmarks, create_bookmark (url, title));
+  }
+  ephy_bookmarks_manager_add_bookmarks (manager, bookmarks);
+  g_sequence_free (bookmarks);
+
+  index = ephy_suggestion_index_new (service, manager);
+  wait_until_ready (index);
+
+  times = g_array_new (FALSE, FALSE, sizeof (gint64));
+  for (int i = 0; i < 100; i++) {
+    g_autofree char *typed = g_strdup_printf ("%s %s",
+                                              words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+                                              words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))]);
+
+    for (gsize length = 1; length <= strlen (typed); length++) {
+      g_autofree char *query = g_strndup (typed, length);
+      GPtrArray *found;
+      GList *urls;
+      gboolean complete;
+      gint64 begin;
+      gint64 elapsed;
+
+      begin = g_get_monotonic_time ();
+      ephy_suggestion_index_query (index, query, HISTORY_LIMIT, &found, &urls, &complete);
+      elapsed = g_get_monotonic_time () - begin;
+
+      g_array_append_val (times, elapsed);
+      g_ptr_array_unref (found);
+      ephy_history_url_list_free (urls);
+    }
+  }
+
+  g_array_sort (times, compare_times);
+  p99 = g_array_index (times, gint64, times->len * 99 / 100) / (double)G_USEC_PER_SEC;
+  g_test_maximized_result (p99, "p99 per-keystroke latency: %.0f us", p99 * G_USEC_PER_SEC);
+  g_assert_cmpfloat (p99 * G_USEC_PER_SEC, <, MAX_P99_LATENCY_US);
+
+  remove_all_bookmarks (manager);
+  g_array_unref (times);
+  g_rand_free (rand);
+  g_object_unref (index);
+  g_object_unref (manager);
+  g_object_unref (service);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  ephy_debug_init ();
+
+  if (!ephy_file_helpers_init (NULL,
+                               EPHY_FILE_HELPERS_TESTING_MODE | EPHY_FILE_HELPERS_ENSURE_EXISTS,
+                               NULL)) {
+    g_debug ("Something wrong happened with ephy_file_helpers_init()");
+    return -1;
+  }
+
+  g_test_add_func ("/src/ephy-suggestion-index/substring_matching", test_substring_matching);
+  g_test_add_func ("/src/ephy-suggestion-index/incremental_updates", test_incremental_updates);
+
+  /* Run with -m perf. */
+  if (g_test_perf ())
+    g_test_add_func ("/src/ephy-suggestion-index/keystroke_latency", test_keystroke_latency);
+
+  ret = g_test_run ();
+
+  ephy_file_helpers_shutdown ();
+
+  if (g_file_test (test_db_filename (), G_FILE_TEST_IS_REGULAR))
+    g_unlink (test_db_filename ());
+
+  return ret;
+}
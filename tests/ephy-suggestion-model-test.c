@@ -0,0 +1,305 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ephy-debug.h"
+#include "ephy-embed-shell.h"
+#include "ephy-file-helpers.h"
+#include "ephy-history-service.h"
+#include "ephy-shell.h"
+#include "ephy-suggestion-model.h"
+
+#include <dazzle.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+static const char *
+test_db_filename (void)
+{
+  static char *filename = NULL;
+  if (!filename)
+    filename = g_build_filename (g_get_tmp_dir (), "epiphany-suggestion-model-test.db", NULL);
+  return filename;
+}
+
+static EphyHistoryService *
+create_history (void)
+{
+  EphyHistoryService *service;
+
+  if (g_file_test (test_db_filename (), G_FILE_TEST_IS_REGULAR))
+    g_unlink (test_db_filename ());
+
+  service = ephy_history_service_new (test_db_filename (), EPHY_SQLITE_CONNECTION_MODE_READWRITE);
+
+  ephy_history_service_visit_url (service, "http://alpha.example/", NULL,
+                                  g_get_real_time (), EPHY_PAGE_VISIT_TYPED, FALSE);
+  ephy_history_service_set_url_title (service, "http://alpha.example/", "Alpha", NULL, NULL, NULL);
+  ephy_history_service_visit_url (service, "http://beta.example/", NULL,
+                                  g_get_real_time (), EPHY_PAGE_VISIT_TYPED, FALSE);
+  ephy_history_service_set_url_title (service, "http://beta.example/", "Beta", NULL, NULL, NULL);
+
+  return service;
+}
+
+typedef struct {
+  GMainLoop *loop;
+  guint pending;
+  guint cancelled;
+  guint completed;
+  guint items_changed;
+  guint removed;
+  guint n_items;
+} QueryData;
+
+static void
+query_cb (GObject      *source,
+          GAsyncResult *result,
+          gpointer      user_data)
+{
+  QueryData *data = user_data;
+  GError *error = NULL;
+
+  if (ephy_suggestion_model_query_finish (EPHY_SUGGESTION_MODEL (source), result, &error)) {
+    data->completed++;
+  } else {
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    g_error_free (error);
+    data->cancelled++;
+  }
+
+  if (--data->pending == 0)
+    g_main_loop_quit (data->loop);
+}
+
+static void
+items_changed_cb (GListModel *model,
+                  guint       position,
+                  guint       removed,
+                  guint       added,
+                  QueryData  *data)
+{
+  g_assert_cmpuint (position + removed, <=, data->n_items);
+
+  data->items_changed++;
+  data->removed += removed;
+  data->n_items += added - removed;
+}
+
+static void
+test_only_newest_query_reaches_model (void)
+{
+  EphyHistoryService *service;
+  EphySuggestionModel *model;
+  QueryData data = { 0, };
+
+  service = create_history ();
+  model = ephy_suggestion_model_new (service,
+                                     ephy_shell_get_bookmarks_manager (ephy_shell_get_default ()));
+  g_signal_connect (model, "items-changed", G_CALLBACK (items_changed_cb), &data);
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  data.pending = 3;
+
+  ephy_suggestion_model_query_async (model, "alpha", NULL, query_cb, &data);
+  ephy_suggestion_model_query_async (model, "alph", NULL, query_cb, &data);
+  ephy_suggestion_model_query_async (model, "beta", NULL, query_cb, &data);
+
+  g_main_loop_run (data.loop);
+
+  g_assert_cmpuint (data.cancelled, ==, 2);
+  g_assert_cmpuint (data.completed, ==, 1);
+  g_assert_cmpuint (data.items_changed, ==, 1);
+
+  g_assert_nonnull (ephy_suggestion_model_get_suggestion_with_uri (model, "http://beta.example/"));
+  g_assert_null (ephy_suggestion_model_get_suggestion_with_uri (model, "http://alpha.example/"));
+
+  g_main_loop_unref (data.loop);
+  g_object_unref (model);
+  g_object_unref (service);
+}
+
+static void
+test_cancelled_query_leaves_model (void)
+{
+  EphyHistoryService *service;
+  EphySuggestionModel *model;
+  GCancellable *cancellable;
+  QueryData data = { 0, };
+
+  service = create_history ();
+  model = ephy_suggestion_model_new (service,
+                                     ephy_shell_get_bookmarks_manager (ephy_shell_get_default ()));
+  g_signal_connect (model, "items-changed", G_CALLBACK (items_changed_cb), &data);
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  data.pending = 1;
+
+  cancellable = g_cancellable_new ();
+  ephy_suggestion_model_query_async (model, "alpha", cancellable, query_cb, &data);
+  g_cancellable_cancel (cancellable);
+
+  g_main_loop_run (data.loop);
+
+  g_assert_cmpuint (data.cancelled, ==, 1);
+  g_assert_cmpuint (data.items_changed, ==, 0);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, 0);
+
+  g_object_unref (cancellable);
+  g_main_loop_unref (data.loop);
+  g_object_unref (model);
+  g_object_unref (service);
+}
+
+static void
+run_query (EphySuggestionModel *model,
+           const char          *query,
+           QueryData           *data)
+{
+  data->pending = 1;
+  ephy_suggestion_model_query_async (model, query, NULL, query_cb, data);
+  g_main_loop_run (data->loop);
+}
+
+static void
+test_unchanged_items_are_kept (void)
+{
+  EphyHistoryService *service;
+  EphySuggestionModel *model;
+  EphySuggestion *beta;
+  QueryData data = { 0, };
+
+  service = create_history ();
+  model = ephy_suggestion_model_new (service,
+                                     ephy_shell_get_bookmarks_manager (ephy_shell_get_default ()));
+  g_signal_connect (model, "items-changed", G_CALLBACK (items_changed_cb), &data);
+  data.loop = g_main_loop_new (NULL, FALSE);
+
+  run_query (model, "example", &data);
+  g_assert_cmpuint (data.n_items, ==, g_list_model_get_n_items (G_LIST_MODEL (model)));
+  beta = ephy_suggestion_model_get_suggestion_with_uri (model, "http://beta.example/");
+  g_assert_nonnull (beta);
+
+  /* The same results must not touch the list box at all. */
+  data.items_changed = 0;
+  run_query (model, "example", &data);
+  g_assert_cmpuint (data.items_changed, ==, 0);
+  g_assert_true (ephy_suggestion_model_get_suggestion_with_uri (model, "http://beta.example/") == beta);
+
+  /* Whatever ranges are emitted must add up to the new contents. */
+  run_query (model, "alpha", &data);
+  g_assert_cmpuint (data.n_items, ==, g_list_model_get_n_items (G_LIST_MODEL (model)));
+  g_assert_null (ephy_suggestion_model_get_suggestion_with_uri (model, "http://beta.example/"));
+
+  run_query (model, "", &data);
+  g_assert_cmpuint (data.n_items, ==, 0);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, 0);
+
+  g_main_loop_unref (data.loop);
+  g_object_unref (model);
+  g_object_unref (service);
+}
+
+/* Typing on changes the highlighting of every title, which must not
+ * replace the rows of results that stay. */
+static void
+test_refined_query_keeps_rows (void)
+{
+  EphyHistoryService *service;
+  EphySuggestionModel *model;
+  EphySuggestion *alpha;
+  EphySuggestion *beta;
+  g_autofree char *expected = NULL;
+  guint n_search_engines;
+  QueryData data = { 0, };
+
+  service = create_history ();
+  /* Visited more often, so that the order of the results is fixed. */
+  ephy_history_service_visit_url (service, "http://alpha.example/", NULL,
+                                  g_get_real_time (), EPHY_PAGE_VISIT_TYPED, FALSE);
+  model = ephy_suggestion_model_new (service,
+                                     ephy_shell_get_bookmarks_manager (ephy_shell_get_default ()));
+  g_signal_connect (model, "items-changed", G_CALLBACK (items_changed_cb), &data);
+  data.loop = g_main_loop_new (NULL, FALSE);
+
+  run_query (model, "exampl", &data);
+  alpha = ephy_suggestion_model_get_suggestion_with_uri (model, "http://alpha.example/");
+  beta = ephy_suggestion_model_get_suggestion_with_uri (model, "http://beta.example/");
+  g_assert_nonnull (alpha);
+  g_assert_nonnull (beta);
+
+  /* Only the search engine rows, whose addresses contain the query, are
+   * replaced. */
+  n_search_engines = data.n_items - 2;
+  data.items_changed = 0;
+  data.removed = 0;
+  run_query (model, "example", &data);
+  g_assert_cmpuint (data.removed, ==, n_search_engines);
+  g_assert_cmpuint (data.n_items, ==, g_list_model_get_n_items (G_LIST_MODEL (model)));
+  g_assert_true (ephy_suggestion_model_get_suggestion_with_uri (model, "http://alpha.example/") == alpha);
+  g_assert_true (ephy_suggestion_model_get_suggestion_with_uri (model, "http://beta.example/") == beta);
+
+  expected = dzl_fuzzy_highlight ("Beta", "example", FALSE);
+  g_assert_cmpstr (dzl_suggestion_get_title (DZL_SUGGESTION (beta)), ==, expected);
+  g_assert_cmpstr (ephy_suggestion_get_unescaped_title (beta), ==, expected);
+
+  g_main_loop_unref (data.loop);
+  g_object_unref (model);
+  g_object_unref (service);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int ret;
+
+  gtk_test_init (&argc, &argv);
+
+  ephy_debug_init ();
+
+  if (!ephy_file_helpers_init (NULL, EPHY_FILE_HELPERS_TESTING_MODE | EPHY_FILE_HELPERS_ENSURE_EXISTS, NULL)) {
+    g_debug ("Something wrong happened with ephy_file_helpers_init()");
+    return -1;
+  }
+
+  _ephy_shell_create_instance (EPHY_EMBED_SHELL_MODE_TEST);
+  g_application_register (G_APPLICATION (ephy_embed_shell_get_default ()), NULL, NULL);
+
+  g_test_add_func ("/src/ephy-suggestion-model/only_newest_query_reaches_model",
+                   test_only_newest_query_reaches_model);
+  g_test_add_func ("/src/ephy-suggestion-model/cancelled_query_leaves_model",
+                   test_cancelled_query_leaves_model);
+  g_test_add_func ("/src/ephy-suggestion-model/unchanged_items_are_kept",
+                   test_unchanged_items_are_kept);
+  g_test_add_func ("/src/ephy-suggestion-model/refined_query_keeps_rows",
+                   test_refined_query_keeps_rows);
+
+  ret = g_test_run ();
+
+  g_object_unref (ephy_embed_shell_get_default ());
+  ephy_file_helpers_shutdown ();
+
+  if (g_file_test (test_db_filename (), G_FILE_TEST_IS_REGULAR))
+    g_unlink (test_db_filename ());
+
+  return ret;
+}
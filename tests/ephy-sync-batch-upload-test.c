@@ -0,0 +1,483 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ephy-debug.h"
+#include "ephy-history-record.h"
+#include "ephy-sync-batch-upload.h"
+#include "ephy-sync-crypto.h"
+#include "ephy-sync-utils.h"
+
+#include <glib.h>
+#include <inttypes.h>
+#include <json-glib/json-glib.h>
+#include <libsoup/soup.h>
+#include <string.h>
+
+#define N_RECORDS 20000
+#define RECORDS_PER_COMMIT (EPHY_SYNC_BATCH_SIZE * EPHY_SYNC_MAX_BATCHES)
+#define SERVER_LATENCY_MS 2
+#define INITIAL_TIMESTAMP 1000
+
+/* A storage server that only knows about the batch API of one collection.
+ * Each response is delayed a little, like over a network. */
+typedef struct {
+  SoupServer *server;
+  char *base_url;
+  gint64 timestamp;
+  guint next_batch;
+  GHashTable *batches;
+  GHashTable *committed;
+  guint posts;
+  guint fail_post;
+  guint commits;
+  guint in_flight;
+  guint max_in_flight;
+} StubServer;
+
+typedef struct {
+  StubServer *stub;
+  SoupMessage *msg;
+} DelayedResponse;
+
+static char *aes_key_b64;
+static char *hmac_key_b64;
+
+static SyncCryptoKeyBundle *
+create_bundle (void)
+{
+  if (!aes_key_b64) {
+    guint8 aes_key[32];
+    guint8 hmac_key[32];
+
+    ephy_sync_utils_generate_random_bytes (NULL, sizeof (aes_key), aes_key);
+    ephy_sync_utils_generate_random_bytes (NULL, sizeof (hmac_key), hmac_key);
+    aes_key_b64 = g_base64_encode (aes_key, sizeof (aes_key));
+    hmac_key_b64 = g_base64_encode (hmac_key, sizeof (hmac_key));
+  }
+
+  return ephy_sync_crypto_key_bundle_new (aes_key_b64, hmac_key_b64);
+}
+
+static gboolean
+send_delayed_response (DelayedResponse *response)
+{
+  response->stub->in_flight--;
+  soup_server_unpause_message (response->stub->server, response->msg);
+  g_free (response);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+respond (StubServer  *stub,
+         SoupMessage *msg,
+         guint        status,
+         const char  *body)
+{
+  DelayedResponse *response;
+
+  soup_message_set_status (msg, status);
+  soup_message_set_response (msg, "application/json", SOUP_MEMORY_COPY, body, strlen (body));
+
+  response = g_new (DelayedResponse, 1);
+  response->stub = stub;
+  response->msg = msg;
+  soup_server_pause_message (stub->server, msg);
+  g_timeout_add (SERVER_LATENCY_MS, (GSourceFunc)send_delayed_response, response);
+}
+
+static void
+add_records (GHashTable  *records,
+             SoupMessage *msg)
+{
+  g_autoptr (JsonNode) node = json_from_string (msg->request_body->data, NULL);
+  JsonArray *array = json_node_get_array (node);
+
+  for (guint i = 0; i < json_array_get_length (array); i++) {
+    JsonObject *object = json_array_get_object_element (array, i);
+
+    g_hash_table_insert (records,
+                         g_strdup (json_object_get_string_member (object, "id")),
+                         g_strdup (json_object_get_string_member (object, "payload")));
+  }
+}
+
+static void
+storage_handler (SoupServer        *server,
+                 SoupMessage       *msg,
+                 const char        *path,
+                 GHashTable        *query,
+                 SoupClientContext *client,
+                 gpointer           user_data)
+{
+  StubServer *stub = user_data;
+  const char *batch = query ? g_hash_table_lookup (query, "batch") : NULL;
+  const char *unmodified_since;
+  g_autofree char *body = NULL;
+  g_autofree char *timestamp = NULL;
+  GHashTable *records;
+  GHashTableIter iter;
+  gpointer id, payload;
+
+  stub->in_flight++;
+  stub->max_in_flight = MAX (stub->max_in_flight, stub->in_flight);
+
+  g_assert_cmpstr (msg->method, ==, SOUP_METHOD_POST);
+  g_assert_nonnull (batch);
+
+  if (query && g_hash_table_contains (query, "commit")) {
+    records = g_hash_table_lookup (stub->batches, batch);
+    g_assert_nonnull (records);
+
+    unmodified_since = soup_message_headers_get_one (msg->request_headers, "X-If-Unmodified-Since");
+    if (unmodified_since && g_ascii_strtoll (unmodified_since, NULL, 10) < stub->timestamp) {
+      respond (stub, msg, 412, "0");
+      return;
+    }
+
+    stub->commits++;
+    stub->timestamp++;
+    g_hash_table_iter_init (&iter, records);
+    while (g_hash_table_iter_next (&iter, &id, &payload)) {
+      g_hash_table_replace (stub->committed, id, payload);
+      g_hash_table_iter_steal (&iter);
+    }
+    g_hash_table_remove (stub->batches, batch);
+
+    timestamp = g_strdup_printf ("%" PRId64 ".00", stub->timestamp);
+    soup_message_headers_append (msg->response_headers, "X-Last-Modified", timestamp);
+    respond (stub, msg, 200, "{}");
+    return;
+  }
+
+  if (++stub->posts == stub->fail_post) {
+    respond (stub, msg, 500, "\"Internal Server Error\"");
+    return;
+  }
+
+  if (strcmp (batch, "true") == 0) {
+    body = g_strdup_printf ("batch-%u", stub->next_batch++);
+    g_hash_table_insert (stub->batches, g_strdup (body),
+                         g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free));
+    batch = body;
+  }
+
+  records = g_hash_table_lookup (stub->batches, batch);
+  g_assert_nonnull (records);
+  add_records (records, msg);
+
+  g_free (body);
+  body = g_strdup_printf ("{\"batch\": \"%s\", \"success\": [], \"failed\": {}}", batch);
+  respond (stub, msg, 202, body);
+}
+
+static StubServer *
+stub_server_new (void)
+{
+  StubServer *stub;
+  GSList *uris;
+  GError *error = NULL;
+
+  stub = g_new0 (StubServer, 1);
+  stub->timestamp = INITIAL_TIMESTAMP;
+  stub->batches = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_hash_table_unref);
+  stub->committed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  stub->server = soup_server_new (NULL, NULL);
+  soup_server_add_handler (stub->server, "/storage", storage_handler, stub, NULL);
+  soup_server_listen_local (stub->server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, &error);
+  g_assert_no_error (error);
+
+  uris = soup_server_get_uris (stub->server);
+  stub->base_url = soup_uri_to_string (uris->data, FALSE);
+  g_slist_free_full (uris, (GDestroyNotify)soup_uri_free);
+
+  return stub;
+}
+
+static void
+stub_server_free (StubServer *stub)
+{
+  soup_server_disconnect (stub->server);
+  g_object_unref (stub->server);
+  g_free (stub->base_url);
+  g_hash_table_unref (stub->batches);
+  g_hash_table_unref (stub->committed);
+  g_free (stub);
+}
+
+static StubServer *stub;
+
+static void
+stub_request (GObject             *source_object,
+              const char          *endpoint,
+              const char          *method,
+              const char          *request_body,
+              gint64               unmodified_since,
+              SoupSessionCallback  callback,
+              gpointer             user_data)
+{
+  g_autofree char *url = g_strconcat (stub->base_url, endpoint, NULL);
+  SoupMessage *msg = soup_message_new (method, url);
+
+  soup_message_set_request (msg, "application/json; charset=utf-8", SOUP_MEMORY_COPY,
+                            request_body, strlen (request_body));
+  if (unmodified_since >= 0) {
+    g_autofree char *header = g_strdup_printf ("%" PRId64, unmodified_since);
+    soup_message_headers_append (msg->request_headers, "X-If-Unmodified-Since", header);
+  }
+
+  soup_session_queue_message (SOUP_SESSION (source_object), msg, callback, user_data);
+}
+
+static GPtrArray *
+create_history_records (void)
+{
+  GPtrArray *records = g_ptr_array_new_with_free_func ((GDestroyNotify)ephy_sync_batch_record_free);
+
+  for (guint i = 0; i < N_RECORDS; i++) {
+    g_autofree char *id = g_strdup_printf ("record-%u", i);
+    g_autofree char *title = g_strdup_printf ("Page %u", i);
+    g_autofree char *uri = g_strdup_printf ("https://example.com/%u", i);
+    g_autoptr (EphyHistoryRecord) record = NULL;
+    g_autofree char *cleartext = NULL;
+
+    record = ephy_history_record_new (id, title, uri, g_get_real_time ());
+    cleartext = json_gobject_to_data (G_OBJECT (record), NULL);
+    g_ptr_array_add (records, ephy_sync_batch_record_new (id, cleartext));
+  }
+
+  return records;
+}
+
+typedef struct {
+  GMainLoop *loop;
+  gboolean success;
+  gint64 last_modified;
+  GError *error;
+} UploadResult;
+
+static void
+upload_cb (GObject      *source_object,
+           GAsyncResult *result,
+           gpointer      user_data)
+{
+  UploadResult *upload = user_data;
+
+  upload->success = ephy_sync_batch_upload_finish (result, &upload->last_modified, &upload->error);
+  g_main_loop_quit (upload->loop);
+}
+
+static void
+run_upload (GPtrArray           *records,
+            SyncCryptoKeyBundle *bundle,
+            gint64               unmodified_since,
+            UploadResult        *upload)
+{
+  SoupSession *session;
+
+  session = soup_session_new_with_options (SOUP_SESSION_MAX_CONNS_PER_HOST, 4, NULL);
+  upload->loop = g_main_loop_new (NULL, FALSE);
+
+  ephy_sync_batch_upload_async (G_OBJECT (session), stub_request, "history",
+                                records, bundle, unmodified_since, upload_cb, upload);
+  g_main_loop_run (upload->loop);
+
+  g_main_loop_unref (upload->loop);
+  g_object_unref (session);
+}
+
+static void
+test_upload (void)
+{
+  g_autoptr (GPtrArray) records = create_history_records ();
+  SyncCryptoKeyBundle *bundle;
+  UploadResult upload = { 0, };
+  EphySyncBatchRecord *record;
+  const char *payload;
+  char *cleartext;
+  double elapsed;
+
+  stub = stub_server_new ();
+
+  g_test_timer_start ();
+  run_upload (records, create_bundle (), INITIAL_TIMESTAMP, &upload);
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed, "Uploaded %u history records in %.2f s", N_RECORDS, elapsed);
+
+  g_assert_no_error (upload.error);
+  g_assert_true (upload.success);
+  g_assert_cmpuint (g_hash_table_size (stub->committed), ==, N_RECORDS);
+  g_assert_cmpuint (g_hash_table_size (stub->batches), ==, 0);
+  g_assert_cmpuint (stub->commits, ==, (N_RECORDS + RECORDS_PER_COMMIT - 1) / RECORDS_PER_COMMIT);
+  g_assert_cmpint (upload.last_modified, ==, stub->timestamp);
+
+  /* Requests are pipelined, but only up to a bound. */
+  g_assert_cmpuint (stub->max_in_flight, >, 1);
+  g_assert_cmpuint (stub->max_in_flight, <=, 4);
+
+  record = g_ptr_array_index (records, N_RECORDS / 2);
+  payload = g_hash_table_lookup (stub->committed, record->id);
+  g_assert_nonnull (payload);
+  bundle = create_bundle ();
+  cleartext = ephy_sync_crypto_decrypt_record (payload, bundle);
+  g_assert_cmpstr (cleartext, ==, record->cleartext);
+  ephy_sync_crypto_key_bundle_unref (bundle);
+  g_free (cleartext);
+
+  stub_server_free (stub);
+}
+
+/* A failure in the first server batch must leave nothing committed. */
+static void
+test_failure_in_first_batch (void)
+{
+  g_autoptr (GPtrArray) records = create_history_records ();
+  UploadResult upload = { 0, };
+
+  stub = stub_server_new ();
+  stub->fail_post = 10;
+
+  run_upload (records, create_bundle (), INITIAL_TIMESTAMP, &upload);
+
+  g_assert_error (upload.error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_assert_false (upload.success);
+  g_assert_cmpint (upload.last_modified, ==, -1);
+  g_assert_cmpuint (stub->commits, ==, 0);
+  g_assert_cmpuint (g_hash_table_size (stub->committed), ==, 0);
+  g_assert_cmpuint (stub->posts, <, EPHY_SYNC_MAX_BATCHES);
+
+  g_error_free (upload.error);
+  stub_server_free (stub);
+}
+
+/* Server batches committed before a failure stay committed, and nothing of
+ * the failed one is. */
+static void
+test_failure_in_later_batch (void)
+{
+  g_autoptr (GPtrArray) records = create_history_records ();
+  UploadResult upload = { 0, };
+
+  stub = stub_server_new ();
+  stub->fail_post = EPHY_SYNC_MAX_BATCHES + 10;
+
+  run_upload (records, create_bundle (), INITIAL_TIMESTAMP, &upload);
+
+  g_assert_error (upload.error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_assert_cmpuint (stub->commits, ==, 1);
+  g_assert_cmpuint (g_hash_table_size (stub->committed), ==, RECORDS_PER_COMMIT);
+  g_assert_cmpint (upload.last_modified, ==, INITIAL_TIMESTAMP + 1);
+  for (guint i = 0; i < RECORDS_PER_COMMIT; i++) {
+    EphySyncBatchRecord *record = g_ptr_array_index (records, i);
+    g_assert_true (g_hash_table_contains (stub->committed, record->id));
+  }
+
+  g_error_free (upload.error);
+  stub_server_free (stub);
+}
+
+/* Someone else changed the collection since it was downloaded. */
+static void
+test_conflicting_commit (void)
+{
+  g_autoptr (GPtrArray) records = create_history_records ();
+  UploadResult upload = { 0, };
+
+  stub = stub_server_new ();
+
+  run_upload (records, create_bundle (), INITIAL_TIMESTAMP - 1, &upload);
+
+  g_assert_error (upload.error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_assert_cmpuint (stub->commits, ==, 0);
+  g_assert_cmpuint (g_hash_table_size (stub->committed), ==, 0);
+
+  g_error_free (upload.error);
+  stub_server_free (stub);
+}
+
+/* Records that come with their own BSO are uploaded as they are, among
+ * records that are encrypted by the upload. */
+static void
+test_prebuilt_bso (void)
+{
+  g_autoptr (GPtrArray) records = create_history_records ();
+  SyncCryptoKeyBundle *bundle;
+  UploadResult upload = { 0, };
+  EphySyncBatchRecord *record;
+  char *cleartext;
+
+  for (guint i = 0; i < N_RECORDS; i += 3) {
+    g_autofree char *id = g_strdup_printf ("record-%u", i);
+    g_autofree char *payload = g_strdup_printf ("custom-%u", i);
+    g_autoptr (JsonNode) bso = json_node_new (JSON_NODE_OBJECT);
+    JsonObject *object = json_object_new ();
+
+    json_object_set_string_member (object, "id", id);
+    json_object_set_string_member (object, "payload", payload);
+    json_node_take_object (bso, object);
+    ephy_sync_batch_record_free (g_ptr_array_index (records, i));
+    g_ptr_array_index (records, i) = ephy_sync_batch_record_new_from_bso (bso);
+  }
+
+  stub = stub_server_new ();
+
+  run_upload (records, create_bundle (), INITIAL_TIMESTAMP, &upload);
+
+  g_assert_no_error (upload.error);
+  g_assert_true (upload.success);
+  g_assert_cmpuint (g_hash_table_size (stub->committed), ==, N_RECORDS);
+  g_assert_cmpstr (g_hash_table_lookup (stub->committed, "record-0"), ==, "custom-0");
+  g_assert_cmpstr (g_hash_table_lookup (stub->committed, "record-3"), ==, "custom-3");
+
+  record = g_ptr_array_index (records, 1);
+  bundle = create_bundle ();
+  cleartext = ephy_sync_crypto_decrypt_record (g_hash_table_lookup (stub->committed, record->id), bundle);
+  g_assert_cmpstr (cleartext, ==, record->cleartext);
+  ephy_sync_crypto_key_bundle_unref (bundle);
+  g_free (cleartext);
+
+  stub_server_free (stub);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  ephy_debug_init ();
+
+  g_test_add_func ("/lib/sync/ephy-sync-batch-upload/upload", test_upload);
+  g_test_add_func ("/lib/sync/ephy-sync-batch-upload/failure_in_first_batch", test_failure_in_first_batch);
+  g_test_add_func ("/lib/sync/ephy-sync-batch-upload/failure_in_later_batch", test_failure_in_later_batch);
+  g_test_add_func ("/lib/sync/ephy-sync-batch-upload/conflicting_commit", test_conflicting_commit);
+  g_test_add_func ("/lib/sync/ephy-sync-batch-upload/prebuilt_bso", test_prebuilt_bso);
+
+  ret = g_test_run ();
+
+  g_free (aes_key_b64);
+  g_free (hmac_key_b64);
+
+  return ret;
+}
@@ -0,0 +1,497 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ephy-debug.h"
+#include "ephy-history-record.h"
+#include "ephy-sync-collection-download.h"
+#include "ephy-sync-crypto.h"
+#include "ephy-sync-utils.h"
+#include "ephy-synchronizable-manager.h"
+
+#include <glib.h>
+#include <inttypes.h>
+#include <json-glib/json-glib.h>
+#include <libsoup/soup.h>
+#include <string.h>
+
+#define N_PAGES 4
+#define N_RECORDS (EPHY_SYNC_DOWNLOAD_PAGE_SIZE * (N_PAGES - 1) + EPHY_SYNC_DOWNLOAD_PAGE_SIZE / 2)
+#define SERVER_TIMESTAMP 1000
+#define LAST_SYNC_TIME 500
+
+/* A storage server that serves one collection in pages, like the real one
+ * does with X-Weave-Next-Offset. */
+typedef struct {
+  SoupServer *server;
+  char *base_url;
+  GPtrArray *bsos;
+  guint requests;
+  guint fail_request;
+  guint fail_status;
+  gboolean saw_newer;
+  gboolean saw_bad_unmodified_since;
+} StubServer;
+
+static char *aes_key_b64;
+static char *hmac_key_b64;
+
+static SyncCryptoKeyBundle *
+create_bundle (void)
+{
+  if (!aes_key_b64) {
+    guint8 aes_key[32];
+    guint8 hmac_key[32];
+
+    ephy_sync_utils_generate_random_bytes (NULL, sizeof (aes_key), aes_key);
+    ephy_sync_utils_generate_random_bytes (NULL, sizeof (hmac_key), hmac_key);
+    aes_key_b64 = g_base64_encode (aes_key, sizeof (aes_key));
+    hmac_key_b64 = g_base64_encode (hmac_key, sizeof (hmac_key));
+  }
+
+  return ephy_sync_crypto_key_bundle_new (aes_key_b64, hmac_key_b64);
+}
+
+static void
+storage_handler (SoupServer        *server,
+                 SoupMessage       *msg,
+                 const char        *path,
+                 GHashTable        *query,
+                 SoupClientContext *client,
+                 gpointer           user_data)
+{
+  StubServer *stub = user_data;
+  const char *offset = query ? g_hash_table_lookup (query, "offset") : NULL;
+  const char *limit = query ? g_hash_table_lookup (query, "limit") : NULL;
+  const char *unmodified_since;
+  g_autofree char *timestamp = NULL;
+  g_autofree char *next_offset = NULL;
+  GString *body;
+  guint start;
+  guint end;
+
+  g_assert_cmpstr (msg->method, ==, SOUP_METHOD_GET);
+  g_assert_cmpstr (path, ==, "/storage/history");
+  g_assert_nonnull (limit);
+
+  stub->requests++;
+  if (query && g_hash_table_contains (query, "newer"))
+    stub->saw_newer = TRUE;
+
+  /* Only the first page may be requested without a snapshot timestamp. */
+  unmodified_since = soup_message_headers_get_one (msg->request_headers, "X-If-Unmodified-Since");
+  if (offset && (!unmodified_since || g_ascii_strtoll (unmodified_since, NULL, 10) != SERVER_TIMESTAMP))
+    stub->saw_bad_unmodified_since = TRUE;
+
+  if (stub->requests == stub->fail_request) {
+    soup_message_set_status (msg, stub->fail_status);
+    soup_message_set_response (msg, "application/json", SOUP_MEMORY_STATIC, "0", 1);
+    return;
+  }
+
+  start = offset ? g_ascii_strtoull (offset, NULL, 10) : 0;
+  end = MIN (start + g_ascii_strtoull (limit, NULL, 10), stub->bsos->len);
+
+  body = g_string_new ("[");
+  for (guint i = start; i < end; i++) {
+    if (i > start)
+      g_string_append_c (body, ',');
+    g_string_append (body, g_ptr_array_index (stub->bsos, i));
+  }
+  g_string_append_c (body, ']');
+
+  timestamp = g_strdup_printf ("%d.00", SERVER_TIMESTAMP);
+  soup_message_headers_append (msg->response_headers, "X-Last-Modified", timestamp);
+  if (end < stub->bsos->len) {
+    next_offset = g_strdup_printf ("%u", end);
+    soup_message_headers_append (msg->response_headers, "X-Weave-Next-Offset", next_offset);
+  }
+
+  soup_message_set_status (msg, 200);
+  soup_message_set_response (msg, "application/json", SOUP_MEMORY_TAKE, body->str, body->len);
+  g_string_free (body, FALSE);
+}
+
+static GPtrArray *
+create_history_bsos (void)
+{
+  GPtrArray *bsos = g_ptr_array_new_with_free_func (g_free);
+  SyncCryptoKeyBundle *bundle = create_bundle ();
+
+  for (guint i = 0; i < N_RECORDS; i++) {
+    g_autofree char *id = g_strdup_printf ("record-%u", i);
+    g_autofree char *title = g_strdup_printf ("Page %u", i);
+    g_autofree char *uri = g_strdup_printf ("https://example.com/%u", i);
+    g_autoptr (EphyHistoryRecord) record = NULL;
+    g_autofree char *cleartext = NULL;
+    g_autofree char *payload = NULL;
+    g_autoptr (JsonObject) bso = json_object_new ();
+    g_autoptr (JsonNode) node = json_node_new (JSON_NODE_OBJECT);
+
+    record = ephy_history_record_new (id, title, uri, g_get_real_time ());
+    cleartext = json_gobject_to_data (G_OBJECT (record), NULL);
+    payload = ephy_sync_crypto_encrypt_record (cleartext, bundle);
+
+    json_object_set_string_member (bso, "id", id);
+    json_object_set_string_member (bso, "payload", payload);
+    json_object_set_double_member (bso, "modified", SERVER_TIMESTAMP - N_RECORDS + i);
+    json_node_set_object (node, bso);
+    g_ptr_array_add (bsos, json_to_string (node, FALSE));
+  }
+
+  ephy_sync_crypto_key_bundle_unref (bundle);
+
+  return bsos;
+}
+
+static StubServer *
+stub_server_new (void)
+{
+  StubServer *stub;
+  GSList *uris;
+  GError *error = NULL;
+
+  stub = g_new0 (StubServer, 1);
+  stub->bsos = create_history_bsos ();
+
+  stub->server = soup_server_new (NULL, NULL);
+  soup_server_add_handler (stub->server, "/storage", storage_handler, stub, NULL);
+  soup_server_listen_local (stub->server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, &error);
+  g_assert_no_error (error);
+
+  uris = soup_server_get_uris (stub->server);
+  stub->base_url = soup_uri_to_string (uris->data, FALSE);
+  g_slist_free_full (uris, (GDestroyNotify)soup_uri_free);
+
+  return stub;
+}
+
+static void
+stub_server_free (StubServer *stub)
+{
+  soup_server_disconnect (stub->server);
+  g_object_unref (stub->server);
+  g_free (stub->base_url);
+  g_ptr_array_unref (stub->bsos);
+  g_free (stub);
+}
+
+static StubServer *stub;
+
+static void
+stub_request (GObject             *source_object,
+              const char          *endpoint,
+              const char          *method,
+              const char          *request_body,
+              gint64               unmodified_since,
+              SoupSessionCallback  callback,
+              gpointer             user_data)
+{
+  g_autofree char *url = g_strconcat (stub->base_url, endpoint, NULL);
+  SoupMessage *msg = soup_message_new (method, url);
+
+  g_assert_null (request_body);
+  if (unmodified_since >= 0) {
+    g_autofree char *header = g_strdup_printf ("%" PRId64, unmodified_since);
+    soup_message_headers_append (msg->request_headers, "X-If-Unmodified-Since", header);
+  }
+
+  soup_session_queue_message (SOUP_SESSION (source_object), msg, callback, user_data);
+}
+
+/* A history manager that only remembers what was merged into it. */
+#define FAKE_TYPE_MANAGER (fake_manager_get_type ())
+G_DECLARE_FINAL_TYPE (FakeManager, fake_manager, FAKE, MANAGER, GObject)
+
+struct _FakeManager {
+  GObject parent_instance;
+
+  gboolean is_initial;
+  GHashTable *merged;
+  guint merges;
+  guint initial_merges;
+};
+
+static void fake_manager_iface_init (EphySynchronizableManagerInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (FakeManager, fake_manager, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (EPHY_TYPE_SYNCHRONIZABLE_MANAGER,
+                                                fake_manager_iface_init))
+
+static const char *
+fake_manager_get_collection_name (EphySynchronizableManager *manager)
+{
+  return "history";
+}
+
+static GType
+fake_manager_get_synchronizable_type (EphySynchronizableManager *manager)
+{
+  return EPHY_TYPE_HISTORY_RECORD;
+}
+
+static gboolean
+fake_manager_is_initial_sync (EphySynchronizableManager *manager)
+{
+  return FAKE_MANAGER (manager)->is_initial;
+}
+
+static gint64
+fake_manager_get_sync_time (EphySynchronizableManager *manager)
+{
+  return LAST_SYNC_TIME;
+}
+
+static void
+fake_manager_merge (EphySynchronizableManager              *manager,
+                    gboolean                                is_initial,
+                    GList                                  *remotes_deleted,
+                    GList                                  *remotes_updated,
+                    EphySynchronizableManagerMergeCallback  callback,
+                    gpointer                                user_data)
+{
+  FakeManager *self = FAKE_MANAGER (manager);
+  GPtrArray *to_upload;
+
+  g_assert_cmpint (is_initial, ==, self->is_initial);
+  g_assert_null (remotes_deleted);
+
+  self->merges++;
+  if (is_initial)
+    self->initial_merges++;
+
+  for (GList *l = remotes_updated; l; l = l->next) {
+    const char *id = ephy_synchronizable_get_id (l->data);
+
+    g_assert_false (g_hash_table_contains (self->merged, id));
+    g_hash_table_add (self->merged, g_strdup (id));
+  }
+
+  /* Every merge asks for the same local record to be uploaded. */
+  to_upload = g_ptr_array_new_with_free_func (g_object_unref);
+  g_ptr_array_add (to_upload, ephy_history_record_new ("local", "Local", "https://example.org/", 0));
+  callback (to_upload, user_data);
+}
+
+static void
+fake_manager_iface_init (EphySynchronizableManagerInterface *iface)
+{
+  iface->get_collection_name = fake_manager_get_collection_name;
+  iface->get_synchronizable_type = fake_manager_get_synchronizable_type;
+  iface->is_initial_sync = fake_manager_is_initial_sync;
+  iface->get_sync_time = fake_manager_get_sync_time;
+  iface->merge = fake_manager_merge;
+}
+
+static void
+fake_manager_finalize (GObject *object)
+{
+  g_hash_table_unref (FAKE_MANAGER (object)->merged);
+
+  G_OBJECT_CLASS (fake_manager_parent_class)->finalize (object);
+}
+
+static void
+fake_manager_class_init (FakeManagerClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = fake_manager_finalize;
+}
+
+static void
+fake_manager_init (FakeManager *self)
+{
+  self->merged = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+typedef struct {
+  GMainLoop *loop;
+  GPtrArray *to_upload;
+  gint64 last_modified;
+  GError *error;
+} DownloadResult;
+
+static void
+download_cb (GObject      *source_object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+  DownloadResult *download = user_data;
+
+  download->to_upload = ephy_sync_collection_download_finish (result, &download->last_modified, &download->error);
+  g_main_loop_quit (download->loop);
+}
+
+static void
+run_download (FakeManager    *manager,
+              DownloadResult *download)
+{
+  SoupSession *session;
+
+  session = soup_session_new ();
+  download->loop = g_main_loop_new (NULL, FALSE);
+
+  ephy_sync_collection_download_async (G_OBJECT (session), stub_request,
+                                       EPHY_SYNCHRONIZABLE_MANAGER (manager),
+                                       create_bundle (), download_cb, download);
+  g_main_loop_run (download->loop);
+
+  g_main_loop_unref (download->loop);
+  g_object_unref (session);
+}
+
+static void
+assert_all_merged (FakeManager *manager)
+{
+  g_assert_cmpuint (g_hash_table_size (manager->merged), ==, N_RECORDS);
+  for (guint i = 0; i < N_RECORDS; i++) {
+    g_autofree char *id = g_strdup_printf ("record-%u", i);
+    g_assert_true (g_hash_table_contains (manager->merged, id));
+  }
+}
+
+static void
+test_initial_sync (void)
+{
+  g_autoptr (FakeManager) manager = g_object_new (FAKE_TYPE_MANAGER, NULL);
+  DownloadResult download = { 0, };
+
+  stub = stub_server_new ();
+  manager->is_initial = TRUE;
+
+  run_download (manager, &download);
+
+  g_assert_no_error (download.error);
+  g_assert_nonnull (download.to_upload);
+  g_assert_cmpuint (stub->requests, ==, N_PAGES);
+  g_assert_false (stub->saw_newer);
+  g_assert_false (stub->saw_bad_unmodified_since);
+  g_assert_cmpint (download.last_modified, ==, SERVER_TIMESTAMP);
+
+  /* The whole collection is merged at once. */
+  g_assert_cmpuint (manager->merges, ==, 1);
+  g_assert_cmpuint (manager->initial_merges, ==, 1);
+  assert_all_merged (manager);
+  g_assert_cmpuint (download.to_upload->len, ==, 1);
+
+  g_ptr_array_unref (download.to_upload);
+  stub_server_free (stub);
+}
+
+static void
+test_regular_sync (void)
+{
+  g_autoptr (FakeManager) manager = g_object_new (FAKE_TYPE_MANAGER, NULL);
+  DownloadResult download = { 0, };
+
+  stub = stub_server_new ();
+
+  run_download (manager, &download);
+
+  g_assert_no_error (download.error);
+  g_assert_nonnull (download.to_upload);
+  g_assert_cmpuint (stub->requests, ==, N_PAGES);
+  g_assert_true (stub->saw_newer);
+  g_assert_false (stub->saw_bad_unmodified_since);
+  g_assert_cmpint (download.last_modified, ==, SERVER_TIMESTAMP);
+
+  /* Pages are merged one by one, and uploads are deduplicated. */
+  g_assert_cmpuint (manager->merges, ==, N_PAGES);
+  g_assert_cmpuint (manager->initial_merges, ==, 0);
+  assert_all_merged (manager);
+  g_assert_cmpuint (download.to_upload->len, ==, 1);
+
+  g_ptr_array_unref (download.to_upload);
+  stub_server_free (stub);
+}
+
+/* An initial merge of part of the collection would upload local records
+ * that the rest of it might have changed, so nothing is merged. */
+static void
+test_initial_sync_failure (void)
+{
+  g_autoptr (FakeManager) manager = g_object_new (FAKE_TYPE_MANAGER, NULL);
+  DownloadResult download = { 0, };
+
+  stub = stub_server_new ();
+  stub->fail_request = 3;
+  stub->fail_status = 500;
+  manager->is_initial = TRUE;
+
+  run_download (manager, &download);
+
+  g_assert_error (download.error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_assert_null (download.to_upload);
+  g_assert_cmpuint (stub->requests, ==, 3);
+  g_assert_cmpuint (manager->merges, ==, 0);
+
+  g_error_free (download.error);
+  stub_server_free (stub);
+}
+
+/* The collection changed while paging through it. Pages downloaded before
+ * are merged, but nothing is uploaded. */
+static void
+test_regular_sync_failure (void)
+{
+  g_autoptr (FakeManager) manager = g_object_new (FAKE_TYPE_MANAGER, NULL);
+  DownloadResult download = { 0, };
+
+  stub = stub_server_new ();
+  stub->fail_request = 3;
+  stub->fail_status = 412;
+
+  run_download (manager, &download);
+
+  g_assert_error (download.error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_assert_null (download.to_upload);
+  g_assert_cmpuint (stub->requests, ==, 3);
+  g_assert_cmpuint (manager->merges, ==, 2);
+  g_assert_cmpuint (g_hash_table_size (manager->merged), ==, 2 * EPHY_SYNC_DOWNLOAD_PAGE_SIZE);
+  for (guint i = 0; i < 2 * EPHY_SYNC_DOWNLOAD_PAGE_SIZE; i++) {
+    g_autofree char *id = g_strdup_printf ("record-%u", i);
+    g_assert_true (g_hash_table_contains (manager->merged, id));
+  }
+
+  g_error_free (download.error);
+  stub_server_free (stub);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  ephy_debug_init ();
+
+  g_test_add_func ("/lib/sync/ephy-sync-collection-download/initial_sync", test_initial_sync);
+  g_test_add_func ("/lib/sync/ephy-sync-collection-download/regular_sync", test_regular_sync);
+  g_test_add_func ("/lib/sync/ephy-sync-collection-download/initial_sync_failure", test_initial_sync_failure);
+  g_test_add_func ("/lib/sync/ephy-sync-collection-download/regular_sync_failure", test_regular_sync_failure);
+
+  ret = g_test_run ();
+
+  g_free (aes_key_b64);
+  g_free (hmac_key_b64);
+
+  return ret;
+}
@@ -0,0 +1,209 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ephy-debug.h"
+#include "ephy-sync-crypto.h"
+#include "ephy-sync-utils.h"
+
+#include <glib.h>
+#include <json-glib/json-glib.h>
+#include <string.h>
+
+#define N_RECORDS 20000
+
+static guint8 aes_key[32];
+static guint8 hmac_key[32];
+
+static SyncCryptoKeyBundle *
+create_bundle (void)
+{
+  g_autofree char *aes_key_b64 = g_base64_encode (aes_key, sizeof (aes_key));
+  g_autofree char *hmac_key_b64 = g_base64_encode (hmac_key, sizeof (hmac_key));
+
+  return ephy_sync_crypto_key_bundle_new (aes_key_b64, hmac_key_b64);
+}
+
+static GPtrArray *
+create_cleartexts (guint n)
+{
+  GPtrArray *cleartexts = g_ptr_array_new_with_free_func (g_free);
+
+  for (guint i = 0; i < n; i++) {
+    g_ptr_array_add (cleartexts,
+                     g_strdup_printf ("{\"id\":\"%012u\",\"histUri\":\"https://example.com/%u\","
+                                      "\"title\":\"Example page number %u\",\"visits\":"
+                                      "[{\"date\":1580000000000000,\"type\":1}]}",
+                                      i, i, i));
+  }
+
+  return cleartexts;
+}
+
+static void
+test_round_trip (void)
+{
+  SyncCryptoKeyBundle *bundle = create_bundle ();
+
+  /* Around the AES block size, where padding changes. */
+  for (guint len = 0; len <= 33; len++) {
+    g_autofree char *cleartext = g_strnfill (len, 'a' + len % 26);
+    g_autofree char *payload = ephy_sync_crypto_encrypt_record (cleartext, bundle);
+    g_autofree char *decrypted = ephy_sync_crypto_decrypt_record (payload, bundle);
+
+    g_assert_cmpstr (decrypted, ==, cleartext);
+  }
+
+  ephy_sync_crypto_key_bundle_unref (bundle);
+}
+
+/* The HMAC must stay what other Sync clients compute over the ciphertext. */
+static void
+test_hmac_format (void)
+{
+  SyncCryptoKeyBundle *bundle = create_bundle ();
+  g_autofree char *payload = ephy_sync_crypto_encrypt_record ("{\"id\":\"test\"}", bundle);
+  g_autofree char *expected = NULL;
+  JsonNode *node;
+  JsonObject *object;
+
+  node = json_from_string (payload, NULL);
+  object = json_node_get_object (node);
+  expected = g_compute_hmac_for_string (G_CHECKSUM_SHA256, hmac_key, sizeof (hmac_key),
+                                        json_object_get_string_member (object, "ciphertext"), -1);
+  g_assert_cmpstr (json_object_get_string_member (object, "hmac"), ==, expected);
+
+  json_node_unref (node);
+  ephy_sync_crypto_key_bundle_unref (bundle);
+}
+
+static void
+test_vector_round_trip (void)
+{
+  SyncCryptoKeyBundle *bundle = create_bundle ();
+  g_autoptr (GPtrArray) cleartexts = NULL;
+  g_autoptr (GPtrArray) payloads = NULL;
+  g_autoptr (GPtrArray) decrypted = NULL;
+
+  /* Enough records to use several worker threads, and an uneven tail. */
+  cleartexts = create_cleartexts (1001);
+  payloads = ephy_sync_crypto_encrypt_records (cleartexts, bundle);
+  g_assert_cmpuint (payloads->len, ==, cleartexts->len);
+
+  decrypted = ephy_sync_crypto_decrypt_records (payloads, bundle);
+  g_assert_cmpuint (decrypted->len, ==, cleartexts->len);
+  for (guint i = 0; i < cleartexts->len; i++) {
+    g_autofree char *single = ephy_sync_crypto_decrypt_record (g_ptr_array_index (payloads, i), bundle);
+
+    g_assert_cmpstr (g_ptr_array_index (decrypted, i), ==, g_ptr_array_index (cleartexts, i));
+    g_assert_cmpstr (single, ==, g_ptr_array_index (cleartexts, i));
+  }
+
+  /* Every record gets its own IV. */
+  g_assert_cmpstr (g_ptr_array_index (payloads, 0), !=, g_ptr_array_index (payloads, 1));
+
+  ephy_sync_crypto_key_bundle_unref (bundle);
+}
+
+static void
+test_tampered_payload (void)
+{
+  SyncCryptoKeyBundle *bundle = create_bundle ();
+  g_autoptr (GPtrArray) cleartexts = create_cleartexts (3);
+  g_autoptr (GPtrArray) payloads = NULL;
+  g_autoptr (GPtrArray) decrypted = NULL;
+  char *payload;
+  char *hmac;
+
+  payloads = ephy_sync_crypto_encrypt_records (cleartexts, bundle);
+  payload = g_ptr_array_index (payloads, 1);
+  hmac = strstr (payload, "\"hmac\":\"") + strlen ("\"hmac\":\"");
+  *hmac = *hmac == '0' ? '1' : '0';
+
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "Incorrect HMAC value");
+  decrypted = ephy_sync_crypto_decrypt_records (payloads, bundle);
+  g_test_assert_expected_messages ();
+
+  g_assert_cmpstr (g_ptr_array_index (decrypted, 0), ==, g_ptr_array_index (cleartexts, 0));
+  g_assert_null (g_ptr_array_index (decrypted, 1));
+  g_assert_cmpstr (g_ptr_array_index (decrypted, 2), ==, g_ptr_array_index (cleartexts, 2));
+
+  ephy_sync_crypto_key_bundle_unref (bundle);
+}
+
+static void
+test_throughput (void)
+{
+  SyncCryptoKeyBundle *bundle = create_bundle ();
+  g_autoptr (GPtrArray) cleartexts = create_cleartexts (N_RECORDS);
+  g_autoptr (GPtrArray) payloads = NULL;
+  g_autoptr (GPtrArray) decrypted = NULL;
+  double elapsed;
+
+  g_test_timer_start ();
+  for (guint i = 0; i < N_RECORDS; i++)
+    g_free (ephy_sync_crypto_encrypt_record (g_ptr_array_index (cleartexts, i), bundle));
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed, "Encrypted %u records one by one in %.3f s", N_RECORDS, elapsed);
+
+  g_test_timer_start ();
+  payloads = ephy_sync_crypto_encrypt_records (cleartexts, bundle);
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed, "Encrypted %u records as a vector in %.3f s", N_RECORDS, elapsed);
+
+  g_test_timer_start ();
+  for (guint i = 0; i < N_RECORDS; i++)
+    g_free (ephy_sync_crypto_decrypt_record (g_ptr_array_index (payloads, i), bundle));
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed, "Decrypted %u records one by one in %.3f s", N_RECORDS, elapsed);
+
+  g_test_timer_start ();
+  decrypted = ephy_sync_crypto_decrypt_records (payloads, bundle);
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed, "Decrypted %u records as a vector in %.3f s", N_RECORDS, elapsed);
+
+  g_assert_cmpstr (g_ptr_array_index (decrypted, N_RECORDS - 1), ==,
+                   g_ptr_array_index (cleartexts, N_RECORDS - 1));
+
+  ephy_sync_crypto_key_bundle_unref (bundle);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  ephy_debug_init ();
+
+  ephy_sync_utils_generate_random_bytes (NULL, sizeof (aes_key), aes_key);
+  ephy_sync_utils_generate_random_bytes (NULL, sizeof (hmac_key), hmac_key);
+
+  g_test_add_func ("/lib/sync/ephy-sync-crypto/round_trip", test_round_trip);
+  g_test_add_func ("/lib/sync/ephy-sync-crypto/hmac_format", test_hmac_format);
+  g_test_add_func ("/lib/sync/ephy-sync-crypto/vector_round_trip", test_vector_round_trip);
+  g_test_add_func ("/lib/sync/ephy-sync-crypto/tampered_payload", test_tampered_payload);
+
+  /* Run with -m perf. */
+  if (g_test_perf ())
+    g_test_add_func ("/lib/sync/ephy-sync-crypto/throughput", test_throughput);
+
+  return g_test_run ();
+}
@@ -49,6 +49,10 @@ test_ephy_uri_helpers_remove_tracking (void)
     { "http://www.test.com/?utm_source=feedburner&view=lno&_reqid=1234", "http://www.test.com/?view=lno&_reqid=1234" },
     { "http://www.test.com/?some&valid&query", "http://www.test.com/?some&valid&query" },
     { "http://www.test.com/?utm_source=feedburner&some&valid&query", "http://www.test.com/?some&valid&query" },
+    { "http://www.test.com/?a=1&utm_source=feedburner#utm_medium=feed", "http://www.test.com/?a=1#utm_medium=feed" },
+    { "http://www.test.com/?utm%5Fsource=feedburner&a=1", "http://www.test.com/?a=1" },
+    { "http://user@foo.youtube.com:8080/?a=1&feature=foo&b=2", "http://user@foo.youtube.com:8080/?a=1&b=2" },
+    { "http://www.test.com/#?utm_source=feedburner", "http://www.test.com/#?utm_source=feedburner" },
   };
   guint i;
 
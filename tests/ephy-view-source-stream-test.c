@@ -0,0 +1,152 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ *  Copyright © 2020 The Epiphany authors
+ *
+ *  This file is part of Epiphany.
+ *
+ *  Epiphany is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Epiphany is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Epiphany.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ephy-view-source-stream.h"
+
+#include <glib.h>
+#include <string.h>
+
+/* As in ephy-view-source-stream.c. The source is escaped this many bytes
+ * at a time. */
+#define SOURCE_CHUNK_SIZE (16 * 1024)
+
+/* The last element of the page header, after which the source starts. */
+#define HEADER_END "<code class=\"language-html\">"
+
+/* A tag with a quoted value, an entity, multibyte UTF-8 sequences and a
+ * comment, so that a chunk boundary can be put in the middle of each. */
+static const char snippet[] =
+  "<a href=\"caf\xc3\xa9\" title='x'>&eacute; \xe2\x82\xac</a>"
+  "<!-- a > b -->"
+  "text & \"more\" \xf0\x9f\x8c\x8d\n";
+
+/* Reads in small, odd sized pieces, so that the output is split at awkward
+ * places too. */
+static char *
+read_all (GBytes   *source,
+          gboolean  highlight)
+{
+  GInputStream *stream;
+  GString *out;
+  char buffer[7];
+  gssize n;
+  GError *error = NULL;
+
+  stream = ephy_view_source_stream_new (source, highlight);
+  out = g_string_new (NULL);
+
+  while ((n = g_input_stream_read (stream, buffer, sizeof (buffer), NULL, &error)) > 0)
+    g_string_append_len (out, buffer, n);
+  g_assert_no_error (error);
+
+  g_object_unref (stream);
+
+  return g_string_free (out, FALSE);
+}
+
+/* The page for @padding followed by @snippet, given the page for @snippet
+ * alone. The padding is plain text, so it is copied as is. */
+static char *
+page_with_padding (const char *page,
+                   const char *padding)
+{
+  const char *body = strstr (page, HEADER_END);
+
+  g_assert_nonnull (body);
+  body += strlen (HEADER_END);
+
+  return g_strdup_printf ("%.*s%s%s", (int)(body - page), page, padding, body);
+}
+
+static void
+check_chunk_boundaries (gboolean highlight)
+{
+  g_autoptr (GBytes) snippet_bytes = NULL;
+  g_autofree char *one_shot = NULL;
+  gsize snippet_length = strlen (snippet);
+
+  /* Shorter than a chunk, so escaped in one go. */
+  snippet_bytes = g_bytes_new_static (snippet, snippet_length);
+  one_shot = read_all (snippet_bytes, highlight);
+
+  /* Put the chunk boundary before each byte of the snippet in turn. */
+  for (gsize offset = 0; offset <= snippet_length; offset++) {
+    g_autoptr (GBytes) source = NULL;
+    g_autofree char *padding = NULL;
+    g_autofree char *data = NULL;
+    g_autofree char *expected = NULL;
+    g_autofree char *actual = NULL;
+
+    padding = g_strnfill (SOURCE_CHUNK_SIZE - offset, 'x');
+    data = g_strconcat (padding, snippet, NULL);
+    source = g_bytes_new (data, strlen (data));
+
+    expected = page_with_padding (one_shot, padding);
+    actual = read_all (source, highlight);
+    g_assert_cmpstr (actual, ==, expected);
+    g_assert_true (g_utf8_validate (actual, -1, NULL));
+  }
+}
+
+static void
+test_escape_chunk_boundaries (void)
+{
+  check_chunk_boundaries (FALSE);
+}
+
+static void
+test_highlight_chunk_boundaries (void)
+{
+  check_chunk_boundaries (TRUE);
+}
+
+static void
+test_escape_matches_markup_escape (void)
+{
+  g_autoptr (GBytes) source = NULL;
+  g_autofree char *page = NULL;
+  g_autofree char *escaped = NULL;
+  g_autofree char *expected = NULL;
+
+  source = g_bytes_new_static (snippet, strlen (snippet));
+  page = read_all (source, FALSE);
+
+  /* Everything between the header and the footer is the escaped source. */
+  escaped = g_markup_escape_text (snippet, -1);
+  expected = g_strconcat ("<body><pre>" HEADER_END, escaped, "</code></pre></body>", NULL);
+  g_assert_cmpstr (page, ==, expected);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/embed/view-source-stream/escape_matches_markup_escape",
+                   test_escape_matches_markup_escape);
+  g_test_add_func ("/embed/view-source-stream/escape_chunk_boundaries",
+                   test_escape_chunk_boundaries);
+  g_test_add_func ("/embed/view-source-stream/highlight_chunk_boundaries",
+                   test_highlight_chunk_boundaries);
+
+  return g_test_run ();
+}